@@ -5,12 +5,13 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 
-static int createNonblocking()
+static int createNonblocking(sa_family_t family)
 {
-    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, family == AF_UNIX ? 0 : IPPROTO_TCP);
     if (sockfd < 0)
     {
         LOG_FATAL("%s:%s:%d listen sockfd create err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
@@ -18,23 +19,85 @@ static int createNonblocking()
     return sockfd;
 }
 
+// 路径上已经有socket文件的时候先connect一下: ECONNREFUSED说明没人在监听 是上次异常退出留下的 可以删
+// 连上了(或者backlog满了EAGAIN)说明另一个进程正在用 不能删 让后面的bind报EADDRINUSE
+// 不是socket(ENOTSOCK 普通文件) 没权限之类的也不删
+static void removeStaleUnixSocket(const InetAddress &addr)
+{
+    int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (probe < 0)
+    {
+        return;
+    }
+    int ret = ::connect(probe, addr.sockAddr(), addr.sockLen());
+    int savedErrno = ret == 0 ? 0 : errno;
+    ::close(probe);
+    if (savedErrno == ECONNREFUSED)
+    {
+        ::unlink(addr.toIP().c_str());
+    }
+    else if (savedErrno != ENOENT)
+    {
+        LOG_ERROR("Acceptor %s is in use (probe err:%d) not removing it\n", addr.toIpPort().c_str(), savedErrno);
+    }
+}
+
 Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport)
     : loop_(loop),
-      acceptSocket_(createNonblocking()), // socket
+      acceptSocket_(createNonblocking(listenAddr.family())), // socket
       acceptChannel_(loop, acceptSocket_.fd()),
       listenning_(false)
 {
-    acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    if (listenAddr.isUnix())
+    {
+        // 文件系统里面的路径 上次没删掉的socket文件会让bind失败(EADDRINUSE) 确认是没人监听的旧文件才删 析构的时候再删
+        // abstract namespace没有文件 不用管
+        if (!listenAddr.isAbstract())
+        {
+            unixPath_ = listenAddr.toIP();
+            if (!unixPath_.empty())
+            {
+                removeStaleUnixSocket(listenAddr);
+            }
+        }
+    }
+    else
+    {
+        acceptSocket_.setReuseAddr(true);
+        acceptSocket_.setReusePort(true);
+    }
     acceptSocket_.bindAddress(listenAddr); // bind
     // TcpServer::start() Acceptor.listen 有新用户的连接, 要执行一个回调(connfd=>channel=>subloop)
     // baseloop=>acceptChannel_(listenfd)=>
     acceptChannel_.setReadcallback(std::bind(&Acceptor::handleRead, this)); // 绑定的函数是 触发事件后要执行的函数
 }
+
+// 接管一个已经bind(一般也已经listen)好的socket 比如热升级的时候从旧进程传过来的
+Acceptor::Acceptor(EventLoop *loop, int listenfd)
+    : loop_(loop),
+      acceptSocket_(listenfd),
+      acceptChannel_(loop, listenfd),
+      listenning_(false)
+{
+    // O_NONBLOCK在同一个打开的文件上 旧进程那边也是非阻塞的 不影响它
+    ::fcntl(listenfd, F_SETFL, ::fcntl(listenfd, F_GETFL) | O_NONBLOCK);
+    ::fcntl(listenfd, F_SETFD, FD_CLOEXEC);
+    InetAddress localAddr(InetAddress::localAddressOf(listenfd));
+    if (localAddr.isUnix() && !localAddr.isAbstract())
+    {
+        unixPath_ = localAddr.toIP(); // 接管了以后socket文件也归这边删
+    }
+    acceptChannel_.setReadcallback(std::bind(&Acceptor::handleRead, this));
+}
+
 Acceptor::~Acceptor()
 {
     acceptChannel_.disableAll();
     acceptChannel_.remove();
+    if (!unixPath_.empty())
+    {
+        ::unlink(unixPath_.c_str());
+    }
 }
 
 void Acceptor::listen()
@@ -44,6 +107,16 @@ void Acceptor::listen()
     acceptChannel_.enableReading();//accpentchannel_==>>poller
 }
 
+void Acceptor::stopAccepting()
+{
+    if (listenning_)
+    {
+        listenning_ = false;
+        acceptChannel_.disableAll();
+    }
+    unixPath_.clear();
+}
+
 // listenfd 有事件发生了 就是有新用户连接了
 void Acceptor::handleRead()
 {
@@ -60,7 +133,7 @@ void Acceptor::handleRead()
             ::close(connfd);
         }
     }
-    else
+    else if (errno != EAGAIN) // 热升级的时候新旧两个进程都在等同一个socket 没抢到的是EAGAIN
     {
         LOG_ERROR("%s:%s:%d accept err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
         if (errno == EMFILE)
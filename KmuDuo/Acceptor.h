@@ -3,6 +3,7 @@
 #include "Socket.h"
 #include "Channel.h"
 #include <functional>
+#include <string>
 
 class EventLoop;
 class InetAddress;
@@ -12,11 +13,17 @@ class Acceptor : noncopyable
 public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress &)>;
     Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport);
+    // 接管一个已经bind好的socket(热升级的时候从旧进程传过来的) 不再bind
+    Acceptor(EventLoop *loop, int listenfd);
     ~Acceptor();
 
     void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
     bool listenning() const { return listenning_; }
     void listen();
+    // 在loop线程里面调用 不再accept 已经排在队列里面的连接留给同一个socket的其他持有者(热升级的新进程)
+    // socket文件的所有权也交出去了 析构的时候不删
+    void stopAccepting();
+    int fd() const { return acceptSocket_.fd(); }
 
 private:
     void handleRead();  
@@ -26,4 +33,5 @@ private:
     Channel acceptChannel_;
     NewConnectionCallback newConnectionCallback_;
     bool listenning_;
+    std::string unixPath_; // 监听AF_UNIX路径的时候 析构的时候删掉socket文件
 };
\ No newline at end of file
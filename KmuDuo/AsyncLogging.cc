@@ -0,0 +1,276 @@
+#include "AsyncLogging.h"
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+AsyncLogging::AsyncLogging(const std::string &filename,
+                           int flushIntervalSec,
+                           size_t maxBuffers,
+                           OverflowPolicy policy)
+    : filename_(filename),
+      flushIntervalSec_(flushIntervalSec),
+      maxBuffers_(maxBuffers < 2 ? 2 : maxBuffers),
+      policy_(policy),
+      fd_(-1),
+      running_(false),
+      dropped_(0),
+      droppedReported_(0),
+      thread_(std::bind(&AsyncLogging::threadFunc, this), "AsyncLogging"),
+      currentBuffer_(new LogBuffer),
+      nextBuffer_(new LogBuffer),
+      allocated_(2),
+      flushRequested_(0),
+      flushDone_(0)
+{
+}
+
+AsyncLogging::~AsyncLogging()
+{
+    stop();
+}
+
+void AsyncLogging::start()
+{
+    if (logFile_)
+    {
+        fd_ = -1; // 日志写到LogFile里面
+    }
+    else if (filename_.empty())
+    {
+        fd_ = STDOUT_FILENO;
+    }
+    else
+    {
+        fd_ = ::open(filename_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd_ < 0)
+        {
+            fprintf(stderr, "AsyncLogging open %s error:%d\n", filename_.c_str(), errno);
+            fd_ = STDOUT_FILENO;
+        }
+    }
+    running_ = true;
+    thread_.start();
+}
+
+void AsyncLogging::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!running_)
+        {
+            return;
+        }
+        running_ = false;
+        cond_.notify_one();
+    }
+    thread_.join(); // 后台线程退出之前会把剩下的日志写完
+    if (logFile_)
+    {
+        logFile_->sync(true);
+    }
+    else if (fd_ >= 0 && fd_ != STDOUT_FILENO)
+    {
+        ::close(fd_);
+    }
+    fd_ = -1;
+}
+
+AsyncLogging::BufferPtr AsyncLogging::takeFreeBuffer()
+{
+    BufferPtr buf;
+    if (!freeBuffers_.empty())
+    {
+        buf = std::move(freeBuffers_.back());
+        freeBuffers_.pop_back();
+    }
+    else if (allocated_ < maxBuffers_)
+    {
+        buf.reset(new LogBuffer);
+        allocated_++;
+    }
+    return buf;
+}
+
+void AsyncLogging::append(const char *line, size_t len)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (currentBuffer_ && currentBuffer_->avail() > len)
+    {
+        memcpy(currentBuffer_->data.get() + currentBuffer_->len, line, len);
+        currentBuffer_->len += len;
+        return;
+    }
+
+    // 当前缓冲区写满了 交给后台线程 换一块新的
+    if (currentBuffer_)
+    {
+        buffers_.push_back(std::move(currentBuffer_));
+        cond_.notify_one();
+    }
+    if (nextBuffer_)
+    {
+        currentBuffer_ = std::move(nextBuffer_);
+    }
+    else
+    {
+        currentBuffer_ = takeFreeBuffer();
+        while (!currentBuffer_ && policy_ == kBlock && running_)
+        {
+            freeCond_.wait(lock);
+            currentBuffer_ = takeFreeBuffer();
+        }
+    }
+
+    if (!currentBuffer_ || currentBuffer_->avail() <= len)
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed); // 内存用完了 或者一行比整个缓冲区还长
+        return;
+    }
+    memcpy(currentBuffer_->data.get() + currentBuffer_->len, line, len);
+    currentBuffer_->len += len;
+}
+
+void AsyncLogging::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!running_)
+    {
+        return;
+    }
+    long seq = ++flushRequested_;
+    cond_.notify_one();
+    while (flushDone_ < seq && running_)
+    {
+        freeCond_.wait(lock);
+    }
+}
+
+void AsyncLogging::writeBuffers(const BufferVector &buffers)
+{
+    if (logFile_)
+    {
+        for (const BufferPtr &buf : buffers)
+        {
+            logFile_->append(buf->data.get(), buf->len);
+        }
+        logFile_->sync(false); // 空闲唤醒的时候也要检查fsync间隔
+        return;
+    }
+
+    struct iovec vec[IOV_MAX];
+    size_t i = 0;
+    while (i < buffers.size())
+    {
+        int cnt = 0;
+        for (; i < buffers.size() && cnt < IOV_MAX; i++)
+        {
+            if (buffers[i]->len > 0)
+            {
+                vec[cnt].iov_base = buffers[i]->data.get();
+                vec[cnt].iov_len = buffers[i]->len;
+                cnt++;
+            }
+        }
+        // writev可能只写了一部分 剩下的接着写
+        struct iovec *iov = vec;
+        while (cnt > 0)
+        {
+            ssize_t n = ::writev(fd_, iov, cnt);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                fprintf(stderr, "AsyncLogging writev error:%d\n", errno);
+                break;
+            }
+            while (cnt > 0 && static_cast<size_t>(n) >= iov->iov_len)
+            {
+                n -= iov->iov_len;
+                iov++;
+                cnt--;
+            }
+            if (cnt > 0)
+            {
+                iov->iov_base = static_cast<char *>(iov->iov_base) + n;
+                iov->iov_len -= n;
+            }
+        }
+    }
+}
+
+void AsyncLogging::threadFunc()
+{
+    BufferVector buffersToWrite;
+    while (true)
+    {
+        long flushSeq;
+        bool running;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (buffers_.empty() && running_ && flushRequested_ == flushDone_)
+            {
+                cond_.wait_for(lock, std::chrono::seconds(flushIntervalSec_));
+            }
+            // 不管写没写满 当前缓冲区也一起写出去 最多延迟flushIntervalSec_秒
+            if (currentBuffer_ && currentBuffer_->len > 0)
+            {
+                buffers_.push_back(std::move(currentBuffer_));
+                currentBuffer_ = takeFreeBuffer();
+            }
+            buffersToWrite.swap(buffers_);
+            flushSeq = flushRequested_;
+            running = running_;
+        }
+
+        long dropped = dropped_.load(std::memory_order_relaxed);
+        if (dropped != droppedReported_)
+        {
+            char buf[128];
+            int n = snprintf(buf, sizeof buf, "[ERROR]AsyncLogging dropped %ld log lines\n", dropped - droppedReported_);
+            if (logFile_)
+            {
+                logFile_->append(buf, n);
+            }
+            else
+            {
+                ::write(fd_, buf, n);
+            }
+            droppedReported_ = dropped;
+        }
+        writeBuffers(buffersToWrite);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (BufferPtr &buf : buffersToWrite)
+            {
+                buf->len = 0;
+                if (!nextBuffer_)
+                {
+                    nextBuffer_ = std::move(buf);
+                }
+                else if (!currentBuffer_)
+                {
+                    currentBuffer_ = std::move(buf);
+                }
+                else
+                {
+                    freeBuffers_.push_back(std::move(buf));
+                }
+            }
+            buffersToWrite.clear();
+            flushDone_ = flushSeq;
+            freeCond_.notify_all();
+            if (!running && buffers_.empty() && (!currentBuffer_ || currentBuffer_->len == 0))
+            {
+                break;
+            }
+        }
+    }
+}
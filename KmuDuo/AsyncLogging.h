@@ -0,0 +1,93 @@
+#pragma once
+#include "noncopyable.h"
+#include "Thread.h"
+#include "LogFile.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+/*
+ * 异步日志后端 双缓冲: 前端(io线程)只把格式化好的一行日志拷贝到currentBuffer_
+ * 后台线程把写满的缓冲区一次性交换出来 用writev批量写到文件 io线程不会阻塞在write/flush上
+ * 缓冲区总数不超过maxBuffers 写不过来的时候按OverflowPolicy 丢掉新日志(记录丢了多少条)或者阻塞前端
+ *
+ * 用法:
+ *   AsyncLogging log("/tmp/server.log");
+ *   log.start();
+ *   Logger::instance().setOutput(std::bind(&AsyncLogging::append, &log, _1, _2));
+ *   Logger::instance().setFlush(std::bind(&AsyncLogging::flush, &log));
+ * 需要按大小/时间滚动的时候 start之前setLogFile(一个LogFile) 日志就写到预分配并mmap的文件段里面
+ */
+class AsyncLogging : noncopyable
+{
+public:
+    enum OverflowPolicy
+    {
+        kDropNewest, // 缓冲区用完了丢掉新来的日志
+        kBlock,      // 缓冲区用完了前端等待后台线程写完
+    };
+
+    static const size_t kBufferSize = 4 * 1024 * 1024;
+
+    // filename为空的时候写到stdout
+    explicit AsyncLogging(const std::string &filename,
+                          int flushIntervalSec = 3,
+                          size_t maxBuffers = 16,
+                          OverflowPolicy policy = kDropNewest);
+    ~AsyncLogging();
+
+    // 用滚动日志文件代替构造时的filename 必须在start之前调用
+    void setLogFile(std::unique_ptr<LogFile> file) { logFile_ = std::move(file); }
+
+    void start();
+    void stop();
+
+    // 前端接口 任意线程都可以调用
+    void append(const char *line, size_t len);
+    // 等待目前为止append的日志全部写到文件
+    void flush();
+
+    long dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    struct LogBuffer
+    {
+        std::unique_ptr<char[]> data;
+        size_t len;
+        LogBuffer() : data(new char[kBufferSize]), len(0) {}
+        size_t avail() const { return kBufferSize - len; }
+    };
+    using BufferPtr = std::unique_ptr<LogBuffer>;
+    using BufferVector = std::vector<BufferPtr>;
+
+    void threadFunc();
+    // 持有mutex_的时候调用 拿一块空闲的缓冲区 没有了并且不能再申请就返回空
+    BufferPtr takeFreeBuffer();
+    void writeBuffers(const BufferVector &buffers);
+
+    const std::string filename_;
+    const int flushIntervalSec_;
+    const size_t maxBuffers_;
+    const OverflowPolicy policy_;
+    int fd_;
+    std::unique_ptr<LogFile> logFile_; // 为空的时候writev到fd_
+
+    std::atomic_bool running_;
+    std::atomic<long> dropped_;
+    long droppedReported_; // 后台线程已经在日志里面报告过的丢弃条数
+    Thread thread_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;     // 唤醒后台线程
+    std::condition_variable freeCond_; // kBlock策略下 等待空闲缓冲区 / 等待flush完成
+    BufferPtr currentBuffer_;
+    BufferPtr nextBuffer_;
+    BufferVector buffers_;     // 写满了等待后台线程写出去的
+    BufferVector freeBuffers_; // 写完了可以复用的
+    size_t allocated_;         // 已经申请的缓冲区总数
+    long flushRequested_;
+    long flushDone_;
+};
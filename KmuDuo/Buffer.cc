@@ -1,4 +1,5 @@
 #include "Buffer.h"
+#include "Socket.h"
 #include <errno.h>
 #include <sys/uio.h>
 #include <unistd.h>
@@ -7,6 +8,11 @@
 buffer缓冲区是有大小的,但是从fd上读取数据的时候,却不知道tcp数据的最终大小
 */
 ssize_t Buffer::readFd(int fd, int *saveErrno)
+{
+    return readFd(fd, saveErrno, nullptr);
+}
+
+ssize_t Buffer::readFd(int fd, int *saveErrno, std::vector<int> *fds)
 {
     char extrabuf[65536] = {0}; // 栈上的内存空间
 
@@ -20,7 +26,7 @@ ssize_t Buffer::readFd(int fd, int *saveErrno)
     vec[1].iov_len = sizeof(extrabuf);
 
     const int iovcnt = (writable < sizeof extrabuf) ? 2 : 1;
-    const ssize_t n = ::readv(fd, vec, iovcnt);
+    const ssize_t n = fds ? Socket::recvWithFds(fd, vec, iovcnt, fds) : ::readv(fd, vec, iovcnt);
     if (n < 0)
     {
         *saveErrno = errno;
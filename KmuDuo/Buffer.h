@@ -26,6 +26,12 @@ public:
     {
     }
 
+    // 底层vector占用的内存
+    size_t internalCapacity() const
+    {
+        return buffer_.capacity();
+    }
+
     // 返回可读的字节数
     size_t readableBytes() const
     {
@@ -106,6 +112,8 @@ public:
 
     // 从fd上读取数据
     ssize_t readFd(int fd, int *saveErrno);
+    // AF_UNIX 和readFd一样 另外把这次收到的SCM_RIGHTS的fd放进fds
+    ssize_t readFd(int fd, int *saveErrno, std::vector<int> *fds);
 
     // 通过fd发送数据   
     ssize_t writeFd(int fd, int *saveErrno);
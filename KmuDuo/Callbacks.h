@@ -13,4 +13,6 @@ using WriteCompleteCallback = std::function<void(const TcpConnectionPtr &)>;
 using MessageCallback = std::function<void(const TcpConnectionPtr &,
                                            Buffer *,
                                            Timestamp)>;
-using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr &,size_t)>;
\ No newline at end of file
+using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr &,size_t)>;
+// AF_UNIX连接收到对端用SCM_RIGHTS传过来的fd 回调拿到fd的所有权(用完要自己关)
+using FdCallback = std::function<void(const TcpConnectionPtr &, int fd)>;
\ No newline at end of file
@@ -52,6 +52,13 @@ void Channel::remove()
      loop_->removeChannel(this);
 }
 
+void Channel::moveToLoop(EventLoop *loop)
+{
+    loop_->removeChannel(this);
+    loop_ = loop;
+    index_ = -1; // 对新的poller来说是一个全新的channel(kNew)
+}
+
 // fd得到poller通知以后,处理事件的。
 void Channel::handleEvent(Timestamp receiveTime)
 {
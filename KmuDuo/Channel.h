@@ -36,6 +36,7 @@ public:
     int fd()const {return fd_;}
     int events()const{return events_;}
     int set_revents(int revt){revents_=revt;return 0;}
+    int revents()const{return revents_;}
     
 
     //设置fd相应的事件状态
@@ -58,6 +59,12 @@ public:
     EventLoop* ownerLoop(){return loop_;}
     void remove();
 
+    // 连接迁移: 把channel从当前loop的poller里面摘掉,换到新的loop上 events_保持不变
+    // 必须在旧loop的线程里面调用
+    void moveToLoop(EventLoop *loop);
+    // 在新loop的线程里面调用 按照原来的events_重新注册到新loop的poller上
+    void restoreEvents(){if(!isNoneEvent()){update();}}
+
 private:
     void update();
     void handleEventWithGuard(Timestamp receiveTime);
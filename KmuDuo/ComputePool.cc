@@ -0,0 +1,174 @@
+#include "ComputePool.h"
+
+// 当前线程如果是某个ComputePool的worker 记录下是哪个pool的第几个worker
+static __thread ComputePool *t_pool = nullptr;
+static __thread int t_workerIndex = -1;
+
+ComputePool::ComputePool(const std::string &name, size_t maxQueueSize)
+    : name_(name),
+      maxQueueSize_(maxQueueSize),
+      localTasks_(0),
+      idle_(0),
+      stolen_(0),
+      running_(false)
+{
+}
+
+ComputePool::~ComputePool()
+{
+    stop();
+}
+
+void ComputePool::start(int numThreads)
+{
+    running_ = true;
+    for (int i = 0; i < numThreads; i++)
+    {
+        workers_.push_back(std::unique_ptr<Worker>(new Worker));
+    }
+    for (int i = 0; i < numThreads; i++)
+    {
+        char buf[name_.size() + 32];
+        snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
+        threads_.push_back(std::unique_ptr<Thread>(new Thread(std::bind(&ComputePool::threadFunc, this, i), buf)));
+        threads_.back()->start();
+    }
+}
+
+void ComputePool::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!running_)
+        {
+            return;
+        }
+        running_ = false;
+        notEmpty_.notify_all();
+    }
+    for (auto &t : threads_)
+    {
+        t->join();
+    }
+    threads_.clear();
+}
+
+size_t ComputePool::queueSize() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return injection_.size() + localTasks_;
+}
+
+bool ComputePool::submit(Task task)
+{
+    if (t_pool == this)
+    {
+        // worker自己产生的子任务 放进自己的双端队列 不占全局队列的名额
+        Worker &w = *workers_[t_workerIndex];
+        {
+            std::unique_lock<std::mutex> lock(w.mutex);
+            w.tasks.push_back(std::move(task));
+        }
+        ++localTasks_;
+        // 和threadFunc里面先idle_++再检查localTasks_配对 两边都是seq_cst 不会丢唤醒
+        if (idle_ > 0)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            notEmpty_.notify_one();
+        }
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    // 还没start或者已经stop了 放进去也没有线程执行 调用者(offload)会退回到自己执行
+    if (!running_ || injection_.size() >= maxQueueSize_)
+    {
+        return false;
+    }
+    injection_.push_back(std::move(task));
+    if (idle_ > 0)
+    {
+        notEmpty_.notify_one();
+    }
+    return true;
+}
+
+bool ComputePool::popLocal(int index, Task *task)
+{
+    Worker &w = *workers_[index];
+    std::unique_lock<std::mutex> lock(w.mutex);
+    if (w.tasks.empty())
+    {
+        return false;
+    }
+    *task = std::move(w.tasks.back());
+    w.tasks.pop_back();
+    --localTasks_;
+    return true;
+}
+
+bool ComputePool::popGlobal(Task *task)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (injection_.empty())
+    {
+        return false;
+    }
+    *task = std::move(injection_.front());
+    injection_.pop_front();
+    return true;
+}
+
+bool ComputePool::steal(int index, Task *task)
+{
+    if (localTasks_ == 0)
+    {
+        return false;
+    }
+    int n = static_cast<int>(workers_.size());
+    for (int i = 1; i < n; i++)
+    {
+        Worker &victim = *workers_[(index + i) % n];
+        std::unique_lock<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            *task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --localTasks_;
+            stolen_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ComputePool::threadFunc(int index)
+{
+    t_pool = this;
+    t_workerIndex = index;
+
+    while (true)
+    {
+        Task task;
+        if (popLocal(index, &task) || popGlobal(&task) || steal(index, &task))
+        {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        ++idle_;
+        while (running_ && injection_.empty() && localTasks_ == 0)
+        {
+            notEmpty_.wait(lock);
+        }
+        --idle_;
+        if (!running_ && injection_.empty() && localTasks_ == 0)
+        {
+            break;
+        }
+    }
+
+    t_pool = nullptr;
+    t_workerIndex = -1;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "noncopyable.h"
+#include "Thread.h"
+#include <functional>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+/*
+ * 计算线程池 专门跑CPU密集的消息处理(压缩 加解密 JSON...) 不让它们阻塞io loop
+ * io loop通过submit把任务放进有界的全局注入队列 队列满了submit返回false
+ * worker线程里面再submit的任务放进自己的双端队列 自己从尾部取(LIFO) 空闲的worker从别人的头部偷(FIFO)
+ * 一般通过TcpConnection::offload使用 结果再投递回连接所属的loop
+ */
+class ComputePool : noncopyable
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit ComputePool(const std::string &name = std::string("ComputePool"), size_t maxQueueSize = 65536);
+    ~ComputePool();
+
+    void start(int numThreads);
+    void stop();
+
+    // 任意线程都可以调用  全局注入队列满了 还没start或者已经stop了返回false 由调用者决定丢弃还是自己执行
+    bool submit(Task task);
+
+    const std::string &name() const { return name_; }
+    size_t queueSize() const;
+    // 被偷走执行的任务数
+    long stolen() const { return stolen_.load(std::memory_order_relaxed); }
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void threadFunc(int index);
+    bool popLocal(int index, Task *task);
+    bool popGlobal(Task *task);
+    bool steal(int index, Task *task);
+
+    std::string name_;
+    size_t maxQueueSize_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::unique_ptr<Thread>> threads_;
+
+    mutable std::mutex mutex_; // 保护injection_ 同时配合notEmpty_让空闲的worker睡眠
+    std::condition_variable notEmpty_;
+    std::deque<Task> injection_;
+
+    std::atomic<int> localTasks_; // 所有worker双端队列里面的任务总数
+    std::atomic<int> idle_;       // 正在睡眠的worker数
+    std::atomic<long> stolen_;
+    std::atomic_bool running_;
+};
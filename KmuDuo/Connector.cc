@@ -0,0 +1,328 @@
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "logger.h"
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <netinet/in.h>
+#include <chrono>
+
+static int createNonblockingOrDie(sa_family_t family)
+{
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, family == AF_UNIX ? 0 : IPPROTO_TCP);
+    if (sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d connect sockfd create err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
+static int getSocketError(int sockfd)
+{
+    int optval;
+    socklen_t optlen = sizeof optval;
+    if (::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    {
+        return errno;
+    }
+    return optval;
+}
+
+// 本地端口和服务器端口相同的时候 连接自己的临时端口会"连上"自己 AF_UNIX没有这个问题
+static bool isSelfConnect(int sockfd)
+{
+    InetAddress localAddr(InetAddress::localAddressOf(sockfd));
+    if (localAddr.isUnix())
+    {
+        return false;
+    }
+    sockaddr_in local, peer;
+    ::bzero(&local, sizeof local);
+    ::bzero(&peer, sizeof peer);
+    socklen_t len = sizeof local;
+    ::getsockname(sockfd, (sockaddr *)&local, &len);
+    len = sizeof peer;
+    ::getpeername(sockfd, (sockaddr *)&peer, &len);
+    return local.sin_port == peer.sin_port && local.sin_addr.s_addr == peer.sin_addr.s_addr;
+}
+
+Connector::Connector(EventLoop *loop, const InetAddress &serverAddr)
+    : loop_(loop),
+      serverAddr_(serverAddr),
+      connect_(false),
+      state_(kDisconnected),
+      maxRetries_(-1),
+      initRetryDelayMs_(kInitRetryDelayMs),
+      maxRetryDelayMs_(kMaxRetryDelayMs),
+      retryDelayMs_(kInitRetryDelayMs),
+      retries_(0),
+      timerfd_(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+      rng_(static_cast<unsigned>(std::chrono::steady_clock::now().time_since_epoch().count()) ^
+           static_cast<unsigned>(reinterpret_cast<uintptr_t>(this)))
+{
+    if (timerfd_ < 0)
+    {
+        LOG_FATAL("%s:%s:%d timerfd create err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    LOG_INFO("Connector ctor[%s]\n", serverAddr_.toIpPort().c_str());
+}
+
+// 应该在loop线程里面 或者loop已经不转了以后析构 一般先stop
+Connector::~Connector()
+{
+    if (channel_)
+    {
+        int sockfd = channel_->fd();
+        channel_->disableAll();
+        channel_->remove();
+        ::close(sockfd);
+    }
+    if (timerChannel_)
+    {
+        timerChannel_->disableAll();
+        timerChannel_->remove();
+    }
+    ::close(timerfd_);
+}
+
+void Connector::setRetryDelay(int initRetryDelayMs, int maxRetryDelayMs)
+{
+    if (initRetryDelayMs <= 0 || maxRetryDelayMs < initRetryDelayMs)
+    {
+        LOG_FATAL("Connector::setRetryDelay init:%d max:%d\n", initRetryDelayMs, maxRetryDelayMs);
+    }
+    initRetryDelayMs_ = initRetryDelayMs;
+    maxRetryDelayMs_ = maxRetryDelayMs;
+    retryDelayMs_ = initRetryDelayMs;
+}
+
+void Connector::start()
+{
+    connect_ = true;
+    loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+}
+
+void Connector::startInLoop()
+{
+    if (connect_ && state_ == kDisconnected)
+    {
+        connect();
+    }
+}
+
+void Connector::restart()
+{
+    setState(kDisconnected);
+    retryDelayMs_ = initRetryDelayMs_;
+    retries_ = 0;
+    connect_ = true;
+    startInLoop();
+}
+
+void Connector::stop()
+{
+    connect_ = false;
+    loop_->queueLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+}
+
+void Connector::stopInLoop()
+{
+    cancelRetryTimer();
+    if (state_ == kConnecting)
+    {
+        setState(kDisconnected);
+        int sockfd = removeAndResetChannel();
+        ::close(sockfd);
+    }
+}
+
+void Connector::connect()
+{
+    int sockfd = createNonblockingOrDie(serverAddr_.family());
+    int ret = ::connect(sockfd, serverAddr_.sockAddr(), serverAddr_.sockLen());
+    int savedErrno = (ret == 0) ? 0 : errno;
+    switch (savedErrno)
+    {
+    case 0:
+    case EINPROGRESS:
+    case EINTR:
+    case EISCONN:
+        connecting(sockfd);
+        break;
+
+    // 本地临时端口用完 对方没有监听 网络不通 过一会儿再试
+    case EAGAIN:
+    case EADDRINUSE:
+    case EADDRNOTAVAIL:
+    case ECONNREFUSED:
+    case ENETUNREACH:
+    case ETIMEDOUT:
+        retry(sockfd, savedErrno);
+        break;
+
+    // AF_UNIX的socket文件还没创建出来(服务器还没起来 或者正在重启) 和TCP的ECONNREFUSED一样对待
+    case ENOENT:
+        if (serverAddr_.isUnix())
+        {
+            retry(sockfd, savedErrno);
+            break;
+        }
+        // fall through
+
+    // 地址或者参数错了 重试也没用
+    default:
+        LOG_ERROR("Connector::connect[%s] unexpected error:%d %s\n",
+                  serverAddr_.toIpPort().c_str(), savedErrno, strerror(savedErrno));
+        ::close(sockfd);
+        setState(kDisconnected);
+        giveUp(savedErrno);
+        break;
+    }
+}
+
+void Connector::connecting(int sockfd)
+{
+    setState(kConnecting);
+    channel_.reset(new Channel(loop_, sockfd));
+    // 回调里面用户可能释放掉最后一个ConnectorPtr(比如连接池连上/放弃以后从pending里面拿掉)
+    // tie住 处理事件的时候持有一份 Connector和这个channel等handleEvent返回以后才析构
+    channel_->tie(shared_from_this());
+    channel_->setWritecallback(std::bind(&Connector::handleWrite, this));
+    channel_->setErrorcallback(std::bind(&Connector::handleError, this));
+    channel_->enableWriting();
+}
+
+// 正在Channel::handleEvent里面 不能马上释放channel_ 放到这一轮事件处理完以后
+int Connector::removeAndResetChannel()
+{
+    channel_->disableAll();
+    channel_->remove();
+    int sockfd = channel_->fd();
+    loop_->queueLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+    return sockfd;
+}
+
+void Connector::resetChannel()
+{
+    // 排队期间可能又开始了一次新的连接 那个channel不能动
+    if (channel_ && channel_->isNoneEvent())
+    {
+        channel_.reset();
+    }
+}
+
+void Connector::handleWrite()
+{
+    if (state_ != kConnecting)
+    {
+        return;
+    }
+    int sockfd = removeAndResetChannel();
+    int err = getSocketError(sockfd);
+    if (err)
+    {
+        LOG_INFO("Connector::handleWrite[%s] SO_ERROR=%d %s\n", serverAddr_.toIpPort().c_str(), err, strerror(err));
+        retry(sockfd, err);
+    }
+    else if (isSelfConnect(sockfd))
+    {
+        LOG_ERROR("Connector::handleWrite[%s] self connect\n", serverAddr_.toIpPort().c_str());
+        retry(sockfd, ECONNREFUSED);
+    }
+    else
+    {
+        // sockfd交出去以后这个Connector就没事了 回到初始状态
+        // 之后的start(TcpClient断开以后再connect)或者restart都从头开始连 重试次数和间隔也从头算
+        setState(kDisconnected);
+        retryDelayMs_ = initRetryDelayMs_;
+        retries_ = 0;
+        if (connect_ && newConnectionCallback_)
+        {
+            newConnectionCallback_(sockfd);
+        }
+        else
+        {
+            ::close(sockfd);
+        }
+    }
+}
+
+void Connector::handleError()
+{
+    if (state_ == kConnecting)
+    {
+        int sockfd = removeAndResetChannel();
+        int err = getSocketError(sockfd);
+        LOG_INFO("Connector::handleError[%s] SO_ERROR=%d %s\n", serverAddr_.toIpPort().c_str(), err, strerror(err));
+        retry(sockfd, err);
+    }
+}
+
+void Connector::retry(int sockfd, int err)
+{
+    ::close(sockfd);
+    setState(kDisconnected);
+    if (!connect_)
+    {
+        return;
+    }
+    if (maxRetries_ >= 0 && retries_ >= maxRetries_)
+    {
+        giveUp(err);
+        return;
+    }
+    // 带抖动的指数退避: 在[delay/2, delay]里面随机等一段时间
+    int delayMs = retryDelayMs_ / 2 + static_cast<int>(rng_() % (retryDelayMs_ - retryDelayMs_ / 2 + 1));
+    retryDelayMs_ = std::min(retryDelayMs_ * 2, maxRetryDelayMs_);
+    retries_++;
+    LOG_INFO("Connector::retry[%s] retry in %d ms\n", serverAddr_.toIpPort().c_str(), delayMs);
+
+    if (!timerChannel_)
+    {
+        timerChannel_.reset(new Channel(loop_, timerfd_));
+        timerChannel_->tie(shared_from_this()); // 同connecting 重试的时候可能同步失败然后giveUp
+        timerChannel_->setReadcallback(std::bind(&Connector::handleRetryTimer, this));
+        timerChannel_->enableReading();
+    }
+    itimerspec spec;
+    ::bzero(&spec, sizeof spec);
+    spec.it_value.tv_sec = delayMs / 1000;
+    spec.it_value.tv_nsec = static_cast<long>(delayMs % 1000) * 1000 * 1000;
+    ::timerfd_settime(timerfd_, 0, &spec, nullptr);
+}
+
+void Connector::giveUp(int err)
+{
+    LOG_INFO("Connector::giveUp[%s] after %d retries err:%d\n", serverAddr_.toIpPort().c_str(), (int)retries_, err);
+    connect_ = false;
+    if (connectFailedCallback_)
+    {
+        connectFailedCallback_(err);
+    }
+}
+
+void Connector::handleRetryTimer()
+{
+    uint64_t expirations;
+    ssize_t n = ::read(timerfd_, &expirations, sizeof expirations);
+    (void)n;
+    startInLoop();
+}
+
+// 定时器停掉 channel也从poller上摘下来 下次retry再挂上去
+void Connector::cancelRetryTimer()
+{
+    if (timerChannel_)
+    {
+        itimerspec spec;
+        ::bzero(&spec, sizeof spec);
+        ::timerfd_settime(timerfd_, 0, &spec, nullptr);
+        timerChannel_->disableAll();
+        timerChannel_->remove();
+        timerChannel_.reset();
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "noncopyable.h"
+#include "inetAddress.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <random>
+
+class EventLoop;
+class Channel;
+
+/*
+ * 主动发起连接 TcpClient用它 和Acceptor对应: Acceptor被动接受连接 Connector主动连出去 两个都只负责拿到一个连好的sockfd
+ * 非阻塞connect 返回EINPROGRESS以后用Channel等可写 可写了再用SO_ERROR看到底连没连上
+ * 连不上(拒绝 超时 自连接)就关掉sockfd 过一段时间重试 间隔从initRetryDelayMs开始每次翻倍 到maxRetryDelayMs为止
+ * 实际等待的时间在[delay/2, delay]里面随机取 很多客户端同时断开的时候不会在同一时刻一起重连
+ * 重试的定时用一个timerfd 和connect的Channel一样挂在loop上 整个过程不会阻塞loop线程
+ *
+ * 连上以后sockfd交给回调 Connector回到kDisconnected 之后可以再start/restart
+ * 所有状态只在loop线程里面改 start/stop可以在别的线程调用
+ */
+class Connector : noncopyable, public std::enable_shared_from_this<Connector>
+{
+public:
+    using NewConnectionCallback = std::function<void(int sockfd)>;
+    // 放弃连接的时候调用 err是最后一次失败的errno
+    using ConnectFailedCallback = std::function<void(int err)>;
+
+    static const int kInitRetryDelayMs = 500;
+    static const int kMaxRetryDelayMs = 30 * 1000;
+
+    Connector(EventLoop *loop, const InetAddress &serverAddr);
+    ~Connector();
+
+    // 连上以后把sockfd交给回调 回调负责关闭它(一般是交给TcpConnection)
+    void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
+    void setConnectFailedCallback(const ConnectFailedCallback &cb) { connectFailedCallback_ = cb; }
+    // start之前设置
+    void setRetryDelay(int initRetryDelayMs, int maxRetryDelayMs);
+    // 最多重试多少次 用完了就放弃 调用ConnectFailedCallback  默认-1一直重试 start之前设置
+    void setMaxRetries(int maxRetries) { maxRetries_ = maxRetries; }
+
+    const InetAddress &serverAddress() const { return serverAddr_; }
+    EventLoop *getLoop() const { return loop_; }
+    // 这一轮连接重试了多少次 连上以后清零
+    int retries() const { return retries_; }
+
+    void start();   // 任意线程
+    void restart(); // 只能在loop线程里面调用 连接断开以后重新开始 重试间隔也从头开始
+    void stop();    // 任意线程 正在连的和等着重试的都取消
+
+private:
+    enum States
+    {
+        kDisconnected,
+        kConnecting
+    };
+
+    void setState(States s) { state_ = s; }
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    void connecting(int sockfd);
+    void handleWrite();
+    void handleError();
+    void retry(int sockfd, int err);
+    void giveUp(int err);
+    int removeAndResetChannel();
+    void resetChannel();
+    void handleRetryTimer();
+    void cancelRetryTimer();
+
+    EventLoop *loop_;
+    InetAddress serverAddr_;
+    std::atomic_bool connect_; // 用户要不要连 stop以后为false
+    std::atomic_int state_;
+    std::unique_ptr<Channel> channel_; // 正在连接的sockfd 连上或者失败以后就不要了
+    NewConnectionCallback newConnectionCallback_;
+    ConnectFailedCallback connectFailedCallback_;
+    int maxRetries_;
+    int initRetryDelayMs_;
+    int maxRetryDelayMs_;
+    int retryDelayMs_; // 下一次重试的间隔上限
+    std::atomic_int retries_;
+    int timerfd_;
+    std::unique_ptr<Channel> timerChannel_; // 等着重试的时候可读
+    std::minstd_rand rng_;
+};
+
+using ConnectorPtr = std::shared_ptr<Connector>;
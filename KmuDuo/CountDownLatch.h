@@ -0,0 +1,21 @@
+#pragma once
+#include "noncopyable.h"
+#include <mutex>
+#include <condition_variable>
+
+// 倒计时门闩  count减到0的时候唤醒所有wait的线程
+// 用于等待一组线程全部就绪 比如EventLoopThreadPoll并行启动所有的subloop
+class CountDownLatch : noncopyable
+{
+public:
+    explicit CountDownLatch(int count);
+
+    void wait();
+    void countDown();
+    int getCount() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    int count_;
+};
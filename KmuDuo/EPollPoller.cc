@@ -46,7 +46,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
     {
         LOG_INFO("%d events happened\n", numEvents);
         fillActiveChannel(numEvents, activeChannels);
-        if (numEvents = events_.size())
+        if (numEvents == static_cast<int>(events_.size()))
         {
             events_.resize(events_.size() * 2);
         }
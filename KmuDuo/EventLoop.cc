@@ -1,12 +1,15 @@
 #include "EventLoop.h"
 #include "logger.h"
+#include "TraceLog.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "TscClock.h"
 #include <sys/eventfd.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <memory>
+#include <time.h>
 
 // 防止一个线程创建多个EventLoop  thread_local
 __thread EventLoop *t_loopInThisThread = nullptr;
@@ -30,11 +33,22 @@ EventLoop::EventLoop()
       quit_(false),
       callingPendingFunctors_(false),
       threadId_(CurrentThread::tid()),
+      pthreadId_(pthread_self()),
+      pollReturnTime_(Timestamp::now()),
+      loopMonotonicMicros_(Timestamp::monotonicMicroSeconds()),
+      pollReturnTicks_(TscClock::ticks()),
       poller_(Poller::newDefaultPoller(this)),
+      wakeupPending_(false),
       wakeupFd_(createEventfd()),
-      wakeupChannel_(new Channel(this, wakeupFd_))
+      wakeupChannel_(new Channel(this, wakeupFd_)),
+      outstandingFunctors_(0),
+      refs_(0),
+      retired_(false)
 
 {
+    heartbeat_.busySince.store(0, std::memory_order_relaxed);
+    heartbeat_.fd.store(-1, std::memory_order_relaxed);
+    heartbeat_.revents.store(0, std::memory_order_relaxed);
     LOG_DEBUG("eventloop created %p in thread %d ", this, threadId_);
     if (t_loopInThisThread) // 不为空
     {
@@ -66,23 +80,41 @@ void EventLoop::loop()
 
     LOG_INFO("eventloop %p start looping\n", this);
 
+    // 每一轮取三次TscClock::ticks() 分别算出poll等待 处理事件 执行functor的时间
+    uint64_t iterationStart = TscClock::ticks();
     while (!quit_)
     {
         activeChannels_.clear();
+        // 进poll之前清掉心跳 阻塞在poll里面不算卡住
+        heartbeat_.busySince.store(0, std::memory_order_relaxed);
         // 监听两类fd 一种是client的fd 一种wakeupfd
         pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        uint64_t polled = TscClock::ticks();
+        pollReturnTicks_ = polled;
+        heartbeat_.busySince.store(polled, std::memory_order_relaxed);
+        loopMonotonicMicros_ = Timestamp::monotonicMicroSeconds();
+        LOG_TRACE("EventLoop %p poll returned %d channels", this, static_cast<int>(activeChannels_.size()));
         for (Channel *channel : activeChannels_)
         {
             // Poller监听哪些channel发生事件了 然后上报给EventLoop 通知channel处理相应的事件
+            heartbeat_.fd.store(channel->fd(), std::memory_order_relaxed);
+            heartbeat_.revents.store(channel->revents(), std::memory_order_relaxed);
             channel->handleEvent(pollReturnTime_);
         }
+        uint64_t handled = TscClock::ticks();
+        heartbeat_.fd.store(-1, std::memory_order_relaxed);
+        heartbeat_.revents.store(0, std::memory_order_relaxed);
         // 执行当前eventloop事件循环 需要处理的回调操作
         /*
          IO线程 mainloop accept fd《=channel subloop
          mainloop 事先注册一个回调cb (需要subloop来执行)  wakeup subloop后,执行下面的方法,执行之前mainloop注册的cb操作
         */
         doPendingFunctors();
+        uint64_t done = TscClock::ticks();
+        stats_.addIteration(polled - iterationStart, handled - polled, done - handled, static_cast<int>(activeChannels_.size()));
+        iterationStart = done;
     }
+    heartbeat_.busySince.store(0, std::memory_order_relaxed);
     LOG_INFO("EventLoop%p stop looping \n", this);
     looping_ = false;
 }
@@ -121,9 +153,13 @@ void EventLoop::runInLoop(Functor cb)
 // 把cb放入队列中，唤醒loop所在的线程，执行cb
 void EventLoop::queueLoop(Functor cb)
 {
+    uint64_t queued = TscClock::ticks();
     {
         std::unique_lock<std::mutex> lock(mutex_);
+        outstandingFunctors_.fetch_add(1);
         pendingFunctors_.emplace_back(cb);
+        pendingTicks_.push_back(queued);
+        stats_.setQueueDepth(pendingFunctors_.size());
     }
     //||callingPendingFunctors_ 当前loop正在执行回调 但是loop又有了新的回调
     if (!isInLoopThread() || callingPendingFunctors_)
@@ -136,6 +172,9 @@ void EventLoop::handleRead()
 {
     uint64_t one = 1;
     ssize_t n = read(wakeupFd_, &one, sizeof(one));
+    // handleRead之后这一轮一定会执行doPendingFunctors 在这之前投递的回调都能被执行到
+    wakeupPending_ = false;
+    stats_.addWakeup();
     if (n != sizeof one)
     {
         LOG_ERROR("EventLoop::handleRead() reads %ld bytes instead of 8", n);
@@ -145,6 +184,12 @@ void EventLoop::handleRead()
 // 用来唤醒loop所在的线程的  向wakeupfd_写一个数据  wakeupchannel就发生读事件,当前loop线程就会被唤醒
 void EventLoop::wakeup()
 {
+    // 已经有一个唤醒还没被处理 loop一定会再执行一次doPendingFunctors 省掉一次write系统调用
+    // 计算线程大量往loop投递结果的时候 很多次投递只需要一次唤醒
+    if (wakeupPending_.exchange(true))
+    {
+        return;
+    }
     uint64_t one = 1;
     ssize_t n = write(wakeupFd_, &one, sizeof(one));
     if (n != sizeof one)
@@ -167,20 +212,46 @@ bool EventLoop::hasChannel(Channel *channel)
     return poller_->hasChannel(channel);
 }
 
+void EventLoop::refreshLoopTime()
+{
+    pollReturnTime_ = Timestamp::now();
+    loopMonotonicMicros_ = Timestamp::monotonicMicroSeconds();
+}
+
+int64_t EventLoop::cpuMicroSeconds() const
+{
+    clockid_t cid;
+    timespec ts;
+    if (::pthread_getcpuclockid(pthreadId_, &cid) != 0 || ::clock_gettime(cid, &ts) != 0)
+    {
+        return 0;
+    }
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
 // 执行回调
 void EventLoop::doPendingFunctors()
 {
     std::vector<Functor> functors;
+    std::vector<uint64_t> queuedTicks;
     callingPendingFunctors_ = true;
     {
         std::unique_lock<std::mutex> lock(mutex_);
         functors.swap(pendingFunctors_);
+        queuedTicks.swap(pendingTicks_);
+        stats_.setQueueDepth(0);
     }
+    stats_.addFunctors(functors.size());
 
-    for (const Functor &functor : functors)
+    // 每个functor开始执行的时间就是上一个结束的时间 每个只多取一次时钟
+    uint64_t now = TscClock::ticks();
+    for (size_t i = 0; i < functors.size(); ++i)
     {
-        functor();//执行当前loop需要执行的回调操作
+        stats_.recordFunctorDelay(now > queuedTicks[i] ? now - queuedTicks[i] : 0);
+        functors[i]();//执行当前loop需要执行的回调操作
+        now = TscClock::ticks();
     }
+    outstandingFunctors_.fetch_sub(functors.size());
     callingPendingFunctors_=false;
 
 }
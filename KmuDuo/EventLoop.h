@@ -2,11 +2,13 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "LoopStats.h"
 #include <vector>
 #include <functional>
 #include <atomic>
 #include <memory>
 #include <mutex>
+#include <pthread.h>
 class Channel;
 class Poller;
 
@@ -26,6 +28,33 @@ public:
 
     Timestamp pollReturnTime() const { return pollReturnTime_; }
 
+    // 缓存的loop时间 每次poll返回的时候刷新一次 同一轮里面的回调要"现在"的时候直接读 不用反复取时钟
+    // loopTime是系统时间(精确到微秒 打日志 传给MessageCallback) loopMonotonicMicros是单调时钟 算超时和耗时用
+    // 只能在loop线程里面读  回调里面做了很久的事情 之后还要用准确的时间可以refreshLoopTime
+    Timestamp loopTime() const { return pollReturnTime_; }
+    int64_t loopMonotonicMicros() const { return loopMonotonicMicros_; }
+    void refreshLoopTime();
+
+    // 运行统计: poll等待 回调 functor各花了多少时间 每次poll的事件数 唤醒次数 回调队列长度 任意线程都可以调用
+    // 第一次调用会校准TscClock(20ms) 不要在io线程上第一次调用
+    LoopStatsSnapshot stats() const { return stats_.snapshot(); }
+    // 这一轮poll返回时的TscClock::ticks() 只能在loop线程里面读
+    uint64_t pollReturnTicks() const { return pollReturnTicks_; }
+    // TcpConnection::handleRead调用 记录poll返回到MessageCallback的延迟和MessageCallback的耗时 只能在loop线程里面调用
+    void recordMessageCallback(uint64_t dispatchTicks, uint64_t callbackTicks) { stats_.recordMessageCallback(dispatchTicks, callbackTicks); }
+
+    // 给LoopWatchdog看的心跳 loop线程每一轮写几个relaxed的原子变量 任意线程都可以读
+    // busySinceTicks: 这一轮poll返回时的TscClock::ticks() 阻塞在poll里面(空闲)的时候是0
+    // handlingFd: 正在处理事件的channel的fd 执行queueLoop投递的回调的时候是-1  handlingEvents是这个channel的revents
+    uint64_t busySinceTicks() const { return heartbeat_.busySince.load(std::memory_order_relaxed); }
+    int handlingFd() const { return heartbeat_.fd.load(std::memory_order_relaxed); }
+    int handlingEvents() const { return heartbeat_.revents.load(std::memory_order_relaxed); }
+    pid_t threadId() const { return threadId_; }
+    pthread_t pthreadId() const { return pthreadId_; }
+
+    // loop所在线程累计消耗的CPU时间(阻塞在poll上不算) 单位微秒 任意线程都可以读 loop本身没有任何开销
+    int64_t cpuMicroSeconds() const;
+
     //在当前loop中执行cb
     void runInLoop(Functor cb);
 
@@ -35,6 +64,17 @@ public:
     //用来唤醒loop所在的线程的
     void wakeup();
 
+    // 缩容时EventLoopThreadPoll判断退役的loop能不能回收 任意线程都可以调用
+    // refs: 还可能往这个loop投递回调的对象数 TcpConnection创建/迁入的时候加1 析构/迁出的时候减1
+    // outstandingFunctors: 已经queueLoop但还没执行完的回调数
+    void ref() { refs_.fetch_add(1); }
+    void unref() { refs_.fetch_sub(1); }
+    int refs() const { return refs_.load(); }
+    int64_t outstandingFunctors() const { return outstandingFunctors_.load(); }
+    // 缩容的时候被移出轮询了 之后迁过来的连接会被拒绝(TcpConnection::migrateInLoop) 任意线程都可以调用
+    void setRetired() { retired_ = true; }
+    bool retired() const { return retired_; }
+
     //EventLoop的方法=> Poller的方法
     void updateChannel(Channel *chanenl);
     void removeChannel(Channel *channel);
@@ -52,9 +92,13 @@ private:
     std::atomic_bool looping_; // 原子操作 通过CAS实现
     std::atomic_bool quit_;    // 标识退出loop循环
     const pid_t threadId_;     // 记录当前loop所在的线程id   有const 在 .cc文件里面的构造函数中一定要初始化
+    const pthread_t pthreadId_; // 用来取loop线程的CPU时钟
     Timestamp pollReturnTime_; // poller返回发生事件的channels的时间点
+    int64_t loopMonotonicMicros_; // 和pollReturnTime_同时刷新的单调时钟
+    uint64_t pollReturnTicks_;
     std::unique_ptr<Poller> poller_;
 
+    std::atomic_bool wakeupPending_; // 已经write过wakeupFd_还没被handleRead读走 就不用重复write了
     int wakeupFd_; // 主要作用 , 当mainloop获取一个新用户的channel 通过轮询算法选择一个subloop,通过该成员唤醒subloop处理channel
     std::unique_ptr<Channel> wakeupChannel_;
 
@@ -62,5 +106,22 @@ private:
 
     std::atomic_bool callingPendingFunctors_; // 标识当前loop是否需要执行的回调操作
     std::vector<Functor> pendingFunctors_;    // 存储loop需要执行的所有的回调操作
+    std::vector<uint64_t> pendingTicks_;      // 和pendingFunctors_一一对应 放进队列时的TscClock::ticks()
     std::mutex mutex_;                        // 互斥锁用来保护上面vector容器的线程安全操作
+    std::atomic<int64_t> outstandingFunctors_; // queueLoop时加1 doPendingFunctors执行完减掉
+    std::atomic<int> refs_;
+    std::atomic_bool retired_;
+
+    LoopStats stats_;
+
+    // 心跳只由loop线程写 看门狗线程隔一段时间读一次 单独占一个cache line
+    // 前面紧挨着stats_的填充 后面自己垫一个cache line 不用alignas(64) 理由同LoopStats
+    struct Heartbeat
+    {
+        std::atomic<uint64_t> busySince;
+        std::atomic<int> fd;
+        std::atomic<int> revents;
+        char pad[64];
+    };
+    Heartbeat heartbeat_;
 };
\ No newline at end of file
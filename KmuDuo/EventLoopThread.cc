@@ -1,4 +1,5 @@
 #include "EventLoopThread.h"
+#include "CountDownLatch.h"
 
 //整个源文件的作用就是 把一个新线程和一个新loop 一一对应
 //thread_ ==>调用回调threadFfunc==>thread_.start()开启线程
@@ -11,7 +12,8 @@ EventLoopThread::EventLoopThread(const ThreadInitCallback &cb,
       thread_(std::bind(&EventLoopThread::threadFunc, this), name),
       mutex_(),
       cond_(),
-      callback_(cb)
+      callback_(cb),
+      latch_(nullptr)
 {
 }
 EventLoopThread::~EventLoopThread()
@@ -26,8 +28,18 @@ EventLoopThread::~EventLoopThread()
 
 EventLoop *EventLoopThread::startloop()
 {
+    startAsync(nullptr);
+    return waitloop();
+}
+
+void EventLoopThread::startAsync(CountDownLatch *latch)
+{
+    latch_ = latch;
     thread_.start(); // 启动底层新线程
+}
 
+EventLoop *EventLoopThread::waitloop()
+{
     EventLoop *loop = nullptr;
     {
         std::unique_lock<std::mutex> lock(mutex_);
@@ -55,6 +67,10 @@ void EventLoopThread::threadFunc()
         loop_ = &loop;
         cond_.notify_one();
     }
+    if (latch_)
+    {
+        latch_->countDown();
+    }
 
     loop.loop();//EventLoop loop => Poller.poll
 
@@ -6,6 +6,8 @@
 #include <condition_variable>
 
 #include"EventLoop.h"
+class CountDownLatch;
+
 class EventLoopThread
 {
 public:
@@ -14,8 +16,15 @@ public:
     EventLoopThread(const ThreadInitCallback &cb = ThreadInitCallback(), const std::string &name = std::string());
     ~EventLoopThread();
 
+    // 启动线程并等待新线程里面的loop创建完成
     EventLoop *startloop();
 
+    // 只启动线程不等待 loop创建完成(包括ThreadInitCallback执行完)以后latch->countDown()
+    // EventLoopThreadPoll用它一次拉起所有的线程 再在一个latch上统一等待
+    void startAsync(CountDownLatch *latch);
+    // 等待loop创建完成 返回loop的地址
+    EventLoop *waitloop();
+
 private:
     void threadFunc();
 
@@ -25,4 +34,5 @@ private:
     std::mutex mutex_;
     std::condition_variable cond_;
     ThreadInitCallback callback_;
+    CountDownLatch *latch_;
 };
\ No newline at end of file
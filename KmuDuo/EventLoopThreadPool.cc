@@ -1,37 +1,175 @@
 #include "EventLoopThreadPool.h"
 #include "EventLoopThread.h"
+#include "CountDownLatch.h"
+#include "Channel.h"
+#include "logger.h"
+#include <errno.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
 
 EventLoopThreadPoll::EventLoopThreadPoll(EventLoop *baseloop, const std::string nameArg)
     : baseloop_(baseloop),
       name_(nameArg),
       started_(false),
       numThread_(0),
-      next_(0)
+      next_(0),
+      numCreated_(0),
+      reapTimerfd_(-1)
 {
 }
 
 EventLoopThreadPoll::~EventLoopThreadPoll()
 {
+    if (reapChannel_)
+    {
+        reapChannel_->disableAll();
+        reapChannel_->remove();
+    }
+    if (reapTimerfd_ >= 0)
+    {
+        ::close(reapTimerfd_);
+    }
 }
 
 void EventLoopThreadPoll::start(const ThreadInitCallback &cb)
 {
     started_ = true;
-    for (int i = 0; i < numThread_; i++)
+    callback_ = cb;
+
+    startThreads(numThread_);
+
+    // 整个服务端只有一个线程,运行着baseloop
+    if (numThread_ == 0 && cb)
+    {
+        cb(baseloop_);
+    }
+}
+
+void EventLoopThreadPoll::startThreads(int num)
+{
+    // 所有的线程一起启动,各自并行地创建EventLoop和执行cb,最后只在一个latch上等待
+    // 而不是一个线程一个线程地启动再等待,线程多并且cb比较重的时候启动会慢很多
+    CountDownLatch latch(num);
+    std::vector<EventLoopThread *> threads;
+    for (int i = 0; i < num; i++)
     {
         char buf[name_.size() + 32];
-        snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), i);
-        EventLoopThread *t = new EventLoopThread(cb, buf);
+        snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), numCreated_++);
+        EventLoopThread *t = new EventLoopThread(callback_, buf);
         thraed_.push_back(std::unique_ptr<EventLoopThread>(t)); // 智能指针装t 自动释放资源
-        loops_.push_back(t->startloop());                       // 底层创建线程绑定一个新的eventloop,并返回该loop的地址
+        threads.push_back(t);
+        t->startAsync(&latch); // 底层创建线程绑定一个新的eventloop
     }
+    latch.wait();
 
-    // 整个服务端只有一个线程,运行着baseloop
-    if (numThread_ == 0 && cb)
+    for (EventLoopThread *t : threads)
     {
-        cb(baseloop_);
+        loops_.push_back(t->waitloop()); // 这里loop都已经创建好了 只是取出loop的地址
+    }
+}
+
+void EventLoopThreadPoll::addThreads(int num)
+{
+    if (num <= 0)
+    {
+        return;
     }
+    numThread_ += num;
+    startThreads(num);
 }
+
+std::vector<EventLoop *> EventLoopThreadPoll::retireLoops(int num)
+{
+    std::vector<EventLoop *> retired;
+    while (num-- > 0 && !loops_.empty())
+    {
+        loops_.back()->setRetired();
+        retired.push_back(loops_.back());
+        retired_.push_back(RetiredLoop{loops_.back(), std::move(thraed_.back()), false});
+        loops_.pop_back();
+        thraed_.pop_back();
+        numThread_--;
+    }
+    if (static_cast<size_t>(next_) >= loops_.size())
+    {
+        next_ = 0;
+    }
+    return retired;
+}
+
+void EventLoopThreadPoll::removeRetiredLoop(EventLoop *loop)
+{
+    for (RetiredLoop &r : retired_)
+    {
+        if (r.loop == loop && !r.removed)
+        {
+            r.removed = true;
+            reapQuiescentLoops();
+            return;
+        }
+    }
+}
+
+void EventLoopThreadPoll::reapQuiescentLoops()
+{
+    bool waiting = false;
+    for (auto it = retired_.begin(); it != retired_.end();)
+    {
+        // 先看refs再看outstandingFunctors: 最后一个引用放掉之前投递的回调 这时候一定已经计进去了
+        if (it->removed && it->loop->refs() == 0 && it->loop->outstandingFunctors() == 0)
+        {
+            it = retired_.erase(it); // ~EventLoopThread => loop->quit() 然后join
+        }
+        else
+        {
+            waiting = waiting || it->removed;
+            ++it;
+        }
+    }
+    if (waiting)
+    {
+        armReapTimer();
+    }
+}
+
+void EventLoopThreadPoll::armReapTimer()
+{
+    if (!reapChannel_)
+    {
+        reapTimerfd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (reapTimerfd_ < 0)
+        {
+            LOG_FATAL("%s:%s:%d timerfd create err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+        }
+        reapChannel_.reset(new Channel(baseloop_, reapTimerfd_));
+        reapChannel_->setReadcallback(std::bind(&EventLoopThreadPoll::handleReapTimer, this));
+        reapChannel_->enableReading();
+    }
+    itimerspec spec;
+    ::bzero(&spec, sizeof spec);
+    spec.it_value.tv_sec = kReapPollMs / 1000;
+    spec.it_value.tv_nsec = static_cast<long>(kReapPollMs % 1000) * 1000 * 1000;
+    ::timerfd_settime(reapTimerfd_, 0, &spec, nullptr);
+}
+
+void EventLoopThreadPoll::handleReapTimer()
+{
+    uint64_t expirations;
+    ssize_t n = ::read(reapTimerfd_, &expirations, sizeof expirations);
+    (void)n;
+    reapQuiescentLoops();
+}
+
+void EventLoopThreadPoll::stop()
+{
+    loops_.clear();
+    thraed_.clear(); // ~EventLoopThread => loop->quit() 然后join
+    retired_.clear();
+    numThread_ = 0;
+    next_ = 0;
+}
+
 // 如果工作在多线程中,baseloop_默认以轮询的方式分配channel给subloop
 EventLoop *EventLoopThreadPoll::getNextLoop()
 {
@@ -5,9 +5,11 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <utility>
 
 class EventLoop;
 class EventLoopThread;
+class Channel;
 
 class EventLoopThreadPoll : noncopyable
 {
@@ -18,6 +20,7 @@ public:
     ~EventLoopThreadPoll();
 
     void setThreadNum(int numThreads) { numThread_ = numThreads; }
+    int numThreads() const { return numThread_; }
 
     void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
@@ -26,15 +29,53 @@ public:
 
     std::vector<EventLoop *> getAllLoops();
 
+    // 运行时扩缩容 都只能在baseloop_所在的线程调用(getNextLoop也是在baseloop_里面调用的)
+    // 扩容: 再并行启动num个subloop 加入轮询
+    void addThreads(int num);
+    // 缩容: 把最后num个subloop移出轮询并标记退役 新连接和之后执行的迁移都不会再落到它们上面 线程先不退出
+    // 返回这些loop 由调用者把上面的连接迁走以后 再调用removeRetiredLoop
+    std::vector<EventLoop *> retireLoops(int num);
+    // 连接的迁移都投递出去以后调用 等这个loop静默了再结束subloop线程(quit+join)
+    // 静默: 没有连接还引用它(EventLoop::refs) 投递过来的回调也都执行完了(EventLoop::outstandingFunctors)
+    // 别的线程刚读到连接的旧loop投递的操作(跨线程send ComputePool的回调)都算在这两个计数里面 不会被丢掉
+    // 还没静默就每kReapPollMs再看一次
+    void removeRetiredLoop(EventLoop *loop);
+    // 结束所有的subloop线程(quit+join) 之后getNextLoop只返回baseloop_ 在baseloop_线程调用
+    // 调用之前上面的连接都要已经销毁 TcpServer::drain用
+    void stop();
+
     bool started() const { return started_; }
     const std::string &name() const { return name_; }
     
+    static const int kReapPollMs = 10;
+
 private:
+    // 并行启动num个线程 在一个latch上等待所有loop创建完成
+    void startThreads(int num);
+    // 结束已经静默的retired线程 还有没静默的就kReapPollMs以后再来
+    void handleReapTimer();
+    void reapQuiescentLoops();
+    void armReapTimer();
+
+    struct RetiredLoop
+    {
+        EventLoop *loop;
+        std::unique_ptr<EventLoopThread> thread;
+        bool removed; // removeRetiredLoop以后才开始等它静默
+    };
+
     EventLoop *baseloop_;
     std::string name_;
     bool started_;
     int numThread_;
     int next_;
+    int numCreated_; // 一共创建过的线程数 用来给新线程起名字
     std::vector<std::unique_ptr<EventLoopThread>> thraed_;
     std::vector<EventLoop *> loops_;
+    ThreadInitCallback callback_; // start时传入的cb 扩容的时候继续用
+
+    // 已经移出轮询 等待连接迁走或者等待静默的subloop线程
+    std::vector<RetiredLoop> retired_;
+    int reapTimerfd_; // 第一次缩容的时候才创建
+    std::unique_ptr<Channel> reapChannel_;
 };
\ No newline at end of file
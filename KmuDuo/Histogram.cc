@@ -0,0 +1,119 @@
+#include "Histogram.h"
+#include "TscClock.h"
+#include <stdio.h>
+
+Histogram::Histogram()
+    : count_(0),
+      sum_(0),
+      max_(0)
+{
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::mergeInto(HistogramSnapshot *snapshot) const
+{
+    // 逐个桶读的过程中写者还在写 count用读到的各个桶加起来的和 保证分位数自洽
+    int64_t count = 0;
+    int64_t *counts = snapshot->counts.data();
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        int64_t n = counts_[i].load(std::memory_order_relaxed);
+        counts[i] += n;
+        count += n;
+    }
+    snapshot->count += count;
+    snapshot->sum += sum_.load(std::memory_order_relaxed);
+    int64_t max = max_.load(std::memory_order_relaxed);
+    if (max > snapshot->max)
+    {
+        snapshot->max = max;
+    }
+}
+
+HistogramSnapshot::HistogramSnapshot()
+    : counts(Histogram::kBuckets, 0),
+      count(0),
+      sum(0),
+      max(0)
+{
+}
+
+void HistogramSnapshot::merge(const HistogramSnapshot &other)
+{
+    for (int i = 0; i < Histogram::kBuckets; ++i)
+    {
+        counts[i] += other.counts[i];
+    }
+    count += other.count;
+    sum += other.sum;
+    if (other.max > max)
+    {
+        max = other.max;
+    }
+}
+
+HistogramSnapshot HistogramSnapshot::operator-(const HistogramSnapshot &rhs) const
+{
+    HistogramSnapshot d(*this);
+    for (int i = 0; i < Histogram::kBuckets; ++i)
+    {
+        d.counts[i] -= rhs.counts[i];
+    }
+    d.count -= rhs.count;
+    d.sum -= rhs.sum;
+    return d;
+}
+
+int64_t HistogramSnapshot::percentileNanos(double q) const
+{
+    if (count <= 0)
+    {
+        return 0;
+    }
+    int64_t rank = static_cast<int64_t>(q * count + 0.5);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+    if (rank > count)
+    {
+        rank = count;
+    }
+    int64_t seen = 0;
+    for (int i = 0; i < Histogram::kBuckets; ++i)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+            uint64_t value = Histogram::bucketLowerBound(i) + Histogram::bucketWidth(i) / 2;
+            if (static_cast<int64_t>(value) > max)
+            {
+                value = max;
+            }
+            return TscClock::elapsedNanos(static_cast<int64_t>(value));
+        }
+    }
+    return maxNanos();
+}
+
+int64_t HistogramSnapshot::maxNanos() const
+{
+    return TscClock::elapsedNanos(max);
+}
+
+double HistogramSnapshot::meanNanos() const
+{
+    return count > 0 ? static_cast<double>(TscClock::elapsedNanos(sum)) / count : 0;
+}
+
+std::string HistogramSnapshot::toString() const
+{
+    char buf[256];
+    snprintf(buf, sizeof buf, "count=%ld p50_us=%.1f p99_us=%.1f p999_us=%.1f max_us=%.1f",
+             static_cast<long>(count), percentileNanos(0.5) / 1000.0, percentileNanos(0.99) / 1000.0,
+             percentileNanos(0.999) / 1000.0, maxNanos() / 1000.0);
+    return buf;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "noncopyable.h"
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * HDR风格的对数-线性直方图 记录延迟分布
+ * 小于kSubBuckets的值每个值一个桶 之后每个2的幂区间再均分成kSubBuckets个桶 相对误差不超过1/kSubBuckets(约3%)
+ * 只有一个写者(loop线程) 写的时候是relaxed的load+store 没有锁也没有原子的read-modify-write
+ * 任意线程都可以读 读的时候拷贝出一份HistogramSnapshot 多个loop的快照可以merge到一起再算分位数
+ * 记录的值是TscClock::ticks()的差 快照输出的时候换算成纳秒
+ */
+struct HistogramSnapshot;
+
+class Histogram : noncopyable
+{
+public:
+    static const int kSubBucketBits = 5;
+    static const int kSubBuckets = 1 << kSubBucketBits;
+    static const int kMaxBits = 48; // 再大的值都记在最后一个桶里
+    static const int kBuckets = (kMaxBits - kSubBucketBits + 1) * kSubBuckets;
+
+    Histogram();
+
+    // 只在写者线程调用
+    void record(uint64_t value)
+    {
+        add(counts_[bucketIndex(value)], 1);
+        add(count_, 1);
+        add(sum_, static_cast<int64_t>(value));
+        if (static_cast<int64_t>(value) > max_.load(std::memory_order_relaxed))
+        {
+            max_.store(static_cast<int64_t>(value), std::memory_order_relaxed);
+        }
+    }
+
+    // 任意线程 把当前的计数加到snapshot上
+    void mergeInto(HistogramSnapshot *snapshot) const;
+
+    static int bucketIndex(uint64_t value)
+    {
+        if (value < static_cast<uint64_t>(kSubBuckets))
+        {
+            return static_cast<int>(value);
+        }
+        int exp = 63 - __builtin_clzll(value);
+        if (exp >= kMaxBits)
+        {
+            return kBuckets - 1;
+        }
+        return (exp - kSubBucketBits + 1) * kSubBuckets + static_cast<int>((value >> (exp - kSubBucketBits)) - kSubBuckets);
+    }
+    // 桶里面最小的值
+    static uint64_t bucketLowerBound(int index)
+    {
+        if (index < kSubBuckets)
+        {
+            return index;
+        }
+        int shift = index / kSubBuckets - 1;
+        return static_cast<uint64_t>(kSubBuckets + index % kSubBuckets) << shift;
+    }
+    // 桶的宽度
+    static uint64_t bucketWidth(int index)
+    {
+        return index < kSubBuckets ? 1 : static_cast<uint64_t>(1) << (index / kSubBuckets - 1);
+    }
+
+private:
+    static void add(std::atomic<int64_t> &counter, int64_t delta)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    std::atomic<int64_t> count_;
+    std::atomic<int64_t> sum_;
+    std::atomic<int64_t> max_;
+    std::atomic<int64_t> counts_[kBuckets];
+};
+
+// 直方图的一份拷贝 值的单位是TscClock::ticks()
+struct HistogramSnapshot
+{
+    std::vector<int64_t> counts;
+    int64_t count;
+    int64_t sum;
+    int64_t max;
+
+    HistogramSnapshot();
+
+    void merge(const HistogramSnapshot &other);
+    // 后一份减前一份 max没法相减 保留后一份的
+    HistogramSnapshot operator-(const HistogramSnapshot &rhs) const;
+
+    // q在[0,1] 返回纳秒 取所在桶的中点 不超过max
+    int64_t percentileNanos(double q) const;
+    int64_t maxNanos() const;
+    double meanNanos() const;
+
+    // count=1000 p50_us=1.2 p99_us=8.0 p999_us=30.1 max_us=45.0
+    std::string toString() const;
+};
@@ -0,0 +1,281 @@
+#include "HotUpgrade.h"
+#include "Socket.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+namespace
+{
+    const size_t kMaxLine = 1024;
+
+    int64_t nowMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+}
+
+HotUpgradeListener::HotUpgradeListener(EventLoop *loop, const InetAddress &controlAddr)
+    : loop_(loop),
+      server_(loop, controlAddr, "HotUpgrade"),
+      handedOff_(false)
+{
+    server_.setConnectionCallback(std::bind(&HotUpgradeListener::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(std::bind(&HotUpgradeListener::onMessage, this,
+                                         std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void HotUpgradeListener::addServer(TcpServer *server)
+{
+    for (TcpServer *s : servers_)
+    {
+        if (s->name() == server->name())
+        {
+            LOG_FATAL("HotUpgradeListener duplicate server name %s\n", server->name().c_str());
+        }
+    }
+    servers_.push_back(server);
+}
+
+void HotUpgradeListener::start()
+{
+    server_.start();
+}
+
+void HotUpgradeListener::onConnection(const TcpConnectionPtr &conn)
+{
+    LOG_INFO("HotUpgradeListener %s %s\n", conn->name().c_str(), conn->connected() ? "UP" : "DOWN");
+}
+
+void HotUpgradeListener::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    while (true)
+    {
+        const char *begin = buf->peek();
+        const char *end = begin + buf->readableBytes();
+        const char *eol = std::find(begin, end, '\n');
+        if (eol == end)
+        {
+            if (buf->readableBytes() > kMaxLine)
+            {
+                conn->shutdown();
+            }
+            return;
+        }
+        std::string line(begin, eol);
+        buf->retrieve(eol - begin + 1);
+
+        if (line == "upgrade")
+        {
+            if (handedOff_)
+            {
+                conn->send("error already handed off\n");
+                conn->shutdown();
+                return;
+            }
+            LOG_INFO("HotUpgradeListener sending %zu listening socket(s) to %s\n", servers_.size(), conn->name().c_str());
+            for (TcpServer *s : servers_)
+            {
+                conn->sendFd(s->listenFd(), "listen " + s->name() + "\n");
+            }
+            conn->send("end\n");
+        }
+        else if (line == "ready" && !handedOff_)
+        {
+            // 新进程已经在accept了 这边停下来 队列里面剩下的连接都归新进程
+            handedOff_ = true;
+            for (TcpServer *s : servers_)
+            {
+                s->stopAccepting();
+            }
+            // 控制socket的路径也交给新进程了: 监听socket shutdown以后再来的connect都是ECONNREFUSED
+            // 新进程的Acceptor看到这个才会把旧的socket文件当成没人用的删掉 再bind自己的
+            server_.stopAccepting();
+            ::shutdown(server_.listenFd(), SHUT_RD);
+            conn->send("done\n");
+            LOG_INFO("HotUpgradeListener handed off to %s\n", conn->name().c_str());
+            if (handoffCallback_)
+            {
+                loop_->queueLoop(handoffCallback_); // 回调里面可能要析构这个对象 不在连接的回调里面直接调
+            }
+        }
+        else
+        {
+            LOG_ERROR("HotUpgradeListener unexpected line '%s' from %s\n", line.c_str(), conn->name().c_str());
+            conn->shutdown();
+            return;
+        }
+    }
+}
+
+HotUpgradeClient::HotUpgradeClient(const InetAddress &controlAddr)
+    : controlAddr_(controlAddr),
+      controlFd_(-1)
+{
+}
+
+HotUpgradeClient::~HotUpgradeClient()
+{
+    closeAll();
+}
+
+void HotUpgradeClient::closeAll()
+{
+    for (auto &item : fds_)
+    {
+        ::close(item.second);
+    }
+    fds_.clear();
+    if (controlFd_ >= 0)
+    {
+        ::close(controlFd_);
+        controlFd_ = -1;
+    }
+}
+
+bool HotUpgradeClient::takeover(int timeoutMs)
+{
+    controlFd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (controlFd_ < 0 || ::connect(controlFd_, controlAddr_.sockAddr(), controlAddr_.sockLen()) < 0)
+    {
+        LOG_INFO("HotUpgradeClient no running process at %s err:%d\n", controlAddr_.toIpPort().c_str(), errno);
+        closeAll();
+        return false;
+    }
+    const char request[] = "upgrade\n";
+    if (::send(controlFd_, request, sizeof request - 1, MSG_NOSIGNAL) != sizeof request - 1)
+    {
+        closeAll();
+        return false;
+    }
+
+    // fd跟着它那一行的字节按顺序到 先到的fd对应先到的listen行
+    std::deque<int> pendingFds;
+    std::string buffer;
+    int64_t deadline = nowMs() + timeoutMs;
+    bool done = false;
+    bool failed = false;
+    while (!done && !failed)
+    {
+        int64_t left = deadline - nowMs();
+        pollfd pfd = {controlFd_, POLLIN, 0};
+        if (left <= 0 || ::poll(&pfd, 1, static_cast<int>(left)) <= 0)
+        {
+            LOG_ERROR("HotUpgradeClient takeover from %s timed out\n", controlAddr_.toIpPort().c_str());
+            break;
+        }
+        char data[4096];
+        std::vector<int> fds;
+        ssize_t n = Socket::recvWithFds(controlFd_, data, sizeof data, &fds);
+        pendingFds.insert(pendingFds.end(), fds.begin(), fds.end());
+        if (n <= 0)
+        {
+            LOG_ERROR("HotUpgradeClient control connection closed err:%d\n", n < 0 ? errno : 0);
+            break;
+        }
+        buffer.append(data, n);
+        size_t eol;
+        while (!done && !failed && (eol = buffer.find('\n')) != std::string::npos)
+        {
+            std::string line = buffer.substr(0, eol);
+            buffer.erase(0, eol + 1);
+            if (line.compare(0, 7, "listen ") == 0 && !pendingFds.empty())
+            {
+                fds_[line.substr(7)] = pendingFds.front();
+                pendingFds.pop_front();
+            }
+            else if (line == "end")
+            {
+                done = true;
+            }
+            else
+            {
+                // 协议对不上了 后面的fd和行也没法再对应 整个交接放弃
+                LOG_ERROR("HotUpgradeClient unexpected line '%s'\n", line.c_str());
+                failed = true;
+            }
+        }
+        if (!done && buffer.size() > kMaxLine)
+        {
+            LOG_ERROR("HotUpgradeClient line too long from %s\n", controlAddr_.toIpPort().c_str());
+            failed = true;
+        }
+    }
+    for (int fd : pendingFds)
+    {
+        ::close(fd);
+    }
+    if (!done || failed)
+    {
+        closeAll();
+        return false;
+    }
+    LOG_INFO("HotUpgradeClient took over %zu listening socket(s) from %s\n", fds_.size(), controlAddr_.toIpPort().c_str());
+    return true;
+}
+
+int HotUpgradeClient::takeFd(const std::string &name)
+{
+    auto it = fds_.find(name);
+    if (it == fds_.end())
+    {
+        return -1;
+    }
+    int fd = it->second;
+    fds_.erase(it);
+    return fd;
+}
+
+std::vector<std::string> HotUpgradeClient::names() const
+{
+    std::vector<std::string> result;
+    for (const auto &item : fds_)
+    {
+        result.push_back(item.first);
+    }
+    return result;
+}
+
+void HotUpgradeClient::confirm(int timeoutMs)
+{
+    if (controlFd_ < 0)
+    {
+        return;
+    }
+    const char ready[] = "ready\n";
+    if (::send(controlFd_, ready, sizeof ready - 1, MSG_NOSIGNAL) != sizeof ready - 1)
+    {
+        LOG_ERROR("HotUpgradeClient confirm err:%d\n", errno);
+        closeAll();
+        return;
+    }
+    // 等旧进程回done 这时候它已经停止accept 控制socket也放开了 这边可以在同一个路径上开HotUpgradeListener
+    std::string buffer;
+    int64_t deadline = nowMs() + timeoutMs;
+    while (buffer.find('\n') == std::string::npos && buffer.size() <= kMaxLine)
+    {
+        int64_t left = deadline - nowMs();
+        pollfd pfd = {controlFd_, POLLIN, 0};
+        if (left <= 0 || ::poll(&pfd, 1, static_cast<int>(left)) <= 0)
+        {
+            LOG_ERROR("HotUpgradeClient confirm to %s timed out\n", controlAddr_.toIpPort().c_str());
+            break;
+        }
+        char data[64];
+        ssize_t n = ::recv(controlFd_, data, sizeof data, 0);
+        if (n <= 0)
+        {
+            LOG_ERROR("HotUpgradeClient control connection closed before done err:%d\n", n < 0 ? errno : 0);
+            break;
+        }
+        buffer.append(data, n);
+    }
+    closeAll();
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * 热升级: 新进程直接接过旧进程的监听socket 部署的时候不用重新bind 不丢连接 也没有accept的空档
+ *
+ * 协议(一个AF_UNIX的控制socket 一行一条):
+ *   新进程连上旧进程的控制socket 发 "upgrade\n"
+ *   旧进程对每个登记过的TcpServer回一行 "listen <名字>\n" 用SCM_RIGHTS带上它的监听fd 最后回 "end\n"
+ *   新进程用这些fd建好TcpServer并且start()以后 发 "ready\n"
+ *   旧进程收到ready: 所有登记的TcpServer stopAccepting() 控制socket也不再接受连接 回 "done\n"
+ *   然后执行HandoffCallback(一般在里面TcpServer::drain然后退出)
+ * 新进程start到旧进程stopAccepting之间 两边accept的是同一个socket 内核里面只有一个accept队列
+ * 队列里面的连接谁先accept就归谁 一个连接都不会被拒绝
+ * 新进程没有发ready就断开了(比如启动失败) 旧进程什么都不改 照常服务 可以再升级一次
+ *
+ * 控制socket要用文件路径 不能用abstract: 新进程接管以后要在同一个路径上开自己的HotUpgradeListener
+ * 等下一次升级 文件路径上旧进程的socket已经不接受连接了 Acceptor会当成旧文件删掉再bind
+ * abstract地址在旧进程退出之前一直被占着
+ *
+ * 旧进程:
+ *   HotUpgradeListener upgrade(&loop, InetAddress::unixAddress("/run/app.upgrade"));
+ *   upgrade.addServer(&server);
+ *   upgrade.setHandoffCallback([&]() { server.drain(30000, [&]() { loop.quit(); }); });
+ *   upgrade.start();
+ *
+ * 新进程(loop跑起来之前):
+ *   HotUpgradeClient client(controlAddr);
+ *   int fd = client.takeover(3000) ? client.takeFd("echo") : -1;   // 连不上说明没有旧进程 正常bind
+ *   std::unique_ptr<TcpServer> server(fd >= 0 ? new TcpServer(&loop, fd, "echo") : new TcpServer(&loop, addr, "echo"));
+ *   server->start();
+ *   client.confirm();   // 旧进程停止accept 控制socket的路径空出来
+ *   然后和旧进程一样开HotUpgradeListener
+ */
+class HotUpgradeListener : noncopyable
+{
+public:
+    using HandoffCallback = std::function<void()>;
+
+    HotUpgradeListener(EventLoop *loop, const InetAddress &controlAddr);
+
+    // start之前登记 按TcpServer::name()交给新进程 名字不能重复
+    void addServer(TcpServer *server);
+    // 新进程接管以后在loop线程里面执行 这时候登记的TcpServer都已经stopAccepting了
+    void setHandoffCallback(const HandoffCallback &cb) { handoffCallback_ = cb; }
+    // 在loop线程里面调用
+    void start();
+
+    bool handedOff() const { return handedOff_; }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp);
+
+    EventLoop *loop_;
+    TcpServer server_; // 控制socket
+    std::vector<TcpServer *> servers_;
+    HandoffCallback handoffCallback_;
+    bool handedOff_;
+};
+
+// 新进程这一边 阻塞的 在loop跑起来之前用
+class HotUpgradeClient : noncopyable
+{
+public:
+    explicit HotUpgradeClient(const InetAddress &controlAddr);
+    // 没有confirm就析构: 关掉控制连接 旧进程照常服务 没有取走的fd也关掉
+    ~HotUpgradeClient();
+
+    // 连上旧进程 拿到所有的监听fd 连不上(没有旧进程)或者timeoutMs之内没有拿全返回false
+    bool takeover(int timeoutMs);
+    // 取走名字对应的fd 以后由调用者负责(一般直接交给TcpServer) 没有返回-1
+    int takeFd(const std::string &name);
+    // 自己的TcpServer都start了以后调用 通知旧进程停止accept 等它回复(最多timeoutMs)以后返回
+    // 返回以后旧进程已经不再accept 控制socket的路径也空出来了
+    void confirm(int timeoutMs = 3000);
+
+    // 旧进程交过来的所有名字
+    std::vector<std::string> names() const;
+
+private:
+    void closeAll();
+
+    const InetAddress controlAddr_;
+    int controlFd_;
+    std::map<std::string, int> fds_;
+};
@@ -0,0 +1,521 @@
+#include "LoadGenerator.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "TcpConnection.h"
+#include "Channel.h"
+#include "Buffer.h"
+#include "CountDownLatch.h"
+#include "TscClock.h"
+#include "logger.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <netinet/tcp.h>
+
+namespace
+{
+    // 一个在路上的请求
+    struct InFlight
+    {
+        uint64_t intended; // 计划发送的时间 闭环的时候和sent一样
+        uint64_t sent;     // 真正交给send的时间
+        size_t length;     // 请求的长度 echo的时候就是响应的长度
+    };
+
+    // 阻塞地连上服务器 然后设置成非阻塞交给TcpConnection 失败返回-1
+    int connectBlocking(const InetAddress &serverAddr)
+    {
+        int fd = ::socket(serverAddr.family(), SOCK_STREAM | SOCK_CLOEXEC, serverAddr.isUnix() ? 0 : IPPROTO_TCP);
+        if (fd < 0)
+        {
+            return -1;
+        }
+        if (::connect(fd, serverAddr.sockAddr(), serverAddr.sockLen()) < 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+        return fd;
+    }
+}
+
+// 一个连接 只在所属worker的loop线程里面访问
+struct LoadGenerator::Session
+{
+    Worker *worker;
+    TcpConnectionPtr conn; // 被服务器关掉以后为空
+    uint64_t firstTicks;   // 开环: 第0个请求计划发送的时间
+    int64_t scheduled;     // 已经发出去的请求数 开环时第scheduled个请求的计划时间是firstTicks + scheduled*intervalTicks_
+    size_t nextRequest;    // 下一个用哪个请求模板
+    std::vector<InFlight> ring; // 在路上的请求 容量是pipeline
+    size_t head;
+    size_t count;
+};
+
+// 一个loop上的所有连接和统计 只在这个loop线程里面访问
+struct LoadGenerator::Worker
+{
+    size_t index; // 在workers_里面的下标
+    EventLoop *loop;
+    std::vector<std::unique_ptr<Session>> sessions;
+    std::unique_ptr<Histogram> latency;
+    std::unique_ptr<Histogram> serviceTime;
+    uint64_t expectedIntervalTicks; // 闭环校正用 0表示不校正
+    int64_t sent;
+    int64_t completed;
+    int64_t errors;
+    int64_t bytesSent;
+    int64_t bytesReceived;
+    std::string batch; // 一个连接这一次要发的请求拼在一起
+    int timerfd;
+    std::unique_ptr<Channel> timerChannel;
+};
+
+LoadGenerator::ResponseFramer LoadGenerator::fixedSizeFramer(size_t size)
+{
+    return [size](const char *, size_t len) { return len >= size ? size : 0; };
+}
+
+LoadGenerator::ResponseFramer LoadGenerator::delimiterFramer(const std::string &delimiter)
+{
+    return [delimiter](const char *data, size_t len) -> size_t {
+        const char *end = static_cast<const char *>(memmem(data, len, delimiter.data(), delimiter.size()));
+        return end ? end - data + delimiter.size() : 0;
+    };
+}
+
+LoadGenerator::Options::Options()
+    : connections(1),
+      pipeline(1),
+      mode(kClosedLoop),
+      rate(0),
+      tickMicros(100),
+      expectedIntervalMicros(0)
+{
+}
+
+LoadGenerator::Result::Result()
+    : seconds(0),
+      sent(0),
+      completed(0),
+      errors(0),
+      backlog(0),
+      bytesSent(0),
+      bytesReceived(0)
+{
+}
+
+void LoadGenerator::Result::merge(const Result &other)
+{
+    sent += other.sent;
+    completed += other.completed;
+    errors += other.errors;
+    backlog += other.backlog;
+    bytesSent += other.bytesSent;
+    bytesReceived += other.bytesReceived;
+    latency.merge(other.latency);
+    serviceTime.merge(other.serviceTime);
+}
+
+std::string LoadGenerator::Result::toString() const
+{
+    char buf[512];
+    snprintf(buf, sizeof buf,
+             "seconds=%.2f sent=%ld completed=%ld requests_per_s=%.0f errors=%ld backlog=%ld "
+             "mib_sent_per_s=%.1f mib_received_per_s=%.1f "
+             "latency_p50_us=%.1f latency_p90_us=%.1f latency_p99_us=%.1f latency_p999_us=%.1f latency_max_us=%.1f "
+             "service_p50_us=%.1f service_p99_us=%.1f service_max_us=%.1f",
+             seconds, static_cast<long>(sent), static_cast<long>(completed), requestsPerSecond(),
+             static_cast<long>(errors), static_cast<long>(backlog),
+             seconds > 0 ? bytesSent / seconds / (1024 * 1024) : 0, seconds > 0 ? bytesReceived / seconds / (1024 * 1024) : 0,
+             latency.percentileNanos(0.5) / 1000.0, latency.percentileNanos(0.9) / 1000.0,
+             latency.percentileNanos(0.99) / 1000.0, latency.percentileNanos(0.999) / 1000.0, latency.maxNanos() / 1000.0,
+             serviceTime.percentileNanos(0.5) / 1000.0, serviceTime.percentileNanos(0.99) / 1000.0, serviceTime.maxNanos() / 1000.0);
+    return buf;
+}
+
+LoadGenerator::LoadGenerator(EventLoop *loop, const InetAddress &serverAddr, const Options &options, const std::string &name)
+    : loop_(loop),
+      serverAddr_(serverAddr),
+      options_(options),
+      name_(name),
+      threadPool_(new EventLoopThreadPoll(loop, name)),
+      ticksPerSecond_(0),
+      intervalTicks_(0),
+      started_(false),
+      stopped_(false)
+{
+    if (options_.requests.empty())
+    {
+        LOG_FATAL("LoadGenerator[%s] needs at least one request\n", name_.c_str());
+    }
+    if (options_.mode == kOpenLoop && options_.rate <= 0)
+    {
+        LOG_FATAL("LoadGenerator[%s] open loop needs rate > 0\n", name_.c_str());
+    }
+    // 时间都用TscClock::ticks()记 在这里把校准做掉 不占io线程
+    ticksPerSecond_ = 1e18 / static_cast<double>(TscClock::elapsedNanos(1000000000));
+    if (options_.mode == kOpenLoop)
+    {
+        intervalTicks_ = ticksPerSecond_ * options_.connections / options_.rate;
+    }
+}
+
+LoadGenerator::~LoadGenerator()
+{
+    if (started_ && !stopped_)
+    {
+        stop();
+    }
+}
+
+void LoadGenerator::setThreadNum(int numThreads)
+{
+    threadPool_->setThreadNum(numThreads);
+}
+
+void LoadGenerator::start()
+{
+    started_ = true;
+    threadPool_->start();
+    for (EventLoop *loop : threadPool_->getAllLoops())
+    {
+        std::unique_ptr<Worker> w(new Worker);
+        w->index = workers_.size();
+        w->loop = loop;
+        w->latency.reset(new Histogram);
+        w->serviceTime.reset(new Histogram);
+        w->expectedIntervalTicks = options_.expectedIntervalMicros > 0
+                                       ? static_cast<uint64_t>(options_.expectedIntervalMicros * ticksPerSecond_ / 1e6)
+                                       : 0;
+        w->sent = w->completed = w->errors = w->bytesSent = w->bytesReceived = 0;
+        w->timerfd = -1;
+        workers_.push_back(std::move(w));
+    }
+
+    // 先把所有连接建好 分给各个worker 然后每个worker在自己的loop线程里面注册连接开始发请求
+    int connectErrors = 0;
+    for (int i = 0; i < options_.connections; i++)
+    {
+        Worker *w = workers_[i % workers_.size()].get();
+        int fd = connectBlocking(serverAddr_);
+        if (fd < 0)
+        {
+            LOG_ERROR("LoadGenerator[%s] connect %s err:%d\n", name_.c_str(), serverAddr_.toIpPort().c_str(), errno);
+            connectErrors++;
+            continue;
+        }
+
+        char buf[64];
+        snprintf(buf, sizeof buf, "%s#%d", name_.c_str(), i);
+        std::unique_ptr<Session> s(new Session);
+        s->worker = w;
+        s->conn.reset(new TcpConnection(w->loop, buf, fd, InetAddress::localAddressOf(fd), serverAddr_));
+        s->firstTicks = 0;
+        s->scheduled = 0;
+        s->nextRequest = i % options_.requests.size();
+        s->ring.resize(options_.pipeline > 0 ? options_.pipeline : 1);
+        s->head = 0;
+        s->count = 0;
+        Session *session = s.get();
+        s->conn->setConnectionCallback([](const TcpConnectionPtr &) {});
+        s->conn->setMessageCallback(std::bind(&LoadGenerator::onMessage, this, session, std::placeholders::_1,
+                                              std::placeholders::_2, std::placeholders::_3));
+        s->conn->setCloseCallback(std::bind(&LoadGenerator::onClose, this, session, std::placeholders::_1));
+        w->sessions.push_back(std::move(s));
+    }
+    if (connectErrors > 0)
+    {
+        // 连不上的也算在errors里面 在第一个worker自己的线程里面加
+        Worker *w = workers_[0].get();
+        w->loop->runInLoop([w, connectErrors]() { w->errors += connectErrors; });
+    }
+
+    // 开环时每个连接的计划时间错开 不要所有连接在同一个ticks发
+    uint64_t now = TscClock::ticks();
+    int index = 0;
+    for (auto &w : workers_)
+    {
+        for (auto &s : w->sessions)
+        {
+            s->firstTicks = now + static_cast<uint64_t>(intervalTicks_ * index++ / options_.connections);
+        }
+        Worker *worker = w.get();
+        worker->loop->runInLoop([this, worker]() {
+            for (auto &s : worker->sessions)
+            {
+                s->conn->connectionEstablished();
+                startSession(s.get());
+            }
+            if (options_.mode == kOpenLoop)
+            {
+                // 开环靠timerfd按节拍检查到点的请求 响应回来的时候也会顺便检查
+                worker->timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+                itimerspec spec;
+                ::bzero(&spec, sizeof spec);
+                spec.it_interval.tv_sec = options_.tickMicros / 1000000;
+                spec.it_interval.tv_nsec = (options_.tickMicros % 1000000) * 1000;
+                spec.it_value = spec.it_interval;
+                ::timerfd_settime(worker->timerfd, 0, &spec, nullptr);
+                worker->timerChannel.reset(new Channel(worker->loop, worker->timerfd));
+                worker->timerChannel->setReadcallback(std::bind(&LoadGenerator::onTick, this, worker));
+                worker->timerChannel->enableReading();
+            }
+        });
+    }
+    statsStart_ = std::chrono::steady_clock::now();
+}
+
+void LoadGenerator::startSession(Session *session)
+{
+    pump(session, TscClock::ticks());
+    flush(session);
+}
+
+// 把能发的请求放进batch: 闭环是补满pipeline 开环是已经到点的 并且pipeline没满
+void LoadGenerator::pump(Session *session, uint64_t now)
+{
+    if (!session->conn)
+    {
+        return;
+    }
+    Worker *w = session->worker;
+    const size_t capacity = session->ring.size();
+    while (session->count < capacity)
+    {
+        uint64_t intended = now;
+        if (options_.mode == kOpenLoop)
+        {
+            intended = session->firstTicks + static_cast<uint64_t>(session->scheduled * intervalTicks_);
+            if (intended > now)
+            {
+                break;
+            }
+        }
+        const std::string &request = options_.requests[session->nextRequest];
+        if (++session->nextRequest == options_.requests.size())
+        {
+            session->nextRequest = 0;
+        }
+        w->batch.append(request);
+        InFlight &f = session->ring[(session->head + session->count) % capacity];
+        f.intended = intended;
+        f.sent = now;
+        f.length = request.size();
+        session->count++;
+        session->scheduled++;
+        w->sent++;
+        w->bytesSent += request.size();
+    }
+}
+
+void LoadGenerator::flush(Session *session)
+{
+    Worker *w = session->worker;
+    if (!w->batch.empty())
+    {
+        if (session->conn)
+        {
+            session->conn->send(w->batch);
+        }
+        w->batch.clear();
+    }
+}
+
+void LoadGenerator::onMessage(Session *session, const TcpConnectionPtr &, Buffer *buf, Timestamp)
+{
+    Worker *w = session->worker;
+    uint64_t now = TscClock::ticks();
+    const size_t capacity = session->ring.size();
+    while (session->count > 0)
+    {
+        const InFlight &f = session->ring[session->head];
+        size_t len;
+        if (options_.framer)
+        {
+            len = options_.framer(buf->peek(), buf->readableBytes());
+            if (len == 0)
+            {
+                break;
+            }
+        }
+        else
+        {
+            len = f.length;
+            if (buf->readableBytes() < len)
+            {
+                break;
+            }
+        }
+        buf->retrieve(len);
+        w->completed++;
+        w->bytesReceived += len;
+        w->serviceTime->record(now > f.sent ? now - f.sent : 0);
+
+        uint64_t latency = now > f.intended ? now - f.intended : 0;
+        w->latency->record(latency);
+        // 闭环的协调遗漏校正: 卡顿期间本来应该发出去的请求 每隔E补记一个
+        uint64_t expected = w->expectedIntervalTicks;
+        if (expected > 0 && latency > expected)
+        {
+            for (uint64_t v = latency - expected; v >= expected; v -= expected)
+            {
+                w->latency->record(v);
+            }
+        }
+        session->head = session->head + 1 == capacity ? 0 : session->head + 1;
+        session->count--;
+    }
+    if (session->count == 0)
+    {
+        // 没有请求在路上还收到数据 不是这个协议的响应 丢掉
+        buf->retrieveAll();
+    }
+    pump(session, now);
+    flush(session);
+}
+
+void LoadGenerator::onClose(Session *session, const TcpConnectionPtr &conn)
+{
+    Worker *w = session->worker;
+    w->errors++;
+    session->conn.reset();
+    session->count = 0;
+    w->loop->queueLoop(std::bind(&TcpConnection::connectionDestroyed, conn));
+}
+
+void LoadGenerator::onTick(Worker *worker)
+{
+    uint64_t expirations;
+    ssize_t n = ::read(worker->timerfd, &expirations, sizeof expirations);
+    (void)n;
+    uint64_t now = TscClock::ticks();
+    for (auto &s : worker->sessions)
+    {
+        pump(s.get(), now);
+        flush(s.get());
+    }
+}
+
+void LoadGenerator::runOnWorkers(const std::function<void(Worker *)> &func)
+{
+    CountDownLatch latch(static_cast<int>(workers_.size()));
+    for (auto &w : workers_)
+    {
+        Worker *worker = w.get();
+        worker->loop->runInLoop([&func, &latch, worker]() {
+            func(worker);
+            latch.countDown();
+        });
+    }
+    latch.wait();
+}
+
+void LoadGenerator::collectInLoop(Worker *worker, Result *result)
+{
+    result->sent += worker->sent;
+    result->completed += worker->completed;
+    result->errors += worker->errors;
+    result->bytesSent += worker->bytesSent;
+    result->bytesReceived += worker->bytesReceived;
+    worker->latency->mergeInto(&result->latency);
+    worker->serviceTime->mergeInto(&result->serviceTime);
+    if (options_.mode == kOpenLoop)
+    {
+        uint64_t now = TscClock::ticks();
+        for (auto &s : worker->sessions)
+        {
+            if (s->conn && now >= s->firstTicks)
+            {
+                int64_t due = static_cast<int64_t>((now - s->firstTicks) / intervalTicks_) + 1;
+                result->backlog += due > s->scheduled ? due - s->scheduled : 0;
+            }
+        }
+    }
+}
+
+void LoadGenerator::resetInLoop(Worker *worker, uint64_t expectedIntervalTicks)
+{
+    worker->latency.reset(new Histogram);
+    worker->serviceTime.reset(new Histogram);
+    worker->expectedIntervalTicks = expectedIntervalTicks;
+    worker->sent = worker->completed = worker->errors = worker->bytesSent = worker->bytesReceived = 0;
+}
+
+void LoadGenerator::stopInLoop(Worker *worker)
+{
+    if (worker->timerChannel)
+    {
+        worker->timerChannel->disableAll();
+        worker->timerChannel->remove();
+        worker->timerChannel.reset();
+        ::close(worker->timerfd);
+        worker->timerfd = -1;
+    }
+    for (auto &s : worker->sessions)
+    {
+        if (s->conn)
+        {
+            s->conn->connectionDestroyed();
+            s->conn.reset();
+        }
+    }
+}
+
+LoadGenerator::Result LoadGenerator::collect(bool stopAfterCollect)
+{
+    std::vector<Result> parts(workers_.size());
+    runOnWorkers([this, &parts, stopAfterCollect](Worker *w) {
+        collectInLoop(w, &parts[w->index]);
+        if (stopAfterCollect)
+        {
+            stopInLoop(w);
+        }
+    });
+    Result result;
+    for (const Result &part : parts)
+    {
+        result.merge(part);
+    }
+    return result;
+}
+
+void LoadGenerator::resetStats()
+{
+    uint64_t expected = 0;
+    if (options_.mode == kClosedLoop)
+    {
+        if (options_.expectedIntervalMicros > 0)
+        {
+            expected = static_cast<uint64_t>(options_.expectedIntervalMicros * ticksPerSecond_ / 1e6);
+        }
+        else
+        {
+            // 预热阶段服务时间的中位数作为预期间隔
+            Result warmup = collect(false);
+            expected = static_cast<uint64_t>(warmup.serviceTime.percentileNanos(0.5) * ticksPerSecond_ / 1e9);
+        }
+    }
+    runOnWorkers([this, expected](Worker *w) { resetInLoop(w, expected); });
+    statsStart_ = std::chrono::steady_clock::now();
+}
+
+LoadGenerator::Result LoadGenerator::stop()
+{
+    Result result;
+    if (!started_ || stopped_)
+    {
+        return result;
+    }
+    stopped_ = true;
+    result = collect(true);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - statsStart_).count();
+    return result;
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include "noncopyable.h"
+#include "inetAddress.h"
+#include "Callbacks.h"
+#include "Histogram.h"
+#include "Timestamp.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class EventLoop;
+class EventLoopThreadPoll;
+class Channel;
+class Buffer;
+
+/*
+ * 压测客户端 用库自己的EventLoop/EventLoopThreadPoll 对一个服务器发请求 统计吞吐和延迟 用来评估一台服务器能扛多少量
+ * 连接平均分到各个loop上 每个连接的状态和统计只在自己的loop线程里面访问 没有锁
+ * 同一个loop上要发的请求拼成一次send 同一个连接最多pipeline个请求在路上 服务器必须按顺序回复
+ *
+ * 两种模式:
+ *   闭环(kClosedLoop): 每个连接保持pipeline个请求在路上 收到一个响应马上补一个 测的是最大吞吐
+ *   开环(kOpenLoop): 所有连接合起来按固定速率rate发 每个请求有一个计划发送时间 和服务器快慢无关
+ *     到点的时候pipeline满了 请求就排着(backlog) 等有响应回来再发
+ *
+ * 协调遗漏(coordinated omission)校正:
+ *   服务器卡住的时候 闭环的客户端也跟着不发请求 本来应该在卡顿期间发出的请求的延迟就"漏"掉了
+ *   开环: latency从计划发送时间算起 而不是真正发出去的时间 排队等待的时间都算进去
+ *   闭环: 和HdrHistogram的recordValueWithExpectedInterval一样 一个延迟L超过预期间隔E 再补记L-E L-2E ...直到E
+ *   E没有设置的时候 在resetStats的时候取之前(预热阶段)服务时间的中位数 没调用过resetStats就不校正
+ *   serviceTime是真正发出去到收到响应的时间 不做校正 两个一起看
+ *
+ * 用法:
+ *   EventLoop loop;
+ *   LoadGenerator::Options options;
+ *   options.connections = 64; options.pipeline = 8; options.requests.push_back(request);
+ *   LoadGenerator gen(&loop, InetAddress(9981, "127.0.0.1"), options);
+ *   gen.setThreadNum(2);
+ *   gen.start();
+ *   // 另一个线程: sleep预热 gen.resetStats(); sleep测量 auto result = gen.stop(); loop.quit();
+ *   loop.loop();
+ */
+class LoadGenerator : noncopyable
+{
+public:
+    enum Mode
+    {
+        kClosedLoop,
+        kOpenLoop,
+    };
+
+    // 在收到的数据开头找一个完整的响应 返回它的长度 还不完整返回0
+    using ResponseFramer = std::function<size_t(const char *data, size_t len)>;
+    // 每个响应固定size字节
+    static ResponseFramer fixedSizeFramer(size_t size);
+    // 响应以delimiter结尾(比如"\r\n")
+    static ResponseFramer delimiterFramer(const std::string &delimiter);
+
+    struct Options
+    {
+        int connections;                   // 默认1
+        int pipeline;                      // 每个连接最多多少个请求在路上 默认1
+        Mode mode;                         // 默认kClosedLoop
+        double rate;                       // 开环时所有连接加起来每秒的请求数
+        int tickMicros;                    // 开环时检查一次到点请求的间隔 默认100us
+        int64_t expectedIntervalMicros;    // 闭环校正用的预期间隔 0表示resetStats的时候自动取
+        std::vector<std::string> requests; // 请求模板 每个连接依次轮流发
+        ResponseFramer framer;             // 为空的时候每个响应和对应的请求一样长(echo)
+
+        Options();
+    };
+
+    struct Result
+    {
+        double seconds;
+        int64_t sent;          // 发出去的请求数
+        int64_t completed;     // 收到的响应数
+        int64_t errors;        // 被服务器关掉的连接数
+        int64_t backlog;       // 开环 结束的时候已经到点还没发出去的请求数
+        int64_t bytesSent;
+        int64_t bytesReceived;
+        HistogramSnapshot latency;     // 协调遗漏校正以后的延迟
+        HistogramSnapshot serviceTime; // 真正发出去到收到响应
+
+        Result();
+        double requestsPerSecond() const { return seconds > 0 ? completed / seconds : 0; }
+        // 把另一部分(另一个loop)的计数和直方图加进来
+        void merge(const Result &other);
+        // 一行key=value
+        std::string toString() const;
+    };
+
+    LoadGenerator(EventLoop *loop, const InetAddress &serverAddr, const Options &options,
+                  const std::string &name = std::string("LoadGenerator"));
+    ~LoadGenerator();
+
+    // start之前设置 0表示所有连接都在loop上
+    void setThreadNum(int numThreads);
+
+    // 在loop线程里面调用(一般是loop.loop()之前) 启动线程 阻塞地建立所有连接 然后开始发请求
+    // 连不上的连接记在errors里面
+    void start();
+    // 清空统计 重新计时 预热结束的时候调用  下面两个都要在loop线程以外的线程调用 会等各个loop处理完
+    void resetStats();
+    // 停止发请求 断开所有连接 返回从start(或者上一次resetStats)以来的结果 只能调用一次
+    Result stop();
+
+private:
+    struct Worker;
+    struct Session;
+
+    void startSession(Session *session);
+    void pump(Session *session, uint64_t now);
+    void flush(Session *session);
+    void onMessage(Session *session, const TcpConnectionPtr &conn, Buffer *buf, Timestamp);
+    void onClose(Session *session, const TcpConnectionPtr &conn);
+    void onTick(Worker *worker);
+    // 下面几个在worker的loop线程里面执行
+    void collectInLoop(Worker *worker, Result *result);
+    void resetInLoop(Worker *worker, uint64_t expectedIntervalTicks);
+    void stopInLoop(Worker *worker);
+    // 在每个loop上执行func 等它们都执行完  各个loop是并行执行的 func只能写自己worker对应的东西
+    void runOnWorkers(const std::function<void(Worker *)> &func);
+    // 每个loop收集自己的一份 再合并
+    Result collect(bool stopAfterCollect);
+
+    EventLoop *loop_;
+    const InetAddress serverAddr_;
+    const Options options_;
+    const std::string name_;
+    std::unique_ptr<EventLoopThreadPoll> threadPool_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    double ticksPerSecond_;
+    double intervalTicks_; // 开环时每个连接两个请求之间的ticks
+    std::chrono::steady_clock::time_point statsStart_;
+    bool started_;
+    bool stopped_;
+};
@@ -0,0 +1,247 @@
+#include "LogFile.h"
+#include <algorithm>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+
+static const size_t kDefaultRollSize = 64 * 1024 * 1024;
+static const int kDefaultRollIntervalSec = 24 * 60 * 60;
+
+// 0会让append里面除零/死循环 给个提示换成默认值
+static size_t checkRollSize(size_t rollSize)
+{
+    if (rollSize == 0)
+    {
+        fprintf(stderr, "LogFile rollSize must be > 0, use %zu\n", kDefaultRollSize);
+        return kDefaultRollSize;
+    }
+    return rollSize;
+}
+
+static int checkRollInterval(int rollIntervalSec)
+{
+    if (rollIntervalSec <= 0)
+    {
+        fprintf(stderr, "LogFile rollIntervalSec must be > 0, use %d\n", kDefaultRollIntervalSec);
+        return kDefaultRollIntervalSec;
+    }
+    return rollIntervalSec;
+}
+
+LogFile::LogFile(const std::string &basename,
+                 size_t rollSize,
+                 int rollIntervalSec,
+                 int fsyncIntervalSec,
+                 int keepFiles)
+    : basename_(basename),
+      rollSize_(checkRollSize(rollSize)),
+      rollIntervalSec_(checkRollInterval(rollIntervalSec)),
+      fsyncIntervalSec_(fsyncIntervalSec),
+      keepFiles_(keepFiles),
+      fd_(-1),
+      mapped_(nullptr),
+      written_(0),
+      startOfPeriod_(0),
+      lastSync_(0),
+      rollCount_(0)
+{
+    rollFile(::time(NULL));
+}
+
+LogFile::~LogFile()
+{
+    closeFile();
+}
+
+void LogFile::append(const char *data, size_t len)
+{
+    time_t now = ::time(NULL);
+    if (now / rollIntervalSec_ * rollIntervalSec_ != startOfPeriod_)
+    {
+        rollFile(now);
+    }
+
+    while (len > 0 && fd_ >= 0)
+    {
+        if (written_ >= rollSize_)
+        {
+            rollFile(now);
+        }
+        size_t n = std::min(len, rollSize_ - written_);
+        if (n < len)
+        {
+            // 这一段放不下了 只写到最后一个完整的行 剩下的行整行放到下一段 不要把一行拆到两个文件里
+            const char *eol = static_cast<const char *>(::memrchr(data, '\n', n));
+            if (eol)
+            {
+                n = eol - data + 1;
+            }
+            else if (written_ > 0)
+            {
+                rollFile(now);
+                continue;
+            }
+            // 一行比整段还长 只能拆开写
+        }
+        if (mapped_)
+        {
+            memcpy(mapped_ + written_, data, n);
+        }
+        else
+        {
+            writeFallback(data, n);
+        }
+        written_ += n;
+        data += n;
+        len -= n;
+    }
+    sync(false);
+}
+
+void LogFile::sync(bool force)
+{
+    time_t now = ::time(NULL);
+    if (fd_ >= 0 && (force || now - lastSync_ >= fsyncIntervalSec_))
+    {
+        ::fdatasync(fd_); // 对MAP_SHARED映射的脏页同样有效
+        lastSync_ = now;
+    }
+}
+
+void LogFile::writeFallback(const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::pwrite(fd_, data, len, written_);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            fprintf(stderr, "LogFile::writeFallback %s error:%d\n", filename_.c_str(), errno);
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+void LogFile::closeFile()
+{
+    if (fd_ < 0)
+    {
+        return;
+    }
+    if (mapped_)
+    {
+        ::munmap(mapped_, rollSize_);
+        mapped_ = nullptr;
+    }
+    ::ftruncate(fd_, written_); // 去掉预分配了但是没写的部分
+    ::fdatasync(fd_);
+    ::close(fd_);
+    fd_ = -1;
+}
+
+void LogFile::rollFile(time_t now)
+{
+    closeFile();
+
+    char timebuf[32];
+    struct tm tm;
+    ::localtime_r(&now, &tm);
+    strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S", &tm);
+    char buf[64];
+    // 同一秒里面滚动多次的时候 用rollCount_区分文件名
+    snprintf(buf, sizeof buf, "%s.%d.%06d.log", timebuf, ::getpid(), rollCount_);
+    filename_ = basename_ + buf;
+
+    written_ = 0;
+    startOfPeriod_ = now / rollIntervalSec_ * rollIntervalSec_;
+    lastSync_ = now;
+    rollCount_++;
+
+    fd_ = ::open(filename_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+    {
+        fprintf(stderr, "LogFile::rollFile open %s error:%d\n", filename_.c_str(), errno);
+        return;
+    }
+    // 预分配磁盘块 分配不到(磁盘满 文件系统不支持)就不能mmap: 稀疏文件的页写的时候才分配 磁盘满了是SIGBUS
+    // 退化成write 出错的时候至少能打一条日志
+    if (::fallocate(fd_, 0, 0, rollSize_) != 0)
+    {
+        fprintf(stderr, "LogFile::rollFile fallocate %s error:%d use write\n", filename_.c_str(), errno);
+        mapped_ = nullptr;
+        removeOldFiles();
+        return;
+    }
+    void *p = ::mmap(NULL, rollSize_, PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED)
+    {
+        fprintf(stderr, "LogFile::rollFile mmap %s error:%d use write\n", filename_.c_str(), errno);
+        mapped_ = nullptr;
+    }
+    else
+    {
+        mapped_ = static_cast<char *>(p);
+        ::madvise(mapped_, rollSize_, MADV_SEQUENTIAL);
+    }
+
+    removeOldFiles();
+}
+
+void LogFile::removeOldFiles()
+{
+    if (keepFiles_ <= 0)
+    {
+        return;
+    }
+    std::string dir = ".";
+    std::string prefix = basename_;
+    size_t slash = basename_.rfind('/');
+    if (slash != std::string::npos)
+    {
+        dir = basename_.substr(0, slash + 1);
+        prefix = basename_.substr(slash + 1);
+    }
+    prefix += ".";
+
+    DIR *d = ::opendir(dir.c_str());
+    if (d == nullptr)
+    {
+        return;
+    }
+    std::vector<std::string> files;
+    while (struct dirent *ent = ::readdir(d))
+    {
+        std::string name(ent->d_name);
+        if (name.compare(0, prefix.size(), prefix) == 0 && name.size() > 4 &&
+            name.compare(name.size() - 4, 4, ".log") == 0)
+        {
+            files.push_back(name);
+        }
+    }
+    ::closedir(d);
+
+    // 文件名里面有时间 按名字排序就是按时间排序
+    if (files.size() <= static_cast<size_t>(keepFiles_))
+    {
+        return;
+    }
+    std::sort(files.begin(), files.end());
+    std::string current = filename_.substr(filename_.rfind('/') == std::string::npos ? 0 : filename_.rfind('/') + 1);
+    for (size_t i = 0; i + keepFiles_ < files.size(); i++)
+    {
+        if (files[i] != current)
+        {
+            ::unlink((slash == std::string::npos ? files[i] : dir + files[i]).c_str());
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "noncopyable.h"
+#include <string>
+#include <time.h>
+
+/*
+ * 按大小和时间滚动的日志文件 只给AsyncLogging的后台线程用(单线程写 没有加锁)
+ * 每一段文件创建的时候就用fallocate预分配rollSize字节 然后整段mmap进来 写日志就是memcpy
+ * 预分配失败(磁盘满 文件系统不支持)的这一段不mmap 退化成pwrite 不会因为写稀疏文件的页收到SIGBUS
+ * 写的时候不会再有分配磁盘块 改文件大小这些元数据操作 缺页也只发生在后台线程 不会卡住io loop
+ * 一段写满了(或者到了滚动的时间)把文件截断到实际写入的长度 再开下一段
+ * 文件名: basename.20260101-120000.pid.序号.log   keepFiles > 0 的时候只保留最近的keepFiles个文件
+ */
+class LogFile : noncopyable
+{
+public:
+    LogFile(const std::string &basename,
+            size_t rollSize = 64 * 1024 * 1024,
+            int rollIntervalSec = 24 * 60 * 60,
+            int fsyncIntervalSec = 3,
+            int keepFiles = 0);
+    ~LogFile();
+
+    void append(const char *data, size_t len);
+    // 距离上一次fdatasync超过fsyncIntervalSec或者force的时候 把写入的数据刷到磁盘
+    void sync(bool force = false);
+
+    const std::string &currentFile() const { return filename_; }
+    int rollCount() const { return rollCount_; }
+
+private:
+    void rollFile(time_t now);
+    void closeFile();
+    void removeOldFiles();
+    void writeFallback(const char *data, size_t len);
+
+    const std::string basename_;
+    const size_t rollSize_;
+    const int rollIntervalSec_;
+    const int fsyncIntervalSec_;
+    const int keepFiles_;
+
+    std::string filename_;
+    int fd_;
+    char *mapped_;    // mmap失败的时候为空 退化成write
+    size_t written_;  // 当前这一段已经写入的字节数
+    time_t startOfPeriod_;
+    time_t lastSync_;
+    int rollCount_;
+};
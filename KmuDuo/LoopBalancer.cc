@@ -0,0 +1,151 @@
+#include "LoopBalancer.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+#include "logger.h"
+#include <algorithm>
+#include <utility>
+
+LoopBalancer::LoopBalancer(double busyGap, int maxMovesPerRound)
+    : busyGap_(busyGap),
+      maxMovesPerRound_(maxMovesPerRound),
+      moved_(0),
+      baseloop_(nullptr),
+      intervalMs_(0),
+      thread_(std::bind(&LoopBalancer::threadFunc, this), "LoopBalancer"),
+      running_(false)
+{
+}
+
+LoopBalancer::~LoopBalancer()
+{
+    stop();
+}
+
+void LoopBalancer::start(EventLoop *baseloop, int intervalMs, const TickCallback &cb)
+{
+    baseloop_ = baseloop;
+    intervalMs_ = intervalMs;
+    tickCallback_ = cb;
+    alive_.reset(new int(0));
+    running_ = true;
+    thread_.start();
+}
+
+void LoopBalancer::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!running_)
+        {
+            return;
+        }
+        running_ = false;
+        cond_.notify_one();
+    }
+    thread_.join();
+    alive_.reset(); // 和执行tick在同一个线程 不会和检查冲突
+}
+
+void LoopBalancer::threadFunc()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_)
+    {
+        cond_.wait_for(lock, std::chrono::milliseconds(intervalMs_));
+        if (running_)
+        {
+            std::weak_ptr<int> alive(alive_);
+            TickCallback cb = tickCallback_;
+            baseloop_->queueLoop([alive, cb]() {
+                if (!alive.expired())
+                {
+                    cb();
+                }
+            });
+        }
+    }
+}
+
+void LoopBalancer::rebalance(const std::vector<EventLoop *> &loops, const std::vector<TcpConnectionPtr> &conns)
+{
+    auto now = std::chrono::steady_clock::now();
+    double elapsedUs = std::chrono::duration<double, std::micro>(now - lastSample_).count();
+    bool firstSample = lastBusy_.empty();
+    lastSample_ = now;
+
+    // 每个loop这段时间的繁忙比例 用loop线程的CPU时间算 机器上线程比核多的时候墙上时间不准
+    std::unordered_map<EventLoop *, int64_t> busy;
+    std::unordered_map<EventLoop *, double> busyRatio;
+    for (EventLoop *loop : loops)
+    {
+        busy[loop] = loop->cpuMicroSeconds();
+        auto it = lastBusy_.find(loop);
+        busyRatio[loop] = it == lastBusy_.end() ? 0 : (busy[loop] - it->second) / elapsedUs;
+    }
+    lastBusy_.swap(busy);
+
+    // 每个连接这段时间的字节速率 按所在的loop分组
+    std::unordered_map<std::string, uint64_t> bytes;
+    std::unordered_map<EventLoop *, std::vector<std::pair<double, TcpConnectionPtr>>> connsOfLoop;
+    std::unordered_map<EventLoop *, double> loopRate;
+    for (const TcpConnectionPtr &conn : conns)
+    {
+        uint64_t total = conn->bytesReceived() + conn->bytesSent();
+        bytes[conn->name()] = total;
+        auto it = lastBytes_.find(conn->name());
+        double rate = (it == lastBytes_.end() || it->second > total) ? 0 : (total - it->second) / elapsedUs;
+        connsOfLoop[conn->getLoop()].push_back(std::make_pair(rate, conn));
+        loopRate[conn->getLoop()] += rate;
+    }
+    lastBytes_.swap(bytes); // 已经断开的连接顺便就清理掉了
+
+    if (firstSample || loops.size() < 2)
+    {
+        return;
+    }
+
+    EventLoop *hot = loops[0];
+    EventLoop *cold = loops[0];
+    for (EventLoop *loop : loops)
+    {
+        if (busyRatio[loop] > busyRatio[hot])
+        {
+            hot = loop;
+        }
+        if (busyRatio[loop] < busyRatio[cold])
+        {
+            cold = loop;
+        }
+    }
+    if (busyRatio[hot] - busyRatio[cold] < busyGap_)
+    {
+        return;
+    }
+
+    // 用字节速率估计负载 目标是把两边的差值挪走一半
+    // 从最热的连接开始挪 但是单个连接比剩下要挪的还多就跳过 不然只是把热点搬了个家
+    double remaining = (loopRate[hot] - loopRate[cold]) / 2;
+    std::vector<std::pair<double, TcpConnectionPtr>> &candidates = connsOfLoop[hot];
+    std::sort(candidates.begin(), candidates.end(),
+              [](const std::pair<double, TcpConnectionPtr> &a, const std::pair<double, TcpConnectionPtr> &b) {
+                  return a.first > b.first;
+              });
+    int moves = 0;
+    for (auto &item : candidates)
+    {
+        if (moves >= maxMovesPerRound_ || remaining <= 0)
+        {
+            break;
+        }
+        if (item.first <= 0 || item.first > remaining)
+        {
+            continue;
+        }
+        LOG_INFO("LoopBalancer::rebalance move %s (%.0f B/s) busy %.2f => %.2f\n",
+                 item.second->name().c_str(), item.first * 1000000, busyRatio[hot], busyRatio[cold]);
+        item.second->migrateTo(cold);
+        remaining -= item.first;
+        moves++;
+    }
+    moved_ += moves;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Thread.h"
+#include <functional>
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+class EventLoop;
+class TcpConnection;
+
+/*
+ * 后台均衡器 解决TcpConnection一旦分配给某个subloop就再也不动的问题
+ * 后台线程每隔intervalMs往baseloop里面投递一次tick回调(TcpServer::rebalanceInLoop)
+ * rebalance在baseloop里面执行: 采样每个subloop线程的CPU时间和每个连接的收发字节速率
+ * 最忙和最闲的loop繁忙比例相差超过busyGap时 把最忙loop上最热的连接迁移(TcpConnection::migrateTo)到最闲的loop
+ */
+class LoopBalancer : noncopyable
+{
+public:
+    using TickCallback = std::function<void()>;
+
+    explicit LoopBalancer(double busyGap = 0.2, int maxMovesPerRound = 4);
+    ~LoopBalancer();
+
+    // 开启后台线程 每隔intervalMs把cb投递到baseloop上执行
+    void start(EventLoop *baseloop, int intervalMs, const TickCallback &cb);
+    // 在baseloop线程调用 返回以后已经投递出去还没执行的cb也不会再执行
+    void stop();
+
+    // 只能在baseloop线程调用 loops是参与轮询的subloop conns是当前所有的连接
+    void rebalance(const std::vector<EventLoop *> &loops, const std::vector<TcpConnectionPtr> &conns);
+
+    // 一共迁移过的连接数
+    int moved() const { return moved_; }
+
+private:
+    void threadFunc();
+
+    double busyGap_;
+    int maxMovesPerRound_;
+    int moved_;
+
+    // 上一次采样的值 算增量用
+    std::chrono::steady_clock::time_point lastSample_;
+    std::unordered_map<EventLoop *, int64_t> lastBusy_;
+    std::unordered_map<std::string, uint64_t> lastBytes_; // 按连接名 指针释放以后可能被新连接复用
+
+    EventLoop *baseloop_;
+    int intervalMs_;
+    TickCallback tickCallback_;
+    std::shared_ptr<int> alive_; // stop的时候释放 投递出去的tick先检查它
+    Thread thread_;
+    bool running_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+};
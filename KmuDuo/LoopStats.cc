@@ -0,0 +1,113 @@
+#include "LoopStats.h"
+#include "TscClock.h"
+#include <algorithm>
+#include <stdio.h>
+
+LoopStatsSnapshot::LoopStatsSnapshot()
+    : iterations(0),
+      pollWaitNanos(0),
+      handlerNanos(0),
+      functorNanos(0),
+      events(0),
+      maxEventsPerPoll(0),
+      wakeups(0),
+      functors(0),
+      maxFunctorBatch(0),
+      queueDepth(0)
+{
+}
+
+double LoopStatsSnapshot::busyRatio() const
+{
+    int64_t busy = handlerNanos + functorNanos;
+    int64_t total = busy + pollWaitNanos;
+    return total > 0 ? static_cast<double>(busy) / total : 0;
+}
+
+LoopStatsSnapshot LoopStatsSnapshot::operator-(const LoopStatsSnapshot &rhs) const
+{
+    LoopStatsSnapshot d(*this);
+    d.iterations -= rhs.iterations;
+    d.pollWaitNanos -= rhs.pollWaitNanos;
+    d.handlerNanos -= rhs.handlerNanos;
+    d.functorNanos -= rhs.functorNanos;
+    d.events -= rhs.events;
+    d.wakeups -= rhs.wakeups;
+    d.functors -= rhs.functors;
+    // 最大值和当前队列长度没法相减 保留后一份的
+    d.dispatchDelay = dispatchDelay - rhs.dispatchDelay;
+    d.functorDelay = functorDelay - rhs.functorDelay;
+    d.messageCallback = messageCallback - rhs.messageCallback;
+    return d;
+}
+
+void LoopStatsSnapshot::merge(const LoopStatsSnapshot &other)
+{
+    iterations += other.iterations;
+    pollWaitNanos += other.pollWaitNanos;
+    handlerNanos += other.handlerNanos;
+    functorNanos += other.functorNanos;
+    events += other.events;
+    maxEventsPerPoll = std::max(maxEventsPerPoll, other.maxEventsPerPoll);
+    wakeups += other.wakeups;
+    functors += other.functors;
+    maxFunctorBatch = std::max(maxFunctorBatch, other.maxFunctorBatch);
+    queueDepth += other.queueDepth;
+    dispatchDelay.merge(other.dispatchDelay);
+    functorDelay.merge(other.functorDelay);
+    messageCallback.merge(other.messageCallback);
+}
+
+std::string LoopStatsSnapshot::toString() const
+{
+    char buf[512];
+    snprintf(buf, sizeof buf,
+             "iterations=%ld poll_wait_us=%ld handler_us=%ld functor_us=%ld busy=%.3f events=%ld events_per_poll=%.2f "
+             "max_events_per_poll=%ld wakeups=%ld functors=%ld max_functor_batch=%ld queue_depth=%ld",
+             static_cast<long>(iterations), static_cast<long>(pollWaitNanos / 1000),
+             static_cast<long>(handlerNanos / 1000), static_cast<long>(functorNanos / 1000), busyRatio(),
+             static_cast<long>(events), eventsPerPoll(), static_cast<long>(maxEventsPerPoll),
+             static_cast<long>(wakeups), static_cast<long>(functors), static_cast<long>(maxFunctorBatch),
+             static_cast<long>(queueDepth));
+    return buf;
+}
+
+std::string LoopStatsSnapshot::histogramsToString() const
+{
+    return "dispatch_delay " + dispatchDelay.toString() + "\n" +
+           "functor_delay " + functorDelay.toString() + "\n" +
+           "message_callback " + messageCallback.toString() + "\n";
+}
+
+LoopStats::LoopStats()
+    : iterations_(0),
+      pollWaitTicks_(0),
+      handlerTicks_(0),
+      functorTicks_(0),
+      events_(0),
+      maxEventsPerPoll_(0),
+      wakeups_(0),
+      functors_(0),
+      maxFunctorBatch_(0),
+      queueDepth_(0)
+{
+}
+
+LoopStatsSnapshot LoopStats::snapshot() const
+{
+    LoopStatsSnapshot s;
+    s.iterations = iterations_.load(std::memory_order_relaxed);
+    s.pollWaitNanos = TscClock::elapsedNanos(pollWaitTicks_.load(std::memory_order_relaxed));
+    s.handlerNanos = TscClock::elapsedNanos(handlerTicks_.load(std::memory_order_relaxed));
+    s.functorNanos = TscClock::elapsedNanos(functorTicks_.load(std::memory_order_relaxed));
+    s.events = events_.load(std::memory_order_relaxed);
+    s.maxEventsPerPoll = maxEventsPerPoll_.load(std::memory_order_relaxed);
+    s.wakeups = wakeups_.load(std::memory_order_relaxed);
+    s.functors = functors_.load(std::memory_order_relaxed);
+    s.maxFunctorBatch = maxFunctorBatch_.load(std::memory_order_relaxed);
+    s.queueDepth = queueDepth_.load(std::memory_order_relaxed);
+    dispatchDelay_.mergeInto(&s.dispatchDelay);
+    functorDelay_.mergeInto(&s.functorDelay);
+    messageCallback_.mergeInto(&s.messageCallback);
+    return s;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include "noncopyable.h"
+#include "Histogram.h"
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+// EventLoop运行统计的一份快照 都是从loop创建开始累计的值 两次快照相减就是这段时间的情况
+struct LoopStatsSnapshot
+{
+    int64_t iterations;         // poll返回的次数
+    int64_t pollWaitNanos;      // 阻塞在poll里面的时间
+    int64_t handlerNanos;       // Channel::handleEvent回调的时间
+    int64_t functorNanos;       // doPendingFunctors的时间
+    int64_t events;             // poll返回的活跃channel总数
+    int64_t maxEventsPerPoll;   // 一次poll返回最多的活跃channel数
+    int64_t wakeups;            // 被wakeupFd_唤醒的次数
+    int64_t functors;           // 执行过的回调数
+    int64_t maxFunctorBatch;    // 一次doPendingFunctors最多执行的回调数
+    int64_t queueDepth;         // 现在pendingFunctors_里面等着的回调数
+
+    HistogramSnapshot dispatchDelay;   // poll返回到调用MessageCallback
+    HistogramSnapshot functorDelay;    // functor从queueLoop到开始执行
+    HistogramSnapshot messageCallback; // MessageCallback执行的时间
+
+    LoopStatsSnapshot();
+
+    // 忙的比例 (回调 + functor) / 总时间
+    double busyRatio() const;
+    double eventsPerPoll() const { return iterations > 0 ? static_cast<double>(events) / iterations : 0; }
+    // 后一份减前一份
+    LoopStatsSnapshot operator-(const LoopStatsSnapshot &rhs) const;
+    // 把另一个loop的统计加进来 计数相加 最大值取大的 直方图合并
+    void merge(const LoopStatsSnapshot &other);
+    // key=value 一行
+    std::string toString() const;
+    // 三个直方图 每个一行 dispatch_delay count=... p50_us=... p99_us=... p999_us=... max_us=...
+    std::string histogramsToString() const;
+};
+
+/*
+ * EventLoop自己的运行统计 除了queueDepth_ 都只由loop线程写 任意线程都可以读
+ * 单写者 写的时候不需要原子的read-modify-write 只用relaxed的load+store 开销就是几条mov
+ * 时间用TscClock::ticks()记录原始计数 读快照的时候才换算成纳秒
+ * 前后各垫一个cache line 不会和EventLoop里面别的线程会写的成员(mutex_ wakeupPending_)挤在同一个cache line
+ * queueDepth_由投递回调的线程写 前后也垫开 单独占一个cache line
+ * 用填充而不是alignas(64): C++17之前new不保证按超过alignof(max_align_t)的要求对齐 EventLoop可能是new出来的
+ */
+class LoopStats : noncopyable
+{
+public:
+    LoopStats();
+
+    // 下面的都只在loop线程里面调用
+    void addIteration(uint64_t pollTicks, uint64_t handlerTicks, uint64_t functorTicks, int events)
+    {
+        add(iterations_, 1);
+        add(pollWaitTicks_, pollTicks);
+        add(handlerTicks_, handlerTicks);
+        add(functorTicks_, functorTicks);
+        add(events_, events);
+        if (events > maxEventsPerPoll_.load(std::memory_order_relaxed))
+        {
+            maxEventsPerPoll_.store(events, std::memory_order_relaxed);
+        }
+    }
+    void addWakeup() { add(wakeups_, 1); }
+    void addFunctors(size_t n)
+    {
+        add(functors_, n);
+        if (static_cast<int64_t>(n) > maxFunctorBatch_.load(std::memory_order_relaxed))
+        {
+            maxFunctorBatch_.store(n, std::memory_order_relaxed);
+        }
+    }
+
+    void recordFunctorDelay(uint64_t ticks) { functorDelay_.record(ticks); }
+    void recordMessageCallback(uint64_t dispatchTicks, uint64_t callbackTicks)
+    {
+        dispatchDelay_.record(dispatchTicks);
+        messageCallback_.record(callbackTicks);
+    }
+
+    // 持有pendingFunctors_的锁的时候调用 任意线程
+    void setQueueDepth(size_t depth) { queueDepth_.store(depth, std::memory_order_relaxed); }
+
+    // 任意线程
+    LoopStatsSnapshot snapshot() const;
+
+private:
+    static const size_t kCacheLine = 64;
+
+    static void add(std::atomic<int64_t> &counter, int64_t delta)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    char padBefore_[kCacheLine];
+    std::atomic<int64_t> iterations_;
+    std::atomic<int64_t> pollWaitTicks_;
+    std::atomic<int64_t> handlerTicks_;
+    std::atomic<int64_t> functorTicks_;
+    std::atomic<int64_t> events_;
+    std::atomic<int64_t> maxEventsPerPoll_;
+    std::atomic<int64_t> wakeups_;
+    std::atomic<int64_t> functors_;
+    std::atomic<int64_t> maxFunctorBatch_;
+    Histogram dispatchDelay_;
+    Histogram functorDelay_;
+    Histogram messageCallback_;
+    char padQueueDepth_[kCacheLine];
+    std::atomic<int64_t> queueDepth_;
+    char padAfter_[kCacheLine]; // 没有按cache line对齐 要垫满一整个才能保证后面的成员不在同一行
+};
@@ -0,0 +1,279 @@
+#include "LoopWatchdog.h"
+#include "EventLoop.h"
+#include "TscClock.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+namespace
+{
+    // 抓栈的状态 整个进程同一时间只抓一个线程的栈 由g_captureMutex保证
+    enum CaptureState
+    {
+        kIdle,
+        kRequested, // 看门狗已经发了信号
+        kCapturing, // 信号处理函数正在backtrace
+        kDone,
+    };
+
+    const int kMaxFrames = 64;
+    // 等信号处理函数多久 loop线程把信号屏蔽了的话就放弃
+    const int kCaptureTimeoutMs = 200;
+
+    std::mutex g_captureMutex;
+    std::atomic<int> g_captureState(kIdle);
+    void *g_frames[kMaxFrames];
+    int g_depth = 0;
+
+    // 在被卡住的loop线程上执行 只有请求过的时候才抓 迟到的信号直接忽略
+    void stackSignalHandler(int)
+    {
+        int savedErrno = errno;
+        int expected = kRequested;
+        if (g_captureState.compare_exchange_strong(expected, kCapturing))
+        {
+            g_depth = ::backtrace(g_frames, kMaxFrames);
+            g_captureState.store(kDone, std::memory_order_release);
+        }
+        errno = savedErrno;
+    }
+
+    // "libmymuduo.so(_ZN9EventLoop4loopEv+0x12) [0x7f..]" 括号里面的符号名换成demangle以后的
+    std::string demangleFrame(const char *frame)
+    {
+        std::string s(frame);
+        size_t begin = s.find('(');
+        size_t end = s.find('+', begin);
+        if (begin == std::string::npos || end == std::string::npos || end == begin + 1)
+        {
+            return s;
+        }
+        std::string mangled = s.substr(begin + 1, end - begin - 1);
+        int status = 0;
+        char *name = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+        if (status == 0 && name)
+        {
+            s.replace(begin + 1, end - begin - 1, name);
+        }
+        free(name);
+        return s;
+    }
+
+    void defaultStallCallback(const LoopWatchdog::StallInfo &info)
+    {
+        // 一条日志最多1024字节 栈帧一行一条
+        LOG_ERROR("LoopWatchdog: EventLoop %p tid=%d stalled %ld ms fd=%d revents=%d%s",
+                  info.loop, info.tid, static_cast<long>(info.stalledMicros / 1000), info.fd, info.revents,
+                  info.recovered ? " (recovered before stack capture)" : "");
+        for (size_t i = 0; i < info.stack.size(); ++i)
+        {
+            LOG_ERROR("LoopWatchdog:   #%zu %s", i, info.stack[i].c_str());
+        }
+    }
+}
+
+std::string LoopWatchdog::StallInfo::toString() const
+{
+    char buf[256];
+    snprintf(buf, sizeof buf, "loop=%p tid=%d fd=%d revents=%d stalled_ms=%ld recovered=%d\n",
+             loop, tid, fd, revents, static_cast<long>(stalledMicros / 1000), recovered ? 1 : 0);
+    std::string s(buf);
+    for (size_t i = 0; i < stack.size(); ++i)
+    {
+        snprintf(buf, sizeof buf, "  #%zu ", i);
+        s += buf;
+        s += stack[i];
+        s += '\n';
+    }
+    return s;
+}
+
+LoopWatchdog::LoopWatchdog(int stallThresholdMs, int signo)
+    : thresholdNanos_(static_cast<int64_t>(stallThresholdMs) * 1000000),
+      signo_(signo),
+      stalls_(0),
+      stallCallback_(defaultStallCallback),
+      running_(false)
+{
+}
+
+LoopWatchdog::~LoopWatchdog()
+{
+    stop();
+}
+
+void LoopWatchdog::watch(EventLoop *loop)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    Watched w = {loop, 0};
+    watched_.push_back(w);
+}
+
+void LoopWatchdog::unwatch(EventLoop *loop)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    watched_.erase(std::remove_if(watched_.begin(), watched_.end(),
+                                  [loop](const Watched &w) { return w.loop == loop; }),
+                   watched_.end());
+}
+
+void LoopWatchdog::start()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (running_)
+        {
+            return;
+        }
+        running_ = true;
+    }
+
+    // backtrace第一次调用会加载libgcc(会malloc) 先在这里调用一次 信号处理函数里面就只剩栈回溯
+    void *frames[2];
+    ::backtrace(frames, 2);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = stackSignalHandler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (::sigaction(signo_, &sa, nullptr) < 0)
+    {
+        LOG_ERROR("LoopWatchdog::start sigaction(%d) err:%d", signo_, errno);
+    }
+
+    thread_.reset(new Thread(std::bind(&LoopWatchdog::threadFunc, this), "LoopWatchdog"));
+    thread_->start();
+}
+
+void LoopWatchdog::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!running_)
+        {
+            return;
+        }
+        running_ = false;
+        cond_.notify_all();
+    }
+    thread_->join();
+    thread_.reset();
+}
+
+void LoopWatchdog::threadFunc()
+{
+    // ticks换算成纳秒要先校准TscClock 在看门狗线程上做 不占io线程的时间
+    TscClock::elapsedNanos(0);
+
+    // 检查间隔是阈值的1/4 卡住以后最晚 阈值*1.25 发现
+    std::chrono::nanoseconds interval(std::max<int64_t>(thresholdNanos_ / 4, 1000000));
+    std::vector<StallInfo> stalled;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait_for(lock, interval);
+            if (!running_)
+            {
+                break;
+            }
+            check(&stalled);
+        }
+        for (const StallInfo &info : stalled)
+        {
+            if (stallCallback_)
+            {
+                stallCallback_(info);
+            }
+        }
+        stalled.clear();
+    }
+}
+
+void LoopWatchdog::check(std::vector<StallInfo> *stalled)
+{
+    for (Watched &w : watched_)
+    {
+        EventLoop *loop = w.loop;
+        uint64_t since = loop->busySinceTicks();
+        // 阻塞在poll里面 或者这一次已经报告过了
+        if (since == 0 || since == w.reportedSince)
+        {
+            continue;
+        }
+        uint64_t now = TscClock::ticks();
+        if (now <= since)
+        {
+            continue;
+        }
+        int64_t stalledNanos = TscClock::elapsedNanos(static_cast<int64_t>(now - since));
+        if (stalledNanos < thresholdNanos_)
+        {
+            continue;
+        }
+
+        w.reportedSince = since;
+        stalls_.fetch_add(1, std::memory_order_relaxed);
+
+        StallInfo info;
+        info.loop = loop;
+        info.tid = loop->threadId();
+        info.fd = loop->handlingFd();
+        info.revents = loop->handlingEvents();
+        info.stalledMicros = stalledNanos / 1000;
+        captureStack(loop->pthreadId(), &info.stack);
+        // 抓栈的时候loop已经往前走了 栈不是卡住的那个地方 不要误导
+        info.recovered = loop->busySinceTicks() != since;
+        if (info.recovered)
+        {
+            info.stack.clear();
+        }
+        stalled->push_back(std::move(info));
+    }
+}
+
+bool LoopWatchdog::captureStack(pthread_t thread, std::vector<std::string> *stack)
+{
+    std::unique_lock<std::mutex> lock(g_captureMutex);
+    g_captureState.store(kRequested, std::memory_order_release);
+    int err = ::pthread_kill(thread, signo_);
+    if (err != 0)
+    {
+        g_captureState.store(kIdle);
+        LOG_ERROR("LoopWatchdog::captureStack pthread_kill err:%d", err);
+        return false;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kCaptureTimeoutMs);
+    while (g_captureState.load(std::memory_order_acquire) != kDone)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            // 信号处理函数还没开始就撤回请求 已经在抓了就等它抓完
+            int expected = kRequested;
+            if (g_captureState.compare_exchange_strong(expected, kIdle))
+            {
+                return false;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    // 第0帧是信号处理函数自己
+    char **symbols = ::backtrace_symbols(g_frames, g_depth);
+    for (int i = 1; i < g_depth; ++i)
+    {
+        stack->push_back(symbols ? demangleFrame(symbols[i]) : std::string("?"));
+    }
+    free(symbols);
+    g_captureState.store(kIdle, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "noncopyable.h"
+#include "Thread.h"
+#include <functional>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <signal.h>
+#include <stdint.h>
+
+class EventLoop;
+
+/*
+ * EventLoop卡顿看门狗 一个MessageCallback里面做了阻塞的事情(DNS 读磁盘 大计算) 这个loop上所有的连接都跟着卡住
+ * loop线程每一轮只写几个relaxed的原子变量(EventLoop的心跳: 这一轮开始忙的ticks 正在处理的fd)
+ * 看门狗线程每隔 阈值/4 看一遍所有被看着的loop 一直忙超过阈值就认为卡住了:
+ *   给loop线程发一个信号 信号处理函数在loop线程上backtrace()抓调用栈 看门狗线程再符号化 交给StallCallback
+ * 同一次卡顿只报告一次 默认的StallCallback用LOG_ERROR打出fd 卡了多久和调用栈
+ *
+ * 注意:
+ *   信号会打断loop线程上正在进行的系统调用(handler装的时候带了SA_RESTART 但sleep epoll_wait这类仍然会提前返回EINTR)
+ *   可执行文件里面的函数名需要链接的时候加-rdynamic 否则只有地址
+ *   loop退出之前要先unwatch 看门狗不能给已经结束的线程发信号
+ *
+ * 用法:
+ *   LoopWatchdog watchdog(500);
+ *   for (EventLoop *loop : pool->getAllLoops()) watchdog.watch(loop);
+ *   watchdog.start();
+ */
+class LoopWatchdog : noncopyable
+{
+public:
+    struct StallInfo
+    {
+        EventLoop *loop;    // 只用来区分是哪个loop 回调里面不要再访问它
+        pid_t tid;          // loop线程的tid
+        int fd;             // 卡在哪个channel的回调里面 -1表示卡在queueLoop投递的回调里面
+        int revents;        // 这个channel这一轮的事件
+        int64_t stalledMicros; // 发现的时候已经卡了多久
+        bool recovered;     // 抓栈之前loop已经恢复了 stack为空
+        std::vector<std::string> stack; // 从被打断的地方开始 由内到外
+
+        // 多行 第一行是 loop tid fd 卡了多久 后面每行一个栈帧
+        std::string toString() const;
+    };
+    using StallCallback = std::function<void(const StallInfo &)>;
+
+    // stallThresholdMs: 一轮(处理事件 + 执行functor)超过这么久算卡住  signo: 用来抓栈的信号 不要和程序自己用的冲突
+    explicit LoopWatchdog(int stallThresholdMs = 1000, int signo = SIGUSR2);
+    ~LoopWatchdog();
+
+    // 任意线程 start前后都可以调用
+    void watch(EventLoop *loop);
+    void unwatch(EventLoop *loop);
+    // start之前设置  在看门狗线程里面调用 不持有锁 可以在里面unwatch
+    void setStallCallback(const StallCallback &cb) { stallCallback_ = cb; }
+
+    void start();
+    void stop();
+
+    // 发现过多少次卡顿
+    long stalls() const { return stalls_.load(std::memory_order_relaxed); }
+
+private:
+    struct Watched
+    {
+        EventLoop *loop;
+        uint64_t reportedSince; // 已经报告过的那一次卡顿的busySinceTicks 同一次不重复报告
+    };
+
+    void threadFunc();
+    // 持有mutex_调用 卡住的loop的信息放进stalled
+    void check(std::vector<StallInfo> *stalled);
+    bool captureStack(pthread_t thread, std::vector<std::string> *stack);
+
+    const int64_t thresholdNanos_;
+    const int signo_;
+    std::atomic<long> stalls_;
+    StallCallback stallCallback_;
+
+    std::mutex mutex_; // 保护watched_ running_ 配合cond_让看门狗线程按间隔醒来
+    std::condition_variable cond_;
+    std::vector<Watched> watched_;
+    bool running_;
+    std::unique_ptr<Thread> thread_;
+};
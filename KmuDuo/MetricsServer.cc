@@ -0,0 +1,191 @@
+#include "MetricsServer.h"
+#include "TscClock.h"
+#include "logger.h"
+#include <algorithm>
+#include <functional>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+    const size_t kMaxRequestSize = 8 * 1024;
+
+    void appendf(std::string *out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+    void appendf(std::string *out, const char *fmt, ...)
+    {
+        char buf[512];
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf, sizeof buf, fmt, args);
+        va_end(args);
+        if (n > 0)
+        {
+            out->append(buf, n < static_cast<int>(sizeof buf) ? n : sizeof buf - 1);
+        }
+    }
+
+    void appendHeader(std::string *out, const char *name, const char *type, const char *help)
+    {
+        appendf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+    }
+
+    void appendSummary(std::string *out, const char *name, const char *help, const std::string &labels,
+                       const HistogramSnapshot &h)
+    {
+        appendHeader(out, name, "summary", help);
+        const double qs[] = {0.5, 0.9, 0.99, 0.999};
+        for (double q : qs)
+        {
+            appendf(out, "%s{%s,quantile=\"%g\"} %.9f\n", name, labels.c_str(), q, h.percentileNanos(q) / 1e9);
+        }
+        appendf(out, "%s_sum{%s} %.9f\n", name, labels.c_str(), h.meanNanos() * h.count / 1e9);
+        appendf(out, "%s_count{%s} %ld\n", name, labels.c_str(), static_cast<long>(h.count));
+    }
+}
+
+MetricsServer::MetricsServer(TcpServer *target, const InetAddress &listenAddr)
+    : target_(target),
+      server_(target->getLoop(), listenAddr, target->name() + "-metrics"),
+      scrapes_(0)
+{
+    server_.setConnectionCallback(std::bind(&MetricsServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(std::bind(&MetricsServer::onMessage, this,
+                                         std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void MetricsServer::start()
+{
+    // 统计里面的时间是TSC计数 第一次换算的时候要校准20ms 在这里先做掉 不要留到第一次抓取
+    TscClock::elapsedNanos(0);
+    server_.start();
+}
+
+void MetricsServer::onConnection(const TcpConnectionPtr &)
+{
+}
+
+void MetricsServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    const char *begin = buf->peek();
+    const char *end = begin + buf->readableBytes();
+    const char *crlf = "\r\n\r\n";
+    const char *headerEnd = std::search(begin, end, crlf, crlf + 4);
+    if (headerEnd == end)
+    {
+        if (buf->readableBytes() > kMaxRequestSize)
+        {
+            conn->shutdown();
+        }
+        return; // 请求头还没收完
+    }
+
+    std::string requestLine(begin, std::find(begin, headerEnd, '\r'));
+    buf->retrieveAll();
+
+    std::string response;
+    if (requestLine.compare(0, 13, "GET /metrics ") == 0 || requestLine == "GET /metrics")
+    {
+        std::string body = render();
+        appendf(&response, "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                body.size());
+        response += body;
+    }
+    else
+    {
+        response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    }
+    conn->send(response);
+    conn->shutdown();
+}
+
+std::string MetricsServer::render()
+{
+    ++scrapes_;
+    std::string out;
+    out.reserve(8 * 1024);
+    std::string server = "server=\"" + target_->name() + "\"";
+
+    TcpServer::ConnectionTotals totals = target_->connectionTotals();
+    appendHeader(&out, "muduo_connections", "gauge", "Current number of connections.");
+    appendf(&out, "muduo_connections{%s} %zu\n", server.c_str(), totals.connections);
+    appendHeader(&out, "muduo_accepted_connections_total", "counter", "Connections accepted since start.");
+    appendf(&out, "muduo_accepted_connections_total{%s} %ld\n", server.c_str(), static_cast<long>(totals.accepted));
+    appendHeader(&out, "muduo_received_bytes_total", "counter", "Bytes read from connections.");
+    appendf(&out, "muduo_received_bytes_total{%s} %lu\n", server.c_str(), static_cast<unsigned long>(totals.bytesReceived));
+    appendHeader(&out, "muduo_sent_bytes_total", "counter", "Bytes written to connections.");
+    appendf(&out, "muduo_sent_bytes_total{%s} %lu\n", server.c_str(), static_cast<unsigned long>(totals.bytesSent));
+    appendHeader(&out, "muduo_output_buffer_bytes", "gauge", "Bytes queued in output buffers, not yet written.");
+    appendf(&out, "muduo_output_buffer_bytes{%s} %zu\n", server.c_str(), totals.pendingOutputBytes);
+    appendHeader(&out, "muduo_buffer_capacity_bytes", "gauge", "Memory held by connection input and output buffers.");
+    appendf(&out, "muduo_buffer_capacity_bytes{%s} %zu\n", server.c_str(), totals.bufferCapacity);
+
+    std::vector<EventLoop *> loopPtrs;
+    std::vector<LoopStatsSnapshot> loops = target_->loopStats(&loopPtrs);
+    LoopStatsSnapshot merged;
+    for (const LoopStatsSnapshot &s : loops)
+    {
+        merged.merge(s);
+    }
+
+    struct LoopMetric
+    {
+        const char *name;
+        const char *type;
+        const char *help;
+    };
+    const LoopMetric metrics[] = {
+        {"muduo_loop_iterations_total", "counter", "Poll returns."},
+        {"muduo_loop_poll_wait_seconds_total", "counter", "Time blocked in poll."},
+        {"muduo_loop_handler_seconds_total", "counter", "Time in channel event handlers."},
+        {"muduo_loop_functor_seconds_total", "counter", "Time running queued functors."},
+        {"muduo_loop_events_total", "counter", "Active channels returned by poll."},
+        {"muduo_loop_wakeups_total", "counter", "Wakeups through the eventfd."},
+        {"muduo_loop_functors_total", "counter", "Queued functors executed."},
+        {"muduo_loop_queue_depth", "gauge", "Functors waiting in the loop queue."},
+        {"muduo_loop_busy_ratio", "gauge", "Share of time spent in handlers and functors since the previous scrape."},
+    };
+    for (size_t m = 0; m < sizeof metrics / sizeof metrics[0]; ++m)
+    {
+        appendHeader(&out, metrics[m].name, metrics[m].type, metrics[m].help);
+        for (size_t i = 0; i < loops.size(); ++i)
+        {
+            const LoopStatsSnapshot &s = loops[i];
+            std::string labels = server + ",loop=\"" + std::to_string(i) + "\"";
+            switch (m)
+            {
+            case 0: appendf(&out, "%s{%s} %ld\n", metrics[m].name, labels.c_str(), static_cast<long>(s.iterations)); break;
+            case 1: appendf(&out, "%s{%s} %.6f\n", metrics[m].name, labels.c_str(), s.pollWaitNanos / 1e9); break;
+            case 2: appendf(&out, "%s{%s} %.6f\n", metrics[m].name, labels.c_str(), s.handlerNanos / 1e9); break;
+            case 3: appendf(&out, "%s{%s} %.6f\n", metrics[m].name, labels.c_str(), s.functorNanos / 1e9); break;
+            case 4: appendf(&out, "%s{%s} %ld\n", metrics[m].name, labels.c_str(), static_cast<long>(s.events)); break;
+            case 5: appendf(&out, "%s{%s} %ld\n", metrics[m].name, labels.c_str(), static_cast<long>(s.wakeups)); break;
+            case 6: appendf(&out, "%s{%s} %ld\n", metrics[m].name, labels.c_str(), static_cast<long>(s.functors)); break;
+            case 7: appendf(&out, "%s{%s} %ld\n", metrics[m].name, labels.c_str(), static_cast<long>(s.queueDepth)); break;
+            default:
+            {
+                // 上一次没有这个loop(新扩出来的)就用从启动开始的累计值
+                // 计数变少了说明是新的loop刚好用了已经结束的loop的地址 也当成新的
+                auto prev = lastStats_.find(loopPtrs[i]);
+                bool same = prev != lastStats_.end() && prev->second.iterations <= s.iterations;
+                double busy = same ? (s - prev->second).busyRatio() : s.busyRatio();
+                appendf(&out, "%s{%s} %.4f\n", metrics[m].name, labels.c_str(), busy);
+                break;
+            }
+            }
+        }
+    }
+    lastStats_.clear(); // 缩容掉的loop不留着
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        lastStats_[loopPtrs[i]] = loops[i];
+    }
+
+    appendSummary(&out, "muduo_dispatch_delay_seconds", "Delay from poll return to MessageCallback.", server, merged.dispatchDelay);
+    appendSummary(&out, "muduo_functor_delay_seconds", "Delay from queueLoop to functor execution.", server, merged.functorDelay);
+    appendSummary(&out, "muduo_message_callback_seconds", "MessageCallback duration.", server, merged.messageCallback);
+
+    appendHeader(&out, "muduo_metrics_scrapes_total", "counter", "Scrapes served by this endpoint.");
+    appendf(&out, "muduo_metrics_scrapes_total{%s} %ld\n", server.c_str(), static_cast<long>(scrapes_));
+    return out;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "LoopStats.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * 内置的Prometheus指标端点: GET /metrics 返回文本格式(text/plain; version=0.0.4)的指标
+ * 自己也是一个TcpServer 不开subloop 和被监控的TcpServer跑在同一个baseloop上
+ * 抓取的时候在baseloop里面读各个loop的LoopStats和各个连接的计数 全部是原子变量的relaxed读 不加锁 不往io loop投递任务
+ * 所以抓取不会阻塞io loop 只占用baseloop一点时间
+ *
+ * 指标: 连接数 接受的连接总数 收发字节数 输出缓冲区积压和缓冲区内存
+ *       每个loop的poll等待/回调/functor时间 事件数 唤醒次数 回调队列长度 上一次抓取以来的繁忙比例
+ *       合并以后的dispatch_delay functor_delay message_callback延迟分布(summary)
+ *
+ * 用法:
+ *   TcpServer server(&loop, addr, "echo");
+ *   MetricsServer metrics(&server, InetAddress(9100));
+ *   metrics.start();
+ */
+class MetricsServer : noncopyable
+{
+public:
+    MetricsServer(TcpServer *target, const InetAddress &listenAddr);
+
+    // 在baseloop线程调用
+    void start();
+
+    // 生成一次指标文本 只能在baseloop线程调用
+    std::string render();
+
+private:
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp time);
+
+    TcpServer *target_;
+    TcpServer server_;
+    // 上一次抓取的快照 用来算这段时间的繁忙比例
+    // 按loop对应 扩缩容以后同一个下标可能是另外一个loop了
+    std::unordered_map<EventLoop *, LoopStatsSnapshot> lastStats_;
+    int64_t scrapes_;
+};
@@ -5,6 +5,8 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <strings.h>
+#include <string.h>
+#include <errno.h>
 #include <netinet/tcp.h>
 
 Socket::~Socket()
@@ -14,9 +16,14 @@ Socket::~Socket()
 
 void Socket::bindAddress(const InetAddress &localaddr) //
 {
-    if (0 != ::bind(sockfd_, (sockaddr *)localaddr.getSockAddr(), sizeof(sockaddr_in)))
+    // 没有名字的AF_UNIX地址bind会自动分配一个abstract的名字 不是调用的人想要的(比如拿accept到的对端地址去bind)
+    if (localaddr.isUnix() && localaddr.sockLen() <= offsetof(sockaddr_un, sun_path))
     {
-        LOG_FATAL("bind sockfd:%d fail\n", sockfd_);
+        LOG_FATAL("bind sockfd:%d unnamed unix address\n", sockfd_);
+    }
+    if (0 != ::bind(sockfd_, localaddr.sockAddr(), localaddr.sockLen()))
+    {
+        LOG_FATAL("bind sockfd:%d %s fail err:%d\n", sockfd_, localaddr.toIpPort().c_str(), errno);
     }
 }
 
@@ -30,13 +37,13 @@ void Socket::listen()
 
 int Socket::accept(InetAddress *peeraddr) //
 {
-    sockaddr_in addr;
+    sockaddr_un addr; // AF_INET和AF_UNIX都放得下
     socklen_t len = sizeof addr;
     bzero(&addr, sizeof(addr));
     int connfd = ::accept4(sockfd_, (sockaddr *)&addr, &len,SOCK_NONBLOCK |SOCK_CLOEXEC);
     if (connfd >= 0)
     {
-        peeraddr->setSockAddr(addr);
+        *peeraddr = InetAddress((const sockaddr *)&addr, len);
     }
     return connfd;
 }
@@ -75,4 +82,68 @@ void Socket::setKeppAlive(bool on)
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE,
                  &optval, static_cast<socklen_t>(sizeof optval));
-}
\ No newline at end of file
+}
+
+ssize_t Socket::sendWithFds(int sockfd, const void *data, size_t len, const int *fds, int nfds)
+{
+    if (nfds <= 0 || nfds > kMaxFdsPerMessage || len == 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    char control[CMSG_SPACE(sizeof(int) * kMaxFdsPerMessage)];
+    bzero(control, sizeof control);
+    iovec iov = {const_cast<void *>(data), len};
+    msghdr msg;
+    bzero(&msg, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+    return ::sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+}
+
+ssize_t Socket::recvWithFds(int sockfd, void *buf, size_t len, std::vector<int> *fds)
+{
+    iovec iov = {buf, len};
+    return recvWithFds(sockfd, &iov, 1, fds);
+}
+
+ssize_t Socket::recvWithFds(int sockfd, const iovec *iov, int iovcnt, std::vector<int> *fds)
+{
+    char control[CMSG_SPACE(sizeof(int) * kMaxFdsPerMessage)];
+    msghdr msg;
+    bzero(&msg, sizeof msg);
+    msg.msg_iov = const_cast<iovec *>(iov);
+    msg.msg_iovlen = iovcnt;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+    ssize_t n = ::recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+    if (n < 0)
+    {
+        return n;
+    }
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < count; i++)
+            {
+                int fd;
+                memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof fd);
+                fds->push_back(fd);
+            }
+        }
+    }
+    if (msg.msg_flags & MSG_CTRUNC)
+    {
+        LOG_ERROR("Socket::recvWithFds sockfd:%d too many fds in one message, the rest were closed\n", sockfd);
+    }
+    return n;
+}
@@ -1,5 +1,8 @@
 #pragma once
 #include "noncopyable.h"
+#include <vector>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 class InetAddress;
 
@@ -25,6 +28,15 @@ public:
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeppAlive(bool on);
+
+    // AF_UNIX: 用SCM_RIGHTS把fds跟着data一起发给对端 data至少1个字节 fds跟着这段数据的第一个字节走
+    // 返回发出去的字节数 只要返回值大于0 fds就都发出去了(对端拿到的是新的fd 这边的还要自己关)
+    static ssize_t sendWithFds(int sockfd, const void *data, size_t len, const int *fds, int nfds);
+    // 收数据 顺便把这段数据带着的fd放进fds(已经设置了FD_CLOEXEC 由调用者负责关闭)
+    static ssize_t recvWithFds(int sockfd, void *buf, size_t len, std::vector<int> *fds);
+    static ssize_t recvWithFds(int sockfd, const iovec *iov, int iovcnt, std::vector<int> *fds);
+    // 一条消息最多带多少个fd 多出来的内核直接关掉
+    static const int kMaxFdsPerMessage = 16;
     
 private:
     const int sockfd_;
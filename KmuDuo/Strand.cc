@@ -0,0 +1,82 @@
+#include "Strand.h"
+#include "ComputePool.h"
+#include <sched.h>
+
+Strand::Strand(ComputePool *pool)
+    : pool_(pool),
+      head_(new Node),
+      tail_(head_.load()),
+      pending_(0)
+{
+}
+
+Strand::~Strand()
+{
+    while (tail_)
+    {
+        Node *next = tail_->next.load();
+        delete tail_;
+        tail_ = next;
+    }
+}
+
+void Strand::post(Task task)
+{
+    Node *node = new Node;
+    node->task = std::move(task);
+    Node *prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+
+    // 0 => 1 说明当前没有drain在跑 由自己负责提交
+    if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0)
+    {
+        schedule();
+    }
+}
+
+void Strand::schedule()
+{
+    std::shared_ptr<Strand> self(shared_from_this()); // drain执行完之前Strand不能析构
+    if (pool_ == nullptr || !pool_->submit([self]() { self->drain(); }))
+    {
+        drain(); // 没有计算线程或者队列满了 就在当前线程执行 仍然保证顺序
+    }
+}
+
+bool Strand::pop(Task *task)
+{
+    Node *next = tail_->next.load(std::memory_order_acquire);
+    if (next == nullptr)
+    {
+        return false;
+    }
+    *task = std::move(next->task);
+    delete tail_;
+    tail_ = next; // next变成新的哑节点
+    return true;
+}
+
+void Strand::drain()
+{
+    int done = 0;
+    while (true)
+    {
+        Task task;
+        if (!pop(&task))
+        {
+            // pending_ > 0 但是生产者exchange以后还没来得及把next挂上 稍等一下
+            ::sched_yield();
+            continue;
+        }
+        task();
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            return;
+        }
+        if (++done >= kMaxBatch)
+        {
+            schedule(); // 还有任务 执行权交给下一次drain 让别的连接也有机会执行
+            return;
+        }
+    }
+}
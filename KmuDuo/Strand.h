@@ -0,0 +1,46 @@
+#pragma once
+#include "noncopyable.h"
+#include <functional>
+#include <memory>
+#include <atomic>
+
+class ComputePool;
+
+/*
+ * 串行执行器 post进来的任务按FIFO顺序执行 同一时刻最多只有一个在执行 但是可以在ComputePool的任意worker上执行
+ * 不需要每个连接一个线程 也不需要锁: 任务放进无锁的MPSC队列 pending_从0变成1的那个post负责把drain提交给ComputePool
+ * drain一次最多执行kMaxBatch个任务 剩下的重新提交 避免一个连接霸占worker
+ * TcpConnection用它保证offload出去的请求按请求的顺序回复 不同连接之间仍然并行
+ * 必须用shared_ptr管理 提交给ComputePool的drain持有它
+ */
+class Strand : noncopyable, public std::enable_shared_from_this<Strand>
+{
+public:
+    using Task = std::function<void()>;
+
+    // pool为空的时候post直接在当前线程执行
+    explicit Strand(ComputePool *pool);
+    ~Strand();
+
+    // 任意线程都可以调用
+    void post(Task task);
+
+private:
+    struct Node
+    {
+        Task task;
+        std::atomic<Node *> next;
+        Node() : next(nullptr) {}
+    };
+
+    static const int kMaxBatch = 64;
+
+    void schedule();
+    void drain();
+    bool pop(Task *task);
+
+    ComputePool *pool_;
+    std::atomic<Node *> head_; // 生产者从这里挂新节点
+    Node *tail_;               // 只有拿到执行权的drain访问 指向已经取走任务的哑节点
+    std::atomic<int> pending_; // 已经post还没执行完的任务数
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Connector.h"
+#include "inetAddress.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+
+class EventLoop;
+
+/*
+ * 对外的客户端类 和TcpServer对应 连上以后得到的是一个普通的TcpConnection 跑在构造时给的loop上
+ * 出去的请求和服务器收到的连接用同一套io loop 整个过程不阻塞(连接 重试 收发都是事件驱动)
+ * 一个TcpClient同一时间最多一个连接
+ *
+ * 用法:
+ *   TcpClient client(loop, InetAddress(9981, "127.0.0.1"), "client");
+ *   client.setConnectionCallback(...); client.setMessageCallback(...);
+ *   client.enableRetry(); // 连接断开以后自动重连
+ *   client.connect();
+ */
+class TcpClient : noncopyable
+{
+public:
+    TcpClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &nameArg);
+    ~TcpClient(); // 在loop线程里面析构
+
+    void connect();    // 开始连接 连不上就按退避间隔一直重试 直到stop
+    void disconnect(); // 半关闭已经建立的连接(shutdown)
+    void stop();       // 停止正在进行的连接和重试 已经建立的连接不受影响
+
+    // 当前的连接 没连上的时候为空
+    TcpConnectionPtr connection() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop *getLoop() const { return loop_; }
+    bool retry() const { return retry_; }
+    // 已经建立的连接断开以后重新连接
+    void enableRetry() { retry_ = true; }
+    // 连接失败以后重试的间隔 从initMs开始翻倍到maxMs connect之前设置
+    void setRetryDelay(int initMs, int maxMs) { connector_->setRetryDelay(initMs, maxMs); }
+    const std::string &name() const { return name_; }
+    // 连接失败重试的次数 每次连上都清零
+    int connectRetries() const { return connector_->retries(); }
+
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+
+private:
+    // 在loop线程里面
+    void newConnection(int sockfd);
+    void removeConnection(const TcpConnectionPtr &conn);
+
+    EventLoop *loop_;
+    ConnectorPtr connector_;
+    const std::string name_;
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+    std::atomic_bool retry_;
+    std::atomic_bool connect_;
+    int nextConnId_; // 只在loop线程里面用
+    mutable std::mutex mutex_;
+    TcpConnectionPtr connection_; // mutex_保护
+};
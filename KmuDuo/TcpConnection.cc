@@ -1,14 +1,20 @@
 #include "TcpConnection.h"
 #include "logger.h"
+#include "TraceLog.h"
+#include "TscClock.h"
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "ComputePool.h"
+#include "Strand.h"
 #include <functional>
 #include <errno.h>
 #include "EventLoop.h"
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <netinet/tcp.h>
 
 static EventLoop *checkloopnotnull(EventLoop *loop)
@@ -26,6 +32,8 @@ TcpConnection::TcpConnection(EventLoop *loop,
                              const InetAddress &localAddr,
                              const InetAddress &peerAddr)
     : loop_(checkloopnotnull(loop)),
+      pendingOpsQueued_(false),
+      runningOps_(false),
       name_(nameAge),
       state_(kConnection),
       reading_(true),
@@ -33,7 +41,14 @@ TcpConnection::TcpConnection(EventLoop *loop,
       channel_(new Channel(loop, sockfd)),
       localAddr_(localAddr),
       peerAddr_(peerAddr),
-      highWaterMark_(64 * 1024 * 1024) // 64MB
+      highWaterMark_(64 * 1024 * 1024), // 64MB
+      computePool_(nullptr),
+      offloadsInFlight_(0),
+      shutdownWhenIdle_(false),
+      bytesReceived_(0),
+      bytesSent_(0),
+      pendingOutputBytes_(0),
+      bufferCapacity_(0)
 
 {
     // 下面给channel设置相应的回调函数,poller给channel通知感兴趣的事件发生了,channel会回调相应的操作函数
@@ -44,27 +59,160 @@ TcpConnection::TcpConnection(EventLoop *loop,
 
     LOG_INFO("TcpConnection::ctor[%s] at fd =%d\n", name_.c_str(), sockfd);
     socket_->setKeppAlive(true);
+    loop->ref(); // 连接活着 所属的loop就不能被缩容回收
 }
 
 TcpConnection::~TcpConnection()
 {
     LOG_INFO("TcpConnection::dtor[%s] at fd = %d satte =%d\n", name_.c_str(), channel_->fd(), (int)state_);
+    for (const PendingFd &p : pendingFds_) // 没发出去的fd
+    {
+        ::close(p.fd);
+    }
+    getLoop()->unref();
 }
 
 void TcpConnection::send(const std::string &buf)
 {
     if (state_ == kConnected)
     {
-        if (loop_->isInLoopThread())
+        if (getLoop()->isInLoopThread() && !runningOps_ && !pendingOpsQueued_.load(std::memory_order_relaxed))
         {
-            // 在自己的线程里直接用
+            // 在自己的线程里 前面也没有排队的操作 直接用
             sendInLoop(buf.c_str(), buf.size());
         }
         else
         {
-            // 等到自己的线程里再用
-            loop_->runInLoop(std::bind(&TcpConnection::sendInLoop, this, buf.c_str(), buf.size()));
+            // 等到自己的线程里再用  buf出了作用域就没了 这里要拷贝一份
+            void (TcpConnection::*fp)(const std::string &) = &TcpConnection::sendInLoop;
+            runInOrder(std::bind(fp, shared_from_this(), buf));
+        }
+    }
+}
+
+void TcpConnection::sendInLoop(const std::string &message)
+{
+    sendInLoop(message.data(), message.size());
+}
+
+void TcpConnection::queueInLoop(std::function<void()> cb)
+{
+    std::lock_guard<std::mutex> lock(opsMutex_);
+    getLoop()->queueLoop(std::move(cb));
+}
+
+void TcpConnection::runInOrder(std::function<void()> op)
+{
+    if (getLoop()->isInLoopThread() && !runningOps_)
+    {
+        // loop_只会被自己的线程改 这里不用锁 别的线程刚排进来的操作本来就和这个op没有先后
+        // 之前在别的线程排进来的(比如连接迁过来之前) 要先执行
+        while (pendingOpsQueued_.load(std::memory_order_relaxed))
+        {
+            doPendingOps();
         }
+        op();
+        return;
+    }
+    // 正在执行的一批操作里面又调用了send/shutdown 也要排在后面 不能插到这一批剩下的前面
+    std::lock_guard<std::mutex> lock(opsMutex_);
+    pendingOps_.push_back(std::move(op));
+    if (!pendingOpsQueued_.load(std::memory_order_relaxed))
+    {
+        pendingOpsQueued_.store(true, std::memory_order_relaxed);
+        getLoop()->queueLoop(std::bind(&TcpConnection::doPendingOpsInLoop, shared_from_this()));
+    }
+}
+
+// 只在连接所属的loop线程里面调用
+void TcpConnection::doPendingOps()
+{
+    std::vector<std::function<void()>> ops;
+    {
+        std::lock_guard<std::mutex> lock(opsMutex_);
+        ops.swap(pendingOps_);
+        pendingOpsQueued_.store(false, std::memory_order_relaxed);
+    }
+    runningOps_ = true;
+    for (const std::function<void()> &op : ops)
+    {
+        op();
+    }
+    runningOps_ = false;
+}
+
+void TcpConnection::doPendingOpsInLoop()
+{
+    if (!getLoop()->isInLoopThread()) // 投递以后连接迁走了 操作还在队列里面 跟过去执行
+    {
+        queueInLoop(std::bind(&TcpConnection::doPendingOpsInLoop, shared_from_this()));
+        return;
+    }
+    doPendingOps(); // 已经被loop线程里面的send执行完了的话 这里是空的
+}
+
+void TcpConnection::sendFd(int fd, const std::string &data)
+{
+    if (state_ != kConnected)
+    {
+        return;
+    }
+    if (data.empty())
+    {
+        LOG_ERROR("TcpConnection::sendFd[%s] needs at least one byte of data\n", name_.c_str());
+        return;
+    }
+    int dupfd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dupfd < 0)
+    {
+        LOG_ERROR("TcpConnection::sendFd[%s] dup fd:%d err:%d\n", name_.c_str(), fd, errno);
+        return;
+    }
+    runInOrder(std::bind(&TcpConnection::sendFdInLoop, shared_from_this(), dupfd, data));
+}
+
+void TcpConnection::sendFdInLoop(int fd, const std::string &data)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected , givp up sending fd ");
+        ::close(fd);
+        return;
+    }
+    // 和sendInLoop一样 前面没有排队的数据就直接发
+    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    {
+        ssize_t n = Socket::sendWithFds(channel_->fd(), data.data(), data.size(), &fd, 1);
+        if (n > 0)
+        {
+            ::close(fd); // 对端已经有自己的一份了
+            bytesSent_.fetch_add(n, std::memory_order_relaxed);
+            if (static_cast<size_t>(n) == data.size())
+            {
+                if (writeCompleteCallback_)
+                {
+                    getLoop()->queueLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+                }
+                return;
+            }
+            outputBuffer_.append(data.data() + n, data.size() - n);
+            updateBufferStats();
+            channel_->enableWriting();
+            return;
+        }
+        if (errno != EWOULDBLOCK && errno != EAGAIN)
+        {
+            LOG_ERROR("TcpConnection::sendFdInLoop[%s] err:%d\n", name_.c_str(), errno);
+            ::close(fd);
+            return;
+        }
+    }
+    pendingFds_.push_back(PendingFd{fd, outputBuffer_.readableBytes()});
+    outputBuffer_.append(data.data(), data.size());
+    updateBufferStats();
+    if (!channel_->isWriting())
+    {
+        channel_->enableWriting();
     }
 }
 
@@ -88,11 +236,12 @@ void TcpConnection::sendInLoop(const void *message, size_t len)
         nwrote = ::write(channel_->fd(), message, len);
         if (nwrote >= 0)
         {
+            bytesSent_.fetch_add(nwrote, std::memory_order_relaxed);
             remaining = len - nwrote;
             if (remaining == 0 && writeCompleteCallback_)
             {
                 // 既然在这里一次性数据全部发送完了 就不用在给channel设置epollout事件了
-                loop_->queueLoop(
+                getLoop()->queueLoop(
                     std::bind(writeCompleteCallback_, shared_from_this()));
             }
         }
@@ -118,11 +267,12 @@ void TcpConnection::sendInLoop(const void *message, size_t len)
         size_t oldlen = outputBuffer_.readableBytes();
         if (oldlen + remaining >= highWaterMark_ && oldlen < highWaterMark_ && highWaterMarkCallback_)
         {
-            loop_->queueLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldlen + remaining));
+            getLoop()->queueLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldlen + remaining));
         }
         //(char*)message + nwrote 是获取从 message 指针起始位置偏移 nwrote 个字节后的内存地址
         // 然后就指到了 没有发送完的数据的内存的起始地址
         outputBuffer_.append((char *)message + nwrote, remaining); // 把数据存入缓冲区中
+        updateBufferStats();
         if (!channel_->isWriting())
         {
             channel_->enableWriting(); // 这里一定要注册channel的写事件,否则poller不会给channel通知epollout
@@ -130,12 +280,25 @@ void TcpConnection::sendInLoop(const void *message, size_t len)
     }
 }
 
+// 只有loop线程写 普通的store
+void TcpConnection::updateBufferStats()
+{
+    pendingOutputBytes_.store(outputBuffer_.readableBytes(), std::memory_order_relaxed);
+    bufferCapacity_.store(inputBuffer_.internalCapacity() + outputBuffer_.internalCapacity(), std::memory_order_relaxed);
+}
+
 // 连接建立
 void TcpConnection::connectionEstablished()
 {
+    if (!getLoop()->isInLoopThread()) // 还没建立就被迁移走了
+    {
+        queueInLoop(std::bind(&TcpConnection::connectionEstablished, shared_from_this()));
+        return;
+    }
     setState(kConnected);
     channel_->tie(shared_from_this());
     channel_->enableReading(); // 向poller注册channel 的 EPOLLIN事件
+    updateBufferStats();
 
     // 新连接建立 执行回调
     connectionCallback_(shared_from_this());
@@ -147,8 +310,8 @@ void TcpConnection::shutdown()
     if(state_==kConnected)
     {
         setState(kDisconnecting);
-
-        loop_->runInLoop(std::bind(&TcpConnection::shutdownInLoop,this));
+        // 和前面别的线程的send排在同一个队列里面 不会在它们之前shutdown
+        runInOrder(std::bind(&TcpConnection::shutdownInLoop,shared_from_this()));
     }
 }
 
@@ -160,9 +323,73 @@ void TcpConnection::shutdownInLoop()
     }
 }
 
+void TcpConnection::shutdownWhenIdle()
+{
+    if (getLoop()->isInLoopThread())
+    {
+        shutdownWhenIdleInLoop();
+    }
+    else
+    {
+        queueInLoop(std::bind(&TcpConnection::shutdownWhenIdleInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::shutdownWhenIdleInLoop()
+{
+    if (!getLoop()->isInLoopThread()) // 连接已经迁移到别的loop上了
+    {
+        queueInLoop(std::bind(&TcpConnection::shutdownWhenIdleInLoop, shared_from_this()));
+        return;
+    }
+    shutdownWhenIdle_ = true;
+    // 刚建立还没收到过数据的连接 对端的第一个请求多半已经在路上了 现在关掉它一定失败 等它到了回复完再关
+    if (offloadsInFlight_ == 0 && bytesReceived() > 0)
+    {
+        shutdown();
+    }
+}
+
+// offload的回复已经send了(进了outputBuffer_) 在连接所属的loop线程里面调用
+void TcpConnection::offloadFinished()
+{
+    if (--offloadsInFlight_ == 0 && shutdownWhenIdle_)
+    {
+        shutdown();
+    }
+}
+
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        // 排队执行 调用者可能正在这个连接的回调里面
+        queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if (!getLoop()->isInLoopThread()) // 连接已经迁移到别的loop上了
+    {
+        queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+        return;
+    }
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose();
+    }
+}
+
 // 连接销毁
 void TcpConnection::connectionDestroyed()
 {
+    if (!getLoop()->isInLoopThread()) // TcpServer投递的时候连接还在旧loop上
+    {
+        queueInLoop(std::bind(&TcpConnection::connectionDestroyed, shared_from_this()));
+        return;
+    }
     if (state_ == kConnected)
     {
         setState(kDisconnected);
@@ -171,14 +398,162 @@ void TcpConnection::connectionDestroyed()
     channel_->remove(); // 把channel从poller中删除掉
 }
 
+void TcpConnection::migrateTo(EventLoop *loop)
+{
+    // 一定要排队 不能runInLoop直接执行: 当前这一轮activeChannels里面可能还有这个channel没处理
+    loop->ref(); // 排队期间loop可能退役 引用先占住 不能让它在migrateInLoop执行之前被回收
+    queueInLoop(std::bind(&TcpConnection::migrateInLoop, shared_from_this(), loop));
+}
+
+EventLoop *TcpConnection::getLoopLocked()
+{
+    std::lock_guard<std::mutex> lock(opsMutex_);
+    return loop_;
+}
+
+void TcpConnection::migrateInLoop(EventLoop *loop)
+{
+    EventLoop *oldLoop = getLoop();
+    if (!oldLoop->isInLoopThread()) // 排队期间已经被迁移过一次了
+    {
+        queueInLoop(std::bind(&TcpConnection::migrateInLoop, shared_from_this(), loop));
+        return;
+    }
+    if (loop == oldLoop)
+    {
+        loop->unref(); // migrateTo占的引用
+        return;
+    }
+
+    // 退役检查和改loop_都在锁里面 和缩容的getLoopLocked互斥: 缩容先标记退役再挑连接
+    // 要么这里看到退役标记 要么缩容看到连接已经在这个loop上 再把它迁走
+    std::unique_lock<std::mutex> lock(opsMutex_); // 锁里面改loop_ queueInLoop不会再投递到旧loop上
+    if (loop->retired())
+    {
+        lock.unlock();
+        LOG_INFO("TcpConnection::migrateInLoop[%s] fd=%d loop %p is retired, stay on %p\n", name_.c_str(), channel_->fd(), loop, oldLoop);
+        loop->unref();
+        return;
+    }
+    LOG_INFO("TcpConnection::migrateInLoop[%s] fd=%d loop %p => %p\n", name_.c_str(), channel_->fd(), oldLoop, loop);
+
+    // 先从旧loop的poller上摘掉channel 再让新loop重新注册
+    // loop_要在attach之前改好: 新loop上一旦有事件 回调里面的send就必须直接走新loop
+    // 转发过去的操作就算排在attach前面也没关系 channel对新poller来说是kNew 谁先update谁注册
+    // 别的线程排进pendingOps_的send留在队列里面 已经投递到旧loop的doPendingOpsInLoop会跟过去 顺序不变
+    channel_->moveToLoop(loop);
+    loop_ = loop; // migrateTo占的引用转给连接
+    lock.unlock();
+    oldLoop->unref(); // 之后不会再有投递到旧loop的回调 已经投递的由outstandingFunctors记着
+    queueInLoop(std::bind(&TcpConnection::attachInLoop, shared_from_this()));
+}
+
+void TcpConnection::attachInLoop()
+{
+    // 还没attach又被迁走了(后一次迁移的migrateInLoop排在这个attach前面) 那次迁移会在新loop上自己attach
+    // 这里再restoreEvents就是在别的线程里面改新loop的poller
+    if (!getLoop()->isInLoopThread())
+    {
+        return;
+    }
+    channel_->restoreEvents();
+}
+
+void TcpConnection::offload(std::function<void()> work, std::function<void()> done)
+{
+    TcpConnectionPtr conn(shared_from_this()); // 计算的过程中连接不能析构
+    offloadsInFlight_++;
+    std::function<void()> finish = [conn, done]() {
+        done();
+        conn->offloadFinished();
+    };
+    if (computePool_ && computePool_->submit([conn, work, finish]() {
+            work();
+            conn->queueInLoop(finish); // 投递回连接现在所属的loop
+        }))
+    {
+        return;
+    }
+    work();
+    if (getLoop()->isInLoopThread())
+    {
+        finish();
+    }
+    else
+    {
+        queueInLoop(finish);
+    }
+}
+
+void TcpConnection::offload(std::function<std::string()> work)
+{
+    TcpConnectionPtr conn(shared_from_this());
+    std::shared_ptr<std::string> reply(new std::string);
+    offload([reply, work]() { *reply = work(); },
+            [conn, reply]() { conn->send(*reply); });
+}
+
+void TcpConnection::offloadOrdered(std::function<std::string()> work)
+{
+    if (!strand_) // 第一次用到的时候才创建 不用offloadOrdered的连接没有这个开销
+    {
+        strand_.reset(new Strand(computePool_));
+    }
+    TcpConnectionPtr conn(shared_from_this());
+    offloadsInFlight_++;
+    // 前一个work的回复已经排进连接的有序队列 下一个work才会开始 回复的顺序就和请求一致
+    // 不能投递到getLoop()上: 两个回复之间连接迁移了 后一个直接在新loop上执行 会比转发过来的前一个先发出去
+    // work退化成在loop线程里直接执行的时候 runInOrder也会先执行排在前面的回复
+    strand_->post([conn, work]() {
+        std::string reply = work();
+        conn->runInOrder([conn, reply]() {
+            if (conn->connected())
+            {
+                conn->sendInLoop(reply.data(), reply.size());
+            }
+            conn->offloadFinished();
+        });
+    });
+}
+
+void TcpConnection::setComputePool(ComputePool *pool)
+{
+    if (pool != computePool_)
+    {
+        computePool_ = pool;
+        strand_.reset(); // 下一次offloadOrdered按新的pool创建
+    }
+}
+
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
     int saveErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &saveErrno);
+    ssize_t n = fdCallback_ ? inputBuffer_.readFd(channel_->fd(), &saveErrno, &receivedFds_)
+                            : inputBuffer_.readFd(channel_->fd(), &saveErrno);
+    if (!receivedFds_.empty())
+    {
+        // 先交出fd 再交出带着它的数据
+        for (int fd : receivedFds_)
+        {
+            fdCallback_(shared_from_this(), fd);
+        }
+        receivedFds_.clear();
+    }
+    LOG_TRACE("TcpConnection::handleRead [%s] fd=%d n=%ld", name_.c_str(), channel_->fd(), static_cast<long>(n));
     if (n > 0)
     {
+        bytesReceived_.fetch_add(n, std::memory_order_relaxed);
         // 已建立连接的用户,有可读事件发生了,调用用户传入的回调操作onMessage
+        // 顺便记录poll返回到这里的延迟和回调本身的耗时(回调里面迁移连接也是queueLoop 这一轮loop不会变)
+        EventLoop *loop = getLoop();
+        uint64_t begin = TscClock::ticks();
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        loop->recordMessageCallback(begin - loop->pollReturnTicks(), TscClock::ticks() - begin);
+        updateBufferStats();
+        if (shutdownWhenIdle_ && offloadsInFlight_ == 0)
+        {
+            shutdown(); // 同步处理的回复已经send了
+        }
     }
     else if (n == 0)
     {
@@ -197,19 +572,26 @@ void TcpConnection::handleWrite()
     if (channel_->isWriting())
     {
         int saveErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &saveErrno);
+        ssize_t n = pendingFds_.empty() ? outputBuffer_.writeFd(channel_->fd(), &saveErrno) : writeWithFds(&saveErrno);
         if (n > 0)
         {
+            bytesSent_.fetch_add(n, std::memory_order_relaxed);
             outputBuffer_.retrieve(n);
+            updateBufferStats();
             if (outputBuffer_.readableBytes() == 0)
             {
-                // 唤醒loop_对应的thread线程,执行回调
-                loop_->queueLoop(
-                    std::bind(writeCompleteCallback_, shared_from_this()));
-            }
-            if (state_ == kDisconnecting)
-            {
-                shutdownInLoop();
+                // 发完了 不再关注EPOLLOUT 不然水平触发会一直报可写 shutdownInLoop也一直等不到
+                channel_->disableWriting();
+                if (writeCompleteCallback_)
+                {
+                    // 唤醒loop_对应的thread线程,执行回调
+                    getLoop()->queueLoop(
+                        std::bind(writeCompleteCallback_, shared_from_this()));
+                }
+                if (state_ == kDisconnecting)
+                {
+                    shutdownInLoop();
+                }
             }
         }
         else
@@ -223,6 +605,38 @@ void TcpConnection::handleWrite()
     }
 }
 
+// 输出缓冲区里面有sendFd排队的fd的时候代替writeFd: fd前面的数据普通write 到了fd的位置用sendmsg带上它
+// 一次不越过下一个fd的位置 每个fd都跟着自己的那段数据
+ssize_t TcpConnection::writeWithFds(int *saveErrno)
+{
+    PendingFd &front = pendingFds_.front();
+    ssize_t n;
+    if (front.offset > 0)
+    {
+        n = ::write(channel_->fd(), outputBuffer_.peek(), front.offset);
+    }
+    else
+    {
+        size_t len = pendingFds_.size() > 1 ? pendingFds_[1].offset : outputBuffer_.readableBytes();
+        n = Socket::sendWithFds(channel_->fd(), outputBuffer_.peek(), len, &front.fd, 1);
+        if (n > 0)
+        {
+            ::close(front.fd);
+            pendingFds_.pop_front();
+        }
+    }
+    if (n < 0)
+    {
+        *saveErrno = errno;
+        return n;
+    }
+    for (PendingFd &p : pendingFds_)
+    {
+        p.offset -= n;
+    }
+    return n;
+}
+
 //poller => channel::closeCallback => TcpConnection::handleClose    
 void TcpConnection::handleClose()
 {
@@ -8,10 +8,16 @@
 #include "Buffer.h"
 #include "Timestamp.h"
 #include<string>
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <vector>
 
 class Channel;
 class EventLoop;
 class Socket;
+class ComputePool;
+class Strand;
 
 /*
  *TcpServer => Acceptor => 有一个新用户连接,通过accept函数拿到connfd
@@ -29,16 +35,54 @@ public:
     ~TcpConnection();
 
     EventLoop *getLoop() const { return loop_; }
+    // 和迁移互斥地读所属的loop 缩容挑选要迁走的连接用: 读到的不是退役的loop 之后的迁移就会看到退役标记
+    EventLoop *getLoopLocked();
     const std::string &name() const { return name_; }
     const InetAddress &localAddress() const { return localAddr_; }
     const InetAddress &peerAddress() const { return peerAddr_; }
 
     bool connected() const { return state_ == kConnected; }
 
-    // 发送数据
+    // 累计收发的字节数 只有所属loop的线程写 任意线程都可以读(LoopBalancer用来算速率)
+    uint64_t bytesReceived() const { return bytesReceived_.load(std::memory_order_relaxed); }
+    uint64_t bytesSent() const { return bytesSent_.load(std::memory_order_relaxed); }
+    // 输出缓冲区里面还没发出去的字节数 / 两个缓冲区占用的内存 loop线程在缓冲区变化以后更新 任意线程都可以读
+    size_t pendingOutputBytes() const { return pendingOutputBytes_.load(std::memory_order_relaxed); }
+    size_t bufferCapacity() const { return bufferCapacity_.load(std::memory_order_relaxed); }
+
+    // 发送数据 任意线程都可以调用
+    // 别的线程调用的send/sendFd/shutdown按调用的顺序执行 中间连接迁移到别的loop也一样
     void send(const std::string &buf);
+    // AF_UNIX连接: 用SCM_RIGHTS把fd跟着data(至少1个字节)一起发给对端 和send的数据保持顺序
+    // fd在调用的时候dup一份 调用者可以马上关掉自己的 任意线程都可以调用
+    void sendFd(int fd, const std::string &data);
     // 关闭连接
     void shutdown();
+    // 不等对端 直接关掉连接 和对端关闭一样走handleClose(连接回调+closeCallback) 任意线程都可以调用
+    void forceClose();
+    // 等还没回来的offload都把回复send出去以后再shutdown 没有offload在执行的时候就是shutdown
+    // 还没收到过数据的连接等第一次收到的数据处理完再shutdown TcpServer::drain用 任意线程都可以调用
+    void shutdownWhenIdle();
+
+    // 把连接(socket channel 缓冲区 回调)整体迁移到另一个loop上 任意线程都可以调用
+    // 旧loop上把channel从poller摘掉 新loop上按原来的事件重新注册
+    // 迁移以后再投递到旧loop上的操作 会被转发到新的loop
+    // 执行的时候loop已经缩容退役(EventLoop::retired)就放弃这次迁移 连接留在原来的loop上
+    void migrateTo(EventLoop *loop);
+    // 投递cb到连接现在所属的loop 和迁移互斥 不会投递到连接已经迁走的loop上 任意线程都可以调用
+    // 要往连接的loop上投递的时候用它 不要用getLoop()->queueLoop
+    void queueInLoop(std::function<void()> cb);
+
+    // 把CPU密集的处理放到ComputePool上执行 不阻塞io loop上的其他连接
+    // work在计算线程上执行 done回到连接所属的loop线程上执行(在done里面可以直接send)
+    // 没有设置ComputePool或者ComputePool的队列满了 就在当前线程直接执行work
+    void offload(std::function<void()> work, std::function<void()> done);
+    // work的返回值作为回复 回到连接所属的loop上send出去
+    void offload(std::function<std::string()> work);
+    // 和offload一样 但是同一个连接的work按调用顺序串行执行(Strand) 回复也按顺序发出(中间迁移也一样)
+    // 适合流水线(pipelining)的请求 不同连接之间仍然并行
+    void offloadOrdered(std::function<std::string()> work);
+    void setComputePool(ComputePool *pool);
 
     // 设置回调
     void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
@@ -55,6 +99,10 @@ public:
 
     void setCloseCallback(const CloseCallback &cb) { closeCallback_ = cb; }
 
+    // 设置了以后读数据改用recvmsg 对端传过来的fd在带着它的那段数据交给MessageCallback之前回调
+    // 没有设置的时候对端传过来的fd被内核直接关掉 在连接的loop线程里面设置(一般在ConnectionCallback里面)
+    void setFdCallback(const FdCallback &cb) { fdCallback_ = cb; }
+
     // 连接建立
     void connectionEstablished();
     // 连接销毁
@@ -78,10 +126,32 @@ private:
 
 
     void sendInLoop(const void *message, size_t len);
+    void sendInLoop(const std::string &message); // 跨线程send的时候 拷贝一份数据过去
+    // 别的线程的send/sendFd/shutdown排进pendingOps_ 由连接当前所属的loop按顺序取出来执行
+    // 迁移的时候还没执行的操作留在队列里面 新loop接着执行 顺序不会被打乱
+    // 在loop线程里面调用的时候 先执行排在前面的 再直接执行op
+    void runInOrder(std::function<void()> op);
+    void doPendingOps();
+    void doPendingOpsInLoop();
+    void sendFdInLoop(int fd, const std::string &data);
+    ssize_t writeWithFds(int *saveErrno);
     
     void shutdownInLoop();
-
-    EventLoop *loop_; // 这里绝对不是baseloop,因为TcpConnection都是在subLoop里面管理的
+    void shutdownWhenIdleInLoop();
+    void forceCloseInLoop();
+    void offloadFinished();
+    void updateBufferStats();
+
+    void migrateInLoop(EventLoop *loop);
+    void attachInLoop();
+
+    // 这里绝对不是baseloop,因为TcpConnection都是在subLoop里面管理的
+    // 连接可以迁移 别的线程send的时候也要读 所以是原子的
+    std::atomic<EventLoop *> loop_;
+    std::mutex opsMutex_; // 保护pendingOps_ 迁移的时候改loop_ 投递到loop_上也在锁里面
+    std::vector<std::function<void()>> pendingOps_;
+    std::atomic_bool pendingOpsQueued_; // pendingOps_不为空 已经投递了doPendingOpsInLoop
+    bool runningOps_; // loop线程正在执行从pendingOps_取出来的一批操作
     const std::string name_;
     std::atomic_int state_;
     bool reading_;
@@ -98,8 +168,27 @@ private:
     WriteCompleteCallback writeCompleteCallback_; // 消息发送完成以后的回调
     HighWaterMarkCallback highWaterMarkCallback_;
     CloseCallback closeCallback_;
+    FdCallback fdCallback_;
     size_t highWaterMark_; // 水位标志
+    ComputePool *computePool_;
+    std::shared_ptr<Strand> strand_; // 第一次offloadOrdered的时候创建
+    std::atomic_int offloadsInFlight_; // 已经offload出去 回复还没有send的个数
+    std::atomic_bool shutdownWhenIdle_;
+
+    std::atomic<uint64_t> bytesReceived_;
+    std::atomic<uint64_t> bytesSent_;
+    std::atomic<size_t> pendingOutputBytes_;
+    std::atomic<size_t> bufferCapacity_;
 
     Buffer inputBuffer_;  // 接收数据的缓冲区
     Buffer outputBuffer_; // 发送数据的缓冲区
+
+    // sendFd排队的fd offset是它跟着的那个字节在outputBuffer_可读区里面的位置 发出去以后关掉
+    struct PendingFd
+    {
+        int fd;
+        size_t offset;
+    };
+    std::deque<PendingFd> pendingFds_;
+    std::vector<int> receivedFds_; // handleRead里面复用
 };
\ No newline at end of file
@@ -0,0 +1,754 @@
+#include "TcpConnectionPool.h"
+#include "TcpConnection.h"
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "CountDownLatch.h"
+#include "Buffer.h"
+#include "logger.h"
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+namespace
+{
+    int64_t nowMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    void noopConnection(const TcpConnectionPtr &)
+    {
+    }
+
+    void discardMessage(const TcpConnectionPtr &, Buffer *buf, Timestamp)
+    {
+        buf->retrieveAll();
+    }
+
+    // 不归池子管的连接 关闭以后直接销毁
+    void destroyConnection(const TcpConnectionPtr &conn)
+    {
+        conn->queueInLoop(std::bind(&TcpConnection::connectionDestroyed, conn));
+    }
+}
+
+struct TcpConnectionPool::Host
+{
+    struct Idle
+    {
+        TcpConnectionPtr conn;
+        int64_t sinceMs; // 放进空闲(或者探测完放回来)的时间 隔checkIntervalMs探测一次
+    };
+    struct Waiter
+    {
+        AcquireCallback cb;
+        int64_t deadlineMs;
+    };
+    struct Pending
+    {
+        ConnectorPtr connector;
+        int64_t deadlineMs;
+    };
+
+    explicit Host(const InetAddress &a) : addr(a), total(0) {}
+
+    InetAddress addr;
+    std::deque<Idle> idle;        // 后进先出 back是最近放回来的
+    std::deque<Waiter> waiters;   // 先来先得
+    std::vector<Pending> pending; // 正在连接
+    int total;                    // 空闲+在用+正在连 不超过maxPerHost
+};
+
+struct TcpConnectionPool::SubPool
+{
+    enum State
+    {
+        kIdle,    // 在host->idle里面
+        kInUse,   // 在使用者手里
+        kProbing, // 主动健康检查中
+        kLimbo,   // 刚连上或者刚放回来 马上交给排队的或者放进idle
+    };
+    struct Member
+    {
+        TcpConnectionPtr conn; // 在用的连接也要有人持有
+        Host *host;
+        State state;
+        int64_t lastUsedMs; // 最后一次被使用者放回来(或者刚连上)的时间 空闲超时按这个算 探测不算使用
+        uint64_t probeId;
+        int64_t probeDeadlineMs;
+    };
+
+    explicit SubPool(EventLoop *l) : loop(l), timerfd(-1), nextProbeId(1), nextConnId(1) {}
+
+    EventLoop *loop;
+    std::unordered_map<std::string, std::unique_ptr<Host>> hosts; // key是ip:port
+    std::unordered_map<TcpConnection *, Member> members;          // 池子管着的连接(不包括正在连的)
+    int timerfd;
+    std::unique_ptr<Channel> timerChannel;
+    uint64_t nextProbeId;
+    int nextConnId;
+};
+
+TcpConnectionPool::Options::Options()
+    : maxPerHost(8),
+      maxIdle(4),
+      idleTimeoutMs(60 * 1000),
+      checkIntervalMs(1000),
+      connectTimeoutMs(3000),
+      acquireTimeoutMs(3000),
+      connectRetries(1)
+{
+}
+
+TcpConnectionPool::Stats::Stats()
+    : acquires(0), reused(0), created(0), connectFailures(0), waitTimeouts(0),
+      evictedIdle(0), evictedUnhealthy(0), idle(0), inUse(0), connecting(0), waiting(0)
+{
+}
+
+std::string TcpConnectionPool::Stats::toString() const
+{
+    char buf[512];
+    snprintf(buf, sizeof buf,
+             "acquires=%lld reused=%lld created=%lld connect_failures=%lld wait_timeouts=%lld "
+             "evicted_idle=%lld evicted_unhealthy=%lld idle=%d in_use=%d connecting=%d waiting=%d",
+             (long long)acquires, (long long)reused, (long long)created, (long long)connectFailures,
+             (long long)waitTimeouts, (long long)evictedIdle, (long long)evictedUnhealthy,
+             idle, inUse, connecting, waiting);
+    return buf;
+}
+
+TcpConnectionPool::TcpConnectionPool(const Options &options, const std::string &name)
+    : options_(options),
+      name_(name),
+      acquires_(0),
+      reused_(0),
+      created_(0),
+      connectFailures_(0),
+      waitTimeouts_(0),
+      evictedIdle_(0),
+      evictedUnhealthy_(0),
+      idle_(0),
+      inUse_(0),
+      connecting_(0),
+      waiting_(0),
+      alive_(new int(0))
+{
+    if (options_.maxPerHost <= 0 || options_.maxIdle < 0 || options_.checkIntervalMs <= 0)
+    {
+        LOG_FATAL("TcpConnectionPool[%s] bad options maxPerHost:%d maxIdle:%d checkIntervalMs:%d\n",
+                  name_.c_str(), options_.maxPerHost, options_.maxIdle, options_.checkIntervalMs);
+    }
+}
+
+TcpConnectionPool::~TcpConnectionPool()
+{
+    // 投递出去还没执行的回调(acquire release discard 探测结果)以后不会再碰这个对象
+    // 已经在执行的拿着guard 等它们执行完 不然它们可能在下面清理完以后又建一个子池
+    std::weak_ptr<int> alive(alive_);
+    alive_.reset();
+    while (!alive.expired())
+    {
+        std::this_thread::yield();
+    }
+    std::vector<SubPool *> subs;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &item : subPools_)
+        {
+            subs.push_back(item.second.get());
+        }
+    }
+    for (SubPool *sub : subs)
+    {
+        if (sub->loop->isInLoopThread())
+        {
+            shutdownInLoop(sub);
+        }
+        else
+        {
+            CountDownLatch latch(1);
+            sub->loop->runInLoop([this, sub, &latch]() {
+                shutdownInLoop(sub);
+                latch.countDown();
+            });
+            latch.wait();
+        }
+    }
+}
+
+TcpConnectionPool::Stats TcpConnectionPool::stats() const
+{
+    Stats s;
+    s.acquires = acquires_;
+    s.reused = reused_;
+    s.created = created_;
+    s.connectFailures = connectFailures_;
+    s.waitTimeouts = waitTimeouts_;
+    s.evictedIdle = evictedIdle_;
+    s.evictedUnhealthy = evictedUnhealthy_;
+    s.idle = idle_;
+    s.inUse = inUse_;
+    s.connecting = connecting_;
+    s.waiting = waiting_;
+    return s;
+}
+
+// 在loop线程里面 第一次用到这个loop的时候创建子池和它的检查定时器
+TcpConnectionPool::SubPool *TcpConnectionPool::subPool(EventLoop *loop)
+{
+    SubPool *sub = findSubPool(loop);
+    if (sub)
+    {
+        return sub;
+    }
+    std::unique_ptr<SubPool> created(new SubPool(loop));
+    sub = created.get();
+    sub->timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (sub->timerfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d timerfd create err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    itimerspec spec;
+    ::bzero(&spec, sizeof spec);
+    spec.it_interval.tv_sec = options_.checkIntervalMs / 1000;
+    spec.it_interval.tv_nsec = static_cast<long>(options_.checkIntervalMs % 1000) * 1000 * 1000;
+    spec.it_value = spec.it_interval;
+    ::timerfd_settime(sub->timerfd, 0, &spec, nullptr);
+    sub->timerChannel.reset(new Channel(loop, sub->timerfd));
+    sub->timerChannel->setReadcallback(std::bind(&TcpConnectionPool::onCheckTimer, this, sub));
+    sub->timerChannel->enableReading();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        subPools_[loop] = std::move(created);
+    }
+    return sub;
+}
+
+TcpConnectionPool::SubPool *TcpConnectionPool::findSubPool(EventLoop *loop) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = subPools_.find(loop);
+    return it == subPools_.end() ? nullptr : it->second.get();
+}
+
+TcpConnectionPool::Host *TcpConnectionPool::host(SubPool *sub, const InetAddress &addr)
+{
+    std::string key = addr.toIpPort();
+    auto it = sub->hosts.find(key);
+    if (it != sub->hosts.end())
+    {
+        return it->second.get();
+    }
+    Host *h = new Host(addr);
+    sub->hosts[key].reset(h);
+    return h;
+}
+
+void TcpConnectionPool::acquire(EventLoop *loop, const InetAddress &addr, const AcquireCallback &cb)
+{
+    if (loop->isInLoopThread())
+    {
+        acquireInLoop(loop, addr, cb);
+    }
+    else
+    {
+        std::weak_ptr<int> alive(alive_);
+        loop->queueLoop([this, alive, loop, addr, cb]() {
+            std::shared_ptr<int> guard(alive.lock());
+            if (guard)
+            {
+                acquireInLoop(loop, addr, cb);
+            }
+            else
+            {
+                cb(TcpConnectionPtr()); // 池子关了
+            }
+        });
+    }
+}
+
+void TcpConnectionPool::acquireInLoop(EventLoop *loop, const InetAddress &addr, const AcquireCallback &cb)
+{
+    acquires_++;
+    SubPool *sub = subPool(loop);
+    Host *h = host(sub, addr);
+    while (!h->idle.empty())
+    {
+        TcpConnectionPtr conn = h->idle.back().conn;
+        SubPool::Member &m = sub->members[conn.get()];
+        if (!conn->connected())
+        {
+            // 已经在关了 关闭的回调还没来
+            evictedUnhealthy_++;
+            closeConnection(sub, conn);
+            continue;
+        }
+        h->idle.pop_back();
+        idle_--;
+        m.state = SubPool::kInUse;
+        inUse_++;
+        reused_++;
+        cb(conn);
+        return;
+    }
+
+    Host::Waiter waiter = {cb, nowMs() + options_.acquireTimeoutMs};
+    h->waiters.push_back(waiter);
+    waiting_++;
+    while (h->waiters.size() > h->pending.size() && h->total < options_.maxPerHost)
+    {
+        startConnect(sub, h);
+    }
+}
+
+void TcpConnectionPool::release(const TcpConnectionPtr &conn)
+{
+    // 总是排队执行: 调用者可能正在这个连接的回调里面 不能在这里换掉它的回调
+    queueRelease(conn, true);
+}
+
+void TcpConnectionPool::discard(const TcpConnectionPtr &conn)
+{
+    queueRelease(conn, false);
+}
+
+// 执行的时候池子可能已经析构了(比如响应回来之前池子就关了) 那就什么都不做 连接已经不归池子管了
+void TcpConnectionPool::queueRelease(const TcpConnectionPtr &conn, bool reuse)
+{
+    std::weak_ptr<int> alive(alive_);
+    conn->queueInLoop([this, alive, conn, reuse]() {
+        std::shared_ptr<int> guard(alive.lock());
+        if (guard)
+        {
+            releaseInLoop(conn, reuse);
+        }
+    });
+}
+
+void TcpConnectionPool::releaseInLoop(const TcpConnectionPtr &conn, bool reuse)
+{
+    SubPool *sub = findSubPool(conn->getLoop());
+    if (!sub)
+    {
+        return;
+    }
+    auto it = sub->members.find(conn.get());
+    if (it == sub->members.end() || it->second.state != SubPool::kInUse)
+    {
+        // 在用的时候已经被关掉了 不归池子管了
+        return;
+    }
+    Host *h = it->second.host;
+    it->second.state = SubPool::kLimbo;
+    it->second.lastUsedMs = nowMs();
+    inUse_--;
+    conn->setConnectionCallback(noopConnection);
+    conn->setMessageCallback(std::bind(&TcpConnectionPool::onIdleMessage, this, sub,
+                                       std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    conn->setWriteCompleteCallback(WriteCompleteCallback());
+    if (!reuse || !conn->connected())
+    {
+        closeConnection(sub, conn);
+        return;
+    }
+    handOff(sub, h, conn, false);
+}
+
+void TcpConnectionPool::startConnect(SubPool *sub, Host *h)
+{
+    ConnectorPtr connector(new Connector(sub->loop, h->addr));
+    connector->setRetryDelay(50, 1000);
+    connector->setMaxRetries(options_.connectRetries);
+    connector->setNewConnectionCallback(std::bind(&TcpConnectionPool::onConnected, this, sub, h, connector.get(), std::placeholders::_1));
+    connector->setConnectFailedCallback(std::bind(&TcpConnectionPool::onConnectFailed, this, sub, h, connector.get(), std::placeholders::_1));
+    Host::Pending pending = {connector, nowMs() + options_.connectTimeoutMs};
+    h->pending.push_back(pending);
+    h->total++;
+    connecting_++;
+    connector->start();
+}
+
+// 正在Connector的回调里面 Connector的channel处理事件的时候tie住了它自己 这里从pending里面拿掉是安全的
+// 找不到说明已经超时被停掉了
+bool TcpConnectionPool::finishConnect(Host *h, Connector *connector)
+{
+    for (auto it = h->pending.begin(); it != h->pending.end(); ++it)
+    {
+        if (it->connector.get() == connector)
+        {
+            h->pending.erase(it);
+            connecting_--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TcpConnectionPool::onConnected(SubPool *sub, Host *h, Connector *connector, int sockfd)
+{
+    if (!finishConnect(h, connector))
+    {
+        ::close(sockfd);
+        return;
+    }
+    int one = 1;
+    ::setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    ::setsockopt(sockfd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof one);
+
+    InetAddress localAddr(InetAddress::localAddressOf(sockfd));
+    char buf[64] = {0};
+    snprintf(buf, sizeof buf, ":%s#%d", h->addr.toIpPort().c_str(), sub->nextConnId++);
+    TcpConnectionPtr conn(new TcpConnection(sub->loop, name_ + buf, sockfd, localAddr, h->addr));
+    conn->setConnectionCallback(noopConnection);
+    conn->setMessageCallback(std::bind(&TcpConnectionPool::onIdleMessage, this, sub,
+                                       std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    conn->setCloseCallback(std::bind(&TcpConnectionPool::onConnectionClosed, this, sub, std::placeholders::_1));
+    SubPool::Member m = {conn, h, SubPool::kLimbo, nowMs(), 0, 0};
+    sub->members[conn.get()] = m;
+    created_++;
+    conn->connectionEstablished();
+    handOff(sub, h, conn, true);
+}
+
+void TcpConnectionPool::onConnectFailed(SubPool *, Host *h, Connector *connector, int err)
+{
+    LOG_ERROR("TcpConnectionPool[%s] connect %s failed err:%d\n", name_.c_str(), h->addr.toIpPort().c_str(), err);
+    if (!finishConnect(h, connector))
+    {
+        return;
+    }
+    h->total--;
+    connectFailures_++;
+    failWaiters(h);
+}
+
+// 上游连不上 正在连的个数不够分的排队者直接失败
+void TcpConnectionPool::failWaiters(Host *h)
+{
+    std::vector<AcquireCallback> failed;
+    while (h->waiters.size() > h->pending.size())
+    {
+        failed.push_back(h->waiters.front().cb);
+        h->waiters.pop_front();
+        waiting_--;
+    }
+    for (auto &cb : failed)
+    {
+        cb(TcpConnectionPtr());
+    }
+}
+
+// conn处于kLimbo 有排队的就给排队的 没有就放进空闲  fresh表示刚建好的连接
+void TcpConnectionPool::handOff(SubPool *sub, Host *h, const TcpConnectionPtr &conn, bool fresh)
+{
+    if (!h->waiters.empty())
+    {
+        AcquireCallback cb = h->waiters.front().cb;
+        h->waiters.pop_front();
+        waiting_--;
+        if (!fresh)
+        {
+            reused_++;
+        }
+        sub->members[conn.get()].state = SubPool::kInUse;
+        inUse_++;
+        cb(conn);
+        return;
+    }
+    putIdle(sub, h, conn);
+}
+
+void TcpConnectionPool::putIdle(SubPool *sub, Host *h, const TcpConnectionPtr &conn)
+{
+    if (static_cast<int>(h->idle.size()) >= options_.maxIdle)
+    {
+        evictedIdle_++;
+        closeConnection(sub, conn);
+        return;
+    }
+    sub->members[conn.get()].state = SubPool::kIdle;
+    Host::Idle idle = {conn, nowMs()};
+    h->idle.push_back(idle);
+    idle_++;
+}
+
+void TcpConnectionPool::removeIdle(Host *h, const TcpConnectionPtr &conn)
+{
+    for (auto it = h->idle.begin(); it != h->idle.end(); ++it)
+    {
+        if (it->conn == conn)
+        {
+            h->idle.erase(it);
+            idle_--;
+            return;
+        }
+    }
+}
+
+// 从池子里去掉并且关掉 关闭的回调换成直接销毁 之后有排队的就补一个连接
+void TcpConnectionPool::closeConnection(SubPool *sub, const TcpConnectionPtr &conn)
+{
+    auto it = sub->members.find(conn.get());
+    if (it == sub->members.end())
+    {
+        return;
+    }
+    Host *h = it->second.host;
+    SubPool::State state = it->second.state;
+    sub->members.erase(it);
+    h->total--;
+    if (state == SubPool::kIdle)
+    {
+        removeIdle(h, conn);
+    }
+    else if (state == SubPool::kInUse || state == SubPool::kProbing)
+    {
+        inUse_--;
+    }
+    conn->setConnectionCallback(noopConnection);
+    conn->setCloseCallback(destroyConnection);
+    conn->forceClose();
+    while (h->waiters.size() > h->pending.size() && h->total < options_.maxPerHost)
+    {
+        startConnect(sub, h);
+    }
+}
+
+// 空闲的连接不该收到数据 收到了说明协议错乱了(比如上一个使用者没把响应读完) 不能再用
+void TcpConnectionPool::onIdleMessage(SubPool *sub, const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    buf->retrieveAll();
+    auto it = sub->members.find(conn.get());
+    if (it != sub->members.end() && it->second.state == SubPool::kIdle)
+    {
+        LOG_INFO("TcpConnectionPool[%s] unexpected data on idle connection %s\n", name_.c_str(), conn->name().c_str());
+        evictedUnhealthy_++;
+        closeConnection(sub, conn);
+    }
+}
+
+// 池子管着的连接被关闭(对端关闭 出错) 在用的连接使用者自己的连接回调已经先收到了
+void TcpConnectionPool::onConnectionClosed(SubPool *sub, const TcpConnectionPtr &conn)
+{
+    auto it = sub->members.find(conn.get());
+    if (it != sub->members.end())
+    {
+        Host *h = it->second.host;
+        SubPool::State state = it->second.state;
+        sub->members.erase(it);
+        h->total--;
+        if (state == SubPool::kIdle)
+        {
+            removeIdle(h, conn);
+            evictedUnhealthy_++;
+        }
+        else if (state == SubPool::kInUse || state == SubPool::kProbing)
+        {
+            inUse_--;
+        }
+        while (h->waiters.size() > h->pending.size() && h->total < options_.maxPerHost)
+        {
+            startConnect(sub, h);
+        }
+    }
+    destroyConnection(conn);
+}
+
+void TcpConnectionPool::onProbeDone(SubPool *sub, const std::weak_ptr<TcpConnection> &weakConn, uint64_t probeId, bool healthy)
+{
+    TcpConnectionPtr conn = weakConn.lock();
+    if (!conn)
+    {
+        return;
+    }
+    auto it = sub->members.find(conn.get());
+    if (it == sub->members.end() || it->second.state != SubPool::kProbing || it->second.probeId != probeId)
+    {
+        return;
+    }
+    Host *h = it->second.host;
+    it->second.state = SubPool::kLimbo;
+    inUse_--;
+    conn->setConnectionCallback(noopConnection);
+    conn->setMessageCallback(std::bind(&TcpConnectionPool::onIdleMessage, this, sub,
+                                       std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    conn->setWriteCompleteCallback(WriteCompleteCallback());
+    if (!healthy || !conn->connected())
+    {
+        evictedUnhealthy_++;
+        closeConnection(sub, conn);
+        return;
+    }
+    handOff(sub, h, conn, false);
+}
+
+void TcpConnectionPool::onCheckTimer(SubPool *sub)
+{
+    uint64_t expirations;
+    ssize_t n = ::read(sub->timerfd, &expirations, sizeof expirations);
+    (void)n;
+    int64_t now = nowMs();
+
+    // 回调使用者的代码可能会再acquire 改到hosts和members 先把要处理的挑出来
+    std::vector<Host *> hosts;
+    for (auto &item : sub->hosts)
+    {
+        hosts.push_back(item.second.get());
+    }
+    std::vector<TcpConnectionPtr> expiredIdle, toProbe, expiredProbes;
+    std::vector<AcquireCallback> timedOut;
+    for (Host *h : hosts)
+    {
+        for (auto &idle : h->idle)
+        {
+            int64_t lastUsedMs = sub->members[idle.conn.get()].lastUsedMs;
+            if (options_.idleTimeoutMs > 0 && now - lastUsedMs >= options_.idleTimeoutMs)
+            {
+                expiredIdle.push_back(idle.conn);
+            }
+            else if (options_.healthCheck && now - idle.sinceMs >= options_.checkIntervalMs)
+            {
+                toProbe.push_back(idle.conn);
+            }
+        }
+        while (!h->waiters.empty() && h->waiters.front().deadlineMs <= now)
+        {
+            timedOut.push_back(h->waiters.front().cb);
+            h->waiters.pop_front();
+            waiting_--;
+            waitTimeouts_++;
+        }
+        bool connectTimedOut = false;
+        for (auto it = h->pending.begin(); it != h->pending.end();)
+        {
+            if (it->deadlineMs <= now)
+            {
+                LOG_ERROR("TcpConnectionPool[%s] connect %s timeout\n", name_.c_str(), h->addr.toIpPort().c_str());
+                it->connector->stop(); // stop里面排队的操作持有shared_ptr
+                it = h->pending.erase(it);
+                h->total--;
+                connecting_--;
+                connectFailures_++;
+                connectTimedOut = true;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        if (connectTimedOut)
+        {
+            failWaiters(h);
+        }
+    }
+    for (auto &item : sub->members)
+    {
+        if (item.second.state == SubPool::kProbing && item.second.probeDeadlineMs <= now)
+        {
+            expiredProbes.push_back(item.second.conn);
+        }
+    }
+
+    for (auto &conn : expiredIdle)
+    {
+        evictedIdle_++;
+        closeConnection(sub, conn);
+    }
+    for (auto &conn : expiredProbes)
+    {
+        evictedUnhealthy_++;
+        closeConnection(sub, conn);
+    }
+    for (auto &conn : toProbe)
+    {
+        auto it = sub->members.find(conn.get());
+        if (it == sub->members.end() || it->second.state != SubPool::kIdle)
+        {
+            continue;
+        }
+        removeIdle(it->second.host, conn);
+        it->second.state = SubPool::kProbing;
+        it->second.probeId = sub->nextProbeId++;
+        it->second.probeDeadlineMs = now + options_.acquireTimeoutMs;
+        inUse_++;
+        std::weak_ptr<TcpConnection> weakConn(conn);
+        uint64_t probeId = it->second.probeId;
+        // done可能在连接自己的回调里面被调用 排队执行 那时候才换回池子的回调
+        // done也可能在池子析构以后才调用(探测还没结果池子就关了) 这时候什么都不做
+        std::weak_ptr<int> alive(alive_);
+        EventLoop *loop = sub->loop;
+        options_.healthCheck(conn, [this, alive, loop, sub, weakConn, probeId](bool healthy) {
+            loop->queueLoop([this, alive, sub, weakConn, probeId, healthy]() {
+                std::shared_ptr<int> guard(alive.lock());
+                if (guard)
+                {
+                    onProbeDone(sub, weakConn, probeId, healthy);
+                }
+            });
+        });
+    }
+    for (auto &cb : timedOut)
+    {
+        cb(TcpConnectionPtr());
+    }
+}
+
+// 池子析构 在子池的loop线程里面把它的东西都清掉
+void TcpConnectionPool::shutdownInLoop(SubPool *sub)
+{
+    sub->timerChannel->disableAll();
+    sub->timerChannel->remove();
+    sub->timerChannel.reset();
+    ::close(sub->timerfd);
+
+    std::vector<AcquireCallback> waiters;
+    for (auto &item : sub->hosts)
+    {
+        Host *h = item.second.get();
+        for (auto &pending : h->pending)
+        {
+            pending.connector->stop();
+        }
+        h->pending.clear();
+        for (auto &w : h->waiters)
+        {
+            waiters.push_back(w.cb);
+        }
+        h->waiters.clear();
+        h->idle.clear();
+    }
+    std::vector<std::pair<TcpConnectionPtr, SubPool::State>> members;
+    for (auto &item : sub->members)
+    {
+        members.push_back(std::make_pair(item.second.conn, item.second.state));
+    }
+    sub->members.clear();
+    for (auto &item : members)
+    {
+        const TcpConnectionPtr &conn = item.first;
+        conn->setCloseCallback(destroyConnection);
+        // 在用的连接留给使用者 其他的关掉
+        if (item.second != SubPool::kInUse)
+        {
+            conn->setConnectionCallback(noopConnection);
+            conn->setMessageCallback(discardMessage);
+            conn->forceClose();
+        }
+    }
+    for (auto &cb : waiters)
+    {
+        cb(TcpConnectionPtr());
+    }
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "inetAddress.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+
+class EventLoop;
+class Connector;
+
+/*
+ * 出站连接池 给后端扇出(一个请求要再去调上游服务)用 对每个上游地址保持一些热连接
+ *
+ * 每个io loop有自己的子池(SubPool): loop N上处理的请求拿到的一定是注册在loop N上的连接
+ * 收发都在当前线程 不需要跨线程投递 子池的状态只在自己的loop线程里面访问 没有锁
+ * 第一次在某个loop上acquire的时候创建这个loop的子池 TcpServer扩容出来的新loop也能直接用
+ *
+ * 每个子池里面对每个地址:
+ *   空闲连接后进先出 最近用过的先拿出去 多出来的在栈底 空闲太久会被回收
+ *   空闲+在用+正在连 不超过maxPerHost 满了的acquire排队 有连接放回来就按顺序交给排队的
+ *   连接失败的时候 正在连的个数不够分的排队者直接失败(上游挂了就快速失败 不在那里干等)
+ *
+ * 健康检查:
+ *   被动: 空闲连接被对端关闭 或者收到了不该有的数据 马上从池里去掉
+ *   定时: 每checkIntervalMs扫一遍 回收空闲超过idleTimeoutMs的连接 排队超时的acquire回调空连接
+ *         连接超时的Connector停掉
+ *   主动(可选): 设置了HealthCheck的时候 空闲超过checkIntervalMs的连接在扫描的时候拿出来探测一次
+ *         探测期间算在用 done(true)放回空闲 done(false)或者超过acquireTimeoutMs没有结果就关掉
+ *
+ * 用法(在loop线程里面):
+ *   pool.acquire(loop, upstreamAddr, [](const TcpConnectionPtr &conn) {
+ *       if (!conn) { 上游不可用 ...; return; }
+ *       conn->setMessageCallback(...);  // 收到完整响应以后 pool.release(conn)
+ *       conn->send(request);
+ *   });
+ *
+ * 连接在用的时候回调由使用者设置 release的时候恢复成池子自己的回调
+ * 池子要在所有用到的loop还在转的时候析构 析构的时候在用的连接不再归池子管
+ * 析构以后还在排队的release/discard/探测结果什么都不做 跨线程投递的acquire回调空连接
+ */
+class TcpConnectionPool : noncopyable
+{
+public:
+    // 在acquire的loop线程里面执行 conn为空表示失败(连不上 排队超时 池子关了)
+    using AcquireCallback = std::function<void(const TcpConnectionPtr &conn)>;
+    // 主动健康检查 在连接的loop线程里面调用 检查完调用done(结果) 可以在以后的回调里面异步调用
+    using HealthCheck = std::function<void(const TcpConnectionPtr &conn, const std::function<void(bool healthy)> &done)>;
+
+    struct Options
+    {
+        int maxPerHost;       // 每个loop上到同一个地址最多多少个连接(空闲+在用+正在连) 默认8
+        int maxIdle;          // 每个loop上到同一个地址最多留多少个空闲连接 多出来的release的时候直接关 默认4
+        int idleTimeoutMs;    // 空闲超过这么久就关掉 默认60000 0表示不限
+        int checkIntervalMs;  // 定时检查的间隔 默认1000 排队和连接的超时也是按这个粒度检查的
+        int connectTimeoutMs; // 建立一个连接最多等多久 默认3000
+        int acquireTimeoutMs; // 排队等连接最多等多久 默认3000
+        int connectRetries;   // 一次建连接失败以后重试几次 默认1
+        HealthCheck healthCheck;
+
+        Options();
+    };
+
+    struct Stats
+    {
+        int64_t acquires;         // acquire调用次数
+        int64_t reused;           // 拿到已有连接(空闲的或者别人刚放回来的)的次数
+        int64_t created;          // 新建的连接数
+        int64_t connectFailures;  // 建连接失败(包括超时)
+        int64_t waitTimeouts;     // 排队超时
+        int64_t evictedIdle;      // 空闲太久或者超过maxIdle被关掉的
+        int64_t evictedUnhealthy; // 空闲的时候被对端关闭 收到数据 或者主动检查失败的
+        int idle;                 // 下面几个是当前值
+        int inUse;
+        int connecting;
+        int waiting;
+
+        Stats();
+        std::string toString() const; // 一行key=value
+    };
+
+    explicit TcpConnectionPool(const Options &options = Options(),
+                               const std::string &name = std::string("TcpConnectionPool"));
+    ~TcpConnectionPool(); // 不能在用到的loop线程里面析构(要等各个loop清理完)
+
+    // 在loop线程里面调用 在别的线程调用会投递到loop线程里面执行
+    void acquire(EventLoop *loop, const InetAddress &addr, const AcquireCallback &cb);
+    // 用完放回 连接坏了或者空闲已经够多了就关掉 任意线程 可以在连接自己的回调里面调用
+    void release(const TcpConnectionPtr &conn);
+    // 不放回 直接关掉(比如协议出错 响应没收完)
+    void discard(const TcpConnectionPtr &conn);
+
+    // 任意线程 各个计数分别是原子的 合起来不是同一时刻的快照
+    Stats stats() const;
+    const std::string &name() const { return name_; }
+
+private:
+    struct Host;
+    struct SubPool;
+
+    SubPool *subPool(EventLoop *loop);
+    SubPool *findSubPool(EventLoop *loop) const;
+    Host *host(SubPool *sub, const InetAddress &addr);
+
+    // 下面的都在子池的loop线程里面执行
+    void acquireInLoop(EventLoop *loop, const InetAddress &addr, const AcquireCallback &cb);
+    void queueRelease(const TcpConnectionPtr &conn, bool reuse);
+    void releaseInLoop(const TcpConnectionPtr &conn, bool reuse);
+    void startConnect(SubPool *sub, Host *h);
+    void onConnected(SubPool *sub, Host *h, Connector *connector, int sockfd);
+    void onConnectFailed(SubPool *sub, Host *h, Connector *connector, int err);
+    bool finishConnect(Host *h, Connector *connector);
+    void failWaiters(Host *h);
+    void handOff(SubPool *sub, Host *h, const TcpConnectionPtr &conn, bool fresh);
+    void putIdle(SubPool *sub, Host *h, const TcpConnectionPtr &conn);
+    void removeIdle(Host *h, const TcpConnectionPtr &conn);
+    void closeConnection(SubPool *sub, const TcpConnectionPtr &conn);
+    void onIdleMessage(SubPool *sub, const TcpConnectionPtr &conn, Buffer *buf, Timestamp);
+    void onConnectionClosed(SubPool *sub, const TcpConnectionPtr &conn);
+    void onProbeDone(SubPool *sub, const std::weak_ptr<TcpConnection> &weakConn, uint64_t probeId, bool healthy);
+    void onCheckTimer(SubPool *sub);
+    void shutdownInLoop(SubPool *sub);
+
+    const Options options_;
+    const std::string name_;
+    mutable std::mutex mutex_; // 只保护subPools_这个表 子池里面的东西只在各自的loop线程里面访问
+    std::unordered_map<EventLoop *, std::unique_ptr<SubPool>> subPools_;
+
+    std::atomic<int64_t> acquires_;
+    std::atomic<int64_t> reused_;
+    std::atomic<int64_t> created_;
+    std::atomic<int64_t> connectFailures_;
+    std::atomic<int64_t> waitTimeouts_;
+    std::atomic<int64_t> evictedIdle_;
+    std::atomic<int64_t> evictedUnhealthy_;
+    std::atomic<int> idle_;
+    std::atomic<int> inUse_;
+    std::atomic<int> connecting_;
+    std::atomic<int> waiting_;
+    std::shared_ptr<int> alive_; // 析构的时候释放 投递出去的回调先检查它
+};
@@ -3,6 +3,13 @@
 #include <functional>
 #include <strings.h>
 #include "TcpConnection.h"
+#include "Channel.h"
+#include <algorithm>
+#include <memory>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
 static EventLoop *checkloopnotnull(EventLoop *loop)
 {
     if (loop == nullptr)
@@ -16,15 +23,46 @@ TcpServer::TcpServer(EventLoop *loop,
                      const InetAddress &listenAddr,
                      const std::string &nameArg,
                      Option option)
-    : loop_(checkloopnotnull(loop)),
-      ipPort_(listenAddr.toIpPort()),
+    : TcpServer(loop,
+                std::unique_ptr<Acceptor>(new Acceptor(checkloopnotnull(loop), listenAddr, option == kNoReusePort)),
+                listenAddr.toIpPort(),
+                nameArg)
+{
+}
+
+TcpServer::TcpServer(EventLoop *loop,
+                     int listenfd,
+                     const std::string &nameArg)
+    : TcpServer(loop,
+                std::unique_ptr<Acceptor>(new Acceptor(checkloopnotnull(loop), listenfd)),
+                InetAddress::localAddressOf(listenfd).toIpPort(),
+                nameArg)
+{
+}
+
+TcpServer::TcpServer(EventLoop *loop,
+                     std::unique_ptr<Acceptor> acceptor,
+                     const std::string &ipPort,
+                     const std::string &nameArg)
+    : loop_(loop),
+      ipPort_(ipPort),
       name_(nameArg),
-      acceptor_(new Acceptor(loop_, listenAddr, option == kNoReusePort)),
+      acceptor_(std::move(acceptor)),
       threadPool_(new EventLoopThreadPoll(loop_, name_)),
       connectionCallback_(),
       messageCallback_(),
+      computePool_(nullptr),
+      started_(0),
       nextConnId_(1),
-      started_(0)
+      accepted_(0),
+      closedBytesReceived_(0),
+      closedBytesSent_(0),
+      draining_(false),
+      drained_(false),
+      drainTimeoutMs_(-1),
+      destroyDeadlineUs_(-1),
+      drainTimerfd_(-1),
+      alive_(new int(0))
 {
     // 当有新用户连接时,会执行TcpServer::newConnection回调
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this,
@@ -33,6 +71,21 @@ TcpServer::TcpServer(EventLoop *loop,
 
 TcpServer::~TcpServer()
 {
+    alive_.reset(); // 还在排队的drain回调不会再碰这个对象
+    if (balancer_)
+    {
+        balancer_->stop();
+    }
+    if (drainTimerChannel_)
+    {
+        drainTimerChannel_->disableAll();
+        drainTimerChannel_->remove();
+    }
+    if (drainTimerfd_ >= 0)
+    {
+        ::close(drainTimerfd_);
+    }
+
     for(auto &item : connections_)
     {
         //这个局部的shared_ptr智能指针对象, 出右括号, 可以自动释放new出来的TcpConnection对象资源了
@@ -40,14 +93,88 @@ TcpServer::~TcpServer()
         item.second.reset();
 
         //销毁连接
-         conn->getLoop()->runInLoop(std::bind(&TcpConnection::connectionDestroyed,conn));
+        // 走连接自己的queueInLoop 拿到的loop不会在投递之前被迁走回收
+        if (conn->getLoop()->isInLoopThread())
+        {
+            conn->connectionDestroyed();
+        }
+        else
+        {
+            conn->queueInLoop(std::bind(&TcpConnection::connectionDestroyed, conn));
+        }
     }
 }
 
 // 设置底层subloop的个数
 void TcpServer::setThreadNum(int numThreads)
 {
-    threadPool_->setThreadNum(numThreads);
+    if (started_ == 0)
+    {
+        threadPool_->setThreadNum(numThreads);
+    }
+    else
+    {
+        // 线程池只能在mainloop里面改 getNextLoop也是在mainloop里面调用的
+        loop_->runInLoop(std::bind(&TcpServer::resizeThreadPoolInLoop, this, numThreads));
+    }
+}
+
+void TcpServer::resizeThreadPoolInLoop(int numThreads)
+{
+    if (draining_) // subloop马上就要全部结束了
+    {
+        return;
+    }
+    int current = threadPool_->numThreads();
+    LOG_INFO("TcpServer::resizeThreadPoolInLoop[%s] %d => %d\n", name_.c_str(), current, numThreads);
+    if (numThreads > current)
+    {
+        threadPool_->addThreads(numThreads - current);
+        // 已有的长连接也要分一部分到新的subloop上 不然扩容只对新连接有用
+        // 按轮询重新分一遍 只迁移那些分到新loop上的连接
+        std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+        size_t i = 0;
+        for (auto &item : connections_)
+        {
+            size_t idx = i++ % loops.size();
+            if (static_cast<int>(idx) >= current && item.second->getLoop() != loops[idx])
+            {
+                item.second->migrateTo(loops[idx]);
+            }
+        }
+    }
+    else if (numThreads < current)
+    {
+        std::vector<EventLoop *> retired = threadPool_->retireLoops(current - numThreads);
+        // 被移出轮询的subloop上的连接 按轮询迁移到剩下的loop上
+        // 缩容之前排队的迁移(比如LoopBalancer)可能还会把连接迁到退役的loop上 用getLoopLocked读
+        // 这样的迁移要么已经完成 这里会把连接再迁走 要么执行的时候看到退役标记放弃
+        for (auto &item : connections_)
+        {
+            const TcpConnectionPtr &conn = item.second;
+            if (std::find(retired.begin(), retired.end(), conn->getLoopLocked()) != retired.end())
+            {
+                conn->migrateTo(threadPool_->getNextLoop());
+            }
+        }
+        // 迁移的回调都排在前面 下面这个回调在subloop上执行的时候 上面的连接已经全部迁走了
+        // 线程不能在自己的loop里面join自己 所以再回到mainloop里面交给线程池 等它静默以后结束它
+        // 用weak_ptr: 这中间TcpServer可能已经析构了
+        std::weak_ptr<EventLoopThreadPoll> weakPool(threadPool_);
+        EventLoop *baseloop = loop_;
+        for (EventLoop *ioloop : retired)
+        {
+            ioloop->queueLoop([weakPool, baseloop, ioloop]() {
+                baseloop->queueLoop([weakPool, ioloop]() {
+                    std::shared_ptr<EventLoopThreadPoll> pool(weakPool.lock());
+                    if (pool)
+                    {
+                        pool->removeRetiredLoop(ioloop);
+                    }
+                });
+            });
+        }
+    }
 }
 //   mainloop 的loop.loop()事件监听  由用户自己开启
 //   新连接的loop.loop() 的事件监听 在启动一个线程的时候===> one thread per loop 的时候就启动了
@@ -61,6 +188,253 @@ void TcpServer::start()
     }
 }
 
+void TcpServer::stopAccepting()
+{
+    loop_->runInLoop(std::bind(&TcpServer::stopAcceptingInLoop, this));
+}
+
+void TcpServer::stopAcceptingInLoop()
+{
+    LOG_INFO("TcpServer::stopAccepting[%s] %s\n", name_.c_str(), ipPort_.c_str());
+    acceptor_->stopAccepting();
+}
+
+void TcpServer::drain(int timeoutMs, const DrainCallback &cb)
+{
+    std::weak_ptr<int> alive(alive_);
+    loop_->runInLoop([this, alive, timeoutMs, cb]() {
+        if (!alive.expired())
+        {
+            drainInLoop(timeoutMs, cb);
+        }
+    });
+}
+
+void TcpServer::drainInLoop(int timeoutMs, const DrainCallback &cb)
+{
+    if (draining_)
+    {
+        return;
+    }
+    LOG_INFO("TcpServer::drain[%s] %zu connection(s) timeout %d ms\n", name_.c_str(), connections_.size(), timeoutMs);
+    draining_ = true;
+    drainCallback_ = cb;
+    drainTimeoutMs_ = timeoutMs;
+    acceptor_->stopAccepting();
+    if (balancer_)
+    {
+        balancer_->stop(); // 不再迁移连接
+    }
+    for (auto &item : connections_)
+    {
+        item.second->shutdownWhenIdle();
+    }
+    drainTimerfd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (drainTimerfd_ < 0)
+    {
+        LOG_FATAL("%s:%s:%d timerfd create err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    drainTimerChannel_.reset(new Channel(loop_, drainTimerfd_));
+    drainTimerChannel_->setReadcallback(std::bind(&TcpServer::handleDrainTimer, this));
+    drainTimerChannel_->enableReading();
+    if (timeoutMs >= 0)
+    {
+        armDrainTimer(timeoutMs);
+    }
+    checkDrained();
+}
+
+// ms < 0 解除定时器
+void TcpServer::armDrainTimer(int ms)
+{
+    itimerspec spec;
+    ::bzero(&spec, sizeof spec);
+    if (ms >= 0)
+    {
+        spec.it_value.tv_sec = ms / 1000;
+        spec.it_value.tv_nsec = static_cast<long>(ms % 1000) * 1000 * 1000 + 1; // 全0会解除定时器
+    }
+    ::timerfd_settime(drainTimerfd_, 0, &spec, nullptr);
+}
+
+// 连接还没关完的时候是超时 关完以后是等连接析构的轮询
+void TcpServer::handleDrainTimer()
+{
+    uint64_t expirations;
+    ssize_t n = ::read(drainTimerfd_, &expirations, sizeof expirations);
+    (void)n;
+    if (drained_)
+    {
+        waitDestroyed();
+        return;
+    }
+    LOG_INFO("TcpServer::drain[%s] timed out, closing %zu connection(s)\n", name_.c_str(), connections_.size());
+    for (auto &item : connections_)
+    {
+        item.second->forceClose();
+    }
+}
+
+void TcpServer::checkDrained()
+{
+    if (!draining_ || drained_ || !connections_.empty())
+    {
+        return;
+    }
+    drained_ = true;
+    armDrainTimer(-1); // 超时不用了 下面改成轮询
+    // forceClose的连接也要点时间析构 所以这一步重新算一个timeoutMs
+    if (drainTimeoutMs_ >= 0)
+    {
+        destroyDeadlineUs_ = Timestamp::monotonicMicroSeconds() + static_cast<int64_t>(drainTimeoutMs_) * 1000;
+    }
+    waitDestroyed();
+}
+
+// 移除的连接可能还被别的地方拿着: subloop上排队的connectionDestroyed 还没回来的offload
+// offload回来要投递到连接的subloop上 所以要等这些连接都析构了(socket也关了)才能结束subloop线程
+// 每个subloop走一个来回再检查 没析构完就过1ms再来 过了截止时间就不等了
+void TcpServer::waitDestroyed()
+{
+    std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+    std::shared_ptr<size_t> remaining(new size_t(loops.size()));
+    EventLoop *baseloop = loop_;
+    // 来回的途中TcpServer可能已经析构了(drain还没结束就析构) 回到baseloop以后先检查
+    std::weak_ptr<int> alive(alive_);
+    for (EventLoop *ioloop : loops)
+    {
+        ioloop->queueLoop([this, alive, baseloop, remaining]() {
+            baseloop->queueLoop([this, alive, remaining]() {
+                if (alive.expired() || --*remaining != 0)
+                {
+                    return;
+                }
+                drainingConnections_.erase(std::remove_if(drainingConnections_.begin(), drainingConnections_.end(),
+                                                          [](const std::weak_ptr<TcpConnection> &conn) {
+                                                              return conn.expired();
+                                                          }),
+                                           drainingConnections_.end());
+                if (drainingConnections_.empty())
+                {
+                    finishDrain();
+                }
+                else if (destroyDeadlineUs_ >= 0 && Timestamp::monotonicMicroSeconds() >= destroyDeadlineUs_)
+                {
+                    LOG_ERROR("TcpServer::drain[%s] %zu connection(s) still not destroyed after %d ms, finish anyway\n",
+                              name_.c_str(), drainingConnections_.size(), drainTimeoutMs_);
+                    finishDrain();
+                }
+                else
+                {
+                    armDrainTimer(1);
+                }
+            });
+        });
+    }
+}
+
+void TcpServer::finishDrain()
+{
+    LOG_INFO("TcpServer::drain[%s] done\n", name_.c_str());
+    drainTimerChannel_->disableAll();
+    threadPool_->stop();
+    if (drainCallback_)
+    {
+        DrainCallback cb;
+        cb.swap(drainCallback_);
+        cb();
+    }
+}
+
+void TcpServer::enableRebalance(int intervalMs, double busyGap)
+{
+    if (balancer_)
+    {
+        return;
+    }
+    balancer_.reset(new LoopBalancer(busyGap));
+    balancer_->start(loop_, intervalMs, std::bind(&TcpServer::rebalanceInLoop, this));
+}
+
+void TcpServer::rebalanceInLoop()
+{
+    std::vector<TcpConnectionPtr> conns;
+    conns.reserve(connections_.size());
+    for (auto &item : connections_)
+    {
+        conns.push_back(item.second);
+    }
+    balancer_->rebalance(threadPool_->getAllLoops(), conns);
+}
+
+TcpServer::ConnectionTotals TcpServer::connectionTotals() const
+{
+    ConnectionTotals totals;
+    totals.connections = connections_.size();
+    totals.accepted = accepted_;
+    totals.bytesReceived = closedBytesReceived_;
+    totals.bytesSent = closedBytesSent_;
+    totals.pendingOutputBytes = 0;
+    totals.bufferCapacity = 0;
+    // 都是原子变量的relaxed读 不会和io线程抢锁
+    for (const auto &item : connections_)
+    {
+        const TcpConnectionPtr &conn = item.second;
+        totals.bytesReceived += conn->bytesReceived();
+        totals.bytesSent += conn->bytesSent();
+        totals.pendingOutputBytes += conn->pendingOutputBytes();
+        totals.bufferCapacity += conn->bufferCapacity();
+    }
+    return totals;
+}
+
+std::vector<LoopStatsSnapshot> TcpServer::loopStats(std::vector<EventLoop *> *loops)
+{
+    std::vector<LoopStatsSnapshot> result;
+    std::vector<EventLoop *> all;
+    all.push_back(loop_);
+    for (EventLoop *loop : threadPool_->getAllLoops())
+    {
+        if (loop != loop_)
+        {
+            all.push_back(loop);
+        }
+    }
+    for (EventLoop *loop : all)
+    {
+        result.push_back(loop->stats());
+    }
+    if (loops)
+    {
+        loops->swap(all);
+    }
+    return result;
+}
+
+LoopStatsSnapshot TcpServer::stats()
+{
+    LoopStatsSnapshot merged;
+    for (const LoopStatsSnapshot &s : loopStats())
+    {
+        merged.merge(s);
+    }
+    return merged;
+}
+
+std::string TcpServer::statsDump()
+{
+    std::vector<LoopStatsSnapshot> loops = loopStats();
+    LoopStatsSnapshot merged;
+    std::string out;
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        out += "loop" + std::to_string(i) + " " + loops[i].toString() + "\n";
+        merged.merge(loops[i]);
+    }
+    out += merged.histogramsToString();
+    return out;
+}
+
 // 有一个新的客户端的连接 acceptor 会执行这个回调操作
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
@@ -69,20 +443,14 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
     char buf[64] = {0};
     snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
     nextConnId_++;
+    accepted_++;
     std::string connName = name_ + buf;
 
     LOG_INFO("TcpServer::newConnection[%s] - new connection[%s] from %s \n",
              name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
 
-    // 通过sockfd 获取 其 绑定的  ===> 本机的ip地址和端口号
-    sockaddr_in local;
-    ::bzero(&local, sizeof local);
-    socklen_t addrlen = sizeof local;
-    if (::getsockname(sockfd, (sockaddr *)&local, &addrlen) < 0)
-    {
-        LOG_ERROR("sockets::getLocalAddr");
-    }
-    InetAddress localAddr(local);
+    // 通过sockfd 获取 其 绑定的  ===> 本机的ip地址和端口号(AF_UNIX的时候是监听的路径)
+    InetAddress localAddr(InetAddress::localAddressOf(sockfd));
 
     // 根据连接成功的sockfd 创建TcpConnection连接对象
     TcpConnectionPtr conn(new TcpConnection(ioloop, connName, sockfd, localAddr, peerAddr));
@@ -91,6 +459,10 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    if (computePool_)
+    {
+        conn->setComputePool(computePool_);
+    }
 
     // 设置了如何关闭连接的回调  conn->shutDown()
     conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
@@ -109,6 +481,12 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
     LOG_INFO("TcpServer::removeConnectionInLoop[%s] - connection %s \n", name_.c_str(), conn->name().c_str());
 
     connections_.erase(conn->name());
-    EventLoop *ioloop = conn->getLoop();
-    ioloop->queueLoop(std::bind(&TcpConnection::connectionDestroyed, conn));
+    closedBytesReceived_ += conn->bytesReceived();
+    closedBytesSent_ += conn->bytesSent();
+    conn->queueInLoop(std::bind(&TcpConnection::connectionDestroyed, conn));
+    if (draining_)
+    {
+        drainingConnections_.push_back(conn);
+        checkDrained();
+    }
 }
\ No newline at end of file
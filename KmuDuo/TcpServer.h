@@ -12,8 +12,11 @@
 #include <unordered_map>
 #include"TcpConnection.h"
 #include"Buffer.h"
+#include "LoopBalancer.h"
 
 class TcpConnection;
+class ComputePool;
+class Channel;
 
 /*
 用户使用muduo编写服务器程序
@@ -24,6 +27,7 @@ class TcpServer : noncopyable
 {
 public:
     using ThreadInitCallback = std::function<void(EventLoop *)>;
+    using DrainCallback = std::function<void()>;
 
     enum Option
     {
@@ -35,6 +39,10 @@ public:
               const InetAddress &listenAddr,
               const std::string&nameArg,
               Option option = kNoReusePort);
+    // 接管一个已经bind并且listen好的socket 热升级的时候新进程用旧进程传过来的fd(见HotUpgrade.h)
+    TcpServer(EventLoop *loop,
+              int listenfd,
+              const std::string &nameArg);
 
     ~TcpServer();
 
@@ -42,19 +50,88 @@ public:
     void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
     void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+    // 新连接都会带上这个ComputePool 可以用TcpConnection::offload把耗时的处理丢给它 pool由用户管理
+    void setComputePool(ComputePool *pool) { computePool_ = pool; }
 
     // 设置底层subloop的个数
+    // start()之后也可以调用: 扩容直接并行拉起新的subloop 缩容把多出来的subloop上的连接迁移走以后再结束线程
     void setThreadNum(int numThreads);
 
     // 开启服务器监听
     void start();
+    // 不再accept新连接 已经建立的连接照常收发 任意线程都可以调用
+    // 热升级的时候新进程接管了监听socket以后 旧进程调用这个 内核队列里面还没accept的连接都留给新进程
+    void stopAccepting();
+    // 监听socket 热升级的时候传给新进程
+    int listenFd() const { return acceptor_->fd(); }
+
+    // 优雅退出 任意线程都可以调用 只有第一次调用有效
+    //   1. stopAccepting 还没accept的连接留在内核队列里面(热升级的时候归新进程)
+    //   2. 每个连接等offload出去的回复都send了 outputBuffer_发完以后shutdown写端
+    //      刚accept还没收到请求的连接 等第一个请求回复完再shutdown
+    //   3. 等对端读完关闭 timeoutMs以后还没关的连接forceClose(timeoutMs < 0 一直等)
+    //   4. 连接都销毁以后结束所有subloop线程 然后在baseloop里面执行cb(一般在里面loop->quit())
+    //      这一步也最多等timeoutMs: 还有连接没析构(一般是offload的work卡住了)就打日志照样结束
+    //      这种连接之后再投递回subloop是不安全的 所以卡住的work要在cb里面退出进程之前处理掉
+    // shutdown以后对端再发来的请求不会再回复 请求-回复的协议里面对端读到EOF就应该关闭
+    // drain没结束就在baseloop线程里面析构TcpServer也可以: 排队的drain回调不会再碰它 cb也不会执行
+    void drain(int timeoutMs, const DrainCallback &cb = DrainCallback());
+    // drain开始以后为true 只能在baseloop线程调用
+    bool draining() const { return draining_; }
+
+    // 开启后台均衡: 每隔intervalMs采样一次 最忙和最闲的subloop繁忙比例相差超过busyGap的时候
+    // 把最忙loop上最热的几个连接迁移到最闲的loop上
+    void enableRebalance(int intervalMs, double busyGap = 0.2);
+
+    // 连接相关的累计值 已经关闭的连接的收发字节数也算在里面 只能在baseloop线程调用
+    struct ConnectionTotals
+    {
+        size_t connections;        // 当前的连接数
+        int64_t accepted;          // 一共接受过的连接数
+        uint64_t bytesReceived;
+        uint64_t bytesSent;
+        size_t pendingOutputBytes; // 所有连接输出缓冲区里面还没发出去的字节数
+        size_t bufferCapacity;     // 所有连接的缓冲区占用的内存
+    };
+    ConnectionTotals connectionTotals() const;
+
+    EventLoop *getLoop() const { return loop_; }
+    const std::string &name() const { return name_; }
+    const std::string &ipPort() const { return ipPort_; }
+
+    // 运行统计 第一个是baseloop 后面是各个subloop(没有subloop的时候只有baseloop) 只能在baseloop线程调用
+    // loops不为空的时候按同样的顺序填上对应的EventLoop 扩缩容以后下标会变 要跨两次调用对比的时候用它
+    std::vector<LoopStatsSnapshot> loopStats(std::vector<EventLoop *> *loops = nullptr);
+    // 所有loop合并以后的统计
+    LoopStatsSnapshot stats();
+    // 紧凑的文本: 每个loop一行计数 加上合并以后的三个延迟直方图
+    std::string statsDump();
 
 private:
+    // 上面两个构造函数都委托给它 只是Acceptor的来源不一样
+    TcpServer(EventLoop *loop,
+              std::unique_ptr<Acceptor> acceptor,
+              const std::string &ipPort,
+              const std::string &nameArg);
+
     void newConnection(int sockfd,const InetAddress&peerAddr);
     
     void removeConnection(const TcpConnectionPtr&conn);
 
     void removeConnectionInLoop(const TcpConnectionPtr&conn);
+
+    void resizeThreadPoolInLoop(int numThreads);
+
+    void stopAcceptingInLoop();
+
+    void drainInLoop(int timeoutMs, const DrainCallback &cb);
+    void armDrainTimer(int ms);
+    void handleDrainTimer();
+    void checkDrained();
+    void waitDestroyed();
+    void finishDrain();
+
+    void rebalanceInLoop();
    
 
     using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
@@ -67,13 +144,29 @@ private:
 
     std::shared_ptr<EventLoopThreadPoll> threadPool_; // one loop per thread
 
+    std::unique_ptr<LoopBalancer> balancer_; // 没有开启均衡的时候为空
+
     ConnectionCallback connectionCallback_;       // 有新连接时的回调
     MessageCallback messageCallback_;             // 有读写消息时的回调
     WriteCompleteCallback writeCompleteCallback_; // 消息发送完成以后的回调
 
     ThreadInitCallback threadInitCallback_; // 线程初始化的回调
+    ComputePool *computePool_;
 
     std::atomic_int started_;
     int nextConnId_;
     ConnectionMap connections_; // 保存所有的连接
+    int64_t accepted_;
+    uint64_t closedBytesReceived_; // 已经移除的连接收发的字节数
+    uint64_t closedBytesSent_;
+
+    bool draining_;
+    bool drained_; // 连接都已经移除 正在等它们析构
+    DrainCallback drainCallback_;
+    int drainTimeoutMs_;
+    int64_t destroyDeadlineUs_; // 等连接析构的截止时间 < 0 一直等
+    std::vector<std::weak_ptr<TcpConnection>> drainingConnections_; // drain开始以后移除的连接
+    int drainTimerfd_; // drain的时候才创建
+    std::unique_ptr<Channel> drainTimerChannel_;
+    std::shared_ptr<int> alive_; // 析构的时候释放 投递出去的drain相关回调先检查它
 };
\ No newline at end of file
@@ -1,12 +1,12 @@
 #include "Thread.h"
 #include"CurrentThread.h"
-#include<semaphore.h>
 std::atomic_int Thread::numCreated_(0);
 
 Thread::Thread(ThreadFunc func, const std::string &name)
     : started_(false),
       joined_(false),
       tid_(0),
+      tidLatch_(1),
       func_(std::move(func)),
       name_(name)
 {
@@ -23,21 +23,26 @@ Thread::~Thread()
 void Thread::start() //一个thread对象，记录的就是一个新线程的详细信息 
 {
     started_=true;
-    sem_t sem;
-    sem_init(&sem,false,0);
 
-    //开启线程
-    thread_ =std::shared_ptr<std::thread>(new std::thread([&](){
+    //开启线程  这里不等待新线程拿到tid,这样一次可以并行拉起很多个线程
+    thread_ =std::shared_ptr<std::thread>(new std::thread([this](){
     //获取线程的tid值
         tid_=CurrentThread::tid();
-        sem_post(&sem);
+        tidLatch_.countDown();
     //开启一个新线程,专门执行该线程函数
         func_();
     }));
+}
 
-    //这里必须等待获取上面新创建的线程的tid值
-    sem_wait(&sem);
+pid_t Thread::pid() const
+{
+    if (started_)
+    {
+        tidLatch_.wait(); // 必须等待新创建的线程写入tid值
+    }
+    return tid_;
 }
+
 void Thread::join()
 {
     joined_=true;
@@ -1,5 +1,6 @@
 #pragma once
 #include "noncopyable.h"
+#include "CountDownLatch.h"
 #include <functional>
 #include <thread>
 #include <memory>
@@ -20,7 +21,8 @@ public:
     void join();
 
     bool started() const { return started_; }
-    pid_t pid() const { return tid_; }
+    // 新线程的tid由新线程自己写入 start()不再阻塞等待,第一次调用pid()的时候才等待
+    pid_t pid() const;
 
     const std::string &name() const { return name_; }
     static int numCreated() { return numCreated_; }
@@ -32,6 +34,7 @@ private:
     bool joined_;
     std::shared_ptr<std::thread> thread_;
     pid_t tid_;
+    mutable CountDownLatch tidLatch_; // 新线程拿到tid以后countDown
     ThreadFunc func_;
     std::string name_;
     static std::atomic_int numCreated_;
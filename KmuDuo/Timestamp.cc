@@ -1,6 +1,36 @@
 #include "Timestamp.h"
 #include <time.h>
-#include<iostream>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+    // 每个线程缓存上一次格式化的秒和对应的 年/月/日 时:分:秒
+    // localtime_r每次都要拿glibc里面时区的全局锁 多个io线程一起写日志的时候会在这里排队
+    __thread time_t t_lastSecond = -1;
+    __thread char t_time[32];
+    __thread size_t t_timeLen = 0;
+
+    const char *formatSecond(time_t seconds, size_t *len)
+    {
+        if (seconds != t_lastSecond)
+        {
+            struct tm tm_time;
+            localtime_r(&seconds, &tm_time);
+            int n = snprintf(t_time, sizeof t_time, "%4d/%02d/%02d %02d:%02d:%02d",
+                             tm_time.tm_year + 1900,
+                             tm_time.tm_mon + 1,
+                             tm_time.tm_mday,
+                             tm_time.tm_hour,
+                             tm_time.tm_min,
+                             tm_time.tm_sec);
+            t_timeLen = n < static_cast<int>(sizeof t_time) ? n : sizeof t_time - 1;
+            t_lastSecond = seconds;
+        }
+        *len = t_timeLen;
+        return t_time;
+    }
+}
 
 Timestamp::Timestamp() : microSecondsSinceEpoch_(0)
 {
@@ -10,24 +40,63 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch) : microSecondsSinceEpoch_(m
 }
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(NULL));
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
+int64_t Timestamp::monotonicMicroSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000;
+}
+size_t Timestamp::formatTo(char *buf, size_t len, bool showMicroseconds) const
+{
+    if (len == 0)
+    {
+        return 0;
+    }
+    size_t n = 0;
+    const char *second = formatSecond(secondsSinceEpoch(), &n);
+    if (n >= len)
+    {
+        n = len - 1;
+    }
+    memcpy(buf, second, n);
+    if (showMicroseconds && n + 7 < len)
+    {
+        // .微秒 固定6位 手工转换 不走snprintf
+        int micros = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+        if (micros < 0)
+        {
+            micros += kMicroSecondsPerSecond;
+        }
+        buf[n] = '.';
+        for (int i = 6; i >= 1; --i)
+        {
+            buf[n + i] = static_cast<char>('0' + micros % 10);
+            micros /= 10;
+        }
+        n += 7;
+    }
+    buf[n] = '\0';
+    return n;
 }
 std::string Timestamp::toString() const
 {
-    char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
-    snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
-             tm_time->tm_year + 1900,
-             tm_time->tm_mon + 1,
-             tm_time->tm_mday,
-             tm_time->tm_hour,
-             tm_time->tm_min,
-             tm_time->tm_sec);
-             return buf;
+    char buf[64];
+    size_t n = formatTo(buf, sizeof buf, false);
+    return std::string(buf, n);
+}
+std::string Timestamp::toFormattedString(bool showMicroseconds) const
+{
+    char buf[64];
+    size_t n = formatTo(buf, sizeof buf, showMicroseconds);
+    return std::string(buf, n);
 }
 
 // int main()
 // {
 //     // std::cout<<Timestamp::now().toString()<<std::endl;
 //     return 0;
-// }
\ No newline at end of file
+// }
@@ -2,15 +2,64 @@
 
 #include <iostream>
 #include <string>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
 
-//时间类
+//时间类 精确到微秒
 class Timestamp
 {
 public:
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
+
     Timestamp();
     explicit Timestamp(int64_t microSecondsSinceEpoch);
+    // clock_gettime(CLOCK_REALTIME) 走vDSO 不陷入内核
     static Timestamp now();
-    std::string toString()const;
+    static Timestamp invalid() { return Timestamp(); }
+    static Timestamp fromUnixTime(time_t t, int microseconds = 0)
+    {
+        return Timestamp(static_cast<int64_t>(t) * kMicroSecondsPerSecond + microseconds);
+    }
+    // CLOCK_MONOTONIC的微秒数 不受系统时间调整影响 用来算耗时
+    static int64_t monotonicMicroSeconds();
+
+    // 2026/01/01 12:00:00  和原来的格式一样
+    std::string toString() const;
+    // 2026/01/01 12:00:00.123456
+    std::string toFormattedString(bool showMicroseconds = true) const;
+    // 不申请内存的版本 写到buf里面(带结尾的0) 返回写了多少个字符 日志用
+    // 年月日时分秒这一段每个线程缓存一份 同一秒之内不再调用localtime_r
+    size_t formatTo(char *buf, size_t len, bool showMicroseconds = true) const;
+
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    time_t secondsSinceEpoch() const { return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond); }
+
 private:
     int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// high - low 单位秒
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+// 单位秒
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
@@ -0,0 +1,612 @@
+#include "TraceLog.h"
+#include "Thread.h"
+#include "CurrentThread.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+std::atomic_bool TraceLog::enabled_(false);
+__thread TraceRing *TraceLog::t_ring = nullptr;
+
+TraceRing::TraceRing(size_t capacity, int tid)
+    : dropped(0),
+      retired(false),
+      capacity_(capacity),
+      mask_(capacity - 1),
+      tid_(tid),
+      buffer_(new char[capacity]()),
+      head_(0),
+      pendingHead_(0),
+      cachedTail_(0),
+      tail_(0)
+{
+}
+
+TraceRing::~TraceRing()
+{
+    delete[] buffer_;
+}
+
+size_t TraceRing::consume(const std::function<void(const TraceRecord *)> &func)
+{
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    size_t n = 0;
+    while (tail != head)
+    {
+        size_t offset = tail & mask_;
+        const TraceRecord *rec = reinterpret_cast<const TraceRecord *>(buffer_ + offset);
+        if (rec->size == 0)
+        {
+            tail += capacity_ - offset; // 绕回标记
+            continue;
+        }
+        func(rec);
+        tail += rec->size;
+        ++n;
+    }
+    tail_.store(tail, std::memory_order_release);
+    return n;
+}
+
+namespace
+{
+    const int kMaxSites = 4096;
+    const size_t kOutputChunk = 64 * 1024;
+
+    // 登记的调用点 格式串在登记的时候切成片段 每个片段是一段普通文字加上一个转换说明 最后一段只有文字
+    struct SiteInfo
+    {
+        const char *file; // 只保留文件名
+        int line;
+        const char *format;
+        std::vector<uint8_t> types;
+        std::vector<std::string> fragments;
+        std::string tail;
+    };
+
+    // 长度修饰符要求的整数宽度 0表示不是整数的长度修饰符
+    size_t integerWidth(const std::string &length)
+    {
+        if (length.empty() || length == "h" || length == "hh")
+        {
+            return sizeof(int); // char short提升成int传
+        }
+        if (length == "l")
+        {
+            return sizeof(long);
+        }
+        if (length == "ll" || length == "q")
+        {
+            return sizeof(long long);
+        }
+        if (length == "j")
+        {
+            return sizeof(intmax_t);
+        }
+        if (length == "z")
+        {
+            return sizeof(size_t);
+        }
+        if (length == "t")
+        {
+            return sizeof(ptrdiff_t);
+        }
+        return 0;
+    }
+
+    // 解码的时候32位的类型按int/unsigned 64位的按long long传给snprintf 宽度对不上就是未定义行为
+    bool compatible(char conversion, const std::string &length, uint8_t type)
+    {
+        switch (conversion)
+        {
+        case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+            if (type == tracelog::kInt32 || type == tracelog::kUInt32)
+            {
+                return integerWidth(length) == 4;
+            }
+            if (type == tracelog::kInt64 || type == tracelog::kUInt64)
+            {
+                return integerWidth(length) == 8;
+            }
+            return false;
+        case 'c':
+            return length.empty() && (type == tracelog::kInt32 || type == tracelog::kUInt32);
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            return (length.empty() || length == "l") && type == tracelog::kDouble; // %Lf要long double
+        case 's':
+            return length.empty() && type == tracelog::kString; // %ls要wchar_t*
+        case 'p':
+            return length.empty() && (type == tracelog::kPointer || type == tracelog::kString);
+        default:
+            return false;
+        }
+    }
+
+    // 格式串和参数对得上返回true
+    bool parseFormat(SiteInfo *info)
+    {
+        std::string cur;
+        size_t arg = 0;
+        bool valid = true;
+        for (const char *p = info->format; *p; ++p)
+        {
+            cur += *p;
+            if (*p != '%')
+            {
+                continue;
+            }
+            if (p[1] == '%')
+            {
+                cur += *++p;
+                continue;
+            }
+            ++p;
+            // 标志 宽度 精度 不支持*
+            while (*p && strchr("-+ #0'123456789.", *p))
+            {
+                cur += *p++;
+            }
+            std::string length;
+            while (*p && strchr("hljztLq", *p))
+            {
+                length += *p;
+                cur += *p++;
+            }
+            if (*p == '\0')
+            {
+                valid = false;
+                break;
+            }
+            cur += *p;
+            if (arg >= info->types.size() || !compatible(*p, length, info->types[arg]))
+            {
+                valid = false;
+            }
+            ++arg;
+            info->fragments.push_back(cur);
+            cur.clear();
+        }
+        info->tail = cur;
+        return valid && arg == info->types.size();
+    }
+
+    template <typename T>
+    void appendFormat(std::string *out, const char *fmt, T value)
+    {
+        char buf[512];
+        int n = snprintf(buf, sizeof buf, fmt, value);
+        if (n < 0)
+        {
+            return;
+        }
+        if (n < static_cast<int>(sizeof buf))
+        {
+            out->append(buf, n);
+        }
+        else
+        {
+            std::vector<char> big(n + 1);
+            snprintf(big.data(), big.size(), fmt, value);
+            out->append(big.data(), n);
+        }
+    }
+
+    int64_t realtimeNanos()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    // 解码线程和登记信息 只有一个
+    class TraceDecoder
+    {
+    public:
+        TraceDecoder()
+            : ringSize_(1024 * 1024),
+              intervalMs_(10),
+              numSites_(0),
+              running_(false),
+              flushRequested_(0),
+              flushDone_(0),
+              droppedRetired_(0),
+              droppedReported_(0),
+              baseTicks_(0),
+              baseNanos_(0),
+              ticksPerNano_(1.0),
+              cachedSecond_(-1)
+        {
+            memset(sites_, 0, sizeof sites_);
+        }
+
+        int registerSite(TraceSite *site, const uint8_t *types, int numArgs)
+        {
+            std::lock_guard<std::mutex> lock(sitesMutex_);
+            int id = site->id.load(std::memory_order_relaxed);
+            if (id != 0)
+            {
+                return id; // 别的线程刚登记过
+            }
+            if (numSites_ + 1 >= kMaxSites)
+            {
+                return -1;
+            }
+            std::unique_ptr<SiteInfo> info(new SiteInfo);
+            const char *slash = strrchr(site->file, '/');
+            info->file = slash ? slash + 1 : site->file;
+            info->line = site->line;
+            info->format = site->format;
+            info->types.assign(types, types + numArgs);
+            if (!parseFormat(info.get()))
+            {
+                // 按格式串解码会是未定义行为(比如%d对上int64_t) 这个调用点以后什么都不记 只报一次
+                fprintf(stderr, "[TRACE]%s:%d format \"%s\" doesn't match its %d argument(s), site disabled\n",
+                        info->file, info->line, info->format, numArgs);
+                site->id.store(-1, std::memory_order_release);
+                return -1;
+            }
+            id = ++numSites_;
+            sites_[id] = info.release();
+            site->id.store(id, std::memory_order_release);
+            return id;
+        }
+
+        TraceRing *createRing()
+        {
+            std::shared_ptr<TraceRing> ring;
+            {
+                std::lock_guard<std::mutex> lock(ringsMutex_);
+                ring = std::make_shared<TraceRing>(ringSize_, CurrentThread::tid());
+                rings_.push_back(ring);
+            }
+            // 线程退出的时候标记一下 缓冲区由解码线程读完以后释放
+            struct RingHolder
+            {
+                std::shared_ptr<TraceRing> ring;
+                ~RingHolder()
+                {
+                    if (ring)
+                    {
+                        ring->retired.store(true, std::memory_order_release);
+                    }
+                }
+            };
+            static thread_local RingHolder holder;
+            holder.ring = ring;
+            return ring.get();
+        }
+
+        void setRingSize(size_t bytes)
+        {
+            size_t size = 4096;
+            while (size < bytes)
+            {
+                size <<= 1;
+            }
+            std::lock_guard<std::mutex> lock(ringsMutex_);
+            ringSize_ = size;
+        }
+
+        bool start(const TraceLog::OutputFunc &output, int intervalMs)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (running_)
+            {
+                return false;
+            }
+            output_ = output;
+            intervalMs_ = intervalMs > 0 ? intervalMs : 1;
+            calibrate();
+            running_ = true;
+            thread_.reset(new Thread(std::bind(&TraceDecoder::threadFunc, this), "TraceLog"));
+            thread_->start();
+            return true;
+        }
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!running_)
+                {
+                    return;
+                }
+                running_ = false;
+                cond_.notify_one();
+            }
+            thread_->join(); // 退出之前会再读一遍所有的缓冲区
+            thread_.reset();
+        }
+
+        void flush()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!running_)
+            {
+                return;
+            }
+            long request = ++flushRequested_;
+            cond_.notify_one();
+            flushCond_.wait(lock, [this, request]() { return flushDone_ >= request || !running_; });
+        }
+
+        long dropped()
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex_);
+            long n = droppedRetired_;
+            for (const std::shared_ptr<TraceRing> &ring : rings_)
+            {
+                n += ring->dropped.load(std::memory_order_relaxed);
+            }
+            return n;
+        }
+
+    private:
+        // 用两次(rdtsc, 系统时间)算出每纳秒多少个tick 解码线程运行的过程中不断用更长的间隔修正
+        void calibrate()
+        {
+            baseTicks_ = tracelog::ticks();
+            baseNanos_ = realtimeNanos();
+#if defined(__x86_64__) || defined(__i386__)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            recalibrate();
+#endif
+        }
+
+        void recalibrate()
+        {
+            int64_t elapsed = realtimeNanos() - baseNanos_;
+            uint64_t ticks = tracelog::ticks();
+            if (elapsed > 0 && ticks > baseTicks_)
+            {
+                ticksPerNano_ = static_cast<double>(ticks - baseTicks_) / elapsed;
+            }
+        }
+
+        void threadFunc()
+        {
+            while (true)
+            {
+                long request;
+                bool running;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    if (running_ && flushRequested_ == flushDone_)
+                    {
+                        cond_.wait_for(lock, std::chrono::milliseconds(intervalMs_));
+                    }
+                    request = flushRequested_;
+                    running = running_;
+                }
+#if defined(__x86_64__) || defined(__i386__)
+                recalibrate();
+#endif
+                drainAll();
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    flushDone_ = request;
+                }
+                flushCond_.notify_all();
+                if (!running)
+                {
+                    break;
+                }
+            }
+        }
+
+        void drainAll()
+        {
+            std::vector<std::shared_ptr<TraceRing>> rings;
+            {
+                std::lock_guard<std::mutex> lock(ringsMutex_);
+                rings = rings_;
+            }
+            for (const std::shared_ptr<TraceRing> &ring : rings)
+            {
+                int tid = ring->tid();
+                ring->consume([this, tid](const TraceRecord *rec) { render(tid, rec); });
+            }
+
+            // 退出的线程 缓冲区已经读完了就释放
+            {
+                std::lock_guard<std::mutex> lock(ringsMutex_);
+                for (auto it = rings_.begin(); it != rings_.end();)
+                {
+                    if ((*it)->retired.load(std::memory_order_acquire) && (*it)->empty())
+                    {
+                        droppedRetired_ += (*it)->dropped.load(std::memory_order_relaxed);
+                        it = rings_.erase(it);
+                    }
+                    else
+                    {
+                        ++it;
+                    }
+                }
+            }
+
+            long dropped = this->dropped();
+            if (dropped > droppedReported_)
+            {
+                char buf[128];
+                int n = snprintf(buf, sizeof buf, "[TRACE]dropped %ld records, ring buffers were full\n", dropped - droppedReported_);
+                out_.append(buf, n);
+                droppedReported_ = dropped;
+            }
+            writeOut();
+        }
+
+        void render(int tid, const TraceRecord *rec)
+        {
+            SiteInfo *info = rec->siteId < static_cast<uint32_t>(kMaxSites) ? sites_[rec->siteId] : nullptr;
+            if (info == nullptr)
+            {
+                return;
+            }
+
+            int64_t nanos = baseNanos_ + static_cast<int64_t>((static_cast<double>(rec->ticks) - static_cast<double>(baseTicks_)) / ticksPerNano_);
+            time_t seconds = static_cast<time_t>(nanos / 1000000000);
+            if (seconds != cachedSecond_)
+            {
+                struct tm tm_time;
+                localtime_r(&seconds, &tm_time);
+                snprintf(cachedTime_, sizeof cachedTime_, "%4d/%02d/%02d %02d:%02d:%02d",
+                         tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+                         tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+                cachedSecond_ = seconds;
+            }
+            char prefix[128];
+            int n = snprintf(prefix, sizeof prefix, "[TRACE]%s.%06d %d %s:%d:", cachedTime_,
+                             static_cast<int>(nanos % 1000000000 / 1000), tid, info->file, info->line);
+            out_.append(prefix, n);
+
+            const char *p = reinterpret_cast<const char *>(rec) + sizeof(TraceRecord);
+            for (size_t i = 0; i < info->types.size(); ++i)
+            {
+                const char *fragment = info->fragments[i].c_str();
+                uint64_t raw;
+                memcpy(&raw, p, 8);
+                p += 8;
+                switch (info->types[i])
+                {
+                case tracelog::kInt32:
+                    appendFormat(&out_, fragment, static_cast<int>(raw));
+                    break;
+                case tracelog::kUInt32:
+                    appendFormat(&out_, fragment, static_cast<unsigned>(raw));
+                    break;
+                case tracelog::kInt64:
+                    appendFormat(&out_, fragment, static_cast<long long>(raw));
+                    break;
+                case tracelog::kUInt64:
+                    appendFormat(&out_, fragment, static_cast<unsigned long long>(raw));
+                    break;
+                case tracelog::kDouble:
+                {
+                    double d;
+                    memcpy(&d, &raw, 8);
+                    appendFormat(&out_, fragment, d);
+                    break;
+                }
+                case tracelog::kPointer:
+                    appendFormat(&out_, fragment, reinterpret_cast<void *>(static_cast<uintptr_t>(raw)));
+                    break;
+                case tracelog::kString:
+                {
+                    std::string s(p, raw); // raw是字符串长度
+                    p += (raw + 7) & ~static_cast<uint64_t>(7);
+                    appendFormat(&out_, fragment, s.c_str());
+                    break;
+                }
+                default:
+                    break;
+                }
+            }
+            // 最后一段普通文字里面可能有%%
+            appendFormat(&out_, info->tail.c_str(), 0);
+            out_ += '\n';
+            if (out_.size() >= kOutputChunk)
+            {
+                writeOut();
+            }
+        }
+
+        void writeOut()
+        {
+            if (out_.empty())
+            {
+                return;
+            }
+            if (output_)
+            {
+                output_(out_.data(), out_.size());
+            }
+            else
+            {
+                fwrite(out_.data(), 1, out_.size(), stdout);
+            }
+            out_.clear();
+        }
+
+        std::mutex sitesMutex_;
+        std::mutex ringsMutex_;
+        size_t ringSize_;
+        int intervalMs_;
+        int numSites_;
+        SiteInfo *sites_[kMaxSites]; // 下标是调用点编号 登记以后不会再改 解码线程不加锁读
+
+        std::vector<std::shared_ptr<TraceRing>> rings_;
+
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        std::condition_variable flushCond_;
+        bool running_;
+        long flushRequested_;
+        long flushDone_;
+        std::unique_ptr<Thread> thread_;
+        TraceLog::OutputFunc output_;
+
+        // 下面的只有解码线程访问
+        long droppedRetired_;
+        long droppedReported_;
+        uint64_t baseTicks_;
+        int64_t baseNanos_;
+        double ticksPerNano_;
+        time_t cachedSecond_;
+        char cachedTime_[64];
+        std::string out_;
+    };
+
+    // 故意不释放: 没有调用stop的时候解码线程在exit的时候还在跑 静态对象析构了它就在用已经释放的锁和缓冲区
+    TraceDecoder &decoder()
+    {
+        static TraceDecoder *d = new TraceDecoder;
+        return *d;
+    }
+}
+
+void TraceLog::start(const OutputFunc &output, int intervalMs)
+{
+    if (decoder().start(output, intervalMs))
+    {
+        enabled_.store(true, std::memory_order_relaxed);
+    }
+}
+
+void TraceLog::stop()
+{
+    enabled_.store(false, std::memory_order_relaxed);
+    decoder().stop();
+}
+
+void TraceLog::flush()
+{
+    decoder().flush();
+}
+
+void TraceLog::setRingSize(size_t bytes)
+{
+    decoder().setRingSize(bytes);
+}
+
+long TraceLog::dropped()
+{
+    return decoder().dropped();
+}
+
+int TraceLog::registerSite(TraceSite *site, const uint8_t *types, int numArgs)
+{
+    return decoder().registerSite(site, types, numArgs);
+}
+
+TraceRing *TraceLog::createRing()
+{
+    t_ring = decoder().createRing();
+    return t_ring;
+}
@@ -0,0 +1,279 @@
+#pragma once
+#include "noncopyable.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * 热路径上的二进制追踪日志(NanoLog的做法) 给EventLoop::loop TcpConnection::handleRead这种每个事件都要打的日志用
+ * LOG_TRACE不做snprintf: 格式串在每个调用点是一个静态的TraceSite 第一次执行的时候登记一次(连同编译期推导出来的参数类型)
+ * 之后每次只把 调用点编号 + 时间戳(rdtsc) + 原始参数(整数 指针 double 短字符串) 拷贝到本线程自己的无锁环形缓冲区
+ * 后台解码线程按登记的格式串把记录渲染成文本 交给输出函数(默认stdout 也可以是AsyncLogging::append)
+ * 环形缓冲区满了不等待 直接丢掉这一条并计数  没有start的时候LOG_TRACE只是一次relaxed的原子读
+ *
+ * 限制: 参数只能是整数 枚举 浮点数 指针 C字符串(最多拷贝kMaxStringLen个字节) 格式串里面不能用*宽度
+ *       登记的时候检查每个转换说明(包括长度修饰符 %d对int64_t不行 要%ld)和参数类型 对不上的调用点报一次错以后不再记录
+ *       exit之前没有stop的话 还没解码的记录就丢了
+ *
+ * 用法:
+ *   TraceLog::start(std::bind(&AsyncLogging::append, &log, _1, _2));
+ *   LOG_TRACE("fd=%d read %ld bytes", fd, n);
+ */
+#define LOG_TRACE(logmsgFormat, ...)\
+do \
+{  \
+    if (TraceLog::enabled())\
+    {  \
+        if (0) TraceLog::checkFormat(logmsgFormat, ##__VA_ARGS__);\
+        static TraceSite traceSite = {__FILE__, __LINE__, logmsgFormat, {0}};\
+        TraceLog::record(&traceSite, ##__VA_ARGS__);\
+    }  \
+}while(0)
+
+// 一个LOG_TRACE调用点 常量初始化 id在第一次执行的时候分配 格式串和参数对不上的是-1
+struct TraceSite
+{
+    const char *file;
+    int line;
+    const char *format;
+    std::atomic<int> id;
+};
+
+// 每条记录的头部 后面跟着按8字节对齐的参数  size为0表示环形缓冲区在这里绕回开头
+struct TraceRecord
+{
+    uint32_t size;
+    uint32_t siteId;
+    uint64_t ticks;
+};
+
+// 单生产者(写日志的线程)单消费者(解码线程)的环形缓冲区 位置是一直递增的64位数
+class TraceRing : noncopyable
+{
+public:
+    TraceRing(size_t capacity, int tid);
+    ~TraceRing();
+
+    // 生产者: 申请size字节(8的倍数) 空间不够返回空  写完以后commit
+    char *reserve(size_t size)
+    {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        size_t offset = head & mask_;
+        size_t contiguous = capacity_ - offset;
+        size_t need = contiguous < size ? contiguous + size : size;
+        if (head + need - cachedTail_ > capacity_)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head + need - cachedTail_ > capacity_)
+            {
+                return nullptr;
+            }
+        }
+        if (contiguous < size)
+        {
+            // 剩下的空间放不下 写一个绕回标记 从头开始
+            reinterpret_cast<TraceRecord *>(buffer_ + offset)->size = 0;
+            head += contiguous;
+            offset = 0;
+        }
+        pendingHead_ = head + size;
+        return buffer_ + offset;
+    }
+    void commit() { head_.store(pendingHead_, std::memory_order_release); }
+
+    // 消费者: 把已经提交的记录依次交给func 返回处理了多少条
+    size_t consume(const std::function<void(const TraceRecord *)> &func);
+    bool empty() const { return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire); }
+
+    int tid() const { return tid_; }
+    std::atomic<long> dropped;
+    std::atomic_bool retired; // 线程已经退出 解码线程读完以后就可以释放
+
+private:
+    const size_t capacity_;
+    const size_t mask_;
+    const int tid_;
+    char *buffer_;
+    // 生产者和消费者各自写的变量放在不同的cache line
+    // 用填充隔开而不是alignas(64): TraceRing是make_shared出来的 C++17之前不保证超过max_align_t的对齐
+    char padHead_[64];
+    std::atomic<uint64_t> head_;
+    uint64_t pendingHead_;
+    uint64_t cachedTail_;
+    char padTail_[64];
+    std::atomic<uint64_t> tail_;
+    char padAfter_[64];
+};
+
+namespace tracelog
+{
+    enum ArgType : uint8_t
+    {
+        kUnknown,
+        kInt32,
+        kUInt32,
+        kInt64,
+        kUInt64,
+        kDouble,
+        kPointer,
+        kString,
+    };
+
+    static const size_t kMaxStringLen = 255;
+
+    // 编译期推导参数类型
+    template <typename T>
+    struct ArgTraits
+    {
+        typedef typename std::decay<T>::type Type;
+        static const uint8_t kType =
+            std::is_floating_point<Type>::value ? kDouble
+            : (std::is_same<Type, char *>::value || std::is_same<Type, const char *>::value) ? kString
+            : std::is_pointer<Type>::value ? kPointer
+            : std::is_enum<Type>::value ? kInt32
+            : !std::is_integral<Type>::value ? kUnknown
+            : sizeof(Type) > 4 ? (std::is_signed<Type>::value ? kInt64 : kUInt64)
+            : (std::is_signed<Type>::value ? kInt32 : kUInt32);
+    };
+
+    inline size_t stringLen(const char *s)
+    {
+        return s ? strnlen(s, kMaxStringLen) : 0;
+    }
+
+    // 每个参数在记录里面占的字节数 字符串是8字节长度加上内容 都按8字节对齐
+    template <typename T>
+    inline size_t argSize(const T &) { return 8; }
+    inline size_t argSize(const char *s) { return 8 + ((stringLen(s) + 7) & ~static_cast<size_t>(7)); }
+    inline size_t argSize(char *s) { return argSize(static_cast<const char *>(s)); }
+
+    inline size_t argsSize() { return 0; }
+    template <typename T, typename... Args>
+    inline size_t argsSize(const T &first, const Args &...rest) { return argSize(first) + argsSize(rest...); }
+
+    template <typename T>
+    inline void encodeArg(char *&p, const T &v, std::integral_constant<int, kDouble>)
+    {
+        double d = static_cast<double>(v);
+        memcpy(p, &d, 8);
+        p += 8;
+    }
+    template <typename T>
+    inline void encodeArg(char *&p, const T &v, std::integral_constant<int, kPointer>)
+    {
+        uint64_t x = reinterpret_cast<uintptr_t>(v);
+        memcpy(p, &x, 8);
+        p += 8;
+    }
+    template <typename T>
+    inline void encodeArg(char *&p, const T &v, std::integral_constant<int, kString>)
+    {
+        const char *s = v;
+        uint64_t len = stringLen(s);
+        memcpy(p, &len, 8);
+        if (len > 0)
+        {
+            memcpy(p + 8, s, len);
+        }
+        p += 8 + ((len + 7) & ~static_cast<uint64_t>(7));
+    }
+    template <typename T, int kType>
+    inline void encodeArg(char *&p, const T &v, std::integral_constant<int, kType>)
+    {
+        // 整数和枚举 统一按64位存 解码的时候按类型转回去
+        int64_t x = static_cast<int64_t>(v);
+        memcpy(p, &x, 8);
+        p += 8;
+    }
+
+    inline void encodeArgs(char *&) {}
+    template <typename T, typename... Args>
+    inline void encodeArgs(char *&p, const T &first, const Args &...rest)
+    {
+        static_assert(ArgTraits<T>::kType != kUnknown, "LOG_TRACE only supports integers, floats, pointers and C strings");
+        encodeArg(p, first, std::integral_constant<int, ArgTraits<T>::kType>());
+        encodeArgs(p, rest...);
+    }
+
+    inline uint64_t ticks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __builtin_ia32_rdtsc();
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+    }
+}
+
+class TraceLog : noncopyable
+{
+public:
+    using OutputFunc = std::function<void(const char *msg, size_t len)>;
+
+    // 开启追踪 启动解码线程 每intervalMs毫秒把所有线程的环形缓冲区读一遍  output为空的时候写到stdout
+    static void start(const OutputFunc &output = OutputFunc(), int intervalMs = 10);
+    // 关闭追踪 把已经写进去的记录解码完再返回 要在output用到的对象析构之前调用
+    static void stop();
+    // 等待调用之前本线程写的记录全部交给output
+    static void flush();
+    // 每个线程环形缓冲区的大小(2的幂) 只影响之后第一次写追踪日志的线程 默认1MB
+    static void setRingSize(size_t bytes);
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+    // 因为缓冲区满了丢掉的记录数
+    static long dropped();
+
+    template <typename... Args>
+    static void record(TraceSite *site, const Args &...args)
+    {
+        int id = site->id.load(std::memory_order_acquire);
+        if (__builtin_expect(id <= 0, 0))
+        {
+            if (id < 0)
+            {
+                return;
+            }
+            static const uint8_t types[] = {tracelog::ArgTraits<Args>::kType..., tracelog::kUnknown};
+            id = registerSite(site, types, sizeof...(Args));
+            if (id < 0)
+            {
+                return;
+            }
+        }
+        TraceRing *ring = t_ring;
+        if (__builtin_expect(ring == nullptr, 0))
+        {
+            ring = createRing();
+        }
+        size_t size = sizeof(TraceRecord) + tracelog::argsSize(args...);
+        char *p = ring->reserve(size);
+        if (__builtin_expect(p == nullptr, 0))
+        {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        TraceRecord *rec = reinterpret_cast<TraceRecord *>(p);
+        rec->size = static_cast<uint32_t>(size);
+        rec->siteId = static_cast<uint32_t>(id);
+        rec->ticks = tracelog::ticks();
+        p += sizeof(TraceRecord);
+        tracelog::encodeArgs(p, args...);
+        ring->commit();
+    }
+
+    // 只用来让编译器按printf检查LOG_TRACE的格式串和参数(需要-Wformat) 从来不会被调用
+    __attribute__((format(printf, 1, 2))) static void checkFormat(const char *, ...) {}
+
+private:
+    static int registerSite(TraceSite *site, const uint8_t *types, int numArgs);
+    static TraceRing *createRing();
+
+    static std::atomic_bool enabled_;
+    static __thread TraceRing *t_ring;
+};
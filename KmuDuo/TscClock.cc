@@ -0,0 +1,124 @@
+#include "TscClock.h"
+#include <mutex>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+std::atomic<const TscClock::Params *> TscClock::params_(nullptr);
+const bool TscClock::invariant_ = TscClock::invariantTsc();
+
+namespace
+{
+    std::mutex g_calibrateMutex;
+
+    // 取一对尽量同时的(tsc, 单调时钟) 前后两次rdtsc夹住clock_gettime 取间隔最小的那一次
+    void samplePair(uint64_t *ticks, int64_t *nanos)
+    {
+        uint64_t best = ~static_cast<uint64_t>(0);
+        for (int i = 0; i < 5; ++i)
+        {
+            uint64_t t0 = TscClock::rdtsc();
+            int64_t ns = TscClock::monotonicNanos();
+            uint64_t t1 = TscClock::rdtsc();
+            if (t1 - t0 < best)
+            {
+                best = t1 - t0;
+                *ticks = t0 + (t1 - t0) / 2;
+                *nanos = ns;
+            }
+        }
+    }
+}
+
+int64_t TscClock::monotonicNanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+bool TscClock::invariantTsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned eax, ebx, ecx, edx;
+    // CPUID.80000007H:EDX[8] Invariant TSC
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+    {
+        return (edx & (1u << 8)) != 0;
+    }
+#endif
+    return false;
+}
+
+// 换参数的时候不能让nowNanos()往回跳: 用旧参数算一下新起点那一刻的值 新起点不小于它
+// 这样前面已经返回的值都不会比之后返回的大 代价是TSC走快了的那部分偏差不再收回 只会被后面的calibrate止住增长
+int64_t TscClock::clampBase(const Params *old, uint64_t baseTicks, int64_t baseNanos)
+{
+    if (old == nullptr)
+    {
+        return baseNanos;
+    }
+    int64_t oldNanos = old->baseNanos + static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(baseTicks - old->baseTicks)) * old->nanosPerTick);
+    return baseNanos < oldNanos ? oldNanos : baseNanos;
+}
+
+bool TscClock::calibrate(int calibrateMs)
+{
+    std::lock_guard<std::mutex> lock(g_calibrateMutex);
+    if (!invariantTsc())
+    {
+        return false;
+    }
+    uint64_t ticks0, ticks1;
+    int64_t nanos0, nanos1;
+    samplePair(&ticks0, &nanos0);
+    struct timespec req = {calibrateMs / 1000, (calibrateMs % 1000) * 1000000L};
+    nanosleep(&req, nullptr);
+    samplePair(&ticks1, &nanos1);
+    if (nanos1 <= nanos0 || ticks1 <= ticks0)
+    {
+        return false;
+    }
+    Params *p = new Params;
+    p->baseTicks = ticks1;
+    p->baseNanos = nanos1;
+    p->nanosPerTick = static_cast<double>(nanos1 - nanos0) / (ticks1 - ticks0);
+    p->baseNanos = clampBase(params_.load(std::memory_order_acquire), p->baseTicks, p->baseNanos);
+    params_.store(p, std::memory_order_release);
+    return true;
+}
+
+void TscClock::resync()
+{
+    std::lock_guard<std::mutex> lock(g_calibrateMutex);
+    const Params *old = params_.load(std::memory_order_acquire);
+    if (old == nullptr)
+    {
+        return;
+    }
+    Params *p = new Params(*old);
+    samplePair(&p->baseTicks, &p->baseNanos);
+    p->baseNanos = clampBase(old, p->baseTicks, p->baseNanos);
+    params_.store(p, std::memory_order_release);
+}
+
+int64_t TscClock::elapsedNanos(int64_t ticks)
+{
+    if (!invariant_)
+    {
+        return ticks; // ticks()本来就是纳秒
+    }
+    if (!available())
+    {
+        static std::once_flag once;
+        std::call_once(once, []() { TscClock::calibrate(); });
+    }
+    return ticksToNanos(ticks);
+}
+
+double TscClock::ticksPerNano()
+{
+    const Params *p = params_.load(std::memory_order_acquire);
+    return p ? 1.0 / p->nanosPerTick : 0.0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+/*
+ * 用invariant TSC(频率恒定 CPU睡眠也不停)做的单调时钟 给统计 追踪这种只要相对时间 又在每个事件上都要取时间的地方用
+ * calibrate()用CLOCK_MONOTONIC校准每个tick多少纳秒 之后nowNanos()只是一次rdtsc加一次乘法 不走vDSO
+ * CPU不支持invariant TSC(或者不是x86)的时候available()返回false nowNanos()退化成clock_gettime(CLOCK_MONOTONIC)
+ * 返回的纳秒数和CLOCK_MONOTONIC同一个起点 长时间运行会和它慢慢偏开(几个ppm) 需要的话定期调用resync()
+ * resync/calibrate不会让nowNanos()往回跳 TSC比CLOCK_MONOTONIC走得快的时候偏差只能留着 要严格对齐的地方用monotonicNanos()
+ */
+class TscClock
+{
+public:
+    // 校准 calibrateMs毫秒 可以重复调用 在用之前调用一次 线程安全
+    static bool calibrate(int calibrateMs = 20);
+    // 重新对齐起点 不重新测频率 消除累计的偏差
+    static void resync();
+
+    static bool available() { return params_.load(std::memory_order_acquire) != nullptr; }
+    // 没有校准过返回0
+    static double ticksPerNano();
+
+    static uint64_t rdtsc()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __builtin_ia32_rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    // 和CLOCK_MONOTONIC对齐的纳秒数
+    static int64_t nowNanos()
+    {
+        const Params *p = params_.load(std::memory_order_acquire);
+        if (__builtin_expect(p != nullptr, 1))
+        {
+            return p->baseNanos + static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(rdtsc() - p->baseTicks)) * p->nanosPerTick);
+        }
+        return monotonicNanos();
+    }
+    // 原始计数 有invariant TSC的时候就是rdtsc 没有的时候是CLOCK_MONOTONIC的纳秒
+    // 热路径上只记录ticks()的差 读统计的时候再用elapsedNanos统一换算
+    static uint64_t ticks() { return invariant_ ? rdtsc() : static_cast<uint64_t>(monotonicNanos()); }
+    // ticks()的差换算成纳秒 还没有校准过的话先校准一次(会阻塞calibrate的时间) 不要在io线程上第一次调用
+    static int64_t elapsedNanos(int64_t ticks);
+
+    // 两次rdtsc的差换算成纳秒 没有校准过原样返回
+    static int64_t ticksToNanos(int64_t ticks)
+    {
+        const Params *p = params_.load(std::memory_order_acquire);
+        return p ? static_cast<int64_t>(static_cast<double>(ticks) * p->nanosPerTick) : ticks;
+    }
+
+    static int64_t monotonicNanos();
+
+private:
+    // 校准的结果 每次calibrate/resync生成一份新的 原子地换上去 读的一方不会看到一半新一半旧的值
+    // 旧的不释放(只在校准的时候产生 几十个字节) 避免读者还拿着指针的时候被释放
+    struct Params
+    {
+        uint64_t baseTicks;
+        int64_t baseNanos;
+        double nanosPerTick;
+    };
+
+    static bool invariantTsc();
+    // 新参数的起点 保证换上去以后nowNanos()不会比之前返回过的值小
+    static int64_t clampBase(const Params *old, uint64_t baseTicks, int64_t baseNanos);
+
+    static std::atomic<const Params *> params_;
+    static const bool invariant_;
+};
@@ -0,0 +1,612 @@
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Channel.h"
+#include "CountDownLatch.h"
+#include "logger.h"
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+namespace
+{
+const size_t kMaxGsoSegments = 64;   // 内核一个GSO大包最多切64段(UDP_MAX_SEGMENTS)
+const size_t kMaxGsoBytes = 65000;   // 一个大包的负载不能超过一个IP包 留点余量
+const size_t kGroSlotSize = 65536;   // 打开GRO以后每个接收槽要放得下合并好的大包
+const size_t kSendControlSize = CMSG_SPACE(sizeof(uint16_t));
+const size_t kRecvControlSize = CMSG_SPACE(sizeof(int));
+}
+
+// 投递到shard的loop上的sendTo/flush拿着shared_ptr<Shard> UdpServer析构以后Shard本身还在
+// closeShard把server置空 排在后面的回调看到server为空就什么都不做
+struct UdpServer::Shard : std::enable_shared_from_this<UdpServer::Shard>
+{
+    struct Out
+    {
+        sockaddr_in peer;
+        size_t offset; // 在outData里面的位置
+        size_t len;
+    };
+
+    Shard() : server(nullptr), index(0), loop(nullptr), fd(-1), gso(false), gro(false), slotSize(0), outHead(0), flushQueued(false),
+              packetsReceived(0), bytesReceived(0), recvCalls(0), truncated(0),
+              packetsSent(0), bytesSent(0), sendCalls(0), sendDropped(0), gsoSends(0), groReceives(0) {}
+
+    UdpServer *server; // closeShard以后为空 只在shard的loop线程里面读写
+    int index;
+    EventLoop *loop;
+    int fd;
+    std::unique_ptr<Channel> channel;
+    bool gso;        // 内核支持并且打开了 发送出错(比如路由到的网卡不行)的时候会关掉
+    bool gro;
+    size_t slotSize; // 接收槽的大小 打开GRO的时候是64KB
+
+    // 接收区 batchSize个槽 每个slotSize字节 recvmmsg直接收到这里
+    std::vector<char> arena;
+    std::vector<mmsghdr> recvMsgs;
+    std::vector<iovec> recvIov;
+    std::vector<sockaddr_in> recvAddrs;
+    std::vector<char> recvControl; // 打开GRO的时候每个包一个 放UDP_GRO的段大小
+
+    // 发送队列 包的内容都拼在outData里面 发完一起清空
+    std::vector<Out> out;
+    std::string outData;
+    size_t outHead; // out里面第一个还没发出去的
+    bool flushQueued;
+    std::vector<mmsghdr> sendMsgs;
+    std::vector<iovec> sendIov;
+    std::vector<size_t> sendSegments; // sendMsgs里面每个消息包含out里面的几个包
+    std::vector<char> sendControl;    // 每个消息一个 放UDP_SEGMENT
+
+    // 只有shard的loop线程写 任意线程读
+    std::atomic<int64_t> packetsReceived;
+    std::atomic<int64_t> bytesReceived;
+    std::atomic<int64_t> recvCalls;
+    std::atomic<int64_t> truncated;
+    std::atomic<int64_t> packetsSent;
+    std::atomic<int64_t> bytesSent;
+    std::atomic<int64_t> sendCalls;
+    std::atomic<int64_t> sendDropped;
+    std::atomic<int64_t> gsoSends;
+    std::atomic<int64_t> groReceives;
+};
+
+static void defaultPacketCallback(const UdpPacket &)
+{
+}
+
+static void add(std::atomic<int64_t> &counter, int64_t n)
+{
+    counter.fetch_add(n, std::memory_order_relaxed);
+}
+
+UdpServer::Options::Options()
+    : batchSize(64),
+      maxBatchesPerEvent(4),
+      maxPacketSize(2048),
+      recvBufferBytes(0),
+      sendBufferBytes(0),
+      maxPendingBytes(4 * 1024 * 1024),
+      gso(false),
+      gro(false)
+{
+}
+
+UdpServer::Stats::Stats()
+    : packetsReceived(0), bytesReceived(0), recvCalls(0), truncated(0),
+      packetsSent(0), bytesSent(0), sendCalls(0), sendDropped(0), gsoSends(0), groReceives(0)
+{
+}
+
+std::string UdpServer::Stats::toString() const
+{
+    char buf[512];
+    snprintf(buf, sizeof buf,
+             "packets_received=%lld bytes_received=%lld recv_calls=%lld truncated=%lld "
+             "packets_sent=%lld bytes_sent=%lld send_calls=%lld send_dropped=%lld gso_sends=%lld gro_receives=%lld",
+             (long long)packetsReceived, (long long)bytesReceived, (long long)recvCalls, (long long)truncated,
+             (long long)packetsSent, (long long)bytesSent, (long long)sendCalls, (long long)sendDropped,
+             (long long)gsoSends, (long long)groReceives);
+    return buf;
+}
+
+UdpServer::UdpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg,
+                     const Options &options)
+    : loop_(loop),
+      listenAddr_(listenAddr),
+      name_(nameArg),
+      options_(options),
+      threadPool_(new EventLoopThreadPoll(loop, nameArg)),
+      packetCallback_(defaultPacketCallback),
+      started_(0)
+{
+    if (options_.batchSize <= 0 || options_.maxBatchesPerEvent <= 0 || options_.maxPacketSize == 0)
+    {
+        LOG_FATAL("UdpServer[%s] bad options batchSize:%d maxBatchesPerEvent:%d maxPacketSize:%zu\n",
+                  name_.c_str(), options_.batchSize, options_.maxBatchesPerEvent, options_.maxPacketSize);
+    }
+}
+
+UdpServer::~UdpServer()
+{
+    for (auto &item : shards_)
+    {
+        Shard *shard = item.get();
+        if (shard->loop->isInLoopThread())
+        {
+            closeShard(shard);
+        }
+        else
+        {
+            CountDownLatch latch(1);
+            shard->loop->runInLoop([this, shard, &latch]() {
+                closeShard(shard);
+                latch.countDown();
+            });
+            latch.wait();
+        }
+    }
+}
+
+void UdpServer::setThreadNum(int numThreads)
+{
+    threadPool_->setThreadNum(numThreads);
+}
+
+void UdpServer::start()
+{
+    if (started_++ != 0)
+    {
+        return;
+    }
+    threadPool_->start(threadInitCallback_);
+    std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+
+    // 所有socket先在这里建好并且绑定 再到各自的loop上注册 绑定失败是配置错误
+    for (size_t i = 0; i < loops.size(); i++)
+    {
+        std::shared_ptr<Shard> shard(new Shard);
+        shard->server = this;
+        shard->index = static_cast<int>(i);
+        shard->loop = loops[i];
+        shard->fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+        if (shard->fd < 0)
+        {
+            LOG_FATAL("%s:%s:%d udp sockfd create err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+        }
+        int one = 1;
+        ::setsockopt(shard->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+        ::setsockopt(shard->fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof one);
+        if (options_.recvBufferBytes > 0)
+        {
+            ::setsockopt(shard->fd, SOL_SOCKET, SO_RCVBUF, &options_.recvBufferBytes, sizeof options_.recvBufferBytes);
+        }
+        if (options_.sendBufferBytes > 0)
+        {
+            ::setsockopt(shard->fd, SOL_SOCKET, SO_SNDBUF, &options_.sendBufferBytes, sizeof options_.sendBufferBytes);
+        }
+        if (::bind(shard->fd, (const sockaddr *)listenAddr_.getSockAddr(), sizeof(sockaddr_in)) != 0)
+        {
+            LOG_FATAL("UdpServer[%s] bind %s fail err:%d\n", name_.c_str(), listenAddr_.toIpPort().c_str(), errno);
+        }
+        shards_.push_back(std::move(shard));
+    }
+    for (auto &shard : shards_)
+    {
+        shard->loop->runInLoop(std::bind(&UdpServer::startShard, this, shard.get()));
+    }
+    LOG_INFO("UdpServer[%s] listening on %s with %zu socket(s)\n", name_.c_str(), listenAddr_.toIpPort().c_str(), shards_.size());
+}
+
+// 在shard的loop线程里面 准备好接收区 注册Channel
+// GSO/GRO内核不支持的时候(4.18/5.0以前)只打一条日志 照常收发
+void UdpServer::startShard(Shard *shard)
+{
+    size_t batch = static_cast<size_t>(options_.batchSize);
+    if (batch > 1 && options_.gso)
+    {
+        int segment = 0;
+        socklen_t len = sizeof segment;
+        shard->gso = ::getsockopt(shard->fd, SOL_UDP, UDP_SEGMENT, &segment, &len) == 0;
+        if (!shard->gso)
+        {
+            LOG_INFO("UdpServer[%s] UDP_SEGMENT not supported err:%d\n", name_.c_str(), errno);
+        }
+    }
+    if (batch > 1 && options_.gro)
+    {
+        int one = 1;
+        shard->gro = ::setsockopt(shard->fd, SOL_UDP, UDP_GRO, &one, sizeof one) == 0;
+        if (!shard->gro)
+        {
+            LOG_INFO("UdpServer[%s] UDP_GRO not supported err:%d\n", name_.c_str(), errno);
+        }
+    }
+    shard->slotSize = shard->gro ? std::max(options_.maxPacketSize, kGroSlotSize) : options_.maxPacketSize;
+
+    shard->arena.resize(batch * shard->slotSize);
+    shard->recvMsgs.resize(batch);
+    shard->recvIov.resize(batch);
+    shard->recvAddrs.resize(batch);
+    if (shard->gro)
+    {
+        shard->recvControl.resize(batch * kRecvControlSize);
+    }
+    memset(shard->recvMsgs.data(), 0, batch * sizeof(mmsghdr));
+    for (size_t i = 0; i < batch; i++)
+    {
+        shard->recvIov[i].iov_base = shard->arena.data() + i * shard->slotSize;
+        shard->recvIov[i].iov_len = shard->slotSize;
+        shard->recvMsgs[i].msg_hdr.msg_iov = &shard->recvIov[i];
+        shard->recvMsgs[i].msg_hdr.msg_iovlen = 1;
+        shard->recvMsgs[i].msg_hdr.msg_name = &shard->recvAddrs[i];
+        if (shard->gro)
+        {
+            shard->recvMsgs[i].msg_hdr.msg_control = shard->recvControl.data() + i * kRecvControlSize;
+        }
+    }
+    shard->sendMsgs.resize(batch);
+    shard->sendIov.resize(batch);
+    shard->sendSegments.resize(batch);
+    if (shard->gso)
+    {
+        shard->sendControl.resize(batch * kSendControlSize);
+    }
+
+    shard->channel.reset(new Channel(shard->loop, shard->fd));
+    shard->channel->setReadcallback(std::bind(&UdpServer::handleRead, this, shard, std::placeholders::_1));
+    shard->channel->setWritecallback(std::bind(&UdpServer::handleWrite, this, shard));
+    shard->channel->enableReading();
+}
+
+void UdpServer::handleRead(Shard *shard, Timestamp receiveTime)
+{
+    if (options_.batchSize == 1)
+    {
+        receiveOne(shard, receiveTime);
+    }
+    else
+    {
+        receiveBatches(shard, receiveTime);
+    }
+}
+
+void UdpServer::receiveBatches(Shard *shard, Timestamp receiveTime)
+{
+    const unsigned batch = static_cast<unsigned>(options_.batchSize);
+    for (int b = 0; b < options_.maxBatchesPerEvent; b++)
+    {
+        // recvmmsg会改msg_namelen和msg_controllen 每次都要恢复
+        for (unsigned i = 0; i < batch; i++)
+        {
+            shard->recvMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            if (shard->gro)
+            {
+                shard->recvMsgs[i].msg_hdr.msg_controllen = kRecvControlSize;
+            }
+        }
+        int n = ::recvmmsg(shard->fd, shard->recvMsgs.data(), batch, MSG_DONTWAIT, nullptr);
+        if (n <= 0)
+        {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_ERROR("UdpServer::receiveBatches[%s] recvmmsg err:%d\n", name_.c_str(), errno);
+            }
+            return;
+        }
+        add(shard->recvCalls, 1);
+        int64_t packets = 0, bytes = 0;
+        for (int i = 0; i < n; i++)
+        {
+            const mmsghdr &msg = shard->recvMsgs[i];
+            if (msg.msg_hdr.msg_flags & MSG_TRUNC)
+            {
+                add(shard->truncated, 1);
+                continue;
+            }
+            int segmentSize = 0;
+            if (shard->gro)
+            {
+                msghdr *hdr = const_cast<msghdr *>(&msg.msg_hdr);
+                for (cmsghdr *cmsg = CMSG_FIRSTHDR(hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(hdr, cmsg))
+                {
+                    if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+                    {
+                        memcpy(&segmentSize, CMSG_DATA(cmsg), sizeof segmentSize);
+                    }
+                }
+            }
+            packets += deliver(shard, shard->arena.data() + i * shard->slotSize, msg.msg_len, segmentSize,
+                               shard->recvAddrs[i], receiveTime);
+            bytes += msg.msg_len;
+        }
+        add(shard->packetsReceived, packets);
+        add(shard->bytesReceived, bytes);
+        if (static_cast<unsigned>(n) < batch) // 已经收空了
+        {
+            return;
+        }
+    }
+}
+
+// GRO合并过的大包按segmentSize切开 每段是发送端的一个数据报 最后一段可能短一点
+int UdpServer::deliver(Shard *shard, const char *data, size_t len, int segmentSize, const sockaddr_in &peer,
+                       Timestamp receiveTime)
+{
+    InetAddress from(peer);
+    if (segmentSize <= 0 || len <= static_cast<size_t>(segmentSize))
+    {
+        if (len > options_.maxPacketSize) // 打开GRO以后槽比maxPacketSize大 单个的大包在这里丢
+        {
+            add(shard->truncated, 1);
+            return 0;
+        }
+        UdpPacket packet = {data, len, from, receiveTime, shard->index};
+        packetCallback_(packet);
+        return 1;
+    }
+    add(shard->groReceives, 1);
+    int packets = 0;
+    for (size_t offset = 0; offset < len; offset += segmentSize)
+    {
+        UdpPacket packet = {data + offset, std::min(static_cast<size_t>(segmentSize), len - offset), from,
+                            receiveTime, shard->index};
+        packetCallback_(packet);
+        packets++;
+    }
+    return packets;
+}
+
+// 基线: 一次事件一个recvfrom
+void UdpServer::receiveOne(Shard *shard, Timestamp receiveTime)
+{
+    sockaddr_in peer;
+    socklen_t len = sizeof peer;
+    ssize_t n = ::recvfrom(shard->fd, shard->arena.data(), options_.maxPacketSize, MSG_DONTWAIT | MSG_TRUNC,
+                           (sockaddr *)&peer, &len);
+    if (n < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            LOG_ERROR("UdpServer::receiveOne[%s] recvfrom err:%d\n", name_.c_str(), errno);
+        }
+        return;
+    }
+    add(shard->recvCalls, 1);
+    if (static_cast<size_t>(n) > options_.maxPacketSize)
+    {
+        add(shard->truncated, 1);
+        return;
+    }
+    add(shard->packetsReceived, 1);
+    add(shard->bytesReceived, n);
+    UdpPacket packet = {shard->arena.data(), static_cast<size_t>(n), InetAddress(peer), receiveTime, shard->index};
+    packetCallback_(packet);
+}
+
+void UdpServer::reply(const UdpPacket &packet, const void *data, size_t len)
+{
+    enqueue(shards_[packet.shard].get(), *packet.peer.getSockAddr(), data, len);
+}
+
+void UdpServer::sendTo(int shard, const InetAddress &peer, const void *data, size_t len)
+{
+    std::shared_ptr<Shard> s = shards_[shard];
+    if (s->loop->isInLoopThread())
+    {
+        enqueue(s.get(), *peer.getSockAddr(), data, len);
+    }
+    else
+    {
+        std::string copy(static_cast<const char *>(data), len);
+        s->loop->queueLoop([s, peer, copy]() {
+            if (s->server)
+            {
+                s->server->enqueue(s.get(), *peer.getSockAddr(), copy.data(), copy.size());
+            }
+        });
+    }
+}
+
+void UdpServer::enqueue(Shard *shard, const sockaddr_in &peer, const void *data, size_t len)
+{
+    if (options_.batchSize == 1 && shard->out.empty())
+    {
+        // 基线: 一个包一个sendto 发不出去就丢
+        ssize_t n = ::sendto(shard->fd, data, len, MSG_DONTWAIT, (const sockaddr *)&peer, sizeof peer);
+        add(shard->sendCalls, 1);
+        if (n < 0)
+        {
+            add(shard->sendDropped, 1);
+            return;
+        }
+        add(shard->packetsSent, 1);
+        add(shard->bytesSent, n);
+        return;
+    }
+    if (shard->outData.size() + len > options_.maxPendingBytes)
+    {
+        add(shard->sendDropped, 1);
+        return;
+    }
+    Shard::Out out = {peer, shard->outData.size(), len};
+    shard->out.push_back(out);
+    shard->outData.append(static_cast<const char *>(data), len);
+    // 这一轮loop里面第一个要发的包 排一个flush到这一轮事件处理完以后 等着可写的时候不用排
+    if (!shard->flushQueued && !shard->channel->isWriting())
+    {
+        shard->flushQueued = true;
+        std::shared_ptr<Shard> guard(shard->shared_from_this());
+        shard->loop->queueLoop([guard]() {
+            if (guard->server)
+            {
+                guard->server->flush(guard.get());
+            }
+        });
+    }
+}
+
+void UdpServer::flush(Shard *shard)
+{
+    shard->flushQueued = false;
+    const size_t batch = static_cast<size_t>(options_.batchSize);
+    while (shard->outHead < shard->out.size())
+    {
+        // 一个消息一个包 打开GSO的时候一个消息是out里面连续几个发给同一个peer的包
+        // 它们在outData里面本来就挨着 一个iovec就够了
+        size_t n = 0;
+        size_t next = shard->outHead;
+        while (n < batch && next < shard->out.size())
+        {
+            Shard::Out &first = shard->out[next];
+            size_t segments = 1;
+            size_t bytes = first.len;
+            if (shard->gso)
+            {
+                while (next + segments < shard->out.size() && segments < kMaxGsoSegments)
+                {
+                    const Shard::Out &o = shard->out[next + segments];
+                    // 除了最后一段 每段都要和第一段一样长
+                    if (o.len > first.len || o.len == 0 || bytes + o.len > kMaxGsoBytes ||
+                        o.peer.sin_port != first.peer.sin_port || o.peer.sin_addr.s_addr != first.peer.sin_addr.s_addr)
+                    {
+                        break;
+                    }
+                    segments++;
+                    bytes += o.len;
+                    if (o.len < first.len)
+                    {
+                        break;
+                    }
+                }
+            }
+            shard->sendIov[n].iov_base = &shard->outData[first.offset];
+            shard->sendIov[n].iov_len = bytes;
+            msghdr &hdr = shard->sendMsgs[n].msg_hdr;
+            memset(&hdr, 0, sizeof hdr);
+            hdr.msg_name = &first.peer;
+            hdr.msg_namelen = sizeof first.peer;
+            hdr.msg_iov = &shard->sendIov[n];
+            hdr.msg_iovlen = 1;
+            if (segments > 1)
+            {
+                hdr.msg_control = shard->sendControl.data() + n * kSendControlSize;
+                hdr.msg_controllen = kSendControlSize;
+                cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t segmentSize = static_cast<uint16_t>(first.len);
+                memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof segmentSize);
+            }
+            shard->sendSegments[n] = segments;
+            next += segments;
+            n++;
+        }
+        int sent = ::sendmmsg(shard->fd, shard->sendMsgs.data(), static_cast<unsigned>(n), 0);
+        add(shard->sendCalls, 1);
+        if (sent > 0)
+        {
+            int64_t packets = 0, bytes = 0, gsoSends = 0;
+            for (int i = 0; i < sent; i++)
+            {
+                packets += shard->sendSegments[i];
+                bytes += shard->sendIov[i].iov_len;
+                gsoSends += shard->sendSegments[i] > 1 ? 1 : 0;
+            }
+            shard->outHead += packets;
+            add(shard->packetsSent, packets);
+            add(shard->bytesSent, bytes);
+            add(shard->gsoSends, gsoSends);
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            // 发送缓冲区满了 等可写
+            if (!shard->channel->isWriting())
+            {
+                shard->channel->enableWriting();
+            }
+            return;
+        }
+        else if (shard->sendSegments[0] > 1 && (errno == EIO || errno == EINVAL))
+        {
+            // 出口网卡不支持校验和卸载的时候GSO会报EIO 关掉GSO 一个包一个包重发
+            LOG_INFO("UdpServer::flush[%s] disable gso err:%d\n", name_.c_str(), errno);
+            shard->gso = false;
+        }
+        else if (errno != EINTR)
+        {
+            // 第一个包就出错(比如太大) 丢掉它 接着发后面的
+            add(shard->sendDropped, static_cast<int64_t>(shard->sendSegments[0]));
+            shard->outHead += shard->sendSegments[0];
+        }
+    }
+    shard->out.clear();
+    shard->outData.clear();
+    shard->outHead = 0;
+    if (shard->channel->isWriting())
+    {
+        shard->channel->disableWriting();
+    }
+}
+
+void UdpServer::handleWrite(Shard *shard)
+{
+    flush(shard);
+}
+
+void UdpServer::closeShard(Shard *shard)
+{
+    // 还攒着没发的包最后发一次 发不出去的算丢掉
+    if (shard->channel && shard->outHead < shard->out.size())
+    {
+        flush(shard);
+        for (size_t i = shard->outHead; i < shard->out.size(); i++)
+        {
+            add(shard->sendDropped, 1);
+        }
+        shard->out.clear();
+        shard->outData.clear();
+        shard->outHead = 0;
+    }
+    shard->server = nullptr; // 排在后面的flush/sendTo不会再用这个shard
+    if (shard->channel)
+    {
+        shard->channel->disableAll();
+        shard->channel->remove();
+        shard->channel.reset();
+    }
+    ::close(shard->fd);
+    shard->fd = -1;
+}
+
+UdpServer::Stats UdpServer::stats() const
+{
+    Stats s;
+    for (auto &shard : shards_)
+    {
+        s.packetsReceived += shard->packetsReceived.load(std::memory_order_relaxed);
+        s.bytesReceived += shard->bytesReceived.load(std::memory_order_relaxed);
+        s.recvCalls += shard->recvCalls.load(std::memory_order_relaxed);
+        s.truncated += shard->truncated.load(std::memory_order_relaxed);
+        s.packetsSent += shard->packetsSent.load(std::memory_order_relaxed);
+        s.bytesSent += shard->bytesSent.load(std::memory_order_relaxed);
+        s.sendCalls += shard->sendCalls.load(std::memory_order_relaxed);
+        s.sendDropped += shard->sendDropped.load(std::memory_order_relaxed);
+        s.gsoSends += shard->gsoSends.load(std::memory_order_relaxed);
+        s.groReceives += shard->groReceives.load(std::memory_order_relaxed);
+    }
+    return s;
+}
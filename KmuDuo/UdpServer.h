@@ -0,0 +1,127 @@
+#pragma once
+#include "noncopyable.h"
+#include "inetAddress.h"
+#include "Timestamp.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class EventLoop;
+class EventLoopThreadPoll;
+
+// 收到的一个数据报 data指向接收区 只在回调里面有效 要留着就拷贝一份
+struct UdpPacket
+{
+    const char *data;
+    size_t len;
+    InetAddress peer;
+    Timestamp receiveTime;
+    int shard; // 哪个socket收到的 reply从同一个socket(同一个loop)发回去
+};
+
+/*
+ * UDP服务器 收遥测之类的高包量数据
+ *
+ * 每个io loop一个数据报socket 都用SO_REUSEPORT绑同一个地址 内核按四元组把包分到各个socket(shard)上
+ * 没有subloop的时候只在baseloop上开一个socket
+ *
+ * 接收: socket可读的时候用recvmmsg一次最多收batchSize个包 收到预先分配好的接收区里面(每个包一个maxPacketSize的槽)
+ *   一次可读事件最多收maxBatchesPerEvent批 剩下的等下一轮(水平触发) 不让一个socket占住loop
+ *   超过maxPacketSize被截断的包丢掉 记在truncated里面
+ * 发送: reply/sendTo先攒在shard的发送队列里 这一轮loop的事件处理完以后用sendmmsg一起发
+ *   发送缓冲区满(EAGAIN)就关注可写 可写了再接着发 队列超过maxPendingBytes以后新的包直接丢掉(UDP本来就可以丢)
+ * batchSize为1的时候退化成一次事件一个recvfrom 一个包一个sendto 作为对比的基线
+ *
+ * GSO/GRO(可选 内核不支持的时候自动关掉 loopback上也能用):
+ *   gso: 发送队列里面连续的 发给同一个peer的 一样长的包(最后一个可以短一点)本来就在outData里面挨着
+ *        合成一个最多64段 不超过64KB的大包 带UDP_SEGMENT一次交给内核 内核(或者网卡)再切成一个个数据报
+ *   gro: 打开UDP_GRO 内核把同一个流连续的包合成一个大包交上来 cmsg里面带着每段的大小 这里按段切开
+ *        一个一个交给PacketCallback 接收区每个槽要放得下64KB 每个shard多占batchSize*64KB的内存
+ *   batchSize为1的基线不用GSO/GRO
+ */
+class UdpServer : noncopyable
+{
+public:
+    using PacketCallback = std::function<void(const UdpPacket &packet)>;
+    using ThreadInitCallback = std::function<void(EventLoop *)>;
+
+    struct Options
+    {
+        int batchSize;          // 一次recvmmsg/sendmmsg最多多少个包 默认64
+        int maxBatchesPerEvent; // 一次可读事件最多收几批 默认4
+        size_t maxPacketSize;   // 接收区每个槽的大小 默认2048
+        int recvBufferBytes;    // SO_RCVBUF 0表示用系统默认
+        int sendBufferBytes;    // SO_SNDBUF 0表示用系统默认
+        size_t maxPendingBytes; // 每个shard发送队列最多攒多少字节 默认4MB
+        bool gso;               // 发送用UDP_SEGMENT 默认false
+        bool gro;               // 接收打开UDP_GRO 默认false
+
+        Options();
+    };
+
+    struct Stats
+    {
+        int64_t packetsReceived;
+        int64_t bytesReceived;
+        int64_t recvCalls;    // 收包的系统调用次数 packetsReceived/recvCalls就是平均每次收了几个包
+        int64_t truncated;    // 超过maxPacketSize被丢掉的
+        int64_t packetsSent;
+        int64_t bytesSent;
+        int64_t sendCalls;
+        int64_t sendDropped;  // 队列满了或者发送出错丢掉的
+        int64_t gsoSends;     // 用GSO一次发了多个包的次数(一个大包算一次)
+        int64_t groReceives;  // 收到GRO合并过的大包的次数
+
+        Stats();
+        std::string toString() const; // 一行key=value
+    };
+
+    UdpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg,
+              const Options &options = Options());
+    ~UdpServer(); // 在baseloop线程里面析构
+
+    void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+    void setPacketCallback(const PacketCallback &cb) { packetCallback_ = cb; }
+    // start之前设置 0表示只在baseloop上收
+    void setThreadNum(int numThreads);
+
+    // 在baseloop线程里面调用 启动subloop 每个loop上建一个socket开始收
+    void start();
+
+    // 在收到packet的loop线程里面调用(一般就是在PacketCallback里面) 从同一个socket回给packet.peer
+    void reply(const UdpPacket &packet, const void *data, size_t len);
+    // 从第shard个socket发给peer 任意线程 不在那个loop线程里面的时候拷贝一份投递过去
+    void sendTo(int shard, const InetAddress &peer, const void *data, size_t len);
+
+    int numShards() const { return static_cast<int>(shards_.size()); }
+    EventLoop *getLoop() const { return loop_; }
+    const std::string &name() const { return name_; }
+    // 任意线程 所有shard加起来
+    Stats stats() const;
+
+private:
+    struct Shard;
+
+    void startShard(Shard *shard);
+    void handleRead(Shard *shard, Timestamp receiveTime);
+    void receiveBatches(Shard *shard, Timestamp receiveTime);
+    void receiveOne(Shard *shard, Timestamp receiveTime);
+    int deliver(Shard *shard, const char *data, size_t len, int segmentSize, const sockaddr_in &peer, Timestamp receiveTime);
+    void enqueue(Shard *shard, const sockaddr_in &peer, const void *data, size_t len);
+    void flush(Shard *shard);
+    void handleWrite(Shard *shard);
+    void closeShard(Shard *shard);
+
+    EventLoop *loop_; // baseloop
+    const InetAddress listenAddr_;
+    const std::string name_;
+    const Options options_;
+    std::unique_ptr<EventLoopThreadPoll> threadPool_;
+    std::vector<std::shared_ptr<Shard>> shards_; // start以后不再变 投递出去的回调也拿着一份
+    PacketCallback packetCallback_;
+    ThreadInitCallback threadInitCallback_;
+    std::atomic_int started_;
+};
@@ -0,0 +1,281 @@
+#pragma once
+// 压测程序共用的客户端和统计 只在bench目录下面用 不进mymuduo库
+//
+// 输出约定: 每个结果一行写到stderr(库的日志写stdout 跑的时候stdout重定向到/dev/null)
+//   bench=<名字> key=value key=value ...
+// 参数和结果都在同一行里面 脚本按行grep出来就能和上一次的结果比较
+#include "noncopyable.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+namespace bench
+{
+    // 第index个位置参数 没有给就用默认值
+    inline long argOr(int argc, char *argv[], int index, long defaultValue)
+    {
+        return argc > index ? atol(argv[index]) : defaultValue;
+    }
+
+    inline double secondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    inline int64_t nowNanos()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // 阻塞地连接addr(AF_INET或者AF_UNIX) 失败返回-1
+    inline int connectTo(const sockaddr *addr, socklen_t len)
+    {
+        int fd = ::socket(addr->sa_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            return -1;
+        }
+        if (::connect(fd, addr, len) < 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        if (addr->sa_family == AF_INET)
+        {
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+        }
+        return fd;
+    }
+
+    // 阻塞地连接127.0.0.1:port 失败返回-1
+    inline int connectLoopback(uint16_t port)
+    {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return connectTo((sockaddr *)&addr, sizeof addr);
+    }
+
+    // 精确分位数 会打乱v的顺序
+    inline int64_t percentile(std::vector<int64_t> &v, double p)
+    {
+        if (v.empty())
+        {
+            return 0;
+        }
+        size_t idx = std::min(v.size() - 1, static_cast<size_t>(v.size() * p));
+        std::nth_element(v.begin(), v.begin() + idx, v.end());
+        return v[idx];
+    }
+
+    // 纳秒样本的 p50 p90 p99 p999 max 换算成微秒 拼成 "<prefix>p50_us=.. <prefix>p90_us=.. ..."
+    inline std::string latencySummary(std::vector<int64_t> &nanos, const std::string &prefix = std::string())
+    {
+        static const double kQuantiles[] = {0.50, 0.90, 0.99, 0.999};
+        static const char *kNames[] = {"p50", "p90", "p99", "p999"};
+        std::string s;
+        char buf[64];
+        for (int i = 0; i < 4; i++)
+        {
+            snprintf(buf, sizeof buf, "%s_us=%.1f ", kNames[i], percentile(nanos, kQuantiles[i]) / 1000.0);
+            s += prefix + buf;
+        }
+        int64_t maxNanos = nanos.empty() ? 0 : *std::max_element(nanos.begin(), nanos.end());
+        snprintf(buf, sizeof buf, "max_us=%.1f", maxNanos / 1000.0);
+        s += prefix + buf;
+        return s;
+    }
+
+    // 一行结果 bench=name 后面接调用者格式化的key=value
+    __attribute__((format(printf, 2, 3))) inline void report(const char *name, const char *fmt, ...)
+    {
+        char buf[1024];
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(buf, sizeof buf, fmt, ap);
+        va_end(ap);
+        fprintf(stderr, "bench=%s %s\n", name, buf);
+    }
+
+    /*
+     * 一个线程用epoll驱动conns个非阻塞连接做pingpong
+     * 每个连接发msgSize字节 收齐msgSize字节的回显以后再发下一条 同一时间每个连接只有一条消息在路上
+     * 记录每条消息的往返时间(可选)和总字节数  服务器必须是原样回显
+     * 连127.0.0.1:port 或者任意的addr(比如AF_UNIX)
+     */
+    class PingpongClient : noncopyable
+    {
+    public:
+        PingpongClient(uint16_t port, int conns, int msgSize)
+            : msgSize_(msgSize), message_(msgSize, 'x'), epfd_(::epoll_create1(EPOLL_CLOEXEC)),
+              started_(false), messages_(0), bytes_(0), errors_(0)
+        {
+            sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            init((sockaddr *)&addr, sizeof addr, conns);
+        }
+        PingpongClient(const sockaddr *addr, socklen_t len, int conns, int msgSize)
+            : msgSize_(msgSize), message_(msgSize, 'x'), epfd_(::epoll_create1(EPOLL_CLOEXEC)),
+              started_(false), messages_(0), bytes_(0), errors_(0)
+        {
+            init(addr, len, conns);
+        }
+        ~PingpongClient()
+        {
+            for (Conn &c : conns_)
+            {
+                ::close(c.fd);
+            }
+            ::close(epfd_);
+        }
+
+        int connected() const { return static_cast<int>(conns_.size()); }
+
+        // 跑seconds秒 rttNanos不为空的时候记录每条消息的往返时间
+        // 可以连续调用多次(比如先预热再测量) 上一次在路上的消息接着算
+        void run(double seconds, std::vector<int64_t> *rttNanos)
+        {
+            if (!started_)
+            {
+                started_ = true;
+                for (Conn &c : conns_)
+                {
+                    sendOne(c);
+                }
+            }
+            std::vector<char> buf(std::max(msgSize_, 65536));
+            std::vector<epoll_event> events(conns_.size() + 1);
+            auto start = std::chrono::steady_clock::now();
+            while (secondsSince(start) < seconds)
+            {
+                int n = ::epoll_wait(epfd_, events.data(), static_cast<int>(events.size()), 100);
+                for (int i = 0; i < n; i++)
+                {
+                    Conn &c = conns_[events[i].data.u64];
+                    ssize_t r;
+                    while ((r = ::read(c.fd, buf.data(), buf.size())) > 0)
+                    {
+                        c.received += r;
+                        bytes_ += r;
+                    }
+                    if (r == 0 || (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+                    {
+                        errors_++;
+                        ::epoll_ctl(epfd_, EPOLL_CTL_DEL, c.fd, nullptr);
+                        continue;
+                    }
+                    // 回显收齐了 记录往返时间 发下一条
+                    while (c.received >= msgSize_)
+                    {
+                        c.received -= msgSize_;
+                        messages_++;
+                        if (rttNanos)
+                        {
+                            rttNanos->push_back(nowNanos() - c.sentNanos);
+                        }
+                        sendOne(c);
+                    }
+                }
+            }
+        }
+
+        int64_t messages() const { return messages_; }
+        int64_t bytes() const { return bytes_; }
+        int errors() const { return errors_; }
+
+    private:
+        struct Conn
+        {
+            int fd;
+            int64_t received; // 这一条已经收到的回显字节数
+            int64_t sentNanos;
+        };
+
+        void init(const sockaddr *addr, socklen_t len, int conns)
+        {
+            for (int i = 0; i < conns; i++)
+            {
+                int fd = connectTo(addr, len);
+                if (fd < 0)
+                {
+                    errors_++;
+                    continue;
+                }
+                ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+                Conn c = {fd, 0, 0};
+                conns_.push_back(c);
+            }
+            for (size_t i = 0; i < conns_.size(); i++)
+            {
+                epoll_event ev = {};
+                ev.events = EPOLLIN;
+                ev.data.u64 = i;
+                ::epoll_ctl(epfd_, EPOLL_CTL_ADD, conns_[i].fd, &ev);
+            }
+        }
+
+        // 消息一般一次write就写完 写不完(内核缓冲区满)就阻塞地等着写完 不影响测量的含义
+        void sendOne(Conn &c)
+        {
+            c.sentNanos = nowNanos();
+            size_t sent = 0;
+            while (sent < message_.size())
+            {
+                ssize_t n = ::write(c.fd, message_.data() + sent, message_.size() - sent);
+                if (n > 0)
+                {
+                    sent += n;
+                }
+                else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                {
+                    // 对端在回显 这边不读的话可能两边都写满 等到能读或者能写 先把回显读掉
+                    // 不能空转: 只有一个CPU的时候会一直占着CPU直到时间片用完 服务器没机会回显
+                    pollfd pfd = {c.fd, POLLIN | POLLOUT, 0};
+                    ::poll(&pfd, 1, 100);
+                    char drain[65536];
+                    ssize_t r = ::read(c.fd, drain, sizeof drain);
+                    if (r > 0)
+                    {
+                        c.received += r;
+                        bytes_ += r;
+                    }
+                }
+                else
+                {
+                    errors_++;
+                    return;
+                }
+            }
+        }
+
+        const int msgSize_;
+        std::string message_;
+        int epfd_;
+        std::vector<Conn> conns_;
+        bool started_;
+        int64_t messages_;
+        int64_t bytes_;
+        int errors_;
+    };
+}
@@ -0,0 +1,382 @@
+// Buffer的微基准 改Buffer(或者在它上面写的解析代码)之前和之后各跑一次 对比ns/op和每次操作分配的字节数
+// 消息大小有三种分布(种子固定 每次跑都一样):
+//   small  固定64字节
+//   mixed  对数正态 中位数约300字节 截断在[16, 64K]
+//   bimodal 90% 128字节 10% 16KB
+// 每种分布跑下面的操作:
+//   append          append一条 retrieveAll 稳态 不扩容
+//   grow            每次新建Buffer 连续append直到64KB 走makeSpace的resize路径 op是一次append
+//   compact         每次retrieve掉大部分 留一个尾巴 再append 走makeSpace的挪动路径
+//   retrieve_string append一条 retrieveAsString取出来
+//   codec           4字节长度头+消息体的帧 按随机大小的分片append(模拟TCP分段) 边收边解析出完整的帧 op是一帧
+//   read_pipe / read_socketpair    write一条到fd 再readFd读出来
+//   write_pipe / write_socketpair  append一条 writeFd写出去 对端read掉
+//   *_raw           同样的系统调用直接读写一个静态缓冲区 和上面相减就是Buffer自己的开销
+// 分配用替换全局operator new统计 单线程
+//
+// 用法: buffer_bench [iters=200000] [seed=1]
+// 注意: Buffer的大部分函数在头文件里面 这里按bench的-O2编译 readFd/writeFd在库里面 跟着库的编译选项
+#include "BenchUtil.h"
+#include "Buffer.h"
+#include <cmath>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+static uint64_t g_allocs = 0;
+static uint64_t g_allocBytes = 0;
+
+void *operator new(size_t size)
+{
+    g_allocs++;
+    g_allocBytes += size;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+static volatile size_t g_sink;
+static const size_t kMaxMsg = 65536;
+static char g_payload[kMaxMsg + 4];
+
+struct Dist
+{
+    const char *name;
+    std::vector<size_t> sizes; // 预先生成 循环使用
+};
+
+static Dist makeDist(const char *name, unsigned seed)
+{
+    Dist d;
+    d.name = name;
+    std::mt19937 rng(seed);
+    std::string n(name);
+    std::lognormal_distribution<double> lognormal(std::log(300.0), 1.0);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    for (int i = 0; i < 4096; i++)
+    {
+        size_t size = 64;
+        if (n == "mixed")
+        {
+            size = static_cast<size_t>(lognormal(rng));
+            size = std::min(kMaxMsg, std::max<size_t>(16, size));
+        }
+        else if (n == "bimodal")
+        {
+            size = uniform(rng) < 0.9 ? 128 : 16384;
+        }
+        d.sizes.push_back(size);
+    }
+    return d;
+}
+
+// 计时和分配统计 一次测量
+struct Measure
+{
+    std::chrono::steady_clock::time_point start;
+    uint64_t allocs;
+    uint64_t bytes;
+    uint64_t payloadBytes;
+
+    Measure() : start(std::chrono::steady_clock::now()), allocs(g_allocs), bytes(g_allocBytes), payloadBytes(0) {}
+
+    void report(const char *op, const Dist &d, long ops)
+    {
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        uint64_t allocs = g_allocs - this->allocs;
+        uint64_t bytes = g_allocBytes - this->bytes;
+        bench::report("buffer", "op=%s dist=%s ops=%ld ns_per_op=%.1f allocs_per_op=%.3f alloc_bytes_per_op=%.1f mib_per_s=%.1f",
+                      op, d.name, ops, ns / ops, static_cast<double>(allocs) / ops, static_cast<double>(bytes) / ops,
+                      payloadBytes / (ns / 1e9) / (1024 * 1024));
+    }
+};
+
+static void benchAppend(const Dist &d, long iters)
+{
+    Buffer buf;
+    Measure m;
+    for (long i = 0; i < iters; i++)
+    {
+        size_t len = d.sizes[i & 4095];
+        buf.append(g_payload, len);
+        m.payloadBytes += len;
+        g_sink = buf.readableBytes();
+        buf.retrieveAll();
+    }
+    m.report("append", d, iters);
+}
+
+static void benchGrow(const Dist &d, long iters)
+{
+    const size_t kTarget = 65536;
+    long ops = 0;
+    Measure m;
+    for (long i = 0; ops < iters; i++)
+    {
+        Buffer buf;
+        while (buf.readableBytes() < kTarget && ops < iters)
+        {
+            size_t len = d.sizes[ops & 4095];
+            buf.append(g_payload, len);
+            m.payloadBytes += len;
+            ops++;
+        }
+        g_sink = buf.readableBytes();
+    }
+    m.report("grow", d, ops);
+}
+
+static void benchCompact(const Dist &d, long iters)
+{
+    Buffer buf;
+    Measure m;
+    for (long i = 0; i < iters; i++)
+    {
+        size_t len = d.sizes[i & 4095];
+        buf.append(g_payload, len);
+        m.payloadBytes += len;
+        // 只消费掉大半 留下不到一条消息的尾巴 下一次append的时候前面空出来的地方够用 就把尾巴挪到开头
+        size_t readable = buf.readableBytes();
+        size_t keep = std::min(readable, len / 4 + 1);
+        buf.retrieve(readable - keep);
+    }
+    g_sink = buf.readableBytes();
+    m.report("compact", d, iters);
+}
+
+static void benchRetrieveString(const Dist &d, long iters)
+{
+    Buffer buf;
+    Measure m;
+    for (long i = 0; i < iters; i++)
+    {
+        size_t len = d.sizes[i & 4095];
+        buf.append(g_payload, len);
+        std::string s = buf.retrieveAsString(len);
+        m.payloadBytes += len;
+        g_sink = s.size();
+    }
+    m.report("retrieve_string", d, iters);
+}
+
+// 长度头+消息体 按[1, 4096]字节的随机分片喂给Buffer 每喂一片就尽量多解析
+static void benchCodec(const Dist &d, long iters)
+{
+    // 先把要发送的字节流准备好 不算在测量里面
+    std::string stream;
+    long frames = std::min<long>(iters, 20000);
+    for (long i = 0; i < frames; i++)
+    {
+        uint32_t len = static_cast<uint32_t>(d.sizes[i & 4095]);
+        uint32_t be = htonl(len);
+        stream.append(reinterpret_cast<const char *>(&be), 4);
+        stream.append(g_payload, len);
+    }
+    std::mt19937 rng(7);
+    std::vector<size_t> chunks;
+    for (size_t off = 0; off < stream.size();)
+    {
+        size_t chunk = std::min(stream.size() - off, static_cast<size_t>(rng() % 4096 + 1));
+        chunks.push_back(chunk);
+        off += chunk;
+    }
+
+    Buffer buf;
+    long parsed = 0;
+    Measure m;
+    while (parsed < iters)
+    {
+        size_t off = 0;
+        for (size_t chunk : chunks)
+        {
+            buf.append(stream.data() + off, chunk);
+            off += chunk;
+            while (buf.readableBytes() >= 4)
+            {
+                uint32_t be;
+                memcpy(&be, buf.peek(), 4);
+                uint32_t len = ntohl(be);
+                if (buf.readableBytes() < 4 + len)
+                {
+                    break;
+                }
+                buf.retrieve(4);
+                std::string body = buf.retrieveAsString(len);
+                m.payloadBytes += len;
+                g_sink = body.size();
+                parsed++;
+            }
+        }
+    }
+    m.report("codec", d, parsed);
+}
+
+// fds[0]写 fds[1]读
+static bool makePair(bool socket, int fds[2])
+{
+    if (socket)
+    {
+        return ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0;
+    }
+    int p[2];
+    if (::pipe2(p, O_CLOEXEC) != 0)
+    {
+        return false;
+    }
+    fds[0] = p[1];
+    fds[1] = p[0];
+    return true;
+}
+
+// 消息最大64KB 和pipe的默认容量一样 写端一次写完不会阻塞 socketpair加大发送缓冲区
+static void setBuffers(bool socket, int fds[2])
+{
+    if (socket)
+    {
+        int size = 4 * kMaxMsg;
+        ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof size);
+        ::setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof size);
+        ::setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &size, sizeof size);
+        ::setsockopt(fds[0], SOL_SOCKET, SO_RCVBUF, &size, sizeof size);
+    }
+}
+
+// 要求每条消息一次write就写完
+static void benchRead(const Dist &d, long iters, bool socket, bool raw)
+{
+    int fds[2];
+    if (!makePair(socket, fds))
+    {
+        perror("pipe/socketpair");
+        return;
+    }
+    setBuffers(socket, fds);
+    static char sink[kMaxMsg];
+    Buffer buf;
+    Measure m;
+    for (long i = 0; i < iters; i++)
+    {
+        size_t len = d.sizes[i & 4095];
+        ssize_t w = ::write(fds[0], g_payload, len);
+        size_t got = 0;
+        while (w > 0 && got < static_cast<size_t>(w))
+        {
+            ssize_t n;
+            if (raw)
+            {
+                n = ::read(fds[1], sink, sizeof sink);
+            }
+            else
+            {
+                int savedErrno = 0;
+                n = buf.readFd(fds[1], &savedErrno);
+            }
+            if (n <= 0)
+            {
+                break;
+            }
+            got += n;
+        }
+        m.payloadBytes += got;
+        if (!raw)
+        {
+            std::string s = buf.retrieveAllAsString();
+            g_sink = s.size();
+        }
+    }
+    char op[32];
+    snprintf(op, sizeof op, "read_%s%s", socket ? "socketpair" : "pipe", raw ? "_raw" : "");
+    m.report(op, d, iters);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+static void benchWrite(const Dist &d, long iters, bool socket, bool raw)
+{
+    int fds[2];
+    if (!makePair(socket, fds))
+    {
+        perror("pipe/socketpair");
+        return;
+    }
+    setBuffers(socket, fds);
+    static char sink[kMaxMsg];
+    Buffer buf;
+    Measure m;
+    for (long i = 0; i < iters; i++)
+    {
+        size_t len = d.sizes[i & 4095];
+        ssize_t w;
+        if (raw)
+        {
+            w = ::write(fds[0], g_payload, len);
+        }
+        else
+        {
+            buf.append(g_payload, len);
+            int savedErrno = 0;
+            w = buf.writeFd(fds[0], &savedErrno);
+            if (w > 0)
+            {
+                buf.retrieve(w);
+            }
+        }
+        size_t got = 0;
+        while (w > 0 && got < static_cast<size_t>(w))
+        {
+            ssize_t n = ::read(fds[1], sink, sizeof sink);
+            if (n <= 0)
+            {
+                break;
+            }
+            got += n;
+        }
+        m.payloadBytes += got;
+    }
+    char op[32];
+    snprintf(op, sizeof op, "write_%s%s", socket ? "socketpair" : "pipe", raw ? "_raw" : "");
+    m.report(op, d, iters);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+int main(int argc, char *argv[])
+{
+    long iters = bench::argOr(argc, argv, 1, 200000);
+    unsigned seed = static_cast<unsigned>(bench::argOr(argc, argv, 2, 1));
+    memset(g_payload, 'x', sizeof g_payload);
+
+    const char *names[] = {"small", "mixed", "bimodal"};
+    for (const char *name : names)
+    {
+        Dist d = makeDist(name, seed);
+        benchAppend(d, iters);
+        benchGrow(d, iters);
+        benchCompact(d, iters);
+        benchRetrieveString(d, iters);
+        benchCodec(d, iters);
+        // 系统调用慢得多 少跑一些
+        long ioIters = std::max<long>(1, iters / 10);
+        for (int socket = 0; socket < 2; socket++)
+        {
+            benchRead(d, ioIters, socket != 0, false);
+            benchRead(d, ioIters, socket != 0, true);
+            benchWrite(d, ioIters, socket != 0, false);
+            benchWrite(d, ioIters, socket != 0, true);
+        }
+    }
+    return 0;
+}
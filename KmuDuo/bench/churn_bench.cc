@@ -0,0 +1,141 @@
+// 连接建立/关闭的吞吐
+// loops个subloop的echo服务器 conns个客户端线程各自循环: connect 发一条msgSize字节的消息等回显(msgSize为0就不发) close
+// 跑seconds秒 输出每秒建立关闭多少个连接 connect的延迟分位数
+// 结束以后等服务器把连接都关掉 leaked不为0说明有连接没被TcpServer清理掉
+// 客户端主动关闭 TIME_WAIT留在客户端 跑太久会用完本地端口(net.ipv4.ip_local_port_range)
+// 回环上本地端口很快被重用(tcp_tw_reuse) 新连接的SYN偶尔要等1秒重传 connect的p999会到1秒
+// rst=1的时候用SO_LINGER(0)关闭 发RST不留TIME_WAIT 测的是服务器处理连接本身的开销
+//
+// 用法: churn_bench [loops=2] [conns=4] [msgSize=0] [seconds=2] [rst=0] [port=9992]   stdout重定向到/dev/null
+#include "BenchUtil.h"
+#include "TcpServer.h"
+#include "CountDownLatch.h"
+#include "logger.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static void onConnection(const TcpConnectionPtr &)
+{
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+// 返回是否成功 connectNanos记录connect的耗时
+static bool churnOnce(uint16_t port, bool rst, const std::string &msg, std::vector<char> *reply, std::vector<int64_t> *connectNanos)
+{
+    int64_t start = bench::nowNanos();
+    int fd = bench::connectLoopback(port);
+    if (fd < 0)
+    {
+        return false;
+    }
+    connectNanos->push_back(bench::nowNanos() - start);
+    bool ok = true;
+    if (!msg.empty())
+    {
+        ok = ::write(fd, msg.data(), msg.size()) == static_cast<ssize_t>(msg.size());
+        size_t got = 0;
+        while (ok && got < msg.size())
+        {
+            ssize_t n = ::read(fd, reply->data() + got, msg.size() - got);
+            ok = n > 0;
+            got += ok ? n : 0;
+        }
+    }
+    if (rst)
+    {
+        struct linger lg = {1, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof lg);
+    }
+    ::close(fd);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = static_cast<int>(bench::argOr(argc, argv, 1, 2));
+    int conns = static_cast<int>(bench::argOr(argc, argv, 2, 4));
+    int msgSize = static_cast<int>(bench::argOr(argc, argv, 3, 0));
+    double seconds = static_cast<double>(bench::argOr(argc, argv, 4, 2));
+    bool rst = bench::argOr(argc, argv, 5, 0) != 0;
+    uint16_t port = static_cast<uint16_t>(bench::argOr(argc, argv, 6, 9992));
+    Logger::setLogLevel(ERROR);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "127.0.0.1"), "churn_bench");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setThreadNum(loops);
+    server.start();
+
+    // 在baseloop里面读TcpServer的连接数
+    auto totals = [&]() {
+        TcpServer::ConnectionTotals t;
+        CountDownLatch latch(1);
+        loop.runInLoop([&]() { t = server.connectionTotals(); latch.countDown(); });
+        latch.wait();
+        return t;
+    };
+
+    std::thread control([&]() {
+        int64_t acceptedBefore = totals().accepted;
+        std::atomic<long> completed(0), failed(0);
+        std::vector<std::vector<int64_t>> connectNanos(conns);
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < conns; i++)
+        {
+            std::vector<int64_t> *samples = &connectNanos[i];
+            threads.push_back(std::thread([&, samples]() {
+                std::string msg(msgSize, 'x');
+                std::vector<char> reply(msgSize);
+                samples->reserve(1 << 16);
+                while (bench::secondsSince(start) < seconds)
+                {
+                    if (churnOnce(port, rst, msg, &reply, samples))
+                    {
+                        completed.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    else
+                    {
+                        failed.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            }));
+        }
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+        double elapsed = bench::secondsSince(start);
+
+        // 服务器关连接是异步的 最多等2秒
+        TcpServer::ConnectionTotals t = totals();
+        for (int i = 0; i < 200 && t.connections > 0; i++)
+        {
+            ::usleep(10 * 1000);
+            t = totals();
+        }
+
+        std::vector<int64_t> all;
+        for (auto &v : connectNanos)
+        {
+            all.insert(all.end(), v.begin(), v.end());
+        }
+        std::string summary = bench::latencySummary(all, "connect_");
+        bench::report("churn", "loops=%d conns=%d msg_size=%d seconds=%.2f close=%s completed=%ld failed=%ld accepted=%ld leaked=%zu "
+                               "conns_per_s=%.0f %s",
+                      loops, conns, msgSize, elapsed, rst ? "rst" : "fin", completed.load(), failed.load(),
+                      static_cast<long>(t.accepted - acceptedBefore), t.connections,
+                      completed.load() / elapsed, summary.c_str());
+        loop.quit();
+    });
+
+    loop.loop();
+    control.join();
+    return 0;
+}
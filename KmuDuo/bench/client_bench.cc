@@ -0,0 +1,259 @@
+// TcpClient/Connector 服务器在单独的loop线程里面 客户端都在main loop上 控制线程按顺序跑下面几项:
+//   connect   依次新建count个TcpClient 从connect()到连接回调的耗时(非阻塞connect+等可写+建TcpConnection)
+//   retry     先连一个没有监听的端口 1秒以后才起服务器 看重试了几次 服务器起来以后多久连上
+//             重试间隔从20ms开始翻倍到200ms 带抖动
+//   reconnect 服务器一连上就关 客户端enableRetry 统计seconds秒里面重连了多少次
+//   pingpong  conns个TcpClient做pingpong 每个连接一条msgSize字节的消息在路上
+//             再用BenchUtil里面裸epoll的PingpongClient跑一遍同样的负载对比
+//
+// 用法: client_bench [count=200] [conns=16] [msgSize=64] [seconds=2] [port=9994]   用到port port+1 port+2  stdout重定向到/dev/null
+#include "BenchUtil.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "CountDownLatch.h"
+#include "logger.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static void onServerConnection(const TcpConnectionPtr &)
+{
+}
+
+static void onEcho(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+static void onDiscard(const TcpConnectionPtr &, Buffer *buf, Timestamp)
+{
+    buf->retrieveAll();
+}
+
+// 一连上就关
+static void onKickConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->shutdown();
+    }
+}
+
+// 在loop线程里面执行f 等它执行完
+static void runAndWait(EventLoop *loop, const std::function<void()> &f)
+{
+    CountDownLatch latch(1);
+    loop->runInLoop([&]() {
+        f();
+        latch.countDown();
+    });
+    latch.wait();
+}
+
+static std::unique_ptr<TcpServer> makeServer(EventLoop *loop, uint16_t port, const ConnectionCallback &cb)
+{
+    std::unique_ptr<TcpServer> server(new TcpServer(loop, InetAddress(port, "127.0.0.1"), "client_bench_server"));
+    server->setConnectionCallback(cb);
+    server->setMessageCallback(onEcho);
+    server->start();
+    return server;
+}
+
+int main(int argc, char *argv[])
+{
+    int count = static_cast<int>(bench::argOr(argc, argv, 1, 200));
+    int conns = static_cast<int>(bench::argOr(argc, argv, 2, 16));
+    int msgSize = static_cast<int>(bench::argOr(argc, argv, 3, 64));
+    double seconds = static_cast<double>(bench::argOr(argc, argv, 4, 2));
+    uint16_t port = static_cast<uint16_t>(bench::argOr(argc, argv, 5, 9994));
+    Logger::setLogLevel(ERROR);
+
+    EventLoopThread serverThread;
+    EventLoop *serverLoop = serverThread.startloop();
+    std::unique_ptr<TcpServer> echoServer, kickServer, lateServer;
+    runAndWait(serverLoop, [&]() {
+        echoServer = makeServer(serverLoop, port, onServerConnection);
+        kickServer = makeServer(serverLoop, static_cast<uint16_t>(port + 1), onKickConnection);
+    });
+
+    EventLoop loop;
+    std::thread control([&]() {
+        // connect
+        {
+            std::vector<int64_t> nanos;
+            std::atomic<int64_t> connectedAt(0);
+            for (int i = 0; i < count; i++)
+            {
+                std::unique_ptr<TcpClient> client;
+                int64_t start = bench::nowNanos();
+                connectedAt = 0;
+                runAndWait(&loop, [&]() {
+                    client.reset(new TcpClient(&loop, InetAddress(port, "127.0.0.1"), "connect"));
+                    client->setConnectionCallback([&connectedAt](const TcpConnectionPtr &conn) {
+                        if (conn->connected())
+                        {
+                            connectedAt = bench::nowNanos();
+                        }
+                    });
+                    client->connect();
+                });
+                while (connectedAt == 0)
+                {
+                    ::usleep(50);
+                }
+                nanos.push_back(connectedAt - start);
+                // 析构的时候连接半关闭 连接回调换掉 不再碰这里的局部变量
+                runAndWait(&loop, [&]() {
+                    TcpConnectionPtr conn = client->connection();
+                    conn->setConnectionCallback(onServerConnection);
+                    client.reset();
+                });
+            }
+            bench::report("client", "op=connect count=%d %s", count, bench::latencySummary(nanos).c_str());
+        }
+
+        // retry
+        {
+            std::unique_ptr<TcpClient> client;
+            std::atomic<int64_t> connectedAt(0);
+            uint16_t latePort = static_cast<uint16_t>(port + 2);
+            runAndWait(&loop, [&]() {
+                client.reset(new TcpClient(&loop, InetAddress(latePort, "127.0.0.1"), "retry"));
+                client->setRetryDelay(20, 200);
+                client->setConnectionCallback([&connectedAt](const TcpConnectionPtr &conn) {
+                    if (conn->connected())
+                    {
+                        connectedAt = bench::nowNanos();
+                    }
+                });
+                client->connect();
+            });
+            ::usleep(1000 * 1000);
+            int retries = client->connectRetries(); // 连上以后会清零 在服务器起来之前取
+            int64_t serverUp = bench::nowNanos();
+            runAndWait(serverLoop, [&]() { lateServer = makeServer(serverLoop, latePort, onServerConnection); });
+            while (connectedAt == 0 && bench::nowNanos() - serverUp < 5000000000LL)
+            {
+                ::usleep(100);
+            }
+            bench::report("client", "op=retry init_delay_ms=20 max_delay_ms=200 retries=%d connected=%d connect_after_server_up_ms=%.1f",
+                          retries, connectedAt != 0 ? 1 : 0,
+                          connectedAt != 0 ? (connectedAt - serverUp) / 1e6 : -1.0);
+            runAndWait(&loop, [&]() {
+                TcpConnectionPtr conn = client->connection();
+                if (conn)
+                {
+                    conn->setConnectionCallback(onServerConnection);
+                }
+                client.reset();
+            });
+        }
+
+        // reconnect
+        {
+            std::unique_ptr<TcpClient> client;
+            std::atomic<int64_t> established(0);
+            runAndWait(&loop, [&]() {
+                client.reset(new TcpClient(&loop, InetAddress(static_cast<uint16_t>(port + 1), "127.0.0.1"), "reconnect"));
+                client->enableRetry();
+                client->setConnectionCallback([&established](const TcpConnectionPtr &conn) {
+                    if (conn->connected())
+                    {
+                        established++;
+                    }
+                });
+                client->connect();
+            });
+            ::usleep(static_cast<useconds_t>(seconds * 1000000));
+            int64_t n = established;
+            runAndWait(&loop, [&]() {
+                client->stop();
+                TcpConnectionPtr conn = client->connection();
+                if (conn)
+                {
+                    conn->setConnectionCallback(onServerConnection);
+                }
+                client.reset();
+            });
+            bench::report("client", "op=reconnect seconds=%.1f reconnects=%lld reconnects_per_s=%.0f",
+                          seconds, static_cast<long long>(n), n / seconds);
+        }
+
+        // pingpong
+        {
+            std::string message(msgSize, 'x');
+            std::atomic<int64_t> messages(0);
+            std::atomic<int> up(0);
+            std::vector<std::unique_ptr<TcpClient>> clients;
+            runAndWait(&loop, [&]() {
+                for (int i = 0; i < conns; i++)
+                {
+                    clients.push_back(std::unique_ptr<TcpClient>(new TcpClient(&loop, InetAddress(port, "127.0.0.1"), "pingpong")));
+                    clients.back()->setConnectionCallback([&, message](const TcpConnectionPtr &conn) {
+                        if (conn->connected())
+                        {
+                            up++;
+                            conn->send(message);
+                        }
+                    });
+                    clients.back()->setMessageCallback([&, message](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+                        while (buf->readableBytes() >= message.size())
+                        {
+                            buf->retrieve(message.size());
+                            messages++;
+                            conn->send(message);
+                        }
+                    });
+                    clients.back()->connect();
+                }
+            });
+            while (up < conns)
+            {
+                ::usleep(100);
+            }
+            ::usleep(300 * 1000);
+            int64_t before = messages;
+            auto start = std::chrono::steady_clock::now();
+            ::usleep(static_cast<useconds_t>(seconds * 1000000));
+            double elapsed = bench::secondsSince(start);
+            int64_t n = messages - before;
+            runAndWait(&loop, [&]() {
+                for (auto &c : clients)
+                {
+                    TcpConnectionPtr conn = c->connection();
+                    if (conn)
+                    {
+                        conn->setConnectionCallback(onServerConnection);
+                        conn->setMessageCallback(onDiscard);
+                    }
+                }
+                clients.clear();
+            });
+            bench::report("client", "op=pingpong client=TcpClient conns=%d msg_size=%d msgs_per_s=%.0f",
+                          conns, msgSize, n / elapsed);
+
+            bench::PingpongClient raw(port, conns, msgSize);
+            raw.run(0.3, nullptr);
+            before = raw.messages();
+            start = std::chrono::steady_clock::now();
+            raw.run(seconds, nullptr);
+            elapsed = bench::secondsSince(start);
+            bench::report("client", "op=pingpong client=raw_epoll conns=%d msg_size=%d msgs_per_s=%.0f",
+                          conns, msgSize, (raw.messages() - before) / elapsed);
+        }
+        loop.quit();
+    });
+    loop.loop();
+    control.join();
+
+    // TcpServer在它自己的loop线程里面析构
+    runAndWait(serverLoop, [&]() {
+        echoServer.reset();
+        kickServer.reset();
+        lateServer.reset();
+    });
+    return 0;
+}
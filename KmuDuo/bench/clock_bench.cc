@@ -0,0 +1,119 @@
+// 热路径上取时间的开销 和TscClock的正确性
+// 1. 每次调用的耗时: clock_gettime(MONOTONIC/REALTIME/MONOTONIC_COARSE) Timestamp::now() rdtsc TscClock::nowNanos()
+//    以及EventLoop缓存的loop时间(回调里面读loopMonotonicMicros)
+// 2. 漂移: seconds秒内每10ms比较一次TscClock::nowNanos()和CLOCK_MONOTONIC 输出最大误差和漂移(ppm)
+//    连续调用nowNanos()必须单调不减  缓存的loop时间不能比poll返回之后的真实时间晚
+//    误差超过maxErrUs微秒或者不单调 退出码为1
+//
+// 用法: clock_bench [calls=10000000] [seconds=3] [maxErrUs=100]
+#include "TscClock.h"
+#include "Timestamp.h"
+#include "EventLoop.h"
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static volatile int64_t g_sink;
+
+template <typename F>
+static double nsPerCall(long calls, F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < calls; i++)
+    {
+        g_sink = f();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+}
+
+static int64_t clockNanos(clockid_t id)
+{
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+    long calls = argc > 1 ? atol(argv[1]) : 10000000;
+    int seconds = argc > 2 ? atoi(argv[2]) : 3;
+    double maxErrUs = argc > 3 ? atof(argv[3]) : 100;
+
+    bool tsc = TscClock::calibrate();
+    fprintf(stderr, "clock_bench invariant_tsc=%d ticks_per_ns=%.4f\n", tsc ? 1 : 0, TscClock::ticksPerNano());
+
+    double mono = nsPerCall(calls, []() { return clockNanos(CLOCK_MONOTONIC); });
+    double real = nsPerCall(calls, []() { return clockNanos(CLOCK_REALTIME); });
+    double coarse = nsPerCall(calls, []() { return clockNanos(CLOCK_MONOTONIC_COARSE); });
+    double ts = nsPerCall(calls, []() { return Timestamp::now().microSecondsSinceEpoch(); });
+    double rdtsc = nsPerCall(calls, []() { return static_cast<int64_t>(TscClock::rdtsc()); });
+    double tscNow = nsPerCall(calls, []() { return TscClock::nowNanos(); });
+
+    // 在loop线程里面读缓存的loop时间 顺便检查它不会比真实时间晚
+    EventLoop loop;
+    double cached = 0;
+    int64_t maxStaleUs = 0;
+    bool loopOk = true;
+    loop.queueLoop([&]() {
+        int64_t real = Timestamp::monotonicMicroSeconds();
+        if (loop.loopMonotonicMicros() > real)
+        {
+            loopOk = false;
+        }
+        maxStaleUs = real - loop.loopMonotonicMicros();
+        cached = nsPerCall(calls, [&loop]() { return loop.loopMonotonicMicros(); });
+        loop.refreshLoopTime();
+        if (loop.loopMonotonicMicros() < real)
+        {
+            loopOk = false;
+        }
+        loop.quit();
+    });
+    loop.loop();
+
+    fprintf(stderr, "clock_bench ns_per_call clock_monotonic=%.1f clock_realtime=%.1f clock_monotonic_coarse=%.1f"
+                    " timestamp_now=%.1f rdtsc=%.1f tsc_now=%.1f loop_cached=%.2f\n",
+            mono, real, coarse, ts, rdtsc, tscNow, cached);
+
+    // 单调性
+    bool monotonic = true;
+    int64_t prev = TscClock::nowNanos();
+    for (long i = 0; i < calls; i++)
+    {
+        int64_t cur = TscClock::nowNanos();
+        if (cur < prev)
+        {
+            monotonic = false;
+        }
+        prev = cur;
+    }
+
+    // 漂移: 误差 = tsc时间 - 单调时钟  用前后两次单调时钟的中点 去掉取时间本身的耗时
+    double maxErr = 0, firstErr = 0, lastErr = 0;
+    int64_t firstAt = 0, lastAt = 0;
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < end)
+    {
+        int64_t m0 = TscClock::monotonicNanos();
+        int64_t t = TscClock::nowNanos();
+        int64_t m1 = TscClock::monotonicNanos();
+        double err = static_cast<double>(t - (m0 + (m1 - m0) / 2));
+        if (firstAt == 0)
+        {
+            firstAt = m0;
+            firstErr = err;
+        }
+        lastAt = m0;
+        lastErr = err;
+        maxErr = std::max(maxErr, std::fabs(err));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    double ppm = lastAt > firstAt ? (lastErr - firstErr) / (lastAt - firstAt) * 1e6 : 0;
+    bool ok = monotonic && loopOk && (!tsc || maxErr / 1000 <= maxErrUs);
+    fprintf(stderr, "clock_bench drift seconds=%d max_err_us=%.2f drift_ppm=%.2f monotonic=%d loop_time_ok=%d loop_stale_us=%ld ok=%d\n",
+            seconds, maxErr / 1000, ppm, monotonic ? 1 : 0, loopOk ? 1 : 0, static_cast<long>(maxStaleUs), ok ? 1 : 0);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+// 服务器退出的时候 正在处理的请求会不会丢 回复会不会被截断
+// 服务器: 2个subloop 每个请求("get\n")offload到ComputePool 等workUs微秒(模拟下游调用)以后回respSize字节
+// 客户端: conns个连接 每个一个线程 发请求 -> 读完整个回复 -> 再发 服务器关掉连接以后就不再发了
+// 跑到seconds/2的时候 服务器drain(timeoutMs):
+//   timeout=0     相当于直接关: 还在offload的请求和outputBuffer_里面没发完的回复都丢掉
+//   timeout=2000  等正在处理的请求回复完 发完再shutdown写端 等对端关闭
+// 输出: 完整的回复数 被截断的回复数(收到一部分就断了) 发出去没有回复的请求数 drain花的时间
+// 服务器这边再分两种: lost 已经开始处理但是回复发不出去(连接已经关了)
+//                    ignored 连接已经在shutdown了才收到的请求(对端读到EOF以后应该换个连接重试)
+// 发请求之前先看一下连接是不是已经被服务器关了 关了就直接停 不算没有回复
+//
+// 用法: drain_bench [conns=32] [respSize=262144] [workUs=2000] [seconds=2] [port=9977]   stdout重定向到/dev/null
+#include "BenchUtil.h"
+#include "TcpServer.h"
+#include "TcpConnection.h"
+#include "ComputePool.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "CountDownLatch.h"
+#include "logger.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <signal.h>
+
+static std::atomic<int64_t> g_lost(0);
+static std::atomic<int64_t> g_ignored(0);
+
+static void onConnection(const TcpConnectionPtr &)
+{
+}
+
+static void onRequest(int respSize, int workUs, const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    while (true)
+    {
+        const char *begin = buf->peek();
+        const char *end = begin + buf->readableBytes();
+        const char *eol = std::find(begin, end, '\n');
+        if (eol == end)
+        {
+            return;
+        }
+        buf->retrieve(eol - begin + 1);
+        if (!conn->connected())
+        {
+            g_ignored++;
+            continue;
+        }
+        std::shared_ptr<std::string> reply(new std::string);
+        conn->offload(
+            [reply, respSize, workUs]() {
+                ::usleep(workUs);
+                reply->assign(respSize, 'x');
+            },
+            [conn, reply]() {
+                if (conn->connected())
+                {
+                    conn->send(*reply);
+                }
+                else
+                {
+                    g_lost++;
+                }
+            });
+    }
+}
+
+struct Result
+{
+    int64_t complete;
+    int64_t truncated;
+    int64_t unanswered;
+    std::vector<int64_t> latency;
+};
+
+// 服务器已经关了(读到EOF或者RST)
+static bool closedByServer(int fd)
+{
+    pollfd pfd = {fd, POLLIN | POLLRDHUP, 0};
+    return ::poll(&pfd, 1, 0) > 0;
+}
+
+static void client(uint16_t port, int respSize, Result *r)
+{
+    int fd = bench::connectLoopback(port);
+    if (fd < 0)
+    {
+        return;
+    }
+    std::vector<char> buf(64 * 1024);
+    while (!closedByServer(fd))
+    {
+        int64_t begin = bench::nowNanos();
+        if (::write(fd, "get\n", 4) != 4)
+        {
+            r->unanswered++;
+            break;
+        }
+        int got = 0;
+        while (got < respSize)
+        {
+            ssize_t n = ::read(fd, buf.data(), std::min(buf.size(), static_cast<size_t>(respSize - got)));
+            if (n <= 0)
+            {
+                break;
+            }
+            got += static_cast<int>(n);
+        }
+        if (got == respSize)
+        {
+            r->complete++;
+            r->latency.push_back(bench::nowNanos() - begin);
+        }
+        else
+        {
+            got == 0 ? r->unanswered++ : r->truncated++;
+            break;
+        }
+    }
+    ::close(fd);
+}
+
+static void runMode(int timeoutMs, int conns, int respSize, int workUs, double seconds, uint16_t port)
+{
+    ComputePool pool;
+    pool.start(4);
+    EventLoopThread baseThread;
+    EventLoop *base = baseThread.startloop();
+    std::unique_ptr<TcpServer> server;
+    {
+        CountDownLatch latch(1);
+        base->runInLoop([&]() {
+            server.reset(new TcpServer(base, InetAddress(port, "127.0.0.1"), "drain_bench"));
+            server->setConnectionCallback(onConnection);
+            server->setMessageCallback(std::bind(onRequest, respSize, workUs, std::placeholders::_1,
+                                                 std::placeholders::_2, std::placeholders::_3));
+            server->setComputePool(&pool);
+            server->setThreadNum(2);
+            server->start();
+            latch.countDown();
+        });
+        latch.wait();
+    }
+
+    g_lost = 0;
+    g_ignored = 0;
+    std::vector<Result> results(conns);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < conns; i++)
+    {
+        results[i] = Result{0, 0, 0, std::vector<int64_t>()};
+        results[i].latency.reserve(1 << 16);
+        threads.push_back(std::thread(client, port, respSize, &results[i]));
+    }
+    ::usleep(static_cast<useconds_t>(seconds / 2 * 1000000));
+
+    CountDownLatch drained(1);
+    int64_t drainStart = bench::nowNanos();
+    int64_t drainEnd = 0;
+    server->drain(timeoutMs, [&]() {
+        drainEnd = bench::nowNanos();
+        drained.countDown();
+    });
+    drained.wait();
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+
+    Result total = Result{0, 0, 0, std::vector<int64_t>()};
+    for (Result &r : results)
+    {
+        total.complete += r.complete;
+        total.truncated += r.truncated;
+        total.unanswered += r.unanswered;
+        total.latency.insert(total.latency.end(), r.latency.begin(), r.latency.end());
+    }
+    bench::report("drain", "timeout_ms=%d conns=%d resp_size=%d work_us=%d complete=%lld truncated=%lld "
+                           "unanswered=%lld lost=%lld ignored=%lld drain_ms=%.1f %s",
+                  timeoutMs, conns, respSize, workUs, (long long)total.complete, (long long)total.truncated,
+                  (long long)total.unanswered, (long long)g_lost.load(), (long long)g_ignored.load(),
+                  (drainEnd - drainStart) / 1e6,
+                  bench::latencySummary(total.latency).c_str());
+
+    CountDownLatch latch(1);
+    base->runInLoop([&]() {
+        server.reset();
+        latch.countDown();
+    });
+    latch.wait();
+    pool.stop();
+}
+
+int main(int argc, char *argv[])
+{
+    int conns = static_cast<int>(bench::argOr(argc, argv, 1, 32));
+    int respSize = static_cast<int>(bench::argOr(argc, argv, 2, 262144));
+    int workUs = static_cast<int>(bench::argOr(argc, argv, 3, 2000));
+    double seconds = static_cast<double>(bench::argOr(argc, argv, 4, 2));
+    uint16_t port = static_cast<uint16_t>(bench::argOr(argc, argv, 5, 9977));
+    Logger::setLogLevel(ERROR);
+    ::signal(SIGPIPE, SIG_IGN);
+
+    runMode(0, conns, respSize, workUs, seconds, port);
+    runMode(2000, conns, respSize, workUs, seconds, port);
+    return 0;
+}
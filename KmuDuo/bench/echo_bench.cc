@@ -0,0 +1,92 @@
+// 多连接echo吞吐
+// loops个subloop的echo服务器 clientThreads个客户端线程一共conns个连接 每个连接同一时间一条msgSize字节的消息在路上
+// 跑seconds秒 输出每秒的消息数和字节数(单向) 以及服务器所有loop合并以后的忙碌比例
+//
+// 用法: echo_bench [loops=2] [conns=16] [msgSize=4096] [seconds=3] [clientThreads=1] [port=9990]   stdout重定向到/dev/null
+#include "BenchUtil.h"
+#include "TcpServer.h"
+#include "CountDownLatch.h"
+#include "logger.h"
+#include <memory>
+#include <thread>
+#include <vector>
+
+static void onConnection(const TcpConnectionPtr &)
+{
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = static_cast<int>(bench::argOr(argc, argv, 1, 2));
+    int conns = static_cast<int>(bench::argOr(argc, argv, 2, 16));
+    int msgSize = static_cast<int>(bench::argOr(argc, argv, 3, 4096));
+    double seconds = static_cast<double>(bench::argOr(argc, argv, 4, 3));
+    int clientThreads = static_cast<int>(bench::argOr(argc, argv, 5, 1));
+    uint16_t port = static_cast<uint16_t>(bench::argOr(argc, argv, 6, 9990));
+    Logger::setLogLevel(ERROR);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "127.0.0.1"), "echo_bench");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setThreadNum(loops);
+    server.start();
+
+    std::thread control([&]() {
+        // 连接平均分给客户端线程 连接都建好以后再一起开始
+        std::vector<std::unique_ptr<bench::PingpongClient>> clients;
+        for (int i = 0; i < clientThreads; i++)
+        {
+            int n = conns / clientThreads + (i < conns % clientThreads ? 1 : 0);
+            clients.push_back(std::unique_ptr<bench::PingpongClient>(new bench::PingpongClient(port, n, msgSize)));
+        }
+
+        LoopStatsSnapshot before;
+        CountDownLatch latch(1);
+        loop.runInLoop([&]() { before = server.stats(); latch.countDown(); });
+        latch.wait();
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (auto &c : clients)
+        {
+            bench::PingpongClient *client = c.get();
+            threads.push_back(std::thread([client, seconds]() { client->run(seconds, nullptr); }));
+        }
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+        double elapsed = bench::secondsSince(start);
+
+        LoopStatsSnapshot diff;
+        CountDownLatch done(1);
+        loop.runInLoop([&]() { diff = server.stats() - before; done.countDown(); });
+        done.wait();
+
+        int64_t messages = 0, bytes = 0;
+        int connected = 0, errors = 0;
+        for (auto &c : clients)
+        {
+            messages += c->messages();
+            bytes += c->bytes();
+            connected += c->connected();
+            errors += c->errors();
+        }
+        bench::report("echo", "loops=%d conns=%d msg_size=%d seconds=%.2f client_threads=%d connected=%d errors=%d "
+                              "msgs_per_s=%.0f bytes_per_s=%.0f mib_per_s=%.1f server_busy=%.3f",
+                      loops, conns, msgSize, elapsed, clientThreads, connected, errors,
+                      messages / elapsed, bytes / elapsed, bytes / elapsed / (1024 * 1024), diff.busyRatio());
+        clients.clear();
+        loop.quit();
+    });
+
+    loop.loop();
+    control.join();
+    return 0;
+}
@@ -0,0 +1,165 @@
+// 延迟直方图
+// 1. Histogram::record每次的耗时 以及分位数的精度: 对数正态分布的随机数 和排序以后的精确分位数比较 相对误差应该在3%左右
+// 2. 两个subloop的echo服务器 conns个连接pingpong seconds秒
+//    另一个线程每200us往baseloop投递一个functor 结束以后在baseloop里面输出TcpServer::statsDump()
+//
+// 用法: histogram_bench [conns=4] [seconds=2] [port=9986]   stdout重定向到/dev/null
+#include "Histogram.h"
+#include "TcpServer.h"
+#include "TscClock.h"
+#include "logger.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static void onConnection(const TcpConnectionPtr &)
+{
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+static int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(fd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    return fd;
+}
+
+static bool accuracy()
+{
+    std::mt19937_64 rng(42);
+    std::lognormal_distribution<double> dist(9.0, 1.5); // 中位数大约8000
+    const int kSamples = 1000000;
+    std::vector<uint64_t> values(kSamples);
+    Histogram h;
+    for (int i = 0; i < kSamples; i++)
+    {
+        values[i] = static_cast<uint64_t>(dist(rng)) + 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kSamples; i++)
+    {
+        h.record(values[i]);
+    }
+    double recordNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / kSamples;
+
+    HistogramSnapshot s;
+    h.mergeInto(&s);
+    std::sort(values.begin(), values.end());
+    double worst = 0;
+    const double qs[] = {0.5, 0.9, 0.99, 0.999};
+    for (double q : qs)
+    {
+        double exact = static_cast<double>(values[static_cast<size_t>(q * kSamples) - 1]);
+        // percentileNanos会按TscClock换算 这里直接用桶算原始值
+        int64_t rank = static_cast<int64_t>(q * s.count + 0.5), seen = 0;
+        double approx = 0;
+        for (int i = 0; i < Histogram::kBuckets; i++)
+        {
+            seen += s.counts[i];
+            if (seen >= rank)
+            {
+                approx = static_cast<double>(Histogram::bucketLowerBound(i) + Histogram::bucketWidth(i) / 2);
+                break;
+            }
+        }
+        worst = std::max(worst, std::fabs(approx - exact) / exact);
+    }
+    fprintf(stderr, "histogram_bench record_ns=%.2f samples=%d worst_relative_error=%.4f buckets=%d\n",
+            recordNs, kSamples, worst, Histogram::kBuckets);
+    return worst < 0.035;
+}
+
+int main(int argc, char *argv[])
+{
+    int conns = argc > 1 ? atoi(argv[1]) : 4;
+    int seconds = argc > 2 ? atoi(argv[2]) : 2;
+    uint16_t port = static_cast<uint16_t>(argc > 3 ? atoi(argv[3]) : 9986);
+
+    bool ok = accuracy();
+    Logger::setLogLevel(ERROR);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "127.0.0.1"), "histogram");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setThreadNum(2);
+    server.start();
+
+    std::atomic_bool stop(false);
+    std::atomic<long> rounds(0);
+    std::vector<std::thread> clients;
+    for (int c = 0; c < conns; c++)
+    {
+        clients.push_back(std::thread([&]() {
+            int fd = connectTo(port);
+            char msg[64] = {0};
+            while (!stop)
+            {
+                ::write(fd, msg, sizeof msg);
+                size_t got = 0;
+                while (got < sizeof msg)
+                {
+                    ssize_t n = ::read(fd, msg + got, sizeof msg - got);
+                    if (n <= 0)
+                    {
+                        return;
+                    }
+                    got += n;
+                }
+                rounds++;
+            }
+            ::close(fd);
+        }));
+    }
+    // 往baseloop投递functor 记录functor的排队延迟
+    std::thread poster([&]() {
+        while (!stop)
+        {
+            loop.queueLoop([]() {});
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    });
+
+    std::thread timer([&]() {
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        stop = true;
+        loop.queueLoop([&]() {
+            fprintf(stderr, "histogram_bench rounds=%ld\n%s", rounds.load(), server.statsDump().c_str());
+            loop.quit();
+        });
+    });
+
+    loop.loop();
+    timer.join();
+    poster.join();
+    for (std::thread &t : clients)
+    {
+        t.join();
+    }
+    return ok ? 0 : 1;
+}
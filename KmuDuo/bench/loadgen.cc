@@ -0,0 +1,100 @@
+// 压测客户端 LoadGenerator的命令行
+// 对host:port上的echo类服务器发msgSize字节的请求 预热1秒以后统计seconds秒
+// rate为0是闭环(每个连接保持pipeline个请求在路上) 大于0是开环 所有连接合起来每秒rate个请求
+// serverLoops>=0的时候在进程里面起一个有serverLoops个subloop的echo服务器 自己压自己 不用另外起服务器
+//
+// 用法: loadgen [threads=1] [conns=16] [msgSize=64] [pipeline=1] [rate=0] [seconds=5] [port=9993] [host=127.0.0.1] [serverLoops=-1]
+//   loadgen 2 64 64 16 0 5 9993 127.0.0.1 2        闭环 64个连接 每个16个请求在路上
+//   loadgen 1 16 64 1 50000 5 9993 127.0.0.1 1     开环 每秒5万个请求
+#include "BenchUtil.h"
+#include "LoadGenerator.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "TcpServer.h"
+#include "CountDownLatch.h"
+#include "logger.h"
+#include <memory>
+#include <string>
+#include <thread>
+
+static void onConnection(const TcpConnectionPtr &)
+{
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = static_cast<int>(bench::argOr(argc, argv, 1, 1));
+    int conns = static_cast<int>(bench::argOr(argc, argv, 2, 16));
+    int msgSize = static_cast<int>(bench::argOr(argc, argv, 3, 64));
+    int pipeline = static_cast<int>(bench::argOr(argc, argv, 4, 1));
+    double rate = argc > 5 ? atof(argv[5]) : 0;
+    double seconds = argc > 6 ? atof(argv[6]) : 5;
+    uint16_t port = static_cast<uint16_t>(bench::argOr(argc, argv, 7, 9993));
+    std::string host = argc > 8 ? argv[8] : "127.0.0.1";
+    int serverLoops = static_cast<int>(bench::argOr(argc, argv, 9, -1));
+    const double warmup = 1;
+    Logger::setLogLevel(ERROR);
+
+    // 进程内的echo服务器 在自己的loop线程里面创建和启动
+    EventLoopThread serverThread;
+    std::unique_ptr<TcpServer> server;
+    if (serverLoops >= 0)
+    {
+        EventLoop *serverLoop = serverThread.startloop();
+        CountDownLatch latch(1);
+        serverLoop->runInLoop([&]() {
+            server.reset(new TcpServer(serverLoop, InetAddress(port, host), "loadgen_server"));
+            server->setConnectionCallback(onConnection);
+            server->setMessageCallback(onMessage);
+            server->setThreadNum(serverLoops);
+            server->start();
+            latch.countDown();
+        });
+        latch.wait();
+    }
+
+    LoadGenerator::Options options;
+    options.connections = conns;
+    options.pipeline = pipeline;
+    options.mode = rate > 0 ? LoadGenerator::kOpenLoop : LoadGenerator::kClosedLoop;
+    options.rate = rate;
+    options.requests.push_back(std::string(msgSize, 'x'));
+
+    EventLoop loop;
+    LoadGenerator generator(&loop, InetAddress(port, host), options, "loadgen");
+    generator.setThreadNum(threads);
+    generator.start();
+
+    LoadGenerator::Result result;
+    std::thread control([&]() {
+        ::usleep(static_cast<useconds_t>(warmup * 1000000));
+        generator.resetStats();
+        ::usleep(static_cast<useconds_t>(seconds * 1000000));
+        result = generator.stop();
+        loop.quit();
+    });
+    loop.loop();
+    control.join();
+
+    bench::report("loadgen", "mode=%s threads=%d conns=%d msg_size=%d pipeline=%d target_rate=%.0f server_loops=%d %s",
+                  rate > 0 ? "open" : "closed", threads, conns, msgSize, pipeline, rate, serverLoops,
+                  result.toString().c_str());
+
+    if (server)
+    {
+        // TcpServer在它自己的loop线程里面析构
+        CountDownLatch latch(1);
+        EventLoop *serverLoop = server->getLoop();
+        serverLoop->runInLoop([&]() {
+            server.reset();
+            latch.countDown();
+        });
+        latch.wait();
+    }
+    return result.errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+// 日志吞吐和写日志的线程(io loop)上的单次调用延迟
+// sync:  每一行都fwrite+fflush到文件(原来std::cout<<std::endl的行为)
+// async: AsyncLogging 双缓冲 后台线程writev
+//
+// 用法: log_bench [threads=4] [linesPerThread=200000] [file=/tmp/mymuduo_log_bench.log]
+#include "logger.h"
+#include "AsyncLogging.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static int64_t percentile(std::vector<int64_t> &v, double p)
+{
+    if (v.empty())
+    {
+        return 0;
+    }
+    size_t idx = std::min(v.size() - 1, static_cast<size_t>(v.size() * p));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+static void run(const char *mode, int threads, int lines)
+{
+    std::vector<std::vector<int64_t>> latency(threads);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+    {
+        workers.push_back(std::thread([t, lines, &latency]() {
+            std::vector<int64_t> &lat = latency[t];
+            lat.reserve(lines);
+            for (int i = 0; i < lines; i++)
+            {
+                auto s = std::chrono::steady_clock::now();
+                LOG_INFO("func=%s fd=%d event=%d index=%d", "updateChannel", t, i, 1);
+                lat.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s).count());
+            }
+        }));
+    }
+    for (std::thread &w : workers)
+    {
+        w.join();
+    }
+    Logger::instance().flush();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<int64_t> all;
+    for (auto &v : latency)
+    {
+        all.insert(all.end(), v.begin(), v.end());
+    }
+    int64_t p50 = percentile(all, 0.50);
+    int64_t p99 = percentile(all, 0.99);
+    int64_t max = *std::max_element(all.begin(), all.end());
+    fprintf(stderr, "log mode=%s threads=%d lines=%ld lines_per_s=%.0f call_p50_ns=%ld call_p99_ns=%ld call_max_ns=%ld\n",
+            mode, threads, static_cast<long>(all.size()), all.size() / sec, p50, p99, max);
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    int lines = argc > 2 ? atoi(argv[2]) : 200000;
+    std::string file = argc > 3 ? argv[3] : "/tmp/mymuduo_log_bench.log";
+
+    {
+        ::unlink(file.c_str());
+        FILE *fp = fopen(file.c_str(), "a");
+        Logger::instance().setOutput([fp](const char *msg, size_t len) {
+            fwrite(msg, 1, len, fp);
+            fflush(fp);
+        });
+        Logger::instance().setFlush([fp]() { fflush(fp); });
+        run("sync", threads, lines);
+        fclose(fp);
+    }
+
+    {
+        ::unlink(file.c_str());
+        AsyncLogging log(file);
+        log.start();
+        Logger::instance().setOutput(std::bind(&AsyncLogging::append, &log, std::placeholders::_1, std::placeholders::_2));
+        Logger::instance().setFlush(std::bind(&AsyncLogging::flush, &log));
+        run("async", threads, lines);
+        Logger::instance().setOutput([](const char *msg, size_t len) { fwrite(msg, 1, len, stdout); });
+        Logger::instance().setFlush(Logger::FlushFunc());
+        fprintf(stderr, "log mode=async dropped=%ld\n", log.dropped());
+    }
+    return 0;
+}
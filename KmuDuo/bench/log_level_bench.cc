@@ -0,0 +1,105 @@
+// 关掉INFO以后每条日志/每个事件的开销
+// 1. 微基准: EPollPoller::poll里面那条LOG_INFO 运行时级别为ERROR(关闭)和DEBUG(打开 输出到空函数)各调用N次
+// 2. 单连接echo pingpong: 同一个进程里运行时切换日志级别 对比每次往返的耗时(每次往返会经过好几条事件日志)
+//
+// 用法: log_level_bench [calls=10000000] [port=9985]   stdout重定向到/dev/null
+#include "TcpServer.h"
+#include "logger.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static double nsPerCall(int level, long calls)
+{
+    Logger::setLogLevel(level);
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < calls; i++)
+    {
+        LOG_INFO("func=%s , fd total count %ld\n", "poll", i);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+}
+
+static void onConnection(const TcpConnectionPtr &)
+{
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+static double usPerRoundTrip(int fd, int level, int rounds)
+{
+    Logger::setLogLevel(level);
+    char msg[64] = {0};
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        ::write(fd, msg, sizeof msg);
+        size_t got = 0;
+        while (got < sizeof msg)
+        {
+            ssize_t n = ::read(fd, msg + got, sizeof msg - got);
+            if (n <= 0)
+            {
+                return 0;
+            }
+            got += n;
+        }
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rounds;
+}
+
+int main(int argc, char *argv[])
+{
+    long calls = argc > 1 ? atol(argv[1]) : 10000000;
+    uint16_t port = static_cast<uint16_t>(argc > 2 ? atoi(argv[2]) : 9985);
+
+    Logger::instance().setOutput([](const char *, size_t) {});
+    double off = nsPerCall(ERROR, calls);
+    double on = nsPerCall(DEBUG, calls / 10);
+    fprintf(stderr, "log_level call info_disabled_ns=%.2f info_enabled_null_sink_ns=%.1f\n", off, on);
+    Logger::instance().setOutput([](const char *msg, size_t len) { fwrite(msg, 1, len, stdout); });
+    Logger::setLogLevel(DEBUG);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "127.0.0.1"), "loglevel");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.start();
+
+    std::thread client([&]() {
+        ::usleep(100 * 1000);
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        if (::connect(fd, (sockaddr *)&addr, sizeof addr) < 0)
+        {
+            perror("connect");
+            exit(1);
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+        usPerRoundTrip(fd, DEBUG, 1000); // 预热
+        double enabled = usPerRoundTrip(fd, DEBUG, 50000);
+        double disabled = usPerRoundTrip(fd, ERROR, 50000);
+        fprintf(stderr, "log_level pingpong info_enabled_us=%.2f info_disabled_us=%.2f\n", enabled, disabled);
+        ::close(fd);
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+    return 0;
+}
@@ -0,0 +1,144 @@
+// 滚动日志文件(LogFile: fallocate预分配 + mmap写)的持续写入速度 和固定速率写日志时io线程上的停顿
+// 1. 不限速: threads个线程各写lines行 输出MB/s  对比AsyncLogging直接writev到一个文件
+// 2. 限速: 两个线程一共每秒rate行 跑5秒 输出每次LOG_INFO调用的p99和最大耗时(io loop会卡住的时间)
+//
+// 用法: log_roll_bench [dir=/tmp/mymuduo_roll] [threads=4] [lines=500000] [rate=200000]
+#include "logger.h"
+#include "AsyncLogging.h"
+#include "LogFile.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static std::atomic<long> g_bytes(0);
+
+static int64_t percentile(std::vector<int64_t> &v, double p)
+{
+    if (v.empty())
+    {
+        return 0;
+    }
+    size_t idx = std::min(v.size() - 1, static_cast<size_t>(v.size() * p));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+static void attach(AsyncLogging *log)
+{
+    Logger::instance().setOutput([log](const char *msg, size_t len) {
+        g_bytes.fetch_add(len, std::memory_order_relaxed);
+        log->append(msg, len);
+    });
+    Logger::instance().setFlush(std::bind(&AsyncLogging::flush, log));
+}
+
+static void detach()
+{
+    Logger::instance().setOutput([](const char *msg, size_t len) { fwrite(msg, 1, len, stdout); });
+    Logger::instance().setFlush(Logger::FlushFunc());
+}
+
+static void throughput(const char *mode, AsyncLogging *log, int threads, int lines)
+{
+    attach(log);
+    g_bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+    {
+        workers.push_back(std::thread([t, lines]() {
+            for (int i = 0; i < lines; i++)
+            {
+                LOG_INFO("TcpConnection::handleRead fd=%d bytes=%d state=%d name=%s", t, i, 2, "server-127.0.0.1:8000#1");
+            }
+        }));
+    }
+    for (std::thread &w : workers)
+    {
+        w.join();
+    }
+    Logger::instance().flush();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "log_roll throughput mode=%s threads=%d lines=%d mb_per_s=%.1f lines_per_s=%.0f dropped=%ld\n",
+            mode, threads, threads * lines, g_bytes / sec / 1e6, threads * lines / sec, log->dropped());
+    detach();
+}
+
+static void paced(const char *mode, AsyncLogging *log, int rate)
+{
+    attach(log);
+    const int kThreads = 2;
+    const int kSeconds = 5;
+    std::vector<std::vector<int64_t>> latency(kThreads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < kThreads; t++)
+    {
+        workers.push_back(std::thread([t, rate, &latency]() {
+            long perThread = static_cast<long>(rate) / kThreads;
+            auto begin = std::chrono::steady_clock::now();
+            for (long i = 0; i < perThread * kSeconds; i++)
+            {
+                // 按计划的时间发 提前了就等一等
+                auto due = begin + std::chrono::nanoseconds(i * 1000000000L / perThread);
+                while (std::chrono::steady_clock::now() < due)
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+                auto s = std::chrono::steady_clock::now();
+                LOG_INFO("TcpConnection::handleRead fd=%d bytes=%ld state=%d name=%s", t, i, 2, "server-127.0.0.1:8000#1");
+                latency[t].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s).count());
+            }
+        }));
+    }
+    for (std::thread &w : workers)
+    {
+        w.join();
+    }
+    Logger::instance().flush();
+    std::vector<int64_t> all;
+    for (auto &v : latency)
+    {
+        all.insert(all.end(), v.begin(), v.end());
+    }
+    int64_t p99 = percentile(all, 0.99);
+    int64_t p999 = percentile(all, 0.999);
+    int64_t max = *std::max_element(all.begin(), all.end());
+    fprintf(stderr, "log_roll paced mode=%s rate=%d lines=%zu call_p99_ns=%ld call_p999_ns=%ld call_max_ns=%ld dropped=%ld\n",
+            mode, rate, all.size(), p99, p999, max, log->dropped());
+    detach();
+}
+
+int main(int argc, char *argv[])
+{
+    std::string dir = argc > 1 ? argv[1] : "/tmp/mymuduo_roll";
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    int lines = argc > 3 ? atoi(argv[3]) : 500000;
+    int rate = argc > 4 ? atoi(argv[4]) : 200000;
+    ::mkdir(dir.c_str(), 0755);
+
+    {
+        std::string file = dir + "/plain.log";
+        ::unlink(file.c_str());
+        AsyncLogging log(file, 1);
+        log.start();
+        throughput("writev", &log, threads, lines);
+        paced("writev", &log, rate);
+    }
+    {
+        AsyncLogging log("", 1);
+        // 64MB一段 最多保留4段 每秒fdatasync一次
+        log.setLogFile(std::unique_ptr<LogFile>(new LogFile(dir + "/roll", 64 * 1024 * 1024, 24 * 60 * 60, 1, 4)));
+        log.start();
+        throughput("mmap-roll", &log, threads, lines);
+        paced("mmap-roll", &log, rate);
+    }
+    return 0;
+}
@@ -0,0 +1,216 @@
+// 内置指标端点
+// 两个subloop的echo服务器 conns个连接pingpong  先不抓取跑seconds秒 再每intervalMs毫秒抓取一次/metrics跑seconds秒
+// 输出两段的往返耗时p50/p99 抓取一次的耗时 和指标的行数 检查每一行都是合法的文本格式
+// 最后在baseloop里面测一下render()本身的耗时
+//
+// 用法: metrics_bench [conns=4] [seconds=2] [intervalMs=5] [port=9987]   stdout重定向到/dev/null
+#include "MetricsServer.h"
+#include "TcpServer.h"
+#include "logger.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static void onConnection(const TcpConnectionPtr &)
+{
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+static int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(fd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    return fd;
+}
+
+static std::string scrape(uint16_t port)
+{
+    int fd = connectTo(port);
+    const char req[] = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ::write(fd, req, sizeof req - 1);
+    std::string resp;
+    char buf[16384];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0)
+    {
+        resp.append(buf, n);
+    }
+    ::close(fd);
+    return resp;
+}
+
+// 每一行要么是#开头的注释 要么是 名字{标签} 数值
+static bool validate(const std::string &resp, int *lines)
+{
+    size_t body = resp.find("\r\n\r\n");
+    if (resp.compare(0, 15, "HTTP/1.1 200 OK") != 0 || body == std::string::npos)
+    {
+        return false;
+    }
+    *lines = 0;
+    size_t pos = body + 4;
+    while (pos < resp.size())
+    {
+        size_t end = resp.find('\n', pos);
+        if (end == std::string::npos)
+        {
+            return false;
+        }
+        std::string line = resp.substr(pos, end - pos);
+        pos = end + 1;
+        ++*lines;
+        if (line[0] == '#')
+        {
+            continue;
+        }
+        size_t close = line.find("} ");
+        if (line.find('{') == std::string::npos || close == std::string::npos)
+        {
+            return false;
+        }
+        char *stop = nullptr;
+        strtod(line.c_str() + close + 2, &stop);
+        if (stop == line.c_str() + close + 2 || *stop != '\0')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static double percentile(std::vector<double> v, double q)
+{
+    if (v.empty())
+    {
+        return 0;
+    }
+    size_t idx = std::min(v.size() - 1, static_cast<size_t>(v.size() * q));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+int main(int argc, char *argv[])
+{
+    int conns = argc > 1 ? atoi(argv[1]) : 4;
+    int seconds = argc > 2 ? atoi(argv[2]) : 2;
+    int intervalMs = argc > 3 ? atoi(argv[3]) : 5;
+    uint16_t port = static_cast<uint16_t>(argc > 4 ? atoi(argv[4]) : 9987);
+    uint16_t metricsPort = static_cast<uint16_t>(port + 1);
+
+    Logger::setLogLevel(ERROR);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "127.0.0.1"), "echo");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setThreadNum(2);
+    server.start();
+    MetricsServer metrics(&server, InetAddress(metricsPort, "127.0.0.1"));
+    metrics.start();
+
+    std::thread driver([&]() {
+        std::atomic_int phase(0); // 0 不抓取 1 抓取 2 结束
+        std::mutex mutex;
+        std::vector<double> rtt[2];
+        std::vector<std::thread> clients;
+        for (int c = 0; c < conns; c++)
+        {
+            clients.push_back(std::thread([&]() {
+                int fd = connectTo(port);
+                char msg[64] = {0};
+                std::vector<double> local[2];
+                int p;
+                while ((p = phase.load()) < 2)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    ::write(fd, msg, sizeof msg);
+                    size_t got = 0;
+                    while (got < sizeof msg)
+                    {
+                        ssize_t n = ::read(fd, msg + got, sizeof msg - got);
+                        if (n <= 0)
+                        {
+                            return;
+                        }
+                        got += n;
+                    }
+                    local[p].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+                }
+                ::close(fd);
+                std::lock_guard<std::mutex> lock(mutex);
+                for (int i = 0; i < 2; i++)
+                {
+                    rtt[i].insert(rtt[i].end(), local[i].begin(), local[i].end());
+                }
+            }));
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        phase = 1;
+        std::vector<double> scrapeUs;
+        bool valid = true;
+        int lines = 0;
+        auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+        while (std::chrono::steady_clock::now() < end)
+        {
+            auto start = std::chrono::steady_clock::now();
+            std::string resp = scrape(metricsPort);
+            scrapeUs.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            valid = valid && validate(resp, &lines);
+            std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+        }
+        phase = 2;
+        for (std::thread &t : clients)
+        {
+            t.join();
+        }
+        std::string last = scrape(metricsPort);
+        fprintf(stderr, "metrics_bench no_scrape rtt_p50_us=%.1f rtt_p99_us=%.1f rounds=%zu\n",
+                percentile(rtt[0], 0.5), percentile(rtt[0], 0.99), rtt[0].size());
+        fprintf(stderr, "metrics_bench scraping rtt_p50_us=%.1f rtt_p99_us=%.1f rounds=%zu scrapes=%zu scrape_p50_us=%.0f scrape_p99_us=%.0f lines=%d valid=%d\n",
+                percentile(rtt[1], 0.5), percentile(rtt[1], 0.99), rtt[1].size(), scrapeUs.size(),
+                percentile(scrapeUs, 0.5), percentile(scrapeUs, 0.99), lines, valid ? 1 : 0);
+        size_t body = last.find("\r\n\r\n");
+        fprintf(stderr, "%s", body == std::string::npos ? last.c_str() : last.c_str() + body + 4);
+        // 在baseloop里面单独测一次生成指标文本的耗时
+        loop.queueLoop([&]() {
+            const int kRenders = 200;
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < kRenders; i++)
+            {
+                metrics.render();
+            }
+            fprintf(stderr, "metrics_bench render_us=%.1f\n",
+                    std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / kRenders);
+            loop.quit();
+        });
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
@@ -0,0 +1,204 @@
+// 1%的昂贵请求混在对延迟敏感的echo里面 对比在io loop上直接处理(inline)和offload到ComputePool
+// 请求第一个字节是'!'的是昂贵请求 处理时要忙等expensiveUs微秒(模拟压缩/加解密/JSON)
+// 先inline跑3秒 再offload跑3秒 分别输出普通请求的p50/p99/p999
+//
+// 用法: offload_bench [loops=2] [workers=2] [conns=32] [msgSize=64] [expensiveUs=2000] [port=9983]
+#include "TcpServer.h"
+#include "ComputePool.h"
+#include "logger.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// 0: 预热 1: inline 2: 切换 3: offload 4: 结束
+static std::atomic<int> g_phase(0);
+static int g_msgSize = 64;
+static int g_expensiveUs = 2000;
+
+static void onConnection(const TcpConnectionPtr &)
+{
+}
+
+static std::string expensive(const std::string &req)
+{
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::microseconds(g_expensiveUs))
+    {
+    }
+    return req;
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    while (buf->readableBytes() >= static_cast<size_t>(g_msgSize))
+    {
+        std::string req = buf->retrieveAsString(g_msgSize);
+        if (req[0] != '!')
+        {
+            conn->send(req);
+        }
+        else if (g_phase < 3)
+        {
+            conn->send(expensive(req));
+        }
+        else
+        {
+            conn->offload(std::bind(expensive, req));
+        }
+    }
+}
+
+static int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(fd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    return fd;
+}
+
+static void client(int fd, int seed, std::vector<int64_t> *lat1, std::vector<int64_t> *lat3)
+{
+    std::mt19937 rng(seed);
+    std::string cheap(g_msgSize, 'x');
+    std::string costly(g_msgSize, 'x');
+    costly[0] = '!';
+    std::vector<char> reply(g_msgSize);
+    int phase;
+    while ((phase = g_phase) != 4)
+    {
+        bool isExpensive = rng() % 100 == 0;
+        const std::string &msg = isExpensive ? costly : cheap;
+        auto start = std::chrono::steady_clock::now();
+        if (::write(fd, msg.data(), msg.size()) != (ssize_t)msg.size())
+        {
+            break;
+        }
+        size_t got = 0;
+        while (got < reply.size())
+        {
+            ssize_t n = ::read(fd, &reply[got], reply.size() - got);
+            if (n <= 0)
+            {
+                return;
+            }
+            got += n;
+        }
+        int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        if (!isExpensive && phase == 1)
+        {
+            lat1->push_back(us);
+        }
+        else if (!isExpensive && phase == 3)
+        {
+            lat3->push_back(us);
+        }
+    }
+}
+
+static int64_t percentile(std::vector<int64_t> &v, double p)
+{
+    if (v.empty())
+    {
+        return 0;
+    }
+    size_t idx = std::min(v.size() - 1, static_cast<size_t>(v.size() * p));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = argc > 1 ? atoi(argv[1]) : 2;
+    int workers = argc > 2 ? atoi(argv[2]) : 2;
+    int conns = argc > 3 ? atoi(argv[3]) : 32;
+    g_msgSize = argc > 4 ? atoi(argv[4]) : 64;
+    g_expensiveUs = argc > 5 ? atoi(argv[5]) : 2000;
+    uint16_t port = static_cast<uint16_t>(argc > 6 ? atoi(argv[6]) : 9983);
+
+    ComputePool pool;
+    pool.start(workers);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "127.0.0.1"), "offload");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setComputePool(&pool);
+    server.setThreadNum(loops);
+    server.start();
+
+    std::thread control([&]() {
+        ::usleep(100 * 1000);
+        std::vector<int> fds;
+        for (int i = 0; i < conns; i++)
+        {
+            fds.push_back(connectTo(port));
+        }
+        std::vector<std::vector<int64_t>> lat1(conns), lat3(conns);
+        std::vector<std::thread> clients;
+        for (int i = 0; i < conns; i++)
+        {
+            clients.push_back(std::thread(client, fds[i], i + 1, &lat1[i], &lat3[i]));
+        }
+
+        ::usleep(500 * 1000);
+        g_phase = 1;
+        ::usleep(3000 * 1000);
+        g_phase = 2;
+        ::usleep(200 * 1000);
+        g_phase = 3;
+        ::usleep(3000 * 1000);
+        g_phase = 4;
+        for (std::thread &t : clients)
+        {
+            t.join();
+        }
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+
+        std::vector<int64_t> all[2];
+        for (int i = 0; i < conns; i++)
+        {
+            all[0].insert(all[0].end(), lat1[i].begin(), lat1[i].end());
+            all[1].insert(all[1].end(), lat3[i].begin(), lat3[i].end());
+        }
+        const char *names[2] = {"inline", "offload"};
+        for (int i = 0; i < 2; i++)
+        {
+            size_t n = all[i].size();
+            int64_t p50 = percentile(all[i], 0.50);
+            int64_t p99 = percentile(all[i], 0.99);
+            int64_t p999 = percentile(all[i], 0.999);
+            fprintf(stderr, "offload mode=%s loops=%d workers=%d conns=%d cheap_requests=%zu p50_us=%ld p99_us=%ld p999_us=%ld\n",
+                    names[i], loops, workers, conns, n, p50, p99, p999);
+        }
+        fprintf(stderr, "offload stolen=%ld\n", pool.stolen());
+        loop.quit();
+    });
+
+    loop.loop();
+    control.join();
+    return 0;
+}
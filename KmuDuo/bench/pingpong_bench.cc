@@ -0,0 +1,89 @@
+// pingpong往返延迟
+// loops个subloop的echo服务器 clientThreads个客户端线程一共conns个连接 每个连接发一条msgSize字节的消息 收齐回显再发下一条
+// 先预热warmup秒(不记录) 再跑seconds秒 记录每一条的往返时间 输出精确的分位数
+//
+// 用法: pingpong_bench [loops=1] [conns=1] [msgSize=64] [seconds=3] [clientThreads=1] [port=9991]   stdout重定向到/dev/null
+#include "BenchUtil.h"
+#include "TcpServer.h"
+#include "logger.h"
+#include <memory>
+#include <thread>
+#include <vector>
+
+static void onConnection(const TcpConnectionPtr &)
+{
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = static_cast<int>(bench::argOr(argc, argv, 1, 1));
+    int conns = static_cast<int>(bench::argOr(argc, argv, 2, 1));
+    int msgSize = static_cast<int>(bench::argOr(argc, argv, 3, 64));
+    double seconds = static_cast<double>(bench::argOr(argc, argv, 4, 3));
+    int clientThreads = static_cast<int>(bench::argOr(argc, argv, 5, 1));
+    uint16_t port = static_cast<uint16_t>(bench::argOr(argc, argv, 6, 9991));
+    const double warmup = 0.5;
+    Logger::setLogLevel(ERROR);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "127.0.0.1"), "pingpong_bench");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setThreadNum(loops);
+    server.start();
+
+    std::thread control([&]() {
+        std::vector<std::unique_ptr<bench::PingpongClient>> clients;
+        for (int i = 0; i < clientThreads; i++)
+        {
+            int n = conns / clientThreads + (i < conns % clientThreads ? 1 : 0);
+            clients.push_back(std::unique_ptr<bench::PingpongClient>(new bench::PingpongClient(port, n, msgSize)));
+        }
+
+        // 每个客户端线程自己记录 结束以后再合并 线程之间不共享任何东西
+        std::vector<std::vector<int64_t>> rtts(clientThreads);
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < clientThreads; i++)
+        {
+            bench::PingpongClient *client = clients[i].get();
+            std::vector<int64_t> *rtt = &rtts[i];
+            threads.push_back(std::thread([client, rtt, seconds, warmup]() {
+                client->run(warmup, nullptr);
+                rtt->reserve(1 << 20);
+                client->run(seconds, rtt);
+            }));
+        }
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+        double elapsed = bench::secondsSince(start) - warmup;
+
+        std::vector<int64_t> all;
+        int connected = 0, errors = 0;
+        for (int i = 0; i < clientThreads; i++)
+        {
+            all.insert(all.end(), rtts[i].begin(), rtts[i].end());
+            connected += clients[i]->connected();
+            errors += clients[i]->errors();
+        }
+        size_t samples = all.size();
+        std::string summary = bench::latencySummary(all);
+        bench::report("pingpong", "loops=%d conns=%d msg_size=%d seconds=%.2f client_threads=%d connected=%d errors=%d "
+                                  "round_trips=%zu round_trips_per_s=%.0f %s",
+                      loops, conns, msgSize, elapsed, clientThreads, connected, errors,
+                      samples, samples / elapsed, summary.c_str());
+        clients.clear();
+        loop.quit();
+    });
+
+    loop.loop();
+    control.join();
+    return 0;
+}
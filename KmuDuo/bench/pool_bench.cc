@@ -0,0 +1,225 @@
+// TcpConnectionPool 经过连接池发请求和每个请求新建一个连接的对比
+// serverLoops个subloop的echo服务器 clientLoops个客户端loop 每个loop上chains条请求链
+// 每条链: acquire -> 发msgSize字节 -> 收齐回显 -> release -> 下一个 同一时间每条链一个请求在路上
+// latency从acquire开始算到收齐回显 包括等连接/建连接的时间
+// 三种模式:
+//   pooled       每个loop用自己的子池 连接复用
+//   per_request  用完discard 每个请求都要新建连接(connect+accept+关闭)
+//   shared_loop  所有链都从loop0的子池拿连接 收发在loop0上 完了再投递回自己的loop 看没有loop亲和的跨线程代价
+//
+// 用法: pool_bench [clientLoops=2] [chains=8] [msgSize=64] [seconds=2] [serverLoops=1] [port=9997]   stdout重定向到/dev/null
+#include "BenchUtil.h"
+#include "TcpConnectionPool.h"
+#include "TcpConnection.h"
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "CountDownLatch.h"
+#include "logger.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static void onServerConnection(const TcpConnectionPtr &)
+{
+}
+
+static void onEcho(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+struct Chain
+{
+    EventLoop *home;     // 请求链自己的loop
+    EventLoop *poolLoop; // 从哪个loop的子池拿连接
+    int64_t start;
+    std::vector<int64_t> latency;
+    int64_t errors;
+};
+
+struct Run
+{
+    TcpConnectionPool *pool;
+    bool discard;
+    InetAddress addr;
+    std::string message;
+    std::atomic<bool> stopping;
+    std::atomic<int> finished;
+};
+
+static void next(Run *run, Chain *chain);
+
+static void onAcquired(Run *run, Chain *chain, const TcpConnectionPtr &conn)
+{
+    if (!conn)
+    {
+        chain->errors++;
+        chain->home->queueLoop(std::bind(next, run, chain));
+        return;
+    }
+    size_t size = run->message.size();
+    conn->setMessageCallback([run, chain, size](const TcpConnectionPtr &c, Buffer *buf, Timestamp) {
+        if (buf->readableBytes() < size)
+        {
+            return;
+        }
+        buf->retrieve(size);
+        chain->latency.push_back(bench::nowNanos() - chain->start);
+        if (run->discard)
+        {
+            run->pool->discard(c);
+        }
+        else
+        {
+            run->pool->release(c);
+        }
+        if (chain->home->isInLoopThread())
+        {
+            next(run, chain);
+        }
+        else
+        {
+            chain->home->queueLoop(std::bind(next, run, chain));
+        }
+    });
+    conn->send(run->message);
+}
+
+static void next(Run *run, Chain *chain)
+{
+    if (run->stopping)
+    {
+        run->finished++;
+        return;
+    }
+    chain->start = bench::nowNanos();
+    run->pool->acquire(chain->poolLoop, run->addr, std::bind(onAcquired, run, chain, std::placeholders::_1));
+}
+
+static void runMode(const char *mode, const std::vector<EventLoop *> &loops, int chainsPerLoop,
+                    int msgSize, double seconds, uint16_t port)
+{
+    TcpConnectionPool::Options options;
+    options.maxPerHost = chainsPerLoop * static_cast<int>(loops.size());
+    options.maxIdle = options.maxPerHost;
+    std::unique_ptr<TcpConnectionPool> pool(new TcpConnectionPool(options, mode));
+
+    Run run;
+    run.pool = pool.get();
+    run.discard = std::string(mode) == "per_request";
+    run.addr = InetAddress(port, "127.0.0.1");
+    run.message = std::string(msgSize, 'x');
+    run.stopping = false;
+    run.finished = 0;
+
+    std::vector<std::unique_ptr<Chain>> chains;
+    for (EventLoop *loop : loops)
+    {
+        for (int i = 0; i < chainsPerLoop; i++)
+        {
+            std::unique_ptr<Chain> chain(new Chain);
+            chain->home = loop;
+            chain->poolLoop = std::string(mode) == "shared_loop" ? loops[0] : loop;
+            chain->start = 0;
+            chain->errors = 0;
+            chain->latency.reserve(1 << 18);
+            chains.push_back(std::move(chain));
+        }
+    }
+
+    // 预热0.3秒 让池子里面的连接建好 然后清掉记录再测
+    for (auto &chain : chains)
+    {
+        Chain *c = chain.get();
+        c->home->queueLoop(std::bind(next, &run, c));
+    }
+    ::usleep(300 * 1000);
+    for (auto &chain : chains)
+    {
+        Chain *c = chain.get();
+        CountDownLatch latch(1);
+        c->home->runInLoop([c, &latch]() {
+            c->latency.clear();
+            c->errors = 0;
+            latch.countDown();
+        });
+        latch.wait();
+    }
+    TcpConnectionPool::Stats before = pool->stats();
+    auto start = std::chrono::steady_clock::now();
+    ::usleep(static_cast<useconds_t>(seconds * 1000000));
+    run.stopping = true;
+    double elapsed = bench::secondsSince(start);
+    while (run.finished < static_cast<int>(chains.size()))
+    {
+        ::usleep(1000);
+    }
+    TcpConnectionPool::Stats after = pool->stats();
+
+    std::vector<int64_t> all;
+    int64_t errors = 0;
+    for (auto &chain : chains)
+    {
+        all.insert(all.end(), chain->latency.begin(), chain->latency.end());
+        errors += chain->errors;
+    }
+    int64_t requests = static_cast<int64_t>(all.size());
+    bench::report("pool", "mode=%s client_loops=%zu chains=%d msg_size=%d requests_per_s=%.0f errors=%lld "
+                          "created=%lld reused=%lld %s",
+                  mode, loops.size(), chainsPerLoop, msgSize, requests / elapsed, (long long)errors,
+                  (long long)(after.created - before.created), (long long)(after.reused - before.reused),
+                  bench::latencySummary(all).c_str());
+    pool.reset();
+}
+
+int main(int argc, char *argv[])
+{
+    int clientLoops = static_cast<int>(bench::argOr(argc, argv, 1, 2));
+    int chains = static_cast<int>(bench::argOr(argc, argv, 2, 8));
+    int msgSize = static_cast<int>(bench::argOr(argc, argv, 3, 64));
+    double seconds = static_cast<double>(bench::argOr(argc, argv, 4, 2));
+    int serverLoops = static_cast<int>(bench::argOr(argc, argv, 5, 1));
+    uint16_t port = static_cast<uint16_t>(bench::argOr(argc, argv, 6, 9997));
+    Logger::setLogLevel(ERROR);
+
+    EventLoopThread serverThread;
+    EventLoop *serverLoop = serverThread.startloop();
+    std::unique_ptr<TcpServer> server;
+    {
+        CountDownLatch latch(1);
+        serverLoop->runInLoop([&]() {
+            server.reset(new TcpServer(serverLoop, InetAddress(port, "127.0.0.1"), "pool_bench_server"));
+            server->setConnectionCallback(onServerConnection);
+            server->setMessageCallback(onEcho);
+            server->setThreadNum(serverLoops);
+            server->start();
+            latch.countDown();
+        });
+        latch.wait();
+    }
+
+    std::vector<std::unique_ptr<EventLoopThread>> clientThreads;
+    std::vector<EventLoop *> loops;
+    for (int i = 0; i < clientLoops; i++)
+    {
+        clientThreads.push_back(std::unique_ptr<EventLoopThread>(new EventLoopThread));
+        loops.push_back(clientThreads.back()->startloop());
+    }
+
+    runMode("pooled", loops, chains, msgSize, seconds, port);
+    runMode("per_request", loops, chains, msgSize, seconds, port);
+    runMode("shared_loop", loops, chains, msgSize, seconds, port);
+
+    // 关掉的连接要在各自的loop上销毁完
+    ::usleep(100 * 1000);
+    clientThreads.clear();
+    CountDownLatch latch(1);
+    serverLoop->runInLoop([&]() {
+        server.reset();
+        latch.countDown();
+    });
+    latch.wait();
+    return 0;
+}
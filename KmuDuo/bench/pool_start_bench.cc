@@ -0,0 +1,79 @@
+// EventLoopThreadPoll 启动耗时
+// 对比 一个一个地startloop(旧的串行启动) 和 EventLoopThreadPoll::start(并行启动,一个latch上等待)
+// 每个线程的ThreadInitCallback模拟预热: 申请并触碰一块内存 再睡1ms
+//
+// 用法: pool_start_bench [loops...]   默认 1 16 128
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "EventLoopThreadPool.h"
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static const size_t kWarmBytes = 256 * 1024;
+
+static void warmUp(EventLoop *)
+{
+    std::vector<char> pool(kWarmBytes);
+    memset(&*pool.begin(), 1, pool.size());
+    ::usleep(1000);
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double serialStart(int numLoops)
+{
+    std::vector<std::unique_ptr<EventLoopThread>> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < numLoops; i++)
+    {
+        threads.push_back(std::unique_ptr<EventLoopThread>(new EventLoopThread(warmUp)));
+        threads.back()->startloop();
+    }
+    return elapsedMs(start);
+}
+
+static double parallelStart(EventLoop *baseloop, int numLoops)
+{
+    EventLoopThreadPoll pool(baseloop, "bench");
+    pool.setThreadNum(numLoops);
+    auto start = std::chrono::steady_clock::now();
+    pool.start(warmUp);
+    return elapsedMs(start);
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<int> sizes;
+    for (int i = 1; i < argc; i++)
+    {
+        sizes.push_back(atoi(argv[i]));
+    }
+    if (sizes.empty())
+    {
+        sizes = {1, 16, 128};
+    }
+
+    EventLoop baseloop;
+    std::vector<std::string> results;
+    for (int n : sizes)
+    {
+        double serial = serialStart(n);
+        double parallel = parallelStart(&baseloop, n);
+        char buf[128];
+        snprintf(buf, sizeof buf, "pool_start loops=%d serial_ms=%.2f parallel_ms=%.2f", n, serial, parallel);
+        results.push_back(buf);
+    }
+    for (const std::string &line : results)
+    {
+        fprintf(stderr, "%s\n", line.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+// 运行时扩缩容io loop 观察echo吞吐的变化
+// 先用initLoops个subloop跑 第2秒扩到peakLoops个(已有连接迁移过去一部分) 第4秒再缩回initLoops个
+// 每500ms输出一次这段时间的请求数
+//
+// 用法: resize_bench [conns=16] [msgSize=64] [initLoops=1] [peakLoops=4] [port=9981]
+#include "TcpServer.h"
+#include "logger.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static std::atomic<long> g_requests(0);
+static std::atomic<bool> g_running(true);
+
+// TcpConnection里面的connectionCallback_必须设置
+static void onConnection(const TcpConnectionPtr &)
+{
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+static void client(uint16_t port, int msgSize)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(fd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+    std::string msg(msgSize, 'x');
+    std::vector<char> reply(msgSize);
+    while (g_running)
+    {
+        if (::write(fd, msg.data(), msg.size()) != (ssize_t)msg.size())
+        {
+            break;
+        }
+        size_t got = 0;
+        while (got < reply.size())
+        {
+            ssize_t n = ::read(fd, &reply[got], reply.size() - got);
+            if (n <= 0)
+            {
+                ::close(fd);
+                return;
+            }
+            got += n;
+        }
+        ++g_requests;
+    }
+    ::close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    int conns = argc > 1 ? atoi(argv[1]) : 16;
+    int msgSize = argc > 2 ? atoi(argv[2]) : 64;
+    int initLoops = argc > 3 ? atoi(argv[3]) : 1;
+    int peakLoops = argc > 4 ? atoi(argv[4]) : 4;
+    uint16_t port = static_cast<uint16_t>(argc > 5 ? atoi(argv[5]) : 9981);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "127.0.0.1"), "resize");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setThreadNum(initLoops);
+    server.start();
+
+    std::thread control([&]() {
+        ::usleep(100 * 1000);
+        std::vector<std::thread> clients;
+        for (int i = 0; i < conns; i++)
+        {
+            clients.push_back(std::thread(client, port, msgSize));
+        }
+
+        int loops = initLoops;
+        long last = g_requests;
+        for (int tick = 1; tick <= 12; tick++)
+        {
+            ::usleep(500 * 1000);
+            long now = g_requests;
+            fprintf(stderr, "resize t_ms=%d loops=%d req_per_s=%ld\n", tick * 500, loops, (now - last) * 2);
+            last = now;
+            if (tick == 4)
+            {
+                loops = peakLoops;
+                server.setThreadNum(loops);
+            }
+            else if (tick == 8)
+            {
+                loops = initLoops;
+                server.setThreadNum(loops);
+            }
+        }
+
+        g_running = false;
+        for (std::thread &t : clients)
+        {
+            t.join();
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    control.join();
+    return 0;
+}
@@ -0,0 +1,27 @@
+#!/bin/bash
+# 依次跑压测套件 每个压测输出一行 bench=<名字> key=value ... 到stdout 可以直接存下来和上一次比较
+# 库自己的日志(stdout)丢掉 压测的结果(stderr)转到stdout
+#
+# 用法: bench/run_suite.sh [build目录=build] [loops=2] [conns=16] [msgSize=4096]
+#   ./bench/run_suite.sh _build 4 64 1024 > result.txt
+
+set -e
+
+BUILD=${1:-build}
+LOOPS=${2:-2}
+CONNS=${3:-16}
+MSG=${4:-4096}
+BIN=$BUILD/bench
+
+$BIN/echo_bench $LOOPS $CONNS $MSG 3 2>&1 >/dev/null
+$BIN/pingpong_bench $LOOPS $CONNS $MSG 3 2>&1 >/dev/null
+$BIN/churn_bench $LOOPS 4 0 2 0 2>&1 >/dev/null
+$BIN/churn_bench $LOOPS 4 0 2 1 2>&1 >/dev/null
+$BIN/runinloop_bench $LOOPS 4 64 200000 2>&1 >/dev/null
+$BIN/client_bench 200 $CONNS 64 2 2>&1 >/dev/null
+$BIN/pool_bench $LOOPS 8 64 2 2>&1 >/dev/null
+$BIN/udp_bench 0 1 64 2 64 0 2>&1 >/dev/null
+$BIN/udp_gso_bench 1200 2 2>&1 >/dev/null
+$BIN/unix_bench 1 64 262144 2 2>&1 >/dev/null
+$BIN/upgrade_bench 4 3 50 2>&1 >/dev/null
+$BIN/drain_bench 32 262144 2000 2 2>&1 >/dev/null
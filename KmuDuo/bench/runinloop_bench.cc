@@ -0,0 +1,79 @@
+// 跨线程runInLoop的吞吐
+// conns个生产者线程 每个往loops个EventLoopThread里面轮流投递count个回调 回调里面带着msgSize字节的数据(按值捕获的string)
+// 输出每秒执行多少个回调 平均每次wakeup执行了多少个回调 以及回调从投递到开始执行的延迟(LoopStats的functorDelay)
+//
+// 用法: runinloop_bench [loops=1] [conns=4] [msgSize=64] [count=200000]   stdout重定向到/dev/null
+#include "BenchUtil.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "logger.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+int main(int argc, char *argv[])
+{
+    int loops = static_cast<int>(bench::argOr(argc, argv, 1, 1));
+    int conns = static_cast<int>(bench::argOr(argc, argv, 2, 4));
+    int msgSize = static_cast<int>(bench::argOr(argc, argv, 3, 64));
+    long count = bench::argOr(argc, argv, 4, 200000);
+    Logger::setLogLevel(ERROR);
+
+    std::vector<std::unique_ptr<EventLoopThread>> threads;
+    std::vector<EventLoop *> targets;
+    for (int i = 0; i < loops; i++)
+    {
+        threads.push_back(std::unique_ptr<EventLoopThread>(new EventLoopThread));
+        targets.push_back(threads.back()->startloop());
+    }
+    // 先校准TscClock 不要让第一次stats()的校准算进测量时间
+    std::vector<LoopStatsSnapshot> before;
+    for (EventLoop *loop : targets)
+    {
+        before.push_back(loop->stats());
+    }
+
+    std::atomic<long> executed(0);
+    std::atomic<size_t> payloadBytes(0);
+    const long total = count * conns;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (int p = 0; p < conns; p++)
+    {
+        producers.push_back(std::thread([&, p]() {
+            std::string payload(msgSize, 'x');
+            for (long i = 0; i < count; i++)
+            {
+                EventLoop *loop = targets[(p + i) % loops];
+                loop->runInLoop([&executed, &payloadBytes, payload]() {
+                    payloadBytes.fetch_add(payload.size(), std::memory_order_relaxed);
+                    executed.fetch_add(1, std::memory_order_relaxed);
+                });
+            }
+        }));
+    }
+    for (std::thread &t : producers)
+    {
+        t.join();
+    }
+    double postSeconds = bench::secondsSince(start);
+    while (executed.load(std::memory_order_relaxed) < total)
+    {
+        std::this_thread::yield();
+    }
+    double elapsed = bench::secondsSince(start);
+
+    LoopStatsSnapshot diff;
+    for (int i = 0; i < loops; i++)
+    {
+        diff.merge(targets[i]->stats() - before[i]);
+    }
+    bench::report("runinloop", "loops=%d conns=%d msg_size=%d count=%ld seconds=%.3f functors_per_s=%.0f post_per_s=%.0f "
+                               "wakeups=%ld functors_per_wakeup=%.1f delay_p50_us=%.1f delay_p99_us=%.1f delay_max_us=%.1f",
+                  loops, conns, msgSize, total, elapsed, total / elapsed, total / postSeconds,
+                  static_cast<long>(diff.wakeups), diff.wakeups > 0 ? static_cast<double>(diff.functors) / diff.wakeups : 0,
+                  diff.functorDelay.percentileNanos(0.50) / 1000.0, diff.functorDelay.percentileNanos(0.99) / 1000.0,
+                  diff.functorDelay.maxNanos() / 1000.0);
+    return payloadBytes.load() == static_cast<size_t>(total) * msgSize ? 0 : 1;
+}
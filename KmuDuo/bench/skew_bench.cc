@@ -0,0 +1,173 @@
+// 90/10 倾斜流量下 后台均衡(TcpServer::enableRebalance)对延迟的影响
+// conns个连接按顺序建立 轮询分配以后 前10%的热连接全部落在第一个subloop上
+// 热连接发大包(hotSize) 其余的发小包(msgSize) 都是pingpong
+// 前3秒不均衡 然后开启均衡 等1秒稳定下来 再测3秒 输出两段的p50/p99
+//
+// 用法: skew_bench [loops=4] [conns=40] [msgSize=64] [hotSize=16384] [busyGap=0.2] [port=9982]
+#include "TcpServer.h"
+#include "logger.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// 0: 预热 1: 不均衡 2: 等待均衡稳定 3: 均衡 4: 结束
+static std::atomic<int> g_phase(0);
+
+static void onConnection(const TcpConnectionPtr &)
+{
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+static int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(fd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    return fd;
+}
+
+// 返回每个阶段的延迟(微秒)
+static void client(int fd, int msgSize, std::vector<int64_t> *before, std::vector<int64_t> *after)
+{
+    std::string msg(msgSize, 'x');
+    std::vector<char> reply(msgSize);
+    int phase;
+    while ((phase = g_phase) != 4)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (::write(fd, msg.data(), msg.size()) != (ssize_t)msg.size())
+        {
+            break;
+        }
+        size_t got = 0;
+        while (got < reply.size())
+        {
+            ssize_t n = ::read(fd, &reply[got], reply.size() - got);
+            if (n <= 0)
+            {
+                return;
+            }
+            got += n;
+        }
+        int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        if (phase == 1)
+        {
+            before->push_back(us);
+        }
+        else if (phase == 3)
+        {
+            after->push_back(us);
+        }
+    }
+}
+
+static int64_t percentile(std::vector<int64_t> &v, double p)
+{
+    if (v.empty())
+    {
+        return 0;
+    }
+    size_t idx = std::min(v.size() - 1, static_cast<size_t>(v.size() * p));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = argc > 1 ? atoi(argv[1]) : 4;
+    int conns = argc > 2 ? atoi(argv[2]) : 40;
+    int msgSize = argc > 3 ? atoi(argv[3]) : 64;
+    int hotSize = argc > 4 ? atoi(argv[4]) : 16384;
+    double busyGap = argc > 5 ? atof(argv[5]) : 0.2;
+    uint16_t port = static_cast<uint16_t>(argc > 6 ? atoi(argv[6]) : 9982);
+    int hotConns = std::max(1, conns / 10);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "127.0.0.1"), "skew");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setThreadNum(loops);
+    server.start();
+
+    std::thread control([&]() {
+        ::usleep(100 * 1000);
+        // 按顺序建立连接 第i*loops个连接都会轮询到第一个subloop上 热连接就用它们
+        std::vector<int> fds;
+        for (int i = 0; i < conns; i++)
+        {
+            fds.push_back(connectTo(port));
+        }
+        std::vector<std::vector<int64_t>> before(conns), after(conns);
+        std::vector<std::thread> clients;
+        int hot = 0;
+        for (int i = 0; i < conns; i++)
+        {
+            bool isHot = (i % loops == 0) && hot < hotConns;
+            hot += isHot ? 1 : 0;
+            clients.push_back(std::thread(client, fds[i], isHot ? hotSize : msgSize, &before[i], &after[i]));
+        }
+
+        ::usleep(500 * 1000);
+        g_phase = 1;
+        ::usleep(3000 * 1000);
+        g_phase = 2;
+        server.enableRebalance(200, busyGap);
+        ::usleep(1000 * 1000);
+        g_phase = 3;
+        ::usleep(3000 * 1000);
+        g_phase = 4;
+        for (std::thread &t : clients)
+        {
+            t.join();
+        }
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+
+        std::vector<int64_t> all[2];
+        for (int i = 0; i < conns; i++)
+        {
+            all[0].insert(all[0].end(), before[i].begin(), before[i].end());
+            all[1].insert(all[1].end(), after[i].begin(), after[i].end());
+        }
+        const char *names[2] = {"static", "rebalanced"};
+        for (int i = 0; i < 2; i++)
+        {
+            size_t n = all[i].size();
+            int64_t p50 = percentile(all[i], 0.50);
+            int64_t p99 = percentile(all[i], 0.99);
+            fprintf(stderr, "skew mode=%s loops=%d conns=%d hot=%d requests=%zu p50_us=%ld p99_us=%ld\n",
+                    names[i], loops, conns, hotConns, n, p50, p99);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    control.join();
+    return 0;
+}
@@ -0,0 +1,282 @@
+// 流水线请求 每个连接同时有depth个请求在路上 服务端处理每个请求要忙等workUs微秒
+// 三种处理方式各跑3秒: inline(io loop上直接处理) offload(ComputePool 不保证顺序) ordered(offloadOrdered 按连接串行)
+// 客户端在fork出来的子进程里面 用一个epoll线程驱动所有连接 检查回复的顺序
+// 请求帧16字节: 8字节序号 + 1字节处理方式 + 填充
+//
+// 用法: strand_bench [conns=10000] [depth=4] [loops=2] [workers=2] [workUs=5] [port=9984]
+#include "TcpServer.h"
+#include "ComputePool.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static const size_t kFrame = 16;
+static int g_workUs = 5;
+
+enum Mode
+{
+    kInline,
+    kOffload,
+    kOrdered,
+};
+
+static void onConnection(const TcpConnectionPtr &)
+{
+}
+
+static std::string work(const std::string &req)
+{
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::microseconds(g_workUs))
+    {
+    }
+    return req;
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    while (buf->readableBytes() >= kFrame)
+    {
+        std::string req = buf->retrieveAsString(kFrame);
+        switch (req[8])
+        {
+        case kInline:
+            conn->send(work(req));
+            break;
+        case kOffload:
+            conn->offload(std::bind(work, req));
+            break;
+        default:
+            conn->offloadOrdered(std::bind(work, req));
+            break;
+        }
+    }
+}
+
+struct ClientConn
+{
+    int fd;
+    uint64_t nextSeq;
+    uint64_t lastSeq; // 收到的最大序号+1
+    std::vector<int64_t> sendTime; // 按seq % depth存放发送时间
+    char partial[kFrame];
+    size_t partialLen;
+};
+
+static int64_t nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t percentile(std::vector<int64_t> &v, double p)
+{
+    if (v.empty())
+    {
+        return 0;
+    }
+    size_t idx = std::min(v.size() - 1, static_cast<size_t>(v.size() * p));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+static void sendRequest(ClientConn &c, int depth, char mode)
+{
+    char frame[kFrame] = {0};
+    memcpy(frame, &c.nextSeq, sizeof c.nextSeq);
+    frame[8] = mode;
+    c.sendTime[c.nextSeq % depth] = nowUs();
+    c.nextSeq++;
+    if (::write(c.fd, frame, kFrame) != static_cast<ssize_t>(kFrame))
+    {
+        perror("write");
+        exit(1);
+    }
+}
+
+static int runClient(int numConns, int depth, uint16_t port)
+{
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    int epfd = ::epoll_create1(0);
+    std::vector<ClientConn> conns(numConns);
+    for (int i = 0; i < numConns; i++)
+    {
+        ClientConn &c = conns[i];
+        c.fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (::connect(c.fd, (sockaddr *)&addr, sizeof addr) < 0)
+        {
+            perror("connect");
+            return 1;
+        }
+        int one = 1;
+        ::setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+        ::fcntl(c.fd, F_SETFL, O_NONBLOCK);
+        c.nextSeq = 0;
+        c.lastSeq = 0;
+        c.sendTime.resize(depth);
+        c.partialLen = 0;
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        ::epoll_ctl(epfd, EPOLL_CTL_ADD, c.fd, &ev);
+    }
+
+    const char modes[3] = {kInline, kOffload, kOrdered};
+    const char *names[3] = {"inline", "offload", "ordered"};
+    std::vector<epoll_event> events(1024);
+    for (int m = 0; m < 3; m++)
+    {
+        for (ClientConn &c : conns)
+        {
+            while (c.nextSeq - c.lastSeq < static_cast<uint64_t>(depth))
+            {
+                sendRequest(c, depth, modes[m]);
+            }
+        }
+        std::vector<int64_t> latency;
+        long reorders = 0;
+        int64_t start = nowUs();
+        int64_t end = start + 3000 * 1000;
+        while (nowUs() < end)
+        {
+            int n = ::epoll_wait(epfd, &*events.begin(), static_cast<int>(events.size()), 100);
+            for (int i = 0; i < n; i++)
+            {
+                ClientConn &c = conns[events[i].data.u32];
+                char buf[kFrame * 64];
+                memcpy(buf, c.partial, c.partialLen);
+                ssize_t got = ::read(c.fd, buf + c.partialLen, sizeof buf - c.partialLen);
+                if (got <= 0)
+                {
+                    continue;
+                }
+                size_t total = c.partialLen + got;
+                size_t off = 0;
+                int64_t now = nowUs();
+                for (; off + kFrame <= total; off += kFrame)
+                {
+                    uint64_t seq;
+                    memcpy(&seq, buf + off, sizeof seq);
+                    // 上一轮迟到的回复不算
+                    if (buf[off + 8] == modes[m])
+                    {
+                        if (seq < c.lastSeq)
+                        {
+                            reorders++;
+                        }
+                        else
+                        {
+                            c.lastSeq = seq + 1;
+                        }
+                        latency.push_back(now - c.sendTime[seq % depth]);
+                    }
+                    if (nowUs() < end)
+                    {
+                        sendRequest(c, depth, modes[m]);
+                    }
+                }
+                c.partialLen = total - off;
+                memcpy(c.partial, buf + off, c.partialLen);
+            }
+        }
+        // 等这一轮在路上的请求都回来 不算进统计
+        int64_t drainEnd = nowUs() + 10000 * 1000;
+        while (nowUs() < drainEnd)
+        {
+            int n = ::epoll_wait(epfd, &*events.begin(), static_cast<int>(events.size()), 200);
+            if (n == 0)
+            {
+                break;
+            }
+            for (int i = 0; i < n; i++)
+            {
+                ClientConn &c = conns[events[i].data.u32];
+                char buf[kFrame * 64];
+                memcpy(buf, c.partial, c.partialLen);
+                ssize_t got = ::read(c.fd, buf + c.partialLen, sizeof buf - c.partialLen);
+                if (got <= 0)
+                {
+                    continue;
+                }
+                size_t total = c.partialLen + got;
+                c.partialLen = total % kFrame;
+                memcpy(c.partial, buf + total - c.partialLen, c.partialLen);
+                c.lastSeq = c.nextSeq; // 序号重新开始比较
+            }
+        }
+        size_t count = latency.size();
+        int64_t p50 = percentile(latency, 0.50);
+        int64_t p99 = percentile(latency, 0.99);
+        fprintf(stderr, "strand mode=%s conns=%d depth=%d req_per_s=%.0f p50_us=%ld p99_us=%ld reorders=%ld\n",
+                names[m], numConns, depth, count / 3.0, p50, p99, reorders);
+    }
+
+    for (ClientConn &c : conns)
+    {
+        ::close(c.fd);
+    }
+    ::close(epfd);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int conns = argc > 1 ? atoi(argv[1]) : 10000;
+    int depth = argc > 2 ? atoi(argv[2]) : 4;
+    int loops = argc > 3 ? atoi(argv[3]) : 2;
+    int workers = argc > 4 ? atoi(argv[4]) : 2;
+    g_workUs = argc > 5 ? atoi(argv[5]) : 5;
+    uint16_t port = static_cast<uint16_t>(argc > 6 ? atoi(argv[6]) : 9984);
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    ComputePool pool;
+    pool.start(workers);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "127.0.0.1"), "strand");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setComputePool(&pool);
+    server.setThreadNum(loops);
+    server.start();
+
+    // 10000个连接客户端和服务端各占一份fd 客户端放到子进程里
+    pid_t child = ::fork();
+    if (child == 0)
+    {
+        ::usleep(100 * 1000);
+        _exit(runClient(conns, depth, port));
+    }
+
+    std::thread control([&]() {
+        int status = 0;
+        ::waitpid(child, &status, 0);
+        loop.quit();
+    });
+
+    loop.loop();
+    control.join();
+    return 0;
+}
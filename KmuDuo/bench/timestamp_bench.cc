@@ -0,0 +1,88 @@
+// Timestamp::now() + 格式化 在threads个线程上的吞吐
+// legacy: 原来的实现 time(NULL) + localtime + snprintf(每次都要拿时区的全局锁)
+// toString / toFormattedString: clock_gettime + 每线程缓存的年月日时分秒  formatTo: 再加上不申请内存
+// 另外输出now()相邻两次调用之间最小的非零差值 看看精度
+//
+// 用法: timestamp_bench [threads=16] [iters=1000000]
+#include "Timestamp.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static std::atomic<size_t> g_sink(0);
+
+static std::string legacyNowString()
+{
+    char buf[128] = {0};
+    time_t seconds = time(NULL);
+    tm *tm_time = localtime(&seconds);
+    snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
+             tm_time->tm_year + 1900,
+             tm_time->tm_mon + 1,
+             tm_time->tm_mday,
+             tm_time->tm_hour,
+             tm_time->tm_min,
+             tm_time->tm_sec);
+    return buf;
+}
+
+template <typename F>
+static void run(const char *mode, int threads, long iters, F f)
+{
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++)
+    {
+        workers.push_back(std::thread([iters, &f]() {
+            size_t sum = 0;
+            for (long i = 0; i < iters; i++)
+            {
+                sum += f();
+            }
+            g_sink += sum;
+        }));
+    }
+    for (std::thread &w : workers)
+    {
+        w.join();
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double total = static_cast<double>(threads) * iters;
+    fprintf(stderr, "timestamp_bench mode=%s threads=%d calls=%.0f mops_per_s=%.2f ns_per_call=%.1f\n",
+            mode, threads, total, total / sec / 1e6, sec * 1e9 / total);
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 16;
+    long iters = argc > 2 ? atol(argv[2]) : 1000000;
+
+    int64_t minStep = 0;
+    Timestamp prev = Timestamp::now();
+    for (int i = 0; i < 1000000; i++)
+    {
+        Timestamp cur = Timestamp::now();
+        int64_t step = cur.microSecondsSinceEpoch() - prev.microSecondsSinceEpoch();
+        if (step > 0 && (minStep == 0 || step < minStep))
+        {
+            minStep = step;
+        }
+        prev = cur;
+    }
+    fprintf(stderr, "timestamp_bench now_min_step_us=%ld sample=%s\n",
+            static_cast<long>(minStep), Timestamp::now().toFormattedString().c_str());
+
+    run("legacy", threads, iters, []() { return legacyNowString().size(); });
+    run("toString", threads, iters, []() { return Timestamp::now().toString().size(); });
+    run("toFormattedString", threads, iters, []() { return Timestamp::now().toFormattedString().size(); });
+    run("formatTo", threads, iters, []() {
+        char buf[64];
+        return Timestamp::now().formatTo(buf, sizeof buf);
+    });
+    return g_sink == 0;
+}
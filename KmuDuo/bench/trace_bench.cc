@@ -0,0 +1,175 @@
+// LOG_TRACE(二进制 延迟格式化)每条的开销 对比走snprintf的LOG_INFO
+// 1. 正确性: 写几条不同类型参数的追踪日志 解码出来的文字和snprintf的结果比较
+// 2. 每条的耗时: 关闭时 / 两个整数 / 整数+指针+短字符串 / threads个线程同时写
+//    每轮写burst条 环形缓冲区放得下 然后flush等解码线程读完 只计写的时间
+//    多线程的时候用线程自己的CPU时间(机器核数少的时候墙上时间包含了别的线程) 另外单独测一下读时间戳(rdtsc)的开销
+// 3. 对比: LOG_INFO格式化以后交给AsyncLogging
+//
+// 用法: trace_bench [calls=2000000] [threads=4]
+#include "TraceLog.h"
+#include "AsyncLogging.h"
+#include "logger.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static const long kBurst = 100000;
+static std::atomic<long> g_outBytes(0);
+static std::string g_captured;
+static bool g_capture = false;
+static volatile uint64_t g_sink;
+
+static void output(const char *msg, size_t len)
+{
+    g_outBytes.fetch_add(len, std::memory_order_relaxed);
+    if (g_capture)
+    {
+        g_captured.append(msg, len);
+    }
+}
+
+// 去掉 "[TRACE]时间 tid 文件:行号:" 前缀
+static std::string body(const std::string &line)
+{
+    size_t pos = line.find(".cc:");
+    pos = line.find(':', pos + 4);
+    return line.substr(pos + 1);
+}
+
+static bool check()
+{
+    g_capture = true;
+    int fd = 17;
+    long n = -4096;
+    unsigned long long big = 18446744073709551615ULL;
+    double ratio = 0.625;
+    const char *name = "server-127.0.0.1:8000#1";
+    LOG_TRACE("fd=%d n=%ld big=%llu ratio=%.3f name=%s 100%%", fd, n, big, ratio, name);
+    LOG_TRACE("ptr=%p char=%c hex=%08x", &fd, 'x', 0xbeefu);
+    LOG_TRACE("no args");
+    TraceLog::flush();
+    g_capture = false;
+
+    char expect[3][256];
+    snprintf(expect[0], 256, "fd=%d n=%ld big=%llu ratio=%.3f name=%s 100%%\n", fd, n, big, ratio, name);
+    snprintf(expect[1], 256, "ptr=%p char=%c hex=%08x\n", &fd, 'x', 0xbeefu);
+    snprintf(expect[2], 256, "no args\n");
+    size_t start = 0;
+    bool ok = true;
+    for (int i = 0; i < 3; i++)
+    {
+        size_t end = g_captured.find('\n', start);
+        if (end == std::string::npos)
+        {
+            return false;
+        }
+        std::string line = g_captured.substr(start, end + 1 - start);
+        if (i == 0)
+        {
+            fprintf(stderr, "trace_bench sample: %s", line.c_str());
+        }
+        ok = ok && body(line) == expect[i];
+        start = end + 1;
+    }
+    return ok;
+}
+
+static double threadCpuNanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+template <typename F>
+static double nsPerCall(long calls, F f)
+{
+    double total = 0;
+    for (long done = 0; done < calls; done += kBurst)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (long i = 0; i < kBurst; i++)
+        {
+            f(done + i);
+        }
+        total += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        TraceLog::flush();
+    }
+    return total / calls;
+}
+
+int main(int argc, char *argv[])
+{
+    long calls = argc > 1 ? atol(argv[1]) : 2000000;
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+
+    auto tickStart = std::chrono::steady_clock::now();
+    for (long i = 0; i < calls; i++)
+    {
+        g_sink = tracelog::ticks();
+    }
+    double ticks = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - tickStart).count() / calls;
+
+    double off = nsPerCall(calls, [](long i) { LOG_TRACE("EventLoop %p poll returned %d channels", &i, static_cast<int>(i)); });
+
+    TraceLog::setRingSize(16 * 1024 * 1024);
+    TraceLog::start(output, 10);
+    bool ok = check();
+    fprintf(stderr, "trace_bench check ok=%d\n", ok ? 1 : 0);
+
+    double twoInts = nsPerCall(calls, [](long i) { LOG_TRACE("fd=%d n=%ld", 17, i); });
+    double mixed = nsPerCall(calls, [](long i) {
+        LOG_TRACE("TcpConnection::handleRead [%s] %p n=%ld", "server-127.0.0.1:8000#1", &i, i);
+    });
+
+    // 多个线程 每个线程写自己的环形缓冲区
+    std::vector<double> perThread(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+    {
+        workers.push_back(std::thread([t, calls, &perThread]() {
+            LOG_TRACE("worker %d start", t); // 第一条会申请环形缓冲区 不计时
+            double start = threadCpuNanos();
+            for (long i = 0; i < kBurst; i++)
+            {
+                LOG_TRACE("worker %d n=%ld", t, i);
+            }
+            perThread[t] = (threadCpuNanos() - start) / kBurst;
+        }));
+    }
+    for (std::thread &w : workers)
+    {
+        w.join();
+    }
+    TraceLog::flush();
+    double multi = 0;
+    for (double ns : perThread)
+    {
+        multi += ns / threads;
+    }
+    long dropped = TraceLog::dropped();
+    TraceLog::stop();
+
+    // snprintf + AsyncLogging
+    AsyncLogging log("/dev/null", 1);
+    log.start();
+    Logger::instance().setOutput(std::bind(&AsyncLogging::append, &log, std::placeholders::_1, std::placeholders::_2));
+    Logger::instance().setFlush(std::bind(&AsyncLogging::flush, &log));
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < calls; i++)
+    {
+        LOG_INFO("fd=%d n=%ld", 17, i);
+    }
+    double info = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+    Logger::instance().flush();
+
+    fprintf(stderr, "trace_bench calls=%ld timestamp_ns=%.1f disabled_ns=%.1f two_ints_ns=%.1f mixed_ns=%.1f threads=%d per_thread_ns=%.1f"
+                    " log_info_async_ns=%.1f dropped=%ld rendered_mb=%.1f\n",
+            calls, ticks, off, twoInts, mixed, threads, multi, info, dropped, g_outBytes / 1e6);
+    return ok ? 0 : 1;
+}
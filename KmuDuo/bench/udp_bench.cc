@@ -0,0 +1,165 @@
+// UdpServer 收包速率 recvmmsg批量收和一次事件一个recvfrom的基线对比
+// 服务器: baseloop加loops个subloop 每个loop一个SO_REUSEPORT的socket
+// 发送端: senders个线程 每个线程8个connect好的socket轮流用sendmmsg一次发64个size字节的包 能发多快发多快
+// echo=1的时候服务器把每个包原样回给发送端(reply走sendmmsg攒批) 发送端每发一批就把回包读掉
+// 每种模式先跑batch=1(基线) 再跑batch=batch 输出服务器收到的包速率 平均每次系统调用收几个包 丢了多少
+//
+// 用法: udp_bench [loops=0] [senders=1] [size=64] [seconds=2] [batch=64] [echo=0] [port=9998]   stdout重定向到/dev/null
+#include "BenchUtil.h"
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "CountDownLatch.h"
+#include "logger.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+
+static double cpuSeconds()
+{
+    rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static int connectUdp(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::connect(fd, (sockaddr *)&addr, sizeof addr);
+    return fd;
+}
+
+static void sender(uint16_t port, int size, bool echo, std::atomic<bool> *stop,
+                   std::atomic<int64_t> *sent, std::atomic<int64_t> *echoed)
+{
+    const int kSockets = 8;
+    const int kBurst = 64;
+    std::vector<int> fds;
+    for (int i = 0; i < kSockets; i++)
+    {
+        fds.push_back(connectUdp(port));
+    }
+    std::string payload(size, 'x');
+    std::vector<mmsghdr> msgs(kBurst);
+    std::vector<iovec> iov(kBurst);
+    for (int i = 0; i < kBurst; i++)
+    {
+        iov[i].iov_base = &payload[0];
+        iov[i].iov_len = payload.size();
+        memset(&msgs[i], 0, sizeof msgs[i]);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    std::vector<char> rbuf(65536);
+    int64_t localSent = 0, localEchoed = 0;
+    for (int round = 0; !*stop; round++)
+    {
+        int fd = fds[round % kSockets];
+        int n = ::sendmmsg(fd, msgs.data(), kBurst, 0);
+        if (n > 0)
+        {
+            localSent += n;
+        }
+        if (echo)
+        {
+            for (int s = 0; s < kSockets; s++)
+            {
+                while (::recv(fds[s], rbuf.data(), rbuf.size(), MSG_DONTWAIT) > 0)
+                {
+                    localEchoed++;
+                }
+            }
+        }
+    }
+    *sent += localSent;
+    *echoed += localEchoed;
+    for (int fd : fds)
+    {
+        ::close(fd);
+    }
+}
+
+static void runMode(int loops, int senders, int size, double seconds, int batch, bool echo, uint16_t port)
+{
+    EventLoopThread baseThread;
+    EventLoop *base = baseThread.startloop();
+    std::unique_ptr<UdpServer> server;
+    UdpServer::Options options;
+    options.batchSize = batch;
+    options.recvBufferBytes = 4 * 1024 * 1024;
+    {
+        CountDownLatch latch(1);
+        base->runInLoop([&]() {
+            server.reset(new UdpServer(base, InetAddress(port, "127.0.0.1"), "udp_bench", options));
+            if (echo)
+            {
+                UdpServer *s = server.get();
+                server->setPacketCallback([s](const UdpPacket &packet) { s->reply(packet, packet.data, packet.len); });
+            }
+            server->setThreadNum(loops);
+            server->start();
+            latch.countDown();
+        });
+        latch.wait();
+    }
+    ::usleep(50 * 1000);
+
+    std::atomic<bool> stop(false);
+    std::atomic<int64_t> sent(0), echoed(0);
+    UdpServer::Stats before = server->stats();
+    double cpuBefore = cpuSeconds();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < senders; i++)
+    {
+        threads.push_back(std::thread(sender, port, size, echo, &stop, &sent, &echoed));
+    }
+    ::usleep(static_cast<useconds_t>(seconds * 1000000));
+    stop = true;
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    ::usleep(50 * 1000); // 让服务器把缓冲区里面剩下的收完
+    double elapsed = bench::secondsSince(start);
+    double cpu = cpuSeconds() - cpuBefore;
+    UdpServer::Stats after = server->stats();
+
+    int64_t received = after.packetsReceived - before.packetsReceived;
+    int64_t calls = after.recvCalls - before.recvCalls;
+    bench::report("udp", "batch=%d loops=%d senders=%d size=%d echo=%d sent=%lld received=%lld dropped=%lld "
+                         "recv_pps=%.0f packets_per_recv_call=%.1f replies_sent=%lld send_calls=%lld echoed=%lld cpu_ns_per_packet=%.0f",
+                  batch, loops, senders, size, echo ? 1 : 0, (long long)sent.load(), (long long)received,
+                  (long long)(sent - received), received / elapsed, calls ? static_cast<double>(received) / calls : 0.0,
+                  (long long)(after.packetsSent - before.packetsSent), (long long)(after.sendCalls - before.sendCalls),
+                  (long long)echoed.load(), received ? cpu * 1e9 / received : 0.0);
+
+    CountDownLatch latch(1);
+    base->runInLoop([&]() {
+        server.reset();
+        latch.countDown();
+    });
+    latch.wait();
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = static_cast<int>(bench::argOr(argc, argv, 1, 0));
+    int senders = static_cast<int>(bench::argOr(argc, argv, 2, 1));
+    int size = static_cast<int>(bench::argOr(argc, argv, 3, 64));
+    double seconds = static_cast<double>(bench::argOr(argc, argv, 4, 2));
+    int batch = static_cast<int>(bench::argOr(argc, argv, 5, 64));
+    bool echo = bench::argOr(argc, argv, 6, 0) != 0;
+    uint16_t port = static_cast<uint16_t>(bench::argOr(argc, argv, 7, 9998));
+    Logger::setLogLevel(ERROR);
+
+    runMode(loops, senders, size, seconds, 1, echo, port);
+    runMode(loops, senders, size, seconds, batch, echo, port);
+    return 0;
+}
@@ -0,0 +1,221 @@
+// UdpServer GSO/GRO 一样的包量下开和不开的CPU对比 都走loopback
+// 只统计服务器loop线程自己的CPU时间(pthread_getcpuclockid) 对端的开销两种情况一样 不算进去
+//
+//   send: loop线程上每一轮sendTo 64个size字节的包给一个不读的sink socket(收不下的内核直接丢)
+//         gso=0 一个包一个消息sendmmsg 比较gso=1 连续64个包合成一个UDP_SEGMENT大包
+//   recv: 一个发送线程用UDP_SEGMENT每次sendmsg 64个(size大的时候少一点)size字节的包 能发多快发多快
+//         gro=0 内核在交给socket之前切开 一个包一个消息recvmmsg 比较gro=1 收到合并的大包在用户态切开
+// 输出每秒包数 平均每次系统调用几个包 服务器loop线程平均每个包多少ns CPU
+//
+// 用法: udp_gso_bench [size=1200] [seconds=2] [port=9988]   stdout重定向到/dev/null
+#include "BenchUtil.h"
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "CountDownLatch.h"
+#include "logger.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <time.h>
+#include <netinet/udp.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+static const int kBurst = 64;
+
+static double threadCpuSeconds(clockid_t clock)
+{
+    timespec ts;
+    ::clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int udpSocket(uint16_t port, bool connectTo)
+{
+    int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connectTo)
+    {
+        ::connect(fd, (sockaddr *)&addr, sizeof addr);
+    }
+    else
+    {
+        ::bind(fd, (sockaddr *)&addr, sizeof addr);
+    }
+    return fd;
+}
+
+// 发送线程: 一次sendmsg带UDP_SEGMENT 内核切成最多kBurst个size字节的数据报 整个大包不能超过一个IP包
+static void gsoSender(uint16_t port, int size, std::atomic<bool> *stop, std::atomic<int64_t> *sent)
+{
+    int fd = udpSocket(port, true);
+    const int segments = std::max(1, std::min(kBurst, 65000 / size));
+    std::string payload(static_cast<size_t>(size) * segments, 'x');
+    iovec iov = {&payload[0], payload.size()};
+    char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+    msghdr hdr = {};
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof control;
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t segmentSize = static_cast<uint16_t>(size);
+    memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof segmentSize);
+
+    int64_t localSent = 0;
+    while (!*stop)
+    {
+        if (::sendmsg(fd, &hdr, 0) > 0)
+        {
+            localSent += segments;
+        }
+    }
+    *sent += localSent;
+    ::close(fd);
+}
+
+struct SendRun
+{
+    UdpServer *server;
+    InetAddress sink;
+    std::string payload;
+    std::atomic<bool> stopping;
+    std::atomic<bool> stopped;
+};
+
+// 在loop线程里面 一轮发kBurst个包 再排到下一轮
+static void produce(SendRun *run, EventLoop *loop)
+{
+    if (run->stopping)
+    {
+        run->stopped = true;
+        return;
+    }
+    for (int i = 0; i < kBurst; i++)
+    {
+        run->server->sendTo(0, run->sink, run->payload.data(), run->payload.size());
+    }
+    loop->queueLoop(std::bind(produce, run, loop));
+}
+
+static void runMode(const char *mode, bool enabled, int size, double seconds, uint16_t port)
+{
+    bool sendMode = std::string(mode) == "send";
+    EventLoopThread baseThread;
+    EventLoop *base = baseThread.startloop();
+    std::unique_ptr<UdpServer> server;
+    clockid_t loopClock;
+    UdpServer::Options options;
+    options.recvBufferBytes = 4 * 1024 * 1024;
+    options.gso = sendMode && enabled;
+    options.gro = !sendMode && enabled;
+    {
+        CountDownLatch latch(1);
+        base->runInLoop([&]() {
+            ::pthread_getcpuclockid(::pthread_self(), &loopClock);
+            server.reset(new UdpServer(base, InetAddress(port, "127.0.0.1"), "udp_gso_bench", options));
+            server->start();
+            latch.countDown();
+        });
+        latch.wait();
+    }
+    ::usleep(50 * 1000);
+
+    // sink只绑定不读 缓冲区满了内核丢包 不影响发送端
+    int sink = sendMode ? udpSocket(static_cast<uint16_t>(port + 1), false) : -1;
+    SendRun run;
+    run.server = server.get();
+    run.sink = InetAddress(static_cast<uint16_t>(port + 1), "127.0.0.1");
+    run.payload = std::string(size, 'x');
+    run.stopping = false;
+    run.stopped = false;
+    std::atomic<bool> stop(false);
+    std::atomic<int64_t> sent(0);
+
+    UdpServer::Stats before = server->stats();
+    double cpuBefore = threadCpuSeconds(loopClock);
+    auto start = std::chrono::steady_clock::now();
+    std::thread sender;
+    if (sendMode)
+    {
+        base->queueLoop(std::bind(produce, &run, base));
+    }
+    else
+    {
+        sender = std::thread(gsoSender, port, size, &stop, &sent);
+    }
+    ::usleep(static_cast<useconds_t>(seconds * 1000000));
+    if (sendMode)
+    {
+        run.stopping = true;
+        while (!run.stopped)
+        {
+            ::usleep(1000);
+        }
+    }
+    else
+    {
+        stop = true;
+        sender.join();
+        ::usleep(50 * 1000); // 让服务器把缓冲区里面剩下的收完
+    }
+    double elapsed = bench::secondsSince(start);
+    double cpu = threadCpuSeconds(loopClock) - cpuBefore;
+    UdpServer::Stats after = server->stats();
+
+    int64_t packets, calls, coalesced;
+    if (sendMode)
+    {
+        packets = after.packetsSent - before.packetsSent;
+        calls = after.sendCalls - before.sendCalls;
+        coalesced = after.gsoSends - before.gsoSends;
+    }
+    else
+    {
+        packets = after.packetsReceived - before.packetsReceived;
+        calls = after.recvCalls - before.recvCalls;
+        coalesced = after.groReceives - before.groReceives;
+    }
+    bench::report("udp_gso", "mode=%s %s=%d size=%d packets=%lld pps=%.0f packets_per_call=%.1f coalesced=%lld "
+                             "loop_cpu_ns_per_packet=%.0f",
+                  mode, sendMode ? "gso" : "gro", enabled ? 1 : 0, size, (long long)packets, packets / elapsed,
+                  calls ? static_cast<double>(packets) / calls : 0.0, (long long)coalesced,
+                  packets ? cpu * 1e9 / packets : 0.0);
+
+    CountDownLatch latch(1);
+    base->runInLoop([&]() {
+        server.reset();
+        latch.countDown();
+    });
+    latch.wait();
+    if (sink >= 0)
+    {
+        ::close(sink);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int size = static_cast<int>(bench::argOr(argc, argv, 1, 1200));
+    double seconds = static_cast<double>(bench::argOr(argc, argv, 2, 2));
+    uint16_t port = static_cast<uint16_t>(bench::argOr(argc, argv, 3, 9988));
+    Logger::setLogLevel(ERROR);
+
+    runMode("send", false, size, seconds, port);
+    runMode("send", true, size, seconds, port);
+    runMode("recv", false, size, seconds, port);
+    runMode("recv", true, size, seconds, port);
+    return 0;
+}
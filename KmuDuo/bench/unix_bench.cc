@@ -0,0 +1,186 @@
+// 同一台机器上的客户端 loopback TCP和AF_UNIX(文件路径 / abstract namespace)的对比
+// 服务器: 三个TcpServer共用一个baseloop和loops个subloop 分别监听127.0.0.1:port 一个socket文件 一个abstract地址 都是原样回显
+// 每种传输各跑两项:
+//   latency     1个连接 msgSize字节pingpong 输出每秒往返次数和往返延迟的分位数
+//   throughput  1个连接 bulkSize字节pingpong 输出每秒来回的MB数
+// 最后一项fd_pass: 客户端每次用SCM_RIGHTS带一个fd发1个字节 服务器FdCallback收下关掉 再用sendFd回一个fd
+//   输出每秒来回传递的fd数和往返延迟 服务器收到的fd数应该等于往返次数
+//
+// 用法: unix_bench [loops=1] [msgSize=64] [bulkSize=262144] [seconds=2] [port=9979]   stdout重定向到/dev/null
+#include "BenchUtil.h"
+#include "TcpServer.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "CountDownLatch.h"
+#include "Socket.h"
+#include "logger.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <signal.h>
+
+static const char *kPath = "/tmp/mymuduo_unix_bench.sock";
+static const char *kAbstract = "@mymuduo_unix_bench";
+static const char *kFdAbstract = "@mymuduo_unix_bench_fd";
+
+static std::atomic<int64_t> g_fdsReceived(0);
+static int g_devNull = -1;
+
+static void onConnection(const TcpConnectionPtr &)
+{
+}
+
+static void onEcho(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+static void onFdConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setFdCallback([](const TcpConnectionPtr &, int fd) {
+            g_fdsReceived++;
+            ::close(fd);
+        });
+    }
+}
+
+// 每收到一个字节回一个fd
+static void onFdMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    size_t n = buf->readableBytes();
+    buf->retrieveAll();
+    for (size_t i = 0; i < n; i++)
+    {
+        conn->sendFd(g_devNull, "f");
+    }
+}
+
+static void runPingpong(const char *transport, const char *test, const InetAddress &addr, int msgSize, double seconds)
+{
+    bench::PingpongClient client(addr.sockAddr(), addr.sockLen(), 1, msgSize);
+    client.run(0.3, nullptr);
+    std::vector<int64_t> rtt;
+    rtt.reserve(1 << 20);
+    int64_t bytesBefore = client.bytes();
+    auto start = std::chrono::steady_clock::now();
+    client.run(seconds, &rtt);
+    double elapsed = bench::secondsSince(start);
+    size_t roundTrips = rtt.size();
+    bench::report("unix", "transport=%s test=%s msg_size=%d round_trips_per_s=%.0f mb_per_s=%.1f errors=%d %s",
+                  transport, test, msgSize, roundTrips / elapsed,
+                  2.0 * (client.bytes() - bytesBefore) / elapsed / (1024 * 1024), client.errors(),
+                  bench::latencySummary(rtt).c_str());
+}
+
+static void runFdPass(const InetAddress &addr, double seconds)
+{
+    int fd = bench::connectTo(addr.sockAddr(), addr.sockLen());
+    if (fd < 0)
+    {
+        bench::report("unix", "transport=abstract test=fd_pass connect_failed=1");
+        return;
+    }
+    std::vector<int64_t> rtt;
+    rtt.reserve(1 << 20);
+    int64_t before = g_fdsReceived;
+    int errors = 0;
+    std::vector<int> fds;
+    auto start = std::chrono::steady_clock::now();
+    while (bench::secondsSince(start) < seconds)
+    {
+        int64_t begin = bench::nowNanos();
+        char c = 'x';
+        if (Socket::sendWithFds(fd, &c, 1, &g_devNull, 1) != 1)
+        {
+            errors++;
+            break;
+        }
+        fds.clear();
+        if (Socket::recvWithFds(fd, &c, 1, &fds) != 1 || fds.size() != 1)
+        {
+            errors++;
+            break;
+        }
+        rtt.push_back(bench::nowNanos() - begin);
+        ::close(fds[0]);
+    }
+    double elapsed = bench::secondsSince(start);
+    ::close(fd);
+    size_t roundTrips = rtt.size();
+    bench::report("unix", "transport=abstract test=fd_pass round_trips_per_s=%.0f fds_received_by_server=%lld errors=%d %s",
+                  roundTrips / elapsed, (long long)(g_fdsReceived - before), errors, bench::latencySummary(rtt).c_str());
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = static_cast<int>(bench::argOr(argc, argv, 1, 1));
+    int msgSize = static_cast<int>(bench::argOr(argc, argv, 2, 64));
+    int bulkSize = static_cast<int>(bench::argOr(argc, argv, 3, 262144));
+    double seconds = static_cast<double>(bench::argOr(argc, argv, 4, 2));
+    uint16_t port = static_cast<uint16_t>(bench::argOr(argc, argv, 5, 9979));
+    Logger::setLogLevel(ERROR);
+    // AF_UNIX的对端关掉以后再write直接就是EPIPE 客户端一断开服务器还在回显的数据就会触发SIGPIPE
+    ::signal(SIGPIPE, SIG_IGN);
+    g_devNull = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    struct Transport
+    {
+        const char *name;
+        InetAddress addr;
+    };
+    std::vector<Transport> transports = {
+        {"tcp", InetAddress(port, "127.0.0.1")},
+        {"unix", InetAddress::unixAddress(kPath)},
+        {"abstract", InetAddress::unixAddress(kAbstract)},
+    };
+    InetAddress fdAddr(InetAddress::unixAddress(kFdAbstract));
+
+    EventLoopThread baseThread;
+    EventLoop *base = baseThread.startloop();
+    std::vector<std::unique_ptr<TcpServer>> servers;
+    {
+        CountDownLatch latch(1);
+        base->runInLoop([&]() {
+            for (const Transport &t : transports)
+            {
+                servers.push_back(std::unique_ptr<TcpServer>(new TcpServer(base, t.addr, t.name)));
+                servers.back()->setConnectionCallback(onConnection);
+                servers.back()->setMessageCallback(onEcho);
+            }
+            servers.push_back(std::unique_ptr<TcpServer>(new TcpServer(base, fdAddr, "fd_pass")));
+            servers.back()->setConnectionCallback(onFdConnection);
+            servers.back()->setMessageCallback(onFdMessage);
+            for (auto &server : servers)
+            {
+                server->setThreadNum(loops);
+                server->start();
+            }
+            latch.countDown();
+        });
+        latch.wait();
+    }
+
+    for (const Transport &t : transports)
+    {
+        runPingpong(t.name, "latency", t.addr, msgSize, seconds);
+    }
+    for (const Transport &t : transports)
+    {
+        runPingpong(t.name, "throughput", t.addr, bulkSize, seconds);
+    }
+    runFdPass(fdAddr, seconds);
+
+    ::usleep(100 * 1000);
+    CountDownLatch latch(1);
+    base->runInLoop([&]() {
+        servers.clear();
+        latch.countDown();
+    });
+    latch.wait();
+    ::close(g_devNull);
+    return 0;
+}
@@ -0,0 +1,256 @@
+// 热升级的时候会不会拒绝连接 有没有accept的空档
+// 旧进程: 127.0.0.1:port上的TcpServer 每个请求("ping\n")回"old\n" 加上一个HotUpgradeListener
+// 压测: clients个线程不停地 建连接 -> 发ping -> 等回复 -> 关连接 记录每次的耗时 被拒绝的次数 由哪个进程回复的
+// 跑到seconds/3的时候 fork+exec自己作为新进程: HotUpgradeClient接过监听fd 建TcpServer(回"new\n") start 然后confirm
+// 旧进程在HandoffCallback里面drain 剩下的连接处理完
+// 输出: 请求数 新旧进程各回复了多少 被拒绝/出错的次数 从启动新进程到交接完成的时间 整个过程里面最长的一次请求
+// 对照mode=rebind: 旧进程先关掉监听socket 新进程自己重新bind 中间的连接都会被拒绝
+// 新进程启动以后先花startupMs毫秒初始化(读配置 预热缓存之类) 然后才接管或者bind
+//
+// 用法: upgrade_bench [clients=4] [seconds=3] [startupMs=50] [port=9978]   stdout重定向到/dev/null
+#include "BenchUtil.h"
+#include "HotUpgrade.h"
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "CountDownLatch.h"
+#include "logger.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <sys/wait.h>
+
+static const char *kControlPath = "/tmp/mymuduo_upgrade_bench.ctl";
+
+static void onConnection(const TcpConnectionPtr &)
+{
+}
+
+static void onRequest(const char *reply, const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    const char *begin = buf->peek();
+    const char *end = begin + buf->readableBytes();
+    if (std::find(begin, end, '\n') != end)
+    {
+        buf->retrieveAll();
+        conn->send(reply);
+    }
+}
+
+static std::unique_ptr<TcpServer> makeServer(EventLoop *loop, int listenfd, uint16_t port, const char *reply)
+{
+    std::unique_ptr<TcpServer> server(listenfd >= 0 ? new TcpServer(loop, listenfd, "echo")
+                                                    : new TcpServer(loop, InetAddress(port, "127.0.0.1"), "echo"));
+    server->setConnectionCallback(onConnection);
+    server->setMessageCallback(std::bind(onRequest, reply, std::placeholders::_1, std::placeholders::_2,
+                                         std::placeholders::_3));
+    return server;
+}
+
+// 新进程 接管(或者重新bind)以后一直服务到被父进程杀掉
+static int runChild(uint16_t port, bool handoff, int startupMs)
+{
+    Logger::setLogLevel(ERROR);
+    ::signal(SIGPIPE, SIG_IGN);
+    ::usleep(startupMs * 1000);
+    EventLoop loop;
+    HotUpgradeClient client(InetAddress::unixAddress(kControlPath));
+    int fd = -1;
+    if (handoff)
+    {
+        fd = client.takeover(3000) ? client.takeFd("echo") : -1;
+        if (fd < 0)
+        {
+            fprintf(stderr, "upgrade_bench child: takeover failed\n");
+            return 1;
+        }
+    }
+    std::unique_ptr<TcpServer> server(makeServer(&loop, fd, port, "new\n"));
+    server->start();
+    client.confirm();
+    // 接管了才开自己的控制socket 等下一次升级 rebind的时候旧进程的控制socket还在用
+    std::unique_ptr<HotUpgradeListener> listener;
+    if (handoff)
+    {
+        listener.reset(new HotUpgradeListener(&loop, InetAddress::unixAddress(kControlPath)));
+        listener->addServer(server.get());
+        listener->start();
+    }
+    loop.loop();
+    return 0;
+}
+
+struct Result
+{
+    int64_t old_;
+    int64_t new_;
+    int64_t refused;
+    int64_t errors;
+    std::vector<int64_t> latency;
+};
+
+static void client(uint16_t port, std::atomic<bool> *stop, Result *r)
+{
+    char buf[64];
+    while (!*stop)
+    {
+        int64_t begin = bench::nowNanos();
+        int fd = bench::connectLoopback(port);
+        if (fd < 0)
+        {
+            if (errno == ECONNREFUSED)
+            {
+                r->refused++;
+            }
+            else
+            {
+                r->errors++;
+            }
+            continue;
+        }
+        ssize_t n = -1;
+        if (::write(fd, "ping\n", 5) == 5)
+        {
+            n = ::read(fd, buf, sizeof buf);
+        }
+        ::close(fd);
+        if (n == 4 && memcmp(buf, "old\n", 4) == 0)
+        {
+            r->old_++;
+        }
+        else if (n == 4 && memcmp(buf, "new\n", 4) == 0)
+        {
+            r->new_++;
+        }
+        else
+        {
+            r->errors++;
+            continue;
+        }
+        r->latency.push_back(bench::nowNanos() - begin);
+    }
+}
+
+static void runMode(const char *mode, int clients, double seconds, int startupMs, uint16_t port)
+{
+    bool handoff = strcmp(mode, "handoff") == 0;
+    EventLoopThread baseThread;
+    EventLoop *base = baseThread.startloop();
+    std::unique_ptr<TcpServer> server;
+    std::unique_ptr<HotUpgradeListener> listener;
+    std::atomic<int64_t> handoffNanos(0);
+    std::atomic<int64_t> drainedNanos(0);
+    {
+        CountDownLatch latch(1);
+        base->runInLoop([&]() {
+            server = makeServer(base, -1, port, "old\n");
+            server->start();
+            listener.reset(new HotUpgradeListener(base, InetAddress::unixAddress(kControlPath)));
+            listener->addServer(server.get());
+            listener->setHandoffCallback([&]() {
+                handoffNanos = bench::nowNanos();
+                server->drain(1000, [&]() { drainedNanos = bench::nowNanos(); });
+            });
+            listener->start();
+            latch.countDown();
+        });
+        latch.wait();
+    }
+
+    std::atomic<bool> stop(false);
+    std::vector<Result> results(clients);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; i++)
+    {
+        results[i] = Result{0, 0, 0, 0, std::vector<int64_t>()};
+        results[i].latency.reserve(1 << 20);
+        threads.push_back(std::thread(client, port, &stop, &results[i]));
+    }
+    ::usleep(static_cast<useconds_t>(seconds / 3 * 1000000));
+
+    int64_t spawnNanos = bench::nowNanos();
+    if (!handoff)
+    {
+        // 传统的重启: 旧进程先停止监听(监听socket上shutdown 新来的连接直接RST) 已经建好的连接照常处理完
+        CountDownLatch latch(1);
+        base->runInLoop([&]() {
+            server->stopAccepting();
+            ::shutdown(server->listenFd(), SHUT_RD);
+            latch.countDown();
+        });
+        latch.wait();
+    }
+    char portArg[16];
+    char startupArg[16];
+    snprintf(portArg, sizeof portArg, "%u", port);
+    snprintf(startupArg, sizeof startupArg, "%d", startupMs);
+    pid_t child = ::fork();
+    if (child == 0)
+    {
+        ::execl("/proc/self/exe", "upgrade_bench", "child", portArg, mode, startupArg, (char *)nullptr);
+        ::_exit(127);
+    }
+    ::usleep(static_cast<useconds_t>(seconds * 2 / 3 * 1000000));
+    stop = true;
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    // 旧进程这边的连接应该都已经处理完了
+    size_t oldConnections = 0;
+    {
+        CountDownLatch latch(1);
+        base->runInLoop([&]() {
+            oldConnections = server->connectionTotals().connections;
+            latch.countDown();
+        });
+        latch.wait();
+    }
+    ::kill(child, SIGTERM);
+    ::waitpid(child, nullptr, 0);
+
+    Result total = Result{0, 0, 0, 0, std::vector<int64_t>()};
+    for (Result &r : results)
+    {
+        total.old_ += r.old_;
+        total.new_ += r.new_;
+        total.refused += r.refused;
+        total.errors += r.errors;
+        total.latency.insert(total.latency.end(), r.latency.begin(), r.latency.end());
+    }
+    bench::report("upgrade", "mode=%s clients=%d seconds=%.1f startup_ms=%d requests=%zu served_by_old=%lld served_by_new=%lld "
+                             "refused=%lld errors=%lld handoff_ms=%.1f old_drain_ms=%.1f old_connections_left=%zu %s",
+                  mode, clients, seconds, startupMs, total.latency.size(), (long long)total.old_, (long long)total.new_,
+                  (long long)total.refused, (long long)total.errors,
+                  handoffNanos ? (handoffNanos - spawnNanos) / 1e6 : -1.0,
+                  drainedNanos ? (drainedNanos - handoffNanos) / 1e6 : -1.0, oldConnections,
+                  bench::latencySummary(total.latency).c_str());
+
+    CountDownLatch latch(1);
+    base->runInLoop([&]() {
+        listener.reset();
+        server.reset();
+        latch.countDown();
+    });
+    latch.wait();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 4 && strcmp(argv[1], "child") == 0)
+    {
+        return runChild(static_cast<uint16_t>(atoi(argv[2])), strcmp(argv[3], "handoff") == 0, atoi(argv[4]));
+    }
+    int clients = static_cast<int>(bench::argOr(argc, argv, 1, 4));
+    double seconds = static_cast<double>(bench::argOr(argc, argv, 2, 3));
+    int startupMs = static_cast<int>(bench::argOr(argc, argv, 3, 50));
+    uint16_t port = static_cast<uint16_t>(bench::argOr(argc, argv, 4, 9978));
+    Logger::setLogLevel(ERROR);
+    ::signal(SIGPIPE, SIG_IGN);
+
+    runMode("rebind", clients, seconds, startupMs, port);
+    runMode("handoff", clients, seconds, startupMs, port);
+    return 0;
+}
@@ -0,0 +1,197 @@
+// EventLoop卡顿看门狗
+// 1. 健康路径的开销: loop每一轮多出来的心跳写入(和EventLoop::loop里面一样的几次relaxed store) 单独循环测每轮多少ns
+//    以及另一个线程往loop投递functor再等它执行(一次往返)的吞吐 看门狗关着和开着各测一次
+// 2. 发现卡顿: 阈值threshold毫秒
+//    a. queueLoop投递的回调里面空转 3*threshold 应该报告fd=-1 栈里面有stallInFunctor
+//    b. eventfd的读回调里面sleep 3*threshold 应该报告这个eventfd 栈里面有stallInRead
+//    发现不了 或者fd 栈不对 返回1
+//
+// 用法: watchdog_bench [roundtrips=200000] [threshold_ms=100]   stdout重定向到/dev/null
+// 可执行文件里面的函数名要链接的时候加-rdynamic
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "LoopWatchdog.h"
+#include "Channel.h"
+#include "CountDownLatch.h"
+#include "TscClock.h"
+#include "logger.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+static volatile uint64_t g_sink;
+
+__attribute__((noinline)) void stallInFunctor(int ms)
+{
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    uint64_t x = 0;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        x += x * 31 + 7;
+    }
+    g_sink = x;
+}
+
+__attribute__((noinline)) void stallInRead(int fd, int ms)
+{
+    uint64_t one;
+    ssize_t n = ::read(fd, &one, sizeof one);
+    g_sink = n;
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// 投递一个空回调 等它执行完 重复n次 返回每秒多少次往返
+static double roundtrips(EventLoop *loop, long n)
+{
+    std::atomic<long> done(0);
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < n; i++)
+    {
+        loop->queueLoop([&done]() { done.fetch_add(1, std::memory_order_release); });
+        while (done.load(std::memory_order_acquire) <= i)
+        {
+            std::this_thread::yield();
+        }
+    }
+    return n / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool stackHas(const LoopWatchdog::StallInfo &info, const char *name)
+{
+    for (const std::string &frame : info.stack)
+    {
+        if (frame.find(name) != std::string::npos)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char *argv[])
+{
+    long rounds = argc > 1 ? atol(argv[1]) : 200000;
+    int thresholdMs = argc > 2 ? atoi(argv[2]) : 100;
+    Logger::setLogLevel(ERROR);
+
+    // 心跳写入本身: 每轮一次busySince清零 一次写busySince 一个活跃channel两次 functor之前两次
+    struct alignas(64)
+    {
+        std::atomic<uint64_t> busySince;
+        std::atomic<int> fd;
+        std::atomic<int> revents;
+    } probe;
+    const long kRounds = 100000000;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < kRounds; i++)
+    {
+        probe.busySince.store(0, std::memory_order_relaxed);
+        asm volatile("" ::: "memory");
+        probe.busySince.store(i + 1, std::memory_order_relaxed);
+        probe.fd.store(static_cast<int>(i), std::memory_order_relaxed);
+        probe.revents.store(1, std::memory_order_relaxed);
+        asm volatile("" ::: "memory");
+        probe.fd.store(-1, std::memory_order_relaxed);
+        probe.revents.store(0, std::memory_order_relaxed);
+        asm volatile("" ::: "memory");
+    }
+    double heartbeatNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / kRounds;
+    g_sink = probe.busySince.load();
+
+    EventLoopThread thread;
+    EventLoop *loop = thread.startloop();
+
+    roundtrips(loop, rounds / 10); // 预热
+    double offRate = roundtrips(loop, rounds);
+
+    std::mutex mutex;
+    std::vector<LoopWatchdog::StallInfo> reports;
+    LoopWatchdog watchdog(thresholdMs);
+    watchdog.setStallCallback([&](const LoopWatchdog::StallInfo &info) {
+        fprintf(stderr, "watchdog_bench report %s", info.toString().c_str());
+        std::unique_lock<std::mutex> lock(mutex);
+        reports.push_back(info);
+    });
+    watchdog.watch(loop);
+    watchdog.start();
+    double onRate = roundtrips(loop, rounds);
+
+    fprintf(stderr, "watchdog_bench heartbeat_ns_per_iteration=%.2f roundtrips_per_s_off=%.0f roundtrips_per_s_on=%.0f on_vs_off=%.3f\n",
+            heartbeatNs, offRate, onRate, offRate > 0 ? onRate / offRate : 0);
+
+    int failures = 0;
+    auto waitReports = [&](size_t n) {
+        for (int i = 0; i < 100; i++)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (reports.size() >= n)
+                {
+                    return;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(thresholdMs / 4 + 1));
+        }
+    };
+
+    // a. 卡在functor里面
+    auto detectStart = std::chrono::steady_clock::now();
+    loop->queueLoop([thresholdMs]() { stallInFunctor(3 * thresholdMs); });
+    waitReports(1);
+    double detectMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - detectStart).count();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        bool ok = reports.size() >= 1 && reports[0].fd == -1 && !reports[0].recovered && stackHas(reports[0], "stallInFunctor");
+        fprintf(stderr, "watchdog_bench functor_stall detected=%d fd_ok=%d stack_ok=%d detect_ms=%.0f\n",
+                reports.size() >= 1 ? 1 : 0, reports.size() >= 1 && reports[0].fd == -1 ? 1 : 0,
+                reports.size() >= 1 && stackHas(reports[0], "stallInFunctor") ? 1 : 0, detectMs);
+        failures += ok ? 0 : 1;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(3 * thresholdMs));
+
+    // b. 卡在channel的读回调里面
+    int evfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    Channel *channel = nullptr;
+    CountDownLatch registered(1);
+    loop->runInLoop([&]() {
+        channel = new Channel(loop, evfd);
+        channel->setReadcallback([evfd, thresholdMs](Timestamp) { stallInRead(evfd, 3 * thresholdMs); });
+        channel->enableReading();
+        registered.countDown();
+    });
+    registered.wait();
+    uint64_t one = 1;
+    ssize_t n = ::write(evfd, &one, sizeof one);
+    g_sink = n;
+    waitReports(2);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        bool detected = reports.size() >= 2;
+        bool fdOk = detected && reports[1].fd == evfd;
+        bool stackOk = detected && stackHas(reports[1], "stallInRead");
+        fprintf(stderr, "watchdog_bench read_stall detected=%d fd_ok=%d stack_ok=%d\n", detected ? 1 : 0, fdOk ? 1 : 0, stackOk ? 1 : 0);
+        failures += detected && fdOk && stackOk && !reports[1].recovered ? 0 : 1;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(3 * thresholdMs));
+
+    CountDownLatch removed(1);
+    loop->runInLoop([&]() {
+        channel->disableAll();
+        channel->remove();
+        delete channel;
+        removed.countDown();
+    });
+    removed.wait();
+    ::close(evfd);
+
+    fprintf(stderr, "watchdog_bench stalls=%ld failures=%d\n", watchdog.stalls(), failures);
+    watchdog.unwatch(loop);
+    watchdog.stop();
+    return failures == 0 ? 0 : 1;
+}
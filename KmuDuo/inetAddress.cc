@@ -1,15 +1,92 @@
 #include "inetAddress.h"
+#include "logger.h"
 #include <strings.h>
 #include<string.h>
+#include <stddef.h>
 InetAddress::InetAddress(uint16_t port, std::string ip)
 {
-    bzero(&addr_,sizeof(addr_));
+    bzero(&unix_,sizeof(unix_));
     addr_.sin_family = AF_INET;
     addr_.sin_port=htons(port);
     addr_.sin_addr.s_addr=inet_addr(ip.c_str());
+    len_ = sizeof(sockaddr_in);
+}
+InetAddress::InetAddress(const sockaddr *addr, socklen_t len)
+{
+    bzero(&unix_, sizeof(unix_));
+    len_ = len < sizeof(unix_) ? len : static_cast<socklen_t>(sizeof(unix_));
+    memcpy(&unix_, addr, len_);
+    if (len_ < sizeof(sa_family_t)) // 地址拿不到的时候当成没有名字的AF_UNIX
+    {
+        unix_.sun_family = AF_UNIX;
+        len_ = sizeof(sa_family_t);
+    }
+}
+InetAddress InetAddress::unixAddress(const std::string &path)
+{
+    sockaddr_un addr;
+    bzero(&addr, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    // 路径要留一个字节给结尾的'\0' abstract的名字没有结尾的'\0' 可以占满sun_path
+    bool abstract = !path.empty() && path[0] == '@';
+    size_t maxLen = abstract ? sizeof(addr.sun_path) : sizeof(addr.sun_path) - 1;
+    if (path.size() > maxLen)
+    {
+        // 截断以后就成了另外一个路径 可能连到(或者删掉)别人的socket
+        // 也不能返回没有名字的地址: 直接bind它内核会自动分配一个随机的abstract名字 服务器"监听"在谁都找不到的地方
+        // 路径是配置 配错了直接退出
+        LOG_FATAL("InetAddress::unixAddress path too long (%zu > %zu): %s\n", path.size(), maxLen, path.c_str());
+    }
+    size_t n = path.size();
+    memcpy(addr.sun_path, path.data(), n);
+    socklen_t len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + n);
+    if (abstract)
+    {
+        addr.sun_path[0] = '\0'; // abstract 长度里面不算结尾的'\0'
+    }
+    else
+    {
+        len += 1; // 路径带上结尾的'\0'
+    }
+    return InetAddress(reinterpret_cast<const sockaddr *>(&addr), len);
+}
+InetAddress InetAddress::localAddressOf(int sockfd)
+{
+    sockaddr_un addr; // 比sockaddr_in大 两种都放得下
+    bzero(&addr, sizeof addr);
+    socklen_t len = sizeof addr;
+    if (::getsockname(sockfd, (sockaddr *)&addr, &len) < 0)
+    {
+        len = 0;
+    }
+    return InetAddress(reinterpret_cast<const sockaddr *>(&addr), len);
+}
+InetAddress InetAddress::peerAddressOf(int sockfd)
+{
+    sockaddr_un addr;
+    bzero(&addr, sizeof addr);
+    socklen_t len = sizeof addr;
+    if (::getpeername(sockfd, (sockaddr *)&addr, &len) < 0)
+    {
+        len = 0;
+    }
+    return InetAddress(reinterpret_cast<const sockaddr *>(&addr), len);
 }
 std::string InetAddress::toIP() const
 {
+    if (isUnix())
+    {
+        size_t offset = offsetof(sockaddr_un, sun_path);
+        if (len_ <= offset)
+        {
+            return std::string();
+        }
+        if (unix_.sun_path[0] == '\0')
+        {
+            return "@" + std::string(unix_.sun_path + 1, len_ - offset - 1);
+        }
+        return std::string(unix_.sun_path, strnlen(unix_.sun_path, len_ - offset));
+    }
     //addr_
     char buf[64]={0};
     ::inet_ntop(AF_INET,&addr_.sin_addr,buf,sizeof(buf));
@@ -17,6 +94,10 @@ std::string InetAddress::toIP() const
 }
 std::string InetAddress::toIpPort() const
 {
+    if (isUnix())
+    {
+        return "unix:" + toIP();
+    }
     //ip:port   
     char buf[64]={0};
     ::inet_ntop(AF_INET,&addr_.sin_addr,buf,sizeof(buf));
@@ -27,6 +108,10 @@ std::string InetAddress::toIpPort() const
 }
 std::uint16_t InetAddress::toPort() const
 {
+    if (isUnix())
+    {
+        return 0;
+    }
     return ntohs(addr_.sin_port);    
 }
 
@@ -34,4 +119,4 @@ std::uint16_t InetAddress::toPort() const
 // int main(){
 //     // InetAddress addr(8080);
 //     // std::cout<<addr.toIpPort()<<std::endl;
-// }
\ No newline at end of file
+// }
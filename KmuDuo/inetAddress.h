@@ -1,21 +1,54 @@
 #pragma once
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stddef.h>
 #include <string>
 // 封装socket地址类型
+// 除了IPv4 也可以是AF_UNIX的地址(同一台机器上的sidecar之类的客户端 不用走整个TCP协议栈)
+//   unixAddress("/run/app.sock")  文件系统里面的路径
+//   unixAddress("@app")           '@'开头表示abstract namespace 不在文件系统里面 最后一个引用关掉就没了
+//   路径超过sun_path的长度(一般107字节)直接LOG_FATAL 截断或者不带名字都会绑到别的地方去
+// AF_UNIX的对端关闭以后write马上就是EPIPE(TCP要先收到RST) 用的程序要忽略SIGPIPE
+// getSockAddr()只对IPv4有意义 bind/connect/accept这些统一用sockAddr()和sockLen()
 class InetAddress
 {
 public:
     explicit InetAddress(uint16_t port = 0, std::string ip = "192.168.217.148");
     explicit InetAddress(const sockaddr_in &addr)
-        : addr_(addr) {};
-    std::string toIP() const;
-    std::string toIpPort() const;
-    std::uint16_t toPort() const;
+        : addr_(addr), len_(sizeof(sockaddr_in)) {};
+    // accept/getsockname拿到的地址 AF_INET或者AF_UNIX
+    InetAddress(const sockaddr *addr, socklen_t len);
+
+    static InetAddress unixAddress(const std::string &path);
+    // sockfd绑定的本地地址/连着的对端地址
+    static InetAddress localAddressOf(int sockfd);
+    static InetAddress peerAddressOf(int sockfd);
+
+    sa_family_t family() const { return addr_.sin_family; }
+    bool isUnix() const { return addr_.sin_family == AF_UNIX; }
+    // abstract namespace的AF_UNIX地址(第一个字节是'\0')
+    bool isAbstract() const { return isUnix() && len_ > offsetof(sockaddr_un, sun_path) && unix_.sun_path[0] == '\0'; }
+
+    std::string toIP() const;     // AF_UNIX的时候是路径 abstract的用'@'开头
+    std::string toIpPort() const; // AF_UNIX的时候是"unix:路径" 没有名字的客户端一端是"unix:"
+    std::uint16_t toPort() const; // AF_UNIX的时候是0
 
     const sockaddr_in *getSockAddr() const { return &addr_; }
-    void setSockAddr(const sockaddr_in &addr) { addr_ = addr; }
+    void setSockAddr(const sockaddr_in &addr)
+    {
+        addr_ = addr;
+        len_ = sizeof(sockaddr_in);
+    }
+    const sockaddr *sockAddr() const { return reinterpret_cast<const sockaddr *>(&addr_); }
+    socklen_t sockLen() const { return len_; }
 
 private:
-    sockaddr_in addr_;
-};
\ No newline at end of file
+    union
+    {
+        sockaddr_in addr_;
+        sockaddr_un unix_;
+    };
+    socklen_t len_;
+};
@@ -1,6 +1,25 @@
 #include "logger.h"
 #include"Timestamp.h"
-#include <iostream>
+#include <stdio.h>
+
+static void defaultOutput(const char *msg, size_t len)
+{
+    fwrite(msg, 1, len, stdout);
+}
+
+static void defaultFlush()
+{
+    fflush(stdout);
+}
+
+// 默认全部输出 和原来的行为一致
+std::atomic<int> Logger::minLevel_(DEBUG);
+
+Logger::Logger()
+    : output_(defaultOutput),
+      flush_(defaultFlush)
+{
+}
 
 // 获取日志唯一的实例对象
 Logger &Logger::instance()
@@ -8,36 +27,54 @@ Logger &Logger::instance()
     static Logger logger;
     return logger;
 }
-// 设置日志级别
-void Logger:: setLogLevel(int level)
-{
-    logLevel_=level;
-}
 // 写日志
-void Logger::log(std::string msg)
+void Logger::log(int level, const char *msg)
 {
-    switch(logLevel_){
+    const char *prefix = "";
+    switch(level){
         case INFO:
-        std::cout<<"[INFO]";
+        prefix = "[INFO]";
         break;
 
         case ERROR:
-        std::cout<<"[ERROR]";
+        prefix = "[ERROR]";
         break;
 
         case FATAL:
-        std::cout<<"[FATAL]";
+        prefix = "[FATAL]";
         break;
 
         case DEBUG:
-        std::cout<<"[DEBUG]";
+        prefix = "[DEBUG]";
         break;
 
         default:
         break;
     }
 
-    //打印时间和msg
-    std::cout<<Timestamp::now().toString()<<":"<<msg<<std::endl;
+    //打印时间(精确到微秒)和msg 整行格式化好以后一次交给输出函数
+    char timebuf[64];
+    Timestamp::now().formatTo(timebuf, sizeof timebuf);
+    char line[1200];
+    int n = snprintf(line, sizeof line, "%s%s:%s\n", prefix, timebuf, msg);
+    if (n >= static_cast<int>(sizeof line))
+    {
+        n = sizeof line - 1;
+        line[n - 1] = '\n';
+    }
+    output_(line, n);
 
-}
\ No newline at end of file
+    //FATAL之后进程马上就退出了 异步日志里面还没写出去的要先写完
+    if (level == FATAL)
+    {
+        flush();
+    }
+}
+
+void Logger::flush()
+{
+    if (flush_)
+    {
+        flush_();
+    }
+}
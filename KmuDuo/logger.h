@@ -1,77 +1,86 @@
 #pragma once
 
 #include <string>
+#include <functional>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include "noncopyable.h"
-//log_debug 的宏开关
-#define MUDEBUG =1;
 
-// 定义日志级别 INFO ERROR FATAL DEBUG
+// 定义日志级别 按严重程度从低到高 DEBUG INFO ERROR FATAL
+// 数值在编译期的日志级别MUDUO_LOG_COMPILE_LEVEL里面也要用
 enum logLevel
 {
-    INFO,  // 普通信息
-    ERROR, // 错误信息
-    FATAL, // core信息
-    DEBUG, // 调试信息
+    DEBUG = 0, // 调试信息
+    INFO = 1,  // 普通信息
+    ERROR = 2, // 错误信息
+    FATAL = 3, // core信息
 };
 
-//LOG_INFO("%s %d",arg1,arg2)
-#define LOG_INFO(logmsgFormat,...)\
-do \
-{  \
-    Logger & logger = Logger::instance();\
-    logger.setLogLevel(INFO);\
-    char buf[1024]={0};\
-    snprintf(buf,1024,logmsgFormat,##__VA_ARGS__);\
-    logger.log(buf);\
-}while(0)
+// 编译期的最低日志级别 低于它的LOG_XXX整个被编译器优化掉 比如 -DMUDUO_LOG_COMPILE_LEVEL=2 只保留ERROR和FATAL
+// 没有定义MUDEBUG的时候 默认去掉LOG_DEBUG 要调试日志就在编译的时候加 -DMUDEBUG(比如cmake -DCMAKE_CXX_FLAGS=-DMUDEBUG)
+#ifndef MUDUO_LOG_COMPILE_LEVEL
+#ifdef MUDEBUG
+#define MUDUO_LOG_COMPILE_LEVEL 0
+#else
+#define MUDUO_LOG_COMPILE_LEVEL 1
+#endif
+#endif
 
-#define LOG_ERROR(logmsgFormat,...)\
+// 先检查编译期级别(常量 直接折叠掉) 再检查运行时级别(一次relaxed的原子读) 都通过了才格式化
+// 这条日志的级别作为参数传给log 不再写到Logger单例里面(多个io线程同时写日志会互相覆盖)
+#define MUDUO_LOG(level, logmsgFormat, ...)\
 do \
 {  \
-    Logger & logger = Logger::instance();\
-    logger.setLogLevel(ERROR);\
-    char buf[1024]={0};\
-    snprintf(buf,1024,logmsgFormat,##__VA_ARGS__);\
-    logger.log(buf);\
+    if ((level) >= MUDUO_LOG_COMPILE_LEVEL && Logger::enabled(level))\
+    {  \
+        char buf[1024];\
+        snprintf(buf,1024,logmsgFormat,##__VA_ARGS__);\
+        Logger::instance().log(level,buf);\
+    }  \
 }while(0)
 
+//LOG_INFO("%s %d",arg1,arg2)
+#define LOG_INFO(logmsgFormat,...) MUDUO_LOG(INFO,logmsgFormat,##__VA_ARGS__)
+
+#define LOG_ERROR(logmsgFormat,...) MUDUO_LOG(ERROR,logmsgFormat,##__VA_ARGS__)
+
 #define LOG_FATAL(logmsgFormat,...)\
 do \
 {  \
-    Logger & logger = Logger::instance();\
-    logger.setLogLevel(FATAL);\
-    char buf[1024]={0};\
-    snprintf(buf,1024,logmsgFormat,##__VA_ARGS__);\
-    logger.log(buf);\
+    MUDUO_LOG(FATAL,logmsgFormat,##__VA_ARGS__);\
     exit(-1);\
 }while(0)
 
-#ifdef MUDEBUG
-#define LOG_DEBUG(logmsgFormat,...)\
-do \
-{  \
-    Logger & logger = Logger::instance();\
-    logger.setLogLevel(DEBUG);\
-    char buf[1024]={0};\
-    snprintf(buf,1024,logmsgFormat,##__VA_ARGS__);\
-    logger.log(buf);\
-}while(0)
-#else
-
-#endif
+#define LOG_DEBUG(logmsgFormat,...) MUDUO_LOG(DEBUG,logmsgFormat,##__VA_ARGS__)
 
 // 输出一个日志类
 class Logger : noncopyable
 {
 public:
+    // 一行格式化好的日志(带换行)交给输出函数  默认写到stdout
+    using OutputFunc = std::function<void(const char *msg, size_t len)>;
+    using FlushFunc = std::function<void()>;
+
     // 获取日志唯一的实例对象
     static Logger &instance();
-    // 设置日志级别
-    void setLogLevel(int level);
+    // 设置运行时的最低日志级别 低于它的日志连格式化都不做 任意线程随时可以调用
+    static void setLogLevel(int level) { minLevel_.store(level, std::memory_order_relaxed); }
+    static int logLevel() { return minLevel_.load(std::memory_order_relaxed); }
+    static bool enabled(int level) { return level >= minLevel_.load(std::memory_order_relaxed); }
+
     // 写日志
-    void log(std::string msg);
+    void log(int level, const char *msg);
+
+    // 设置日志的输出位置 比如AsyncLogging::append 程序启动的时候设置 不要在写日志的过程中改
+    void setOutput(const OutputFunc &out) { output_ = out; }
+    void setFlush(const FlushFunc &flush) { flush_ = flush; }
+    void flush();
+
 private:
-    int logLevel_;
-    Logger() {}
-};
\ No newline at end of file
+    static std::atomic<int> minLevel_;
+    OutputFunc output_;
+    FlushFunc flush_;
+    Logger();
+};